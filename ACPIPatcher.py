@@ -10,9 +10,12 @@ import os
 import sys
 import subprocess
 import platform
+import struct
 import shutil
 import argparse
 import logging
+import re
+import tempfile
 
 # Configure logging
 logging.basicConfig(level=logging.INFO, format='%(levelname)s: %(message)s')
@@ -484,6 +487,7 @@ class ACPIPatcherBuilder:
                 
             # Copy output files
             build_output_dir = os.path.join(self.edk2_path, 'Build', 'ACPIPatcher', f'{self.build_type}_{toolchain}', self.arch)
+            self.build_output_dir = build_output_dir
             
             output_files = [
                 'ACPIPatcher.efi',
@@ -500,6 +504,16 @@ class ACPIPatcherBuilder:
                     logging.info(f"✓ {output_file} copied ({file_size:,} bytes)")
                 else:
                     logging.warning(f"Output file not found: {output_file}")
+
+            # Message catalog for decoding ACPI_PATCHER_BINARY_LOG serial captures
+            catalog_path = os.path.join(self.workspace, 'ACPIPatcher.logcat.json')
+            catalog_cmd = [sys.executable, os.path.join(self.workspace, 'Tools', 'AcpiBinLog.py'),
+                           'catalog', os.path.join(self.package_path, 'ACPIPatcher'),
+                           '-o', catalog_path]
+            if subprocess.run(catalog_cmd, capture_output=True).returncode == 0:
+                logging.info("✓ ACPIPatcher.logcat.json generated")
+            else:
+                logging.warning("Could not generate the binary log catalog")
                     
             logging.info("✓ Build completed successfully")
             return True
@@ -507,6 +521,79 @@ class ACPIPatcherBuilder:
         finally:
             os.chdir(original_cwd)
             
+    def embed_acpi_tables(self, table_dir):
+        """Pack the tables in table_dir into RAW sections of ACPIPatcherDxe.ffs
+
+        The driver reads them back through its own FILE_GUID at entry
+        (AcpiEmbedded.h), so it patches without waiting for a file system.
+        Tables go in the order the directory scan would load them, and a
+        packed .aml.lz is embedded decoded: the FDF can compress the file.
+        Put ACPIPatcherDxe.ffs in the firmware volume in place of the
+        driver built from the INF.
+        """
+        sys.path.insert(0, os.path.join(self.workspace, 'Tools'))
+        from AcpiCompress import is_table_name, read_table
+        from AcpiManifest import load_order
+
+        names = load_order([name for name in os.listdir(table_dir)
+                            if is_table_name(name) and os.path.isfile(os.path.join(table_dir, name))])
+        if not names:
+            logging.error(f"No ACPI tables in {table_dir}")
+            return False
+
+        inf_path = os.path.join(self.package_path, 'ACPIPatcher', 'ACPIPatcherDxe.inf')
+        with open(inf_path) as inf:
+            file_guid = re.search(r'^\s*FILE_GUID\s*=\s*([0-9A-Fa-f-]+)', inf.read(), re.MULTILINE).group(1)
+
+        if platform.system() == "Windows":
+            basetools_bin = os.path.join(self.edk2_path, 'BaseTools', 'Bin', 'Win32')
+        else:
+            basetools_bin = os.path.join(self.edk2_path, 'BaseTools', 'Source', 'C', 'bin')
+        gensec = os.path.join(basetools_bin, 'GenSec')
+        genffs = os.path.join(basetools_bin, 'GenFfs')
+
+        module_dir = os.path.join(self.build_output_dir, 'ACPIPatcherPkg', 'ACPIPatcher', 'ACPIPatcherDxe', 'OUTPUT')
+        image = os.path.join(module_dir, 'ACPIPatcherDxe.efi')
+        depex = os.path.join(module_dir, 'ACPIPatcherDxe.depex')
+        ffs_path = os.path.join(self.workspace, 'ACPIPatcherDxe.ffs')
+
+        with tempfile.TemporaryDirectory() as work:
+            # The sections a driver file normally has, then one per table
+            sections = [
+                ('EFI_SECTION_DXE_DEPEX', depex, []),
+                ('EFI_SECTION_PE32', image, []),
+                ('EFI_SECTION_USER_INTERFACE', None, ['-n', 'ACPIPatcherDxe']),
+            ]
+            for index, name in enumerate(names):
+                try:
+                    table = read_table(os.path.join(table_dir, name))
+                except (ValueError, IndexError, struct.error) as error:
+                    logging.error(f"{name}: {error}")
+                    return False
+                table_path = os.path.join(work, f'table{index}.aml')
+                with open(table_path, 'wb') as handle:
+                    handle.write(table)
+                sections.append(('EFI_SECTION_RAW', table_path, []))
+
+            inputs = []
+            for index, (kind, source, extra) in enumerate(sections):
+                section_path = os.path.join(work, f'section{index}.sec')
+                cmd = [gensec, '-s', kind, '-o', section_path] + extra + ([source] if source else [])
+                if subprocess.run(cmd).returncode != 0:
+                    logging.error(f"GenSec failed for {source or kind}")
+                    return False
+                inputs += ['-i', section_path]
+
+            cmd = [genffs, '-t', 'EFI_FV_FILETYPE_DRIVER', '-g', file_guid, '-o', ffs_path] + inputs
+            if subprocess.run(cmd).returncode != 0:
+                logging.error("GenFfs failed")
+                return False
+
+        logging.info(f"✓ ACPIPatcherDxe.ffs written with {len(names)} embedded tables ({os.path.getsize(ffs_path):,} bytes)")
+        for name in names:
+            logging.info(f"  {name}")
+        return True
+
     def verify_critical_tools(self):
         """Verify that critical BaseTools are available and attempt to build them if missing"""
         logging.info("Verifying critical BaseTools availability...")
@@ -588,6 +675,8 @@ def main():
     parser.add_argument('--build-type', '-b', default='RELEASE', choices=['RELEASE', 'DEBUG'],
                         help='Build type (default: RELEASE)')
     parser.add_argument('--toolchain', '-t', help='Toolchain to use (auto-detected if not specified)')
+    parser.add_argument('--embed', metavar='DIR',
+                        help='After building, write ACPIPatcherDxe.ffs with the tables in DIR embedded')
     
     args = parser.parse_args()
     
@@ -606,6 +695,8 @@ def main():
         
     if args.build:
         success = builder.build_acpi_patcher()
+        if success and args.embed:
+            success = builder.embed_acpi_tables(args.embed)
         sys.exit(0 if success else 1)
     else:
         parser.print_help()
@@ -6,127 +6,59 @@
 #include <Library/BaseMemoryLib.h>
 #include <Library/PrintLib.h>
 #include <Library/DebugLib.h>
-#include <Library/SerialPortLib.h>
 
 #include <Guid/Acpi.h>
 #include <Guid/FileInfo.h>
 
+#define ACPI_LOG_FILE_ID  1
+
+#include "AcpiBundle.h"
+#include "AcpiChecksum.h"
+#include "AcpiDirHint.h"
+#include "AcpiEmbedded.h"
+#include "AcpiLz.h"
+#include "AcpiManifest.h"
+#include "BootCache.h"
+#include "DebugLog.h"
+#include "DirSnapshot.h"
 #include "FsHelpers.h"
-
-// Debug output macros for DXE driver
-#ifdef DXE_DRIVER_BUILD
-STATIC EFI_FILE_PROTOCOL *gDebugLogFile = NULL;
-
-EFI_STATUS
-InitializeDebugLog (
-  VOID
-  )
-{
-  EFI_STATUS Status;
-  UINTN HandleCount;
-  EFI_HANDLE *HandleBuffer;
-  EFI_SIMPLE_FILE_SYSTEM_PROTOCOL *FileSystem;
-  EFI_FILE_PROTOCOL *RootDir;
-  
-  // Find the first available file system (usually ESP)
-  Status = gBS->LocateHandleBuffer(
-    ByProtocol,
-    &gEfiSimpleFileSystemProtocolGuid,
-    NULL,
-    &HandleCount,
-    &HandleBuffer
-  );
-  
-  if (EFI_ERROR(Status) || HandleCount == 0) {
-    return Status;
-  }
-  
-  Status = gBS->HandleProtocol(
-    HandleBuffer[0],
-    &gEfiSimpleFileSystemProtocolGuid,
-    (VOID**)&FileSystem
-  );
-  
-  if (EFI_ERROR(Status)) {
-    FreePool(HandleBuffer);
-    return Status;
-  }
-  
-  Status = FileSystem->OpenVolume(FileSystem, &RootDir);
-  if (EFI_ERROR(Status)) {
-    FreePool(HandleBuffer);
-    return Status;
-  }
-  
-  // Create/open debug log file
-  Status = RootDir->Open(
-    RootDir,
-    &gDebugLogFile,
-    L"ACPIPatcher_Debug.log",
-    EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE | EFI_FILE_MODE_CREATE,
-    0
-  );
-  
-  RootDir->Close(RootDir);
-  FreePool(HandleBuffer);
-  
-  if (!EFI_ERROR(Status)) {
-    CHAR8 InitMsg[] = "\r\n=== ACPIPatcher DXE Driver Debug Log ===\r\n";
-    UINTN WriteSize = AsciiStrLen(InitMsg);
-    gDebugLogFile->Write(gDebugLogFile, &WriteSize, InitMsg);
-  }
-  
-  return Status;
-}
-
-VOID
-WriteDebugLog (
-  IN CONST CHAR16 *Format,
-  ...
-  )
-{
-  if (gDebugLogFile == NULL) {
-    return;
-  }
-  
-  VA_LIST Args;
-  CHAR16 WideBuffer[512];
-  CHAR8 Buffer[512];
-  UINTN Length;
-  UINTN Index;
-  
-  VA_START(Args, Format);
-  Length = UnicodeVSPrint(WideBuffer, sizeof(WideBuffer), Format, Args);
-  VA_END(Args);
-  
-  // Convert to ASCII for file output
-  for (Index = 0; Index < Length && Index < (sizeof(Buffer) - 1); Index++) {
-    Buffer[Index] = (CHAR8)(WideBuffer[Index] & 0xFF);
-  }
-  Buffer[Index] = '\0';
-  
-  Length = AsciiStrLen(Buffer);
-  gDebugLogFile->Write(gDebugLogFile, &Length, Buffer);
-  gDebugLogFile->Flush(gDebugLogFile);
-  gDebugLogFile->Flush(gDebugLogFile);
-}
-
-#define DXE_DEBUG(Format, ...) WriteDebugLog(Format, ##__VA_ARGS__)
-#define DXE_DEBUG_INIT() InitializeDebugLog()
-#else
-#define DXE_DEBUG(Format, ...) Print(Format, ##__VA_ARGS__)
-#define DXE_DEBUG_INIT() 
-#endif
+#include "TableArena.h"
+#include "XsdtIndex.h"
+#include "XsdtPlan.h"
 
 //
 // Constants
 //
 #define ACPI_PATCHER_VERSION_MAJOR    1
 #define ACPI_PATCHER_VERSION_MINOR    1
-#define MAX_ADDITIONAL_TABLES         16
 #define FILE_NAME_BUFFER_SIZE         512
 #define DSDT_FILE_NAME                L"DSDT.aml"
 
+//
+// Largest table loaded from disk, after decoding.  Anything bigger is
+// taken to be a stray file rather than ACPI, and is skipped before the
+// arena is sized for it.
+//
+#define ACPI_TABLE_MAX_SIZE           SIZE_16MB
+
+//
+// Plain .aml files larger than this have their header read and checked
+// before anything is allocated for them, so a large file that is not the
+// table it claims to be costs one small Read().  Smaller files are read
+// whole and checked afterwards.
+//
+#define ACPI_HEADER_PROBE_SIZE        SIZE_64KB
+
+//
+// Entries the firmware XSDT may gain before the driver commits at
+// ReadyToBoot; the arena keeps room for them in the new XSDT.
+//
+#ifdef DXE_DRIVER_BUILD
+#define ACPI_XSDT_SPARE_ENTRIES       32
+#else
+#define ACPI_XSDT_SPARE_ENTRIES       0
+#endif
+
 //
 // Helper macros
 //
@@ -150,27 +82,117 @@ EFI_ACPI_2_0_ROOT_SYSTEM_DESCRIPTION_POINTER  *gRsdp = NULL;
 EFI_ACPI_DESCRIPTION_HEADER                    *gXsdt = NULL;
 EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE      *gFacp = NULL;
 
+// Index of gXsdt, built once by FindFadtInXsdt() and used for every lookup
+XSDT_INDEX                                     gXsdtIndex;
+
 // Global variables for both UEFI Application and DXE Driver builds
 EFI_HANDLE                                     gAcpiPatcherImageHandle = NULL;
 EFI_SYSTEM_TABLE                               *gAcpiPatcherSystemTable = NULL;
 
+//
+// An AML file being read.  The table is allocated at the size the
+// snapshot gives for the file and only checked once the read completes.
+// A compressed file is read into Packed instead, and the table only
+// allocated once its header gives the decoded size.
+//
+typedef struct {
+  CONST DIR_SNAPSHOT_ENTRY     *Entry;
+  // NULL if the file could not be opened, or there was nothing to read
+  EFI_FILE_PROTOCOL            *File;
+  EFI_ACPI_DESCRIPTION_HEADER  *Table;
+  VOID                         *Packed;
+  FS_ASYNC_READ                Read;
+} ACPI_TABLE_READ;
+
+//
+// How many files are read ahead of the one being planned.
+//
+#define ACPI_READ_AHEAD  8
+
+//
+// A plan being built.  The tables still to load are a queue of snapshot
+// entries, or the manifest's own entries; each step loads, checks and
+// plans one of them.  The application runs every step at once, the
+// driver a slice of them per timer tick.
+//
+typedef struct {
+  DIR_SNAPSHOT                 *Snapshot;
+  ACPI_MANIFEST                *Manifest;
+  // Firmware XSDT the boot cache fingerprint is taken from
+  EFI_ACPI_DESCRIPTION_HEADER  *Xsdt;
+  TABLE_ARENA                  Arena;
+  XSDT_PLAN                    Plan;
+  // Load order for a scan; NULL for a manifest or a bundle
+  DIR_SNAPSHOT_ENTRY           **Queue;
+  // Queue or manifest entries, the next one to plan and the next one to
+  // start reading
+  UINTN                        Count;
+  UINTN                        Next;
+  UINTN                        Issued;
+  UINTN                        AmlCount;
+  // Reads in flight, entry Next onwards, by entry number modulo
+  // ACPI_READ_AHEAD.  The file system driver holds on to them, so the
+  // job must not move once reading has started.
+  ACPI_TABLE_READ              Reads[ACPI_READ_AHEAD];
+} ACPI_PLAN_JOB;
+
 #ifdef DXE_DRIVER_BUILD
+//
+// How much of the ACPI files the driver reads per timer tick, in KB, and
+// how often the timer fires.  At least one file is read per tick.
+//
+#ifndef ACPI_PATCHER_SLICE_KB
+#define ACPI_PATCHER_SLICE_KB  64
+#endif
+#define ACPI_PLAN_TICK_MS      1
+
+//
+// How long the driver waits for the boot volume or an ESP to show up once
+// it has found ACPI files on another volume, in milliseconds.
+//
+#ifndef ACPI_PATCHER_DISCOVERY_DEADLINE_MS
+#define ACPI_PATCHER_DISCOVERY_DEADLINE_MS  2000
+#endif
+
+//
+// The ACPI files directory chosen so far.  It is kept across file system
+// notifications, so each new volume only adds its own candidates.
+//
+typedef struct {
+  DIR_SNAPSHOT    Best;
+  UINTN           FileCount;
+  UINT32          Priority;
+  // Where Best is, to remember it for the next boot; NULL if it came from
+  // the last boot's record
+  EFI_HANDLE      Volume;
+  CONST CHAR16    *Path;
+  FS_VOLUME_RANK  Rank;
+  // Best cannot be beaten: .aml files in a volume root, or the directory
+  // remembered from the last boot
+  BOOLEAN         Final;
+  // Volumes searched, for the log
+  UINTN           VolumeCount;
+} ACPI_DIR_SEARCH;
+
 // DXE Driver specific globals for delayed file system access
 EFI_EVENT                                      gFileSystemReadyEvent = NULL;
 VOID                                           *gFileSystemProtocolNotifyReg = NULL;
 BOOLEAN                                        gFileSystemReady = FALSE;
+EFI_EVENT                                      gAcpiDiscoveryDeadlineEvent = NULL;
+STATIC ACPI_DIR_SEARCH                         mAcpiDirSearch;
+
+// The plan being loaded by the timer, or waiting for ReadyToBoot to be
+// put in the XSDT, with the snapshot or manifest it loads from
+EFI_EVENT                                      gAcpiPlanTimerEvent = NULL;
+EFI_EVENT                                      gAcpiCommitEvent = NULL;
+STATIC ACPI_PLAN_JOB                           mAcpiPlanJob;
+STATIC DIR_SNAPSHOT                            mAcpiPlanSnapshot;
+STATIC ACPI_MANIFEST                           mAcpiPlanManifest;
 #endif
 
 //
 // Function prototypes
 //
-VOID
-AcpiDebugPrint (
-  IN UINTN       Level,
-  IN CONST CHAR16 *Format,
-  ...
-  );
-
 EFI_STATUS
 FindFadtInXsdt (
   VOID
@@ -183,6 +205,59 @@ PatchAcpiTables (
   IN EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE *Facp
   );
 
+EFI_STATUS
+PatchAcpiTablesFromSnapshot (
+  IN OUT DIR_SNAPSHOT                  *Snapshot  OPTIONAL,
+  IN OUT ACPI_MANIFEST                 *Manifest  OPTIONAL,
+  IN ACPI_BUNDLE                       *Bundle    OPTIONAL,
+  IN EFI_ACPI_DESCRIPTION_HEADER       *Xsdt,
+  IN EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE *Facp
+  );
+
+STATIC
+EFI_STATUS
+PatchAcpiTablesFromBundle (
+  IN EFI_FILE_PROTOCOL                 *Directory,
+  IN EFI_ACPI_DESCRIPTION_HEADER       *Xsdt,
+  IN EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE *Facp
+  );
+
+STATIC
+EFI_STATUS
+PatchAcpiTablesFromCache (
+  IN DIR_SNAPSHOT                      *Snapshot,
+  IN EFI_ACPI_DESCRIPTION_HEADER       *Xsdt,
+  IN EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE *Facp
+  );
+
+STATIC
+BOOLEAN
+PlanNextAcpiTables (
+  IN OUT ACPI_PLAN_JOB                 *Job,
+  IN     UINTN                         Budget
+  );
+
+STATIC
+VOID
+EndAcpiPlan (
+  IN OUT ACPI_PLAN_JOB                 *Job
+  );
+
+STATIC
+UINTN
+CommitAcpiPlan (
+  IN OUT XSDT_PLAN                     *Plan,
+  IN OUT TABLE_ARENA                   *Arena,
+  IN EFI_ACPI_DESCRIPTION_HEADER       *Xsdt,
+  IN EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE *Facp
+  );
+
+EFI_STATUS
+CreateAcpiDirSnapshot (
+  IN  EFI_FILE_PROTOCOL                *Directory,
+  OUT DIR_SNAPSHOT                     *Snapshot
+  );
+
 #ifdef DXE_DRIVER_BUILD
 //
 // DXE Driver specific function prototypes
@@ -199,28 +274,82 @@ WaitForFileSystemReady (
   VOID
   );
 
+STATIC
+VOID
+StartAcpiDiscovery (
+  VOID
+  );
+
+STATIC
+VOID
+ArmAcpiDiscoveryDeadline (
+  VOID
+  );
+
 EFI_STATUS
 PerformDelayedAcpiPatching (
+  IN OUT DIR_SNAPSHOT  *Snapshot
+  );
+
+STATIC
+EFI_STATUS
+LocateFirmwareAcpiTables (
   VOID
   );
 
-EFI_FILE_PROTOCOL *
-FindAcpiFilesDirectory (
+STATIC
+EFI_STATUS
+PatchAcpiTablesFromFv (
+  VOID
+  );
+
+STATIC
+EFI_STATUS
+ScheduleAcpiPlan (
+  IN OUT ACPI_PLAN_JOB  *Job,
+  IN OUT DIR_SNAPSHOT   *Snapshot  OPTIONAL,
+  IN OUT ACPI_MANIFEST  *Manifest  OPTIONAL
+  );
+
+STATIC
+VOID
+FinishAcpiPlanLoad (
   VOID
   );
+
+STATIC
+VOID
+EFIAPI
+OnAcpiPlanTick (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  );
+
+STATIC
+VOID
+EFIAPI
+OnReadyToBootCommit (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  );
+
+STATIC
+VOID
+SearchVolumeForAcpiFiles (
+  IN     EFI_HANDLE       Volume,
+  IN     FS_VOLUME_RANK   Rank,
+  IN OUT ACPI_DIR_SEARCH  *Search
+  );
+
+EFI_STATUS
+FindAcpiFilesDirectory (
+  IN OUT ACPI_DIR_SEARCH  *Search
+  );
 #endif
 
 //
 // Helper functions for actual patching
 //
-EFI_STATUS
-LoadAmlFileFromDisk (
-  IN  EFI_FILE_PROTOCOL               *Directory,
-  IN  CONST CHAR16                    *FileName,
-  OUT EFI_ACPI_DESCRIPTION_HEADER     **AmlTable,
-  OUT UINTN                          *TableSize
-  );
-
 EFI_STATUS
 ValidateAcpiTable (
   IN EFI_ACPI_DESCRIPTION_HEADER *Table
@@ -235,107 +364,22 @@ CalculateAcpiChecksum (
 EFI_STATUS
 ReplaceAcpiTableInXsdt (
   IN OUT EFI_ACPI_DESCRIPTION_HEADER   *Xsdt,
+  IN     CONST XSDT_INDEX              *Index,
   IN     UINT32                        TableSignature,
   IN     EFI_ACPI_DESCRIPTION_HEADER   *NewTable
   );
 
 EFI_STATUS
 ScanDirectoryForSsdtFiles (
-  IN     EFI_FILE_PROTOCOL             *Directory,
-  IN OUT EFI_ACPI_DESCRIPTION_HEADER   *Xsdt,
-  IN OUT UINT32                        *MaxEntries,
-  IN OUT UINTN                         *TablesPatched
+  IN     DIR_SNAPSHOT                  *Snapshot,
+  IN     TABLE_ARENA                   *Arena,
+  IN OUT XSDT_PLAN                     *Plan
   );
 
 //
 // Function implementations
 //
 
-/**
-  Load an AML file from disk into memory.
-  
-  @param[in]  Directory   File system directory to search
-  @param[in]  FileName    Name of the AML file to load
-  @param[out] AmlTable    Pointer to loaded table (caller must free)
-  @param[out] TableSize   Size of the loaded table
-  
-  @retval EFI_SUCCESS     File loaded successfully
-  @retval EFI_NOT_FOUND   File not found
-  @retval Other           Error loading file
-**/
-EFI_STATUS
-LoadAmlFileFromDisk (
-  IN  EFI_FILE_PROTOCOL               *Directory,
-  IN  CONST CHAR16                    *FileName,
-  OUT EFI_ACPI_DESCRIPTION_HEADER     **AmlTable,
-  OUT UINTN                          *TableSize
-  )
-{
-  EFI_STATUS          Status;
-  EFI_FILE_PROTOCOL   *FileHandle;
-  EFI_FILE_INFO       *FileInfo;
-  UINTN               FileInfoSize;
-  VOID                *FileBuffer;
-
-  DXE_DEBUG(L"[INFO]  Loading AML file: %s\r\n", FileName);
-
-  // Try to open the file
-  Status = FsOpenFile(Directory, (CHAR16*)FileName, &FileHandle);
-  if (EFI_ERROR(Status)) {
-    DXE_DEBUG(L"[WARN]  File %s not found, skipping\r\n", FileName);
-    return Status;
-  }
-
-  // Get file information to determine size
-  FileInfoSize = sizeof(EFI_FILE_INFO) + 512;
-  FileInfo = AllocateZeroPool(FileInfoSize);
-  if (FileInfo == NULL) {
-    FileHandle->Close(FileHandle);
-    return EFI_OUT_OF_RESOURCES;
-  }
-
-  Status = FileHandle->GetInfo(FileHandle, &gEfiFileInfoGuid, &FileInfoSize, FileInfo);
-  if (EFI_ERROR(Status)) {
-    DXE_DEBUG(L"[ERROR] Failed to get file info for %s: %r\r\n", FileName, Status);
-    FreePool(FileInfo);
-    FileHandle->Close(FileHandle);
-    return Status;
-  }
-
-  *TableSize = (UINTN)FileInfo->FileSize;
-  DXE_DEBUG(L"[INFO]  File size: %d bytes\r\n", *TableSize);
-
-  // Read the file into memory
-  Status = FsReadFileToBuffer(FileHandle, *TableSize, &FileBuffer);
-  if (EFI_ERROR(Status)) {
-    DXE_DEBUG(L"[ERROR] Failed to read file %s: %r\r\n", FileName, Status);
-    FreePool(FileInfo);
-    FileHandle->Close(FileHandle);
-    return Status;
-  }
-
-  *AmlTable = (EFI_ACPI_DESCRIPTION_HEADER*)FileBuffer;
-  
-  // Validate that this is a proper ACPI table
-  Status = ValidateAcpiTable(*AmlTable);
-  if (EFI_ERROR(Status)) {
-    DXE_DEBUG(L"[ERROR] Invalid ACPI table in file %s\r\n", FileName);
-    FreePool(FileBuffer);
-    FreePool(FileInfo);
-    FileHandle->Close(FileHandle);
-    return Status;
-  }
-
-  CHAR8 Signature[5];
-  CopyMem(Signature, &(*AmlTable)->Signature, 4);
-  Signature[4] = '\0';
-  DXE_DEBUG(L"[INFO]  Successfully loaded '%a' table, %d bytes\r\n", Signature, (*AmlTable)->Length);
-
-  FreePool(FileInfo);
-  FileHandle->Close(FileHandle);
-  return EFI_SUCCESS;
-}
-
 /**
   Validate an ACPI table structure and checksum.
   
@@ -356,18 +400,18 @@ ValidateAcpiTable (
 
   // Check minimum table size
   if (Table->Length < sizeof(EFI_ACPI_DESCRIPTION_HEADER)) {
-    DXE_DEBUG(L"[ERROR] Table too small: %d bytes\r\n", Table->Length);
+    DXE_DEBUG(DEBUG_ERROR, L"[ERROR] Table too small: %d bytes\r\n", Table->Length);
     return EFI_INVALID_PARAMETER;
   }
 
   // Validate checksum
   UINT8 CalculatedChecksum = CalculateAcpiChecksum((UINT8*)Table, Table->Length);
   if (CalculatedChecksum != 0) {
-    DXE_DEBUG(L"[ERROR] Checksum validation failed: expected 0, got 0x%02x\r\n", CalculatedChecksum);
+    DXE_DEBUG(DEBUG_ERROR, L"[ERROR] Checksum validation failed: expected 0, got 0x%02x\r\n", CalculatedChecksum);
     return EFI_CRC_ERROR;
   }
 
-  DXE_DEBUG(L"[INFO]  Table validation passed\r\n");
+  DXE_DEBUG(DEBUG_VERBOSE, L"[INFO]  Table validation passed\r\n");
   return EFI_SUCCESS;
 }
 
@@ -385,20 +429,18 @@ CalculateAcpiChecksum (
   IN UINTN  Length
   )
 {
-  UINT8 Sum = 0;
-  UINTN Index;
-
-  for (Index = 0; Index < Length; Index++) {
-    Sum += Buffer[Index];
-  }
-
-  return Sum;
+  return AcpiChecksumSum(Buffer, Length);
 }
 
 /**
   Replace an ACPI table in the XSDT.
+
+  SSDTs are matched on their OEM Table ID as well as the signature, so a
+  patched copy of one firmware SSDT replaces exactly that one.  The XSDT
+  checksum is adjusted for the new entry rather than recomputed.
   
   @param[in,out] Xsdt           Pointer to XSDT to modify
+  @param[in]     Index          Index of Xsdt
   @param[in]     TableSignature Signature of table to replace
   @param[in]     NewTable       Pointer to new table
   
@@ -408,215 +450,447 @@ CalculateAcpiChecksum (
 EFI_STATUS
 ReplaceAcpiTableInXsdt (
   IN OUT EFI_ACPI_DESCRIPTION_HEADER   *Xsdt,
+  IN     CONST XSDT_INDEX              *Index,
   IN     UINT32                        TableSignature,
   IN     EFI_ACPI_DESCRIPTION_HEADER   *NewTable
   )
 {
-  UINT32  EntryCount;
-  UINT64  *EntryPtr;
-  UINTN   Index;
-  EFI_ACPI_DESCRIPTION_HEADER *Entry;
+  UINTN   Position;
+  XSDT_INDEX_ENTRY *Entry;
   CHAR8   SigStr[5];
 
-  EntryCount = (Xsdt->Length - sizeof(EFI_ACPI_DESCRIPTION_HEADER)) / sizeof(UINT64);
-  EntryPtr = (UINT64 *)(Xsdt + 1);
-
   CopyMem(SigStr, &TableSignature, 4);
   SigStr[4] = '\0';
-  DXE_DEBUG(L"[INFO]  Searching for table '%a' to replace\r\n", SigStr);
-
-  for (Index = 0; Index < EntryCount; Index++) {
-    Entry = (EFI_ACPI_DESCRIPTION_HEADER *)(UINTN)EntryPtr[Index];
-    if (Entry != NULL && Entry->Signature == TableSignature) {
-      DXE_DEBUG(L"[INFO]  Found table '%a' at index %d, replacing\r\n", SigStr, Index);
-      DXE_DEBUG(L"[INFO]  Old table: %d bytes at " PTR_FMT L"\r\n", Entry->Length, PTR_TO_INT(Entry));
-      DXE_DEBUG(L"[INFO]  New table: %d bytes at " PTR_FMT L"\r\n", NewTable->Length, PTR_TO_INT(NewTable));
-      
-      // Replace the pointer
-      EntryPtr[Index] = (UINT64)(UINTN)NewTable;
-      
-      DXE_DEBUG(L"[INFO]  Table '%a' successfully replaced\r\n", SigStr);
-      return EFI_SUCCESS;
-    }
+  DXE_DEBUG(DEBUG_VERBOSE, L"[INFO]  Searching for table '%a' to replace\r\n", SigStr);
+
+  if (TableSignature == EFI_ACPI_2_0_SECONDARY_SYSTEM_DESCRIPTION_TABLE_SIGNATURE) {
+    Entry = XsdtIndexFind(Index, TableSignature, &NewTable->OemTableId, NULL, NULL);
+  } else {
+    Entry = XsdtIndexFind(Index, TableSignature, NULL, NULL, NULL);
+  }
+
+  if (Entry != NULL) {
+    Position = XSDT_INDEX_POSITION(Index, Entry);
+    DXE_DEBUG(DEBUG_INFO, L"[INFO]  Found table '%a' at index %d, replacing\r\n", SigStr, Position);
+    DXE_DEBUG(DEBUG_VERBOSE, L"[INFO]  Old table: %d bytes at " PTR_FMT L"\r\n", Entry->Table->Length, PTR_TO_INT(Entry->Table));
+    DXE_DEBUG(DEBUG_VERBOSE, L"[INFO]  New table: %d bytes at " PTR_FMT L"\r\n", NewTable->Length, PTR_TO_INT(NewTable));
+    
+    // Replace the pointer
+    AcpiTableReplaceEntry(Xsdt, Position, (UINT64)(UINTN)NewTable);
+    
+    DXE_DEBUG(DEBUG_INFO, L"[INFO]  Table '%a' successfully replaced\r\n", SigStr);
+    return EFI_SUCCESS;
   }
 
-  DXE_DEBUG(L"[WARN]  Table '%a' not found in XSDT\r\n", SigStr);
+  DXE_DEBUG(DEBUG_WARN, L"[WARN]  Table '%a' not found in XSDT\r\n", SigStr);
   return EFI_NOT_FOUND;
 }
 
 /**
-  Simplified AML file loader using existing file system helpers.
+  Checks the header of an AML file: the signature must be four ACPI name
+  characters and Length must cover the header and match the size of the
+  file exactly.
 **/
+STATIC
 EFI_STATUS
-LoadAmlFile (
-  IN  EFI_FILE_PROTOCOL               *Directory,
-  IN  CONST CHAR16                    *FileName,
-  OUT EFI_ACPI_DESCRIPTION_HEADER     **AmlTable,
-  OUT UINTN                           *TableSize
+CheckAmlHeader (
+  IN CONST EFI_ACPI_DESCRIPTION_HEADER  *Header,
+  IN UINT64                             FileSize,
+  IN CONST CHAR16                       *FileName
   )
 {
-  EFI_STATUS Status;
-  EFI_FILE_PROTOCOL *AcpiDir = NULL;
-  EFI_FILE_PROTOCOL *FileHandle = NULL;
-  VOID *FileBuffer;
-  UINTN FileSize;
+  CONST UINT8 *Signature;
+  UINTN       Index;
+
+  Signature = (CONST UINT8 *)&Header->Signature;
+  for (Index = 0; Index < sizeof(Header->Signature); Index++) {
+    if (!((Signature[Index] >= 'A' && Signature[Index] <= 'Z') ||
+          (Signature[Index] >= '0' && Signature[Index] <= '9') ||
+          Signature[Index] == '_')) {
+      DXE_DEBUG(DEBUG_WARN, L"[WARN]  %s is not an ACPI table, skipping\r\n", FileName);
+      return EFI_UNSUPPORTED;
+    }
+  }
 
-  DXE_DEBUG(L"[INFO]  Attempting to load: %s\r\n", FileName);
-  DXE_DEBUG(L"[INFO]  Using directory handle: %p\r\n", Directory);
-  
-  if (Directory == NULL) {
-    DXE_DEBUG(L"[WARN]  No directory provided, cannot load file\r\n");
-    return EFI_INVALID_PARAMETER;
+  if (Header->Length < sizeof(EFI_ACPI_DESCRIPTION_HEADER) || Header->Length != FileSize) {
+    DXE_DEBUG(DEBUG_WARN, L"[WARN]  %s: header length %d does not match file size %ld, skipping\r\n",
+              FileName, Header->Length, FileSize);
+    return EFI_VOLUME_CORRUPTED;
   }
 
-  // For DXE driver mode, the Directory parameter might already be the ACPI directory
-  // from FindAcpiFilesDirectory(). Try to open the file directly first.
-  Status = FsOpenFile(Directory, (CHAR16*)FileName, &FileHandle);
-  
-  if (!EFI_ERROR(Status)) {
-    DXE_DEBUG(L"[INFO]  Found file in provided directory: %s\r\n", FileName);
+  return EFI_SUCCESS;
+}
+
+/**
+  Releases a table returned by LoadAmlEntry() that was not installed.
+**/
+STATIC
+VOID
+FreeAmlTable (
+  IN TABLE_ARENA                  *Arena,
+  IN EFI_ACPI_DESCRIPTION_HEADER  *Table
+  )
+{
+  if (Arena != NULL) {
+    TableArenaFree(Arena, Table);
   } else {
-    // If direct access failed, try to find ACPI subdirectory (for application mode only)
-    // First check if we might already be in an ACPI directory by trying to open the parent
-    Status = Directory->Open(
-      Directory,
-      &AcpiDir,
-      L"ACPI",
-      EFI_FILE_MODE_READ,
-      0
-    );
-    
+    FreePool(Table);
+  }
+}
+
+/**
+  Returns the most arena space a snapshot entry's table can take, or 0 if
+  the file is too small to hold one or so large that it cannot be ACPI.
+  A compressed table's size is only known once it is read; it is at most
+  ACPI_LZ_MAX_RATIO times its file (AcpiLz.h).
+**/
+STATIC
+UINTN
+AmlEntryTableSize (
+  IN CONST DIR_SNAPSHOT_ENTRY  *Entry
+  )
+{
+  UINT64 Ratio;
+
+  Ratio = Entry->Compressed ? ACPI_LZ_MAX_RATIO : 1;
+  if (Entry->FileSize < (Entry->Compressed ? sizeof(ACPI_LZ_HEADER) : sizeof(EFI_ACPI_DESCRIPTION_HEADER)) ||
+      Entry->FileSize > ACPI_TABLE_MAX_SIZE / Ratio) {
+    return 0;
+  }
+
+  return TABLE_ARENA_SIZE((UINTN)(Entry->FileSize * Ratio));
+}
+
+/**
+  Starts reading an AML file listed in a directory snapshot.
+
+  The whole file is read, in the background where the file system driver
+  supports it, into an allocation of the size the snapshot gives for it.
+  A file that cannot hold an ACPI header, or that is larger than any table
+  (ACPI_TABLE_MAX_SIZE), is not opened at all.  A plain file larger than
+  ACPI_HEADER_PROBE_SIZE has its header read and checked first, and is
+  turned away before the rest is read if it does not match.  A compressed
+  file is read into pool memory, to be decoded into the arena
+  by FinishAmlRead().
+
+  @param[in]  Snapshot   Snapshot of the ACPI files directory
+  @param[in]  Entry      Entry of the file to load
+  @param[in]  Arena      Arena to place the table in, or NULL for pool memory
+  @param[out] Read       Read to start; finish it with FinishAmlRead()
+
+  @retval EFI_SUCCESS   The read was started, or has already completed.
+  @retval Other         Opening or allocating failed.
+**/
+STATIC
+EFI_STATUS
+StartAmlRead (
+  IN  CONST DIR_SNAPSHOT              *Snapshot,
+  IN  CONST DIR_SNAPSHOT_ENTRY        *Entry,
+  IN  TABLE_ARENA                     *Arena,
+  OUT ACPI_TABLE_READ                 *Read
+  )
+{
+  EFI_STATUS Status;
+  EFI_FILE_PROTOCOL *FileHandle = NULL;
+  EFI_ACPI_DESCRIPTION_HEADER Header;
+  UINTN FileSize;
+  UINTN Offset;
+
+  DXE_DEBUG(DEBUG_VERBOSE, L"[INFO]  Attempting to load: %s\r\n", Entry->Name);
+
+  ZeroMem(Read, sizeof(*Read));
+  Read->Entry = Entry;
+
+  if (AmlEntryTableSize(Entry) == 0) {
+    DXE_DEBUG(DEBUG_WARN, L"[WARN]  %s is too small or too large for an ACPI table, skipping\r\n", Entry->Name);
+    Read->Read.Status = EFI_VOLUME_CORRUPTED;
+    return EFI_VOLUME_CORRUPTED;
+  }
+  FileSize = (UINTN)Entry->FileSize;
+
+  Status = DirSnapshotOpen(Snapshot, Entry, &FileHandle);
+  if (EFI_ERROR(Status)) {
+    DXE_DEBUG(DEBUG_WARN, L"[WARN]  Failed to open %s: %r\r\n", Entry->Name, Status);
+    Read->Read.Status = Status;
+    return Status;
+  }
+
+  Offset = 0;
+  if (!Entry->Compressed && FileSize > ACPI_HEADER_PROBE_SIZE) {
+    Status = FsReadExact(FileHandle, sizeof(Header), &Header, NULL);
     if (EFI_ERROR(Status)) {
-      // No ACPI subdirectory found - we might already be in the ACPI directory
-      // or the file simply doesn't exist. Either way, we already tried direct access
-      DXE_DEBUG(L"[INFO]  File not found: %s\r\n", FileName);
-      return EFI_NOT_FOUND;
+      DXE_DEBUG(DEBUG_WARN, L"[WARN]  Failed to read %s: %r\r\n", Entry->Name, Status);
     } else {
-      DXE_DEBUG(L"[INFO]  Found ACPI subdirectory, loading from ACPI/%s\r\n", FileName);
-      // Use ACPI directory for searching
-      Status = FsOpenFile(AcpiDir, (CHAR16*)FileName, &FileHandle);
-      AcpiDir->Close(AcpiDir);  // Close the ACPI directory handle after use
-      
+      Status = CheckAmlHeader(&Header, FileSize, Entry->Name);
+    }
+    if (EFI_ERROR(Status)) {
+      FileHandle->Close(FileHandle);
+      Read->Read.Status = Status;
+      return Status;
+    }
+    Offset = sizeof(Header);
+  }
+
+  if (Entry->Compressed) {
+    Read->Packed = AllocatePool(FileSize);
+  } else {
+    Read->Table = (Arena != NULL) ? TableArenaAllocate(Arena, FileSize) : AllocatePool(FileSize);
+  }
+  if (Read->Table == NULL && Read->Packed == NULL) {
+    FileHandle->Close(FileHandle);
+    Read->Read.Status = EFI_OUT_OF_RESOURCES;
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  if (Offset != 0) {
+    CopyMem(Read->Table, &Header, Offset);
+  }
+  Read->File = FileHandle;
+  FsReadAsync(FileHandle, FileSize - Offset,
+              Entry->Compressed ? Read->Packed : (UINT8 *)Read->Table + Offset, &Read->Read);
+  return EFI_SUCCESS;
+}
+
+/**
+  Decodes a compressed file read by StartAmlRead() into a table of the
+  size its header gives, taken from the arena or pool as an uncompressed
+  table would be.  The packed copy is released either way.
+**/
+STATIC
+EFI_STATUS
+DecodeAmlRead (
+  IN OUT ACPI_TABLE_READ              *Read,
+  IN     TABLE_ARENA                  *Arena,
+  OUT    EFI_ACPI_DESCRIPTION_HEADER  **Table,
+  OUT    UINTN                        *Length
+  )
+{
+  EFI_STATUS Status;
+  UINTN      FileSize;
+
+  *Table   = NULL;
+  FileSize = (UINTN)Read->Entry->FileSize;
+  Status   = AcpiLzDecodedLength(Read->Packed, FileSize, Length);
+  if (!EFI_ERROR(Status)) {
+    *Table = (Arena != NULL) ? TableArenaAllocate(Arena, *Length) : AllocatePool(*Length);
+    if (*Table == NULL) {
+      Status = EFI_OUT_OF_RESOURCES;
+    } else {
+      Status = AcpiLzDecode(Read->Packed, FileSize, *Table, *Length);
       if (EFI_ERROR(Status)) {
-        DXE_DEBUG(L"[INFO]  File not found in ACPI subdirectory: %s\r\n", FileName);
-        return EFI_NOT_FOUND;
+        FreeAmlTable(Arena, *Table);
+        *Table = NULL;
       }
     }
   }
-  
+
+  FreePool(Read->Packed);
+  Read->Packed = NULL;
+  if (EFI_ERROR(Status)) {
+    DXE_DEBUG(DEBUG_WARN, L"[WARN]  %s does not decode to an ACPI table: %r\r\n", Read->Entry->Name, Status);
+  }
+
+  return Status;
+}
+
+/**
+  Finishes a read started by StartAmlRead(), waiting for it if it is
+  still in flight.  A compressed file is decoded first.  The header is
+  then checked against the file size, or the decoded size, so a stray
+  file that happens to end in .aml is turned away, and the table is
+  checksummed.  A bad checksum is logged but the table is still loaded,
+  as an OS would.
+
+  @param[in,out] Read       Read started by StartAmlRead()
+  @param[in]     Arena      Arena the table was placed in, or NULL
+  @param[out]    AmlTable   Loaded table (release with FreeAmlTable())
+  @param[out]    TableSize  Size of the loaded table
+
+  @retval EFI_SUCCESS           The table was loaded.
+  @retval EFI_UNSUPPORTED       The file does not start with an ACPI header.
+  @retval EFI_VOLUME_CORRUPTED  The header length and the file size differ,
+                                or a compressed file does not decode.
+  @retval Other                 Opening, reading or allocating failed.
+**/
+STATIC
+EFI_STATUS
+FinishAmlRead (
+  IN OUT ACPI_TABLE_READ              *Read,
+  IN     TABLE_ARENA                  *Arena,
+  OUT    EFI_ACPI_DESCRIPTION_HEADER  **AmlTable,
+  OUT    UINTN                        *TableSize
+  )
+{
+  EFI_STATUS Status;
+  EFI_ACPI_DESCRIPTION_HEADER *Table;
+  UINT64 Length;
+  UINTN DecodedLength;
+  UINT8 Sum;
+
+  *AmlTable  = NULL;
+  *TableSize = 0;
+
+  if (Read->File == NULL) {
+    return Read->Read.Status;
+  }
+
+  Status = FsReadAsyncWait(&Read->Read);
+  Read->File->Close(Read->File);
+  Read->File = NULL;
+
+  Table       = Read->Table;
+  Read->Table = NULL;
   if (EFI_ERROR(Status)) {
+    DXE_DEBUG(DEBUG_WARN, L"[WARN]  Failed to read %s: %r\r\n", Read->Entry->Name, Status);
+    if (Read->Packed != NULL) {
+      FreePool(Read->Packed);
+      Read->Packed = NULL;
+    } else {
+      FreeAmlTable(Arena, Table);
+    }
     return Status;
   }
 
-  // Get file size (simplified - assume reasonable size < 1MB)
-  FileSize = 0x100000; // 1MB buffer
-  Status = FsReadFileToBuffer(FileHandle, FileSize, &FileBuffer);
-  FileHandle->Close(FileHandle);
-  
+  Length = Read->Entry->FileSize;
+  if (Read->Packed != NULL) {
+    Status = DecodeAmlRead(Read, Arena, &Table, &DecodedLength);
+    if (EFI_ERROR(Status)) {
+      return Status;
+    }
+    Length = DecodedLength;
+  }
+
+  Status = CheckAmlHeader(Table, Length, Read->Entry->Name);
   if (EFI_ERROR(Status)) {
+    FreeAmlTable(Arena, Table);
     return Status;
   }
 
-  *AmlTable = (EFI_ACPI_DESCRIPTION_HEADER*)FileBuffer;
-  *TableSize = (*AmlTable)->Length;
-  
-  DXE_DEBUG(L"[INFO]  Loaded %d bytes\r\n", *TableSize);
+  Sum = AcpiChecksumSum(Table, Table->Length);
+  if (Sum != 0) {
+    DXE_DEBUG(DEBUG_WARN, L"[WARN]  %s: checksum is off by 0x%02x\r\n", Read->Entry->Name, Sum);
+  }
+
+  *AmlTable  = Table;
+  *TableSize = Table->Length;
+
+  DXE_DEBUG(DEBUG_VERBOSE, L"[INFO]  Loaded %d bytes\r\n", *TableSize);
   return EFI_SUCCESS;
 }
 
 /**
-  Replace table in XSDT (simplified version).
+  Loads an AML file listed in a directory snapshot, waiting for the read.
+
+  @param[in]  Snapshot   Snapshot of the ACPI files directory
+  @param[in]  Entry      Entry of the file to load
+  @param[in]  Arena      Arena to place the table in, or NULL for pool memory
+  @param[out] AmlTable   Loaded table (release with FreeAmlTable())
+  @param[out] TableSize  Size of the loaded table
+
+  @retval EFI_SUCCESS           The table was loaded.
+  @retval Other                 As FinishAmlRead().
 **/
 EFI_STATUS
-ReplaceTableInXsdt (
-  IN OUT EFI_ACPI_DESCRIPTION_HEADER   *Xsdt,
-  IN     UINT32                        Signature,
-  IN     EFI_ACPI_DESCRIPTION_HEADER   *NewTable
+LoadAmlEntry (
+  IN  CONST DIR_SNAPSHOT              *Snapshot,
+  IN  CONST DIR_SNAPSHOT_ENTRY        *Entry,
+  IN  TABLE_ARENA                     *Arena,
+  OUT EFI_ACPI_DESCRIPTION_HEADER     **AmlTable,
+  OUT UINTN                           *TableSize
   )
 {
-  UINT32 EntryCount = (Xsdt->Length - sizeof(EFI_ACPI_DESCRIPTION_HEADER)) / sizeof(UINT64);
-  UINT64 *EntryPtr = (UINT64 *)(Xsdt + 1);
-  
-  for (UINTN i = 0; i < EntryCount; i++) {
-    EFI_ACPI_DESCRIPTION_HEADER *Entry = (EFI_ACPI_DESCRIPTION_HEADER *)(UINTN)EntryPtr[i];
-    if (Entry != NULL && Entry->Signature == Signature) {
-      EntryPtr[i] = (UINT64)(UINTN)NewTable;
-      return EFI_SUCCESS;
-    }
-  }
-  return EFI_NOT_FOUND;
+  ACPI_TABLE_READ Read;
+
+  StartAmlRead(Snapshot, Entry, Arena, &Read);
+  return FinishAmlRead(&Read, Arena, AmlTable, TableSize);
 }
 
 /**
-  Add new table to XSDT.
+  Loads an AML file by name from a directory snapshot.  A name that is not
+  in the snapshot fails without touching the file system.
 **/
 EFI_STATUS
-AddTableToXsdt (
-  IN OUT EFI_ACPI_DESCRIPTION_HEADER   *Xsdt,
-  IN     EFI_ACPI_DESCRIPTION_HEADER   *NewTable,
-  IN OUT UINT32                        *MaxEntries
+LoadAmlFile (
+  IN  CONST DIR_SNAPSHOT              *Snapshot,
+  IN  CONST CHAR16                    *FileName,
+  IN  TABLE_ARENA                     *Arena,
+  OUT EFI_ACPI_DESCRIPTION_HEADER     **AmlTable,
+  OUT UINTN                           *TableSize
   )
 {
-  UINT32 CurrentEntries = (Xsdt->Length - sizeof(EFI_ACPI_DESCRIPTION_HEADER)) / sizeof(UINT64);
-  
-  if (CurrentEntries >= *MaxEntries) {
-    return EFI_OUT_OF_RESOURCES;
+  DIR_SNAPSHOT_ENTRY *Entry;
+
+  if (Snapshot == NULL) {
+    DXE_DEBUG(DEBUG_WARN, L"[WARN]  No directory provided, cannot load file\r\n");
+    return EFI_INVALID_PARAMETER;
   }
-  
-  UINT64 *EntryPtr = (UINT64 *)(Xsdt + 1);
-  EntryPtr[CurrentEntries] = (UINT64)(UINTN)NewTable;
-  
-  Xsdt->Length += sizeof(UINT64);
-  return EFI_SUCCESS;
+
+  Entry = DirSnapshotFind(Snapshot, FileName);
+  if (Entry == NULL || Entry->Kind < DirEntryDsdt) {
+    DXE_DEBUG(DEBUG_VERBOSE, L"[INFO]  File not found: %s\r\n", FileName);
+    return EFI_NOT_FOUND;
+  }
+
+  return LoadAmlEntry(Snapshot, Entry, Arena, AmlTable, TableSize);
 }
 
 /**
-  Debug print function that forces output to console for DXE driver visibility.
-  
-  @param[in]  Level   Debug level for this message
-  @param[in]  Format  Format string for debug output
-  @param[in]  ...     Variable arguments for format string
+  Takes the snapshot PatchAcpiTables() works from.  If Directory has an
+  ACPI subdirectory, as the application's own folder does, the snapshot is
+  of that subdirectory instead.
+
+  @param[in]  Directory  Directory the patcher was started with
+  @param[out] Snapshot   Receives the snapshot (release with DirSnapshotFree)
 **/
-VOID
-AcpiDebugPrint (
-  IN UINTN       Level,
-  IN CONST CHAR16 *Format,
-  ...
+EFI_STATUS
+CreateAcpiDirSnapshot (
+  IN  EFI_FILE_PROTOCOL                *Directory,
+  OUT DIR_SNAPSHOT                     *Snapshot
   )
 {
-#ifdef DXE_DRIVER_BUILD
-  // For DXE drivers, force ALL debug output to console for visibility
-  Print(Format);
-  gST->ConOut->OutputString(gST->ConOut, (CHAR16*)Format);
-  
-  // Also add a short delay to ensure visibility
-  gBS->Stall(100000); // 100ms delay
-#else
-  // Use standard EDK2 DEBUG levels and output to Print for visibility
-  if (Level == DEBUG_ERROR) {
-    Print(L"ERROR: ");
-    Print(Format);
-  } else if (Level == DEBUG_WARN) {
-    Print(L"WARN: ");
-    Print(Format);
-  } else if (Level == DEBUG_INFO) {
-    Print(L"INFO: ");
-    Print(Format);
-  } else if (Level == DEBUG_VERBOSE) {
-    Print(L"VERBOSE: ");
-    Print(Format);
-  } else {
-    Print(Format);
+  EFI_STATUS         Status;
+  DIR_SNAPSHOT_ENTRY *Entry;
+  EFI_FILE_PROTOCOL  *AcpiDir;
+
+  Status = DirSnapshotCreate(Directory, Snapshot);
+  if (EFI_ERROR(Status)) {
+    return Status;
   }
-#endif
+
+  Entry = DirSnapshotFind(Snapshot, L"ACPI");
+  if (Entry == NULL || Entry->Kind != DirEntryDirectory) {
+    AcpiDebugPrint(DEBUG_VERBOSE, L"No ACPI subdirectory found, using provided directory\n");
+    return EFI_SUCCESS;
+  }
+
+  Status = DirSnapshotOpen(Snapshot, Entry, &AcpiDir);
+  if (EFI_ERROR(Status)) {
+    AcpiDebugPrint(DEBUG_WARN, L"Cannot open ACPI subdirectory: %r\n", Status);
+    return EFI_SUCCESS;
+  }
+
+  AcpiDebugPrint(DEBUG_VERBOSE, L"Found ACPI subdirectory, using ACPI/ subdirectory\n");
+  DirSnapshotFree(Snapshot);
+  Status = DirSnapshotCreate(AcpiDir, Snapshot);
+  if (EFI_ERROR(Status)) {
+    AcpiDir->Close(AcpiDir);
+    return Status;
+  }
+
+  Snapshot->OwnsDirectory = TRUE;
+  return EFI_SUCCESS;
 }
 
 /**
   Search for FADT table in the XSDT.
+
+  Builds gXsdtIndex on the way, so every later lookup in the run is a hash
+  lookup rather than another walk of the XSDT.
   
   @retval EFI_SUCCESS           FADT found successfully
   @retval EFI_INVALID_PARAMETER XSDT pointer is invalid
   @retval EFI_NOT_FOUND         FADT not found in XSDT
+  @retval EFI_OUT_OF_RESOURCES  The XSDT could not be indexed
 **/
 EFI_STATUS
 FindFadtInXsdt (
@@ -624,10 +898,10 @@ FindFadtInXsdt (
   )
 {
   EFI_ACPI_DESCRIPTION_HEADER *Entry;
-  UINT32              EntryCount;
-  UINT64              *EntryPtr;
+  XSDT_INDEX_ENTRY    *Fadt;
   UINTN               Index;
   CHAR8               SigStr[5];
+  EFI_STATUS          Status;
 
   AcpiDebugPrint(DEBUG_INFO, L"Searching for FADT in XSDT...\n");
 
@@ -636,22 +910,28 @@ FindFadtInXsdt (
     return EFI_INVALID_PARAMETER;
   }
 
-  EntryCount = (gXsdt->Length - sizeof(EFI_ACPI_DESCRIPTION_HEADER)) / sizeof(UINT64);
-  EntryPtr = (UINT64 *)(gXsdt + 1);
+  XsdtIndexFree(&gXsdtIndex);
+  Status = XsdtIndexBuild(&gXsdtIndex, gXsdt);
+  if (EFI_ERROR(Status)) {
+    AcpiDebugPrint(DEBUG_ERROR, L"Cannot index XSDT: %r\n", Status);
+    return Status;
+  }
 
-  AcpiDebugPrint(DEBUG_VERBOSE, L"XSDT has %d entries to scan\n", EntryCount);
+  AcpiDebugPrint(DEBUG_VERBOSE, L"XSDT has %d entries to scan\n", gXsdtIndex.Count);
 
   // Null terminate the signature string buffer
   SigStr[4] = '\0';
 
   // Enhanced debug: Show detailed ACPI table discovery
-  DXE_DEBUG(L"[INFO]  === ACPI Table Discovery ===\r\n");
-  DXE_DEBUG(L"[INFO]  XSDT contains %d table entries\r\n", EntryCount);
+  DXE_DEBUG(DEBUG_INFO, L"[INFO]  === ACPI Table Discovery ===\r\n");
+  DXE_DEBUG(DEBUG_INFO, L"[INFO]  XSDT contains %d table entries\r\n", gXsdtIndex.Count);
   
-  for (Index = 0; Index < EntryCount; Index++) {
-    Entry = (EFI_ACPI_DESCRIPTION_HEADER *)(UINTN)EntryPtr[Index];
+  // The per-table dump is the only remaining walk; skip it when it would
+  // print nothing.
+  for (Index = 0; ACPI_LOG_ENABLED(DEBUG_VERBOSE) && Index < gXsdtIndex.Count; Index++) {
+    Entry = gXsdtIndex.Entries[Index].Table;
     if (Entry == NULL) {
-      DXE_DEBUG(L"[WARN]  Entry %d: NULL pointer, skipping\r\n", Index);
+      DXE_DEBUG(DEBUG_WARN, L"[WARN]  Entry %d: NULL pointer, skipping\r\n", Index);
       continue;
     }
 
@@ -659,31 +939,33 @@ FindFadtInXsdt (
     CopyMem(SigStr, &Entry->Signature, 4);
     
     // Show detailed table information
-    DXE_DEBUG(L"[INFO]  Table[%d]: Signature='%a', Length=%d bytes, Revision=%d\r\n", 
+    DXE_DEBUG(DEBUG_VERBOSE, L"[INFO]  Table[%d]: Signature='%a', Length=%d bytes, Revision=%d\r\n", 
           Index, SigStr, Entry->Length, Entry->Revision);
-    DXE_DEBUG(L"[INFO]    Address: " PTR_FMT L", Checksum=0x%02x\r\n", 
+    DXE_DEBUG(DEBUG_VERBOSE, L"[INFO]    Address: " PTR_FMT L", Checksum=0x%02x\r\n", 
           PTR_TO_INT(Entry), Entry->Checksum);
 
     // Show table-specific information
     if (Entry->Signature == EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE_SIGNATURE) {
-      gFacp = (EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE *)Entry;
-      DXE_DEBUG(L"[INFO]    -> FADT (Fixed ACPI Description Table)\r\n");
-      DXE_DEBUG(L"[INFO]       DSDT Address: 0x%x, X_DSDT Address: 0x%llx\r\n", 
-            gFacp->Dsdt, gFacp->XDsdt);
+      DXE_DEBUG(DEBUG_VERBOSE, L"[INFO]    -> FADT (Fixed ACPI Description Table)\r\n");
+      DXE_DEBUG(DEBUG_VERBOSE, L"[INFO]       DSDT Address: 0x%x, X_DSDT Address: 0x%llx\r\n", 
+            ((EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE *)Entry)->Dsdt,
+            ((EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE *)Entry)->XDsdt);
     } else if (Entry->Signature == EFI_ACPI_2_0_DIFFERENTIATED_SYSTEM_DESCRIPTION_TABLE_SIGNATURE) {
-      DXE_DEBUG(L"[INFO]    -> DSDT (Differentiated System Description Table)\r\n");
+      DXE_DEBUG(DEBUG_VERBOSE, L"[INFO]    -> DSDT (Differentiated System Description Table)\r\n");
     } else if (Entry->Signature == EFI_ACPI_2_0_SECONDARY_SYSTEM_DESCRIPTION_TABLE_SIGNATURE) {
-      DXE_DEBUG(L"[INFO]    -> SSDT (Secondary System Description Table)\r\n");
+      DXE_DEBUG(DEBUG_VERBOSE, L"[INFO]    -> SSDT (Secondary System Description Table)\r\n");
     } else if (Entry->Signature == EFI_ACPI_2_0_MULTIPLE_APIC_DESCRIPTION_TABLE_SIGNATURE) {
-      DXE_DEBUG(L"[INFO]    -> APIC/MADT (Multiple APIC Description Table)\r\n");
+      DXE_DEBUG(DEBUG_VERBOSE, L"[INFO]    -> APIC/MADT (Multiple APIC Description Table)\r\n");
     } else if (Entry->Signature == EFI_ACPI_2_0_MEMORY_MAPPED_CONFIGURATION_BASE_ADDRESS_TABLE_SIGNATURE) {
-      DXE_DEBUG(L"[INFO]    -> MCFG (Memory Mapped Configuration)\r\n");
+      DXE_DEBUG(DEBUG_VERBOSE, L"[INFO]    -> MCFG (Memory Mapped Configuration)\r\n");
     }
   }
 
-  if (gFacp != NULL) {
-    DXE_DEBUG(L"[INFO]  === FADT Analysis Complete ===\r\n");
-    DXE_DEBUG(L"[INFO]  Successfully found FADT at " PTR_FMT L"\r\n", PTR_TO_INT(gFacp));
+  Fadt = XsdtIndexFind(&gXsdtIndex, EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE_SIGNATURE, NULL, NULL, NULL);
+  if (Fadt != NULL) {
+    gFacp = (EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE *)Fadt->Table;
+    DXE_DEBUG(DEBUG_INFO, L"[INFO]  === FADT Analysis Complete ===\r\n");
+    DXE_DEBUG(DEBUG_INFO, L"[INFO]  Successfully found FADT at " PTR_FMT L"\r\n", PTR_TO_INT(gFacp));
     return EFI_SUCCESS;
   }
 
@@ -692,9 +974,73 @@ FindFadtInXsdt (
 }
 
 #ifdef DXE_DRIVER_BUILD
+/**
+  Tells whether the directory found so far is good enough to patch from
+  without waiting for more volumes: it is in a volume root, was remembered
+  from the last boot, or is on the boot volume or an ESP.
+**/
+STATIC
+BOOLEAN
+AcpiDirSearchQualifies (
+  IN CONST ACPI_DIR_SEARCH  *Search
+  )
+{
+  return Search->Final || (Search->Best.Directory != NULL && Search->Rank >= FsVolumeEsp);
+}
+
+/**
+  Ends discovery and patches from the best directory found, if any.  Safe
+  to call more than once; only the first call patches.
+  
+  @param[in] Reason  Why discovery ends, for the log.
+**/
+STATIC
+VOID
+FinishAcpiDiscovery (
+  IN CONST CHAR16  *Reason
+  )
+{
+  EFI_STATUS Status;
+
+  if (gFileSystemReady) {
+    return;
+  }
+  gFileSystemReady = TRUE;
+
+  // No more volumes are wanted
+  if (gFileSystemReadyEvent != NULL) {
+    gBS->CloseEvent(gFileSystemReadyEvent);
+    gFileSystemReadyEvent = NULL;
+  }
+  if (gAcpiDiscoveryDeadlineEvent != NULL) {
+    gBS->CloseEvent(gAcpiDiscoveryDeadlineEvent);
+    gAcpiDiscoveryDeadlineEvent = NULL;
+  }
+
+  AcpiDebugPrint(DEBUG_INFO, L"[DXE] ACPI files discovery finished (%s) after %d file system(s)\n", Reason, mAcpiDirSearch.VolumeCount);
+  if (mAcpiDirSearch.Volume != NULL) {
+    AcpiDirHintSave(mAcpiDirSearch.Volume, mAcpiDirSearch.Path);
+  }
+
+  // Perform the ACPI patching now that file system is ready
+  Status = PerformDelayedAcpiPatching(&mAcpiDirSearch.Best);
+  if (EFI_ERROR(Status)) {
+    AcpiDebugPrint(DEBUG_ERROR, L"[DXE] Delayed ACPI patching failed: %r\n", Status);
+  } else {
+    AcpiDebugPrint(DEBUG_INFO, L"[DXE] SUCCESS: Delayed ACPI patching completed!\n");
+  }
+  ZeroMem(&mAcpiDirSearch, sizeof(mAcpiDirSearch));
+
+  // Patching is over; write the buffered log in one go
+  AcpiLogComplete();
+}
+
 /**
   Callback function that gets called when Simple File System Protocol becomes available.
   This allows the DXE driver to wait until storage is ready before loading .aml files.
+
+  Only the volumes installed since the last notification are searched;
+  what they hold is weighed against the directory found so far.
   
   @param[in] Event    The event that was signaled
   @param[in] Context  Event context (unused)
@@ -707,27 +1053,94 @@ OnFileSystemProtocolReady (
   )
 {
   EFI_STATUS Status;
+  EFI_HANDLE Volume;
+  UINTN Size;
+  FS_VOLUME_RANK Rank;
   
-  Print(L"[DXE] File System Protocol ready notification received!\n");
+  AcpiDebugPrint(DEBUG_VERBOSE, L"[DXE] File System Protocol ready notification received!\n");
   
-  // Mark file system as ready
-  gFileSystemReady = TRUE;
-  
-  // Close the event as we no longer need it
-  if (gFileSystemReadyEvent != NULL) {
-    gBS->CloseEvent(gFileSystemReadyEvent);
-    gFileSystemReadyEvent = NULL;
+  for (;;) {
+    Size = sizeof(Volume);
+    Status = gBS->LocateHandle(ByRegisterNotify, NULL, gFileSystemProtocolNotifyReg, &Size, &Volume);
+    if (EFI_ERROR(Status)) {
+      break;
+    }
+
+    // A volume ranked below the one already holding the best directory
+    // cannot beat it
+    FsRankVolumes(&Volume, 1, &Rank);
+    if (mAcpiDirSearch.Best.Directory != NULL && Rank < mAcpiDirSearch.Rank) {
+      AcpiDebugPrint(DEBUG_VERBOSE, L"[DXE] Skipping new file system of rank %d\n", Rank);
+      continue;
+    }
+    SearchVolumeForAcpiFiles(Volume, Rank, &mAcpiDirSearch);
   }
+
+  if (AcpiDirSearchQualifies(&mAcpiDirSearch)) {
+    FinishAcpiDiscovery(L"preferred directory found");
+  } else if (mAcpiDirSearch.Best.Directory != NULL) {
+    ArmAcpiDiscoveryDeadline();
+  }
+}
+
+/**
+  Deadline callback: better volumes did not show up in time, so the best
+  directory found so far is used.
   
-  Print(L"[DXE] Now attempting delayed ACPI patching with file system access...\n");
-  
-  // Perform the ACPI patching now that file system is ready
-  Status = PerformDelayedAcpiPatching();
+  @param[in] Event    The event that was signaled
+  @param[in] Context  Event context (unused)
+**/
+STATIC
+VOID
+EFIAPI
+OnAcpiDiscoveryDeadline (
+  IN EFI_EVENT    Event,
+  IN VOID         *Context
+  )
+{
+  FinishAcpiDiscovery(L"deadline");
+}
+
+/**
+  Starts the deadline once a directory that does not qualify outright has
+  been found.  Later calls leave a running deadline alone.
+**/
+STATIC
+VOID
+ArmAcpiDiscoveryDeadline (
+  VOID
+  )
+{
+  EFI_STATUS Status;
+
+  if (gAcpiDiscoveryDeadlineEvent != NULL) {
+    return;
+  }
+
+  Status = gBS->CreateEvent(
+    EVT_TIMER | EVT_NOTIFY_SIGNAL,
+    TPL_CALLBACK,
+    OnAcpiDiscoveryDeadline,
+    NULL,
+    &gAcpiDiscoveryDeadlineEvent
+  );
+  if (!EFI_ERROR(Status)) {
+    // SetTimer() counts in 100 ns units
+    Status = gBS->SetTimer(gAcpiDiscoveryDeadlineEvent, TimerRelative, MultU64x32(ACPI_PATCHER_DISCOVERY_DEADLINE_MS, 10000));
+  }
   if (EFI_ERROR(Status)) {
-    Print(L"[DXE] ERROR: Delayed ACPI patching failed: %r\n", Status);
-  } else {
-    Print(L"[DXE] SUCCESS: Delayed ACPI patching completed!\n");
+    // Without a timer there is nothing to wait for
+    AcpiDebugPrint(DEBUG_WARN, L"[DXE] Cannot start discovery deadline: %r\n", Status);
+    if (gAcpiDiscoveryDeadlineEvent != NULL) {
+      gBS->CloseEvent(gAcpiDiscoveryDeadlineEvent);
+      gAcpiDiscoveryDeadlineEvent = NULL;
+    }
+    FinishAcpiDiscovery(L"no timer");
+    return;
   }
+
+  AcpiDebugPrint(DEBUG_INFO, L"[DXE] Found ACPI files on a data volume, waiting %d ms for a preferred one\n",
+                 ACPI_PATCHER_DISCOVERY_DEADLINE_MS);
 }
 
 /**
@@ -744,7 +1157,12 @@ WaitForFileSystemReady (
 {
   EFI_STATUS Status;
   
-  Print(L"[DXE] Setting up file system ready notification...\n");
+  AcpiDebugPrint(DEBUG_VERBOSE, L"[DXE] Setting up file system ready notification...\n");
+
+  // Leftovers of an earlier run of the entry point
+  ZeroMem(&mAcpiDirSearch, sizeof(mAcpiDirSearch));
+  gFileSystemReady = FALSE;
+  gAcpiDiscoveryDeadlineEvent = NULL;
   
   // Create an event that will be signaled when Simple File System Protocol is installed
   Status = gBS->CreateEvent(
@@ -756,11 +1174,12 @@ WaitForFileSystemReady (
   );
   
   if (EFI_ERROR(Status)) {
-    Print(L"[DXE] ERROR: Failed to create file system event: %r\n", Status);
+    AcpiDebugPrint(DEBUG_ERROR, L"[DXE] Failed to create file system event: %r\n", Status);
     return Status;
   }
   
-  // Register for protocol installation notification
+  // Register for protocol installation notification.  The registration
+  // stays until discovery ends, so every volume is seen as it arrives.
   Status = gBS->RegisterProtocolNotify(
     &gEfiSimpleFileSystemProtocolGuid,
     gFileSystemReadyEvent,
@@ -768,102 +1187,374 @@ WaitForFileSystemReady (
   );
   
   if (EFI_ERROR(Status)) {
-    Print(L"[DXE] ERROR: Failed to register protocol notify: %r\n", Status);
+    AcpiDebugPrint(DEBUG_ERROR, L"[DXE] Failed to register protocol notify: %r\n", Status);
     gBS->CloseEvent(gFileSystemReadyEvent);
     gFileSystemReadyEvent = NULL;
     return Status;
   }
   
-  Print(L"[DXE] File system notification registered successfully\n");
-  Print(L"[DXE] DXE driver will wait for storage to initialize...\n");
+  AcpiDebugPrint(DEBUG_VERBOSE, L"[DXE] File system notification registered successfully\n");
+  AcpiDebugPrint(DEBUG_VERBOSE, L"[DXE] DXE driver will wait for storage to initialize...\n");
   
   return EFI_SUCCESS;
 }
 
+/**
+  Searches the volumes that are already there, once the notification is
+  registered, and patches right away if that finds a preferred directory.
+
+  The search runs at TPL_CALLBACK so a volume installed meanwhile is left
+  to the notification rather than searched twice at once.
+**/
+STATIC
+VOID
+StartAcpiDiscovery (
+  VOID
+  )
+{
+  EFI_TPL OldTpl;
+
+  OldTpl = gBS->RaiseTPL(TPL_CALLBACK);
+  FindAcpiFilesDirectory(&mAcpiDirSearch);
+  gBS->RestoreTPL(OldTpl);
+
+  if (AcpiDirSearchQualifies(&mAcpiDirSearch)) {
+    FinishAcpiDiscovery(L"preferred directory found");
+  } else if (mAcpiDirSearch.Best.Directory != NULL) {
+    ArmAcpiDiscoveryDeadline();
+  }
+}
+
 /**
   Performs the actual ACPI patching once file system is ready.
-  This is called from the file system ready callback.
+  This is called when discovery finishes.  The tables are loaded and
+  checked now; the new XSDT is only put in place at ReadyToBoot.
+
+  @param[in,out] Snapshot  Snapshot of the ACPI files directory discovery
+                           chose, or a zeroed one if it found none.  It is
+                           freed.
   
   @retval EFI_SUCCESS     ACPI patching completed successfully
   @retval Other           Error during patching
 **/
 EFI_STATUS
 PerformDelayedAcpiPatching (
-  VOID
+  IN OUT DIR_SNAPSHOT  *Snapshot
   )
 {
   EFI_STATUS Status;
   EFI_FILE_PROTOCOL *SelfDir;
+  ACPI_MANIFEST Manifest;
   
-  Print(L"[DXE] === Delayed ACPI Patching (File System Ready) ===\n");
+  AcpiDebugPrint(DEBUG_VERBOSE, L"[DXE] === Delayed ACPI Patching (File System Ready) ===\n");
   
-  // For DXE drivers, we need to search for ACPI files in standard locations
+  // For DXE drivers the ACPI files were searched for in standard locations
   // since FsGetSelfDir() doesn't work (DXE drivers are loaded from firmware, not filesystem)
+  ZeroMem(&Manifest, sizeof(Manifest));
   SelfDir = FsGetSelfDir();
   if (SelfDir == NULL) {
-    DXE_DEBUG(L"[DXE] INFO: DXE driver loaded from firmware, searching for ACPI files in standard locations\r\n");
-    // Try to find ESP and look for ACPI files in standard paths
-    SelfDir = FindAcpiFilesDirectory();
-    if (SelfDir == NULL) {
-      DXE_DEBUG(L"[DXE] WARNING: Could not locate ACPI files directory, continuing without files\r\n");
+    DXE_DEBUG(DEBUG_INFO, L"[DXE] INFO: DXE driver loaded from firmware, using the ACPI files found on the file systems\r\n");
+    // The snapshot taken while choosing the directory is the one patched from
+    if (Snapshot->Directory == NULL) {
+      DXE_DEBUG(DEBUG_WARN, L"[DXE] WARNING: Could not locate ACPI files directory, continuing without files\r\n");
     } else {
-      DXE_DEBUG(L"[DXE] SUCCESS: Found ACPI files directory\r\n");
+      DXE_DEBUG(DEBUG_INFO, L"[DXE] SUCCESS: Found ACPI files directory\r\n");
     }
   } else {
-    DXE_DEBUG(L"[DXE] SUCCESS: File system accessible via self directory\r\n");
+    // PatchAcpiTables() below picks the bundle, manifest or scan itself
+    DXE_DEBUG(DEBUG_INFO, L"[DXE] SUCCESS: File system accessible via self directory\r\n");
   }
   
-  // Get RSDP from the system table (if not already done)
-  if (gRsdp == NULL) {
-    Status = EfiGetSystemConfigurationTable(&gEfiAcpi20TableGuid, (VOID**)&gRsdp);
-    if (EFI_ERROR(Status)) {
-      // Try ACPI 1.0 table if 2.0 is not available
-      Status = EfiGetSystemConfigurationTable(&gEfiAcpiTableGuid, (VOID**)&gRsdp);
-      if (EFI_ERROR(Status)) {
-        Print(L"[DXE] ERROR: Failed to find ACPI tables: %r\n", Status);
-        return Status;
-      }
-      Print(L"[DXE] Using ACPI 1.0 tables\n");
-    } else {
-      Print(L"[DXE] Using ACPI 2.0+ tables\n");
-    }
+  Status = LocateFirmwareAcpiTables();
+  if (EFI_ERROR(Status)) {
+    DirSnapshotFree(Snapshot);
+    return Status;
+  }
+  
+  // Perform ACPI patching with file system access
+  if (SelfDir != NULL) {
+    Status = PatchAcpiTables(SelfDir, gXsdt, gFacp);
+  } else {
+    // The search has read the directory already, but a bundle or a
+    // manifest in it still decides what is loaded
+    Status = EFI_NOT_FOUND;
+    if (Snapshot->Directory != NULL) {
+      Status = PatchAcpiTablesFromBundle(Snapshot->Directory, gXsdt, gFacp);
+      if (Status == EFI_NOT_FOUND && !EFI_ERROR(AcpiManifestLoad(Snapshot->Directory, &Manifest))) {
+        // A manifest beside the tables shares the search's handle, and the
+        // job it is scheduled with outlives the search, so it takes the
+        // handle over
+        if (Manifest.Snapshot.Directory == Snapshot->Directory) {
+          Manifest.Snapshot.OwnsDirectory = Snapshot->OwnsDirectory;
+          Snapshot->OwnsDirectory         = FALSE;
+        }
+        Status = PatchAcpiTablesFromSnapshot(&Manifest.Snapshot, &Manifest, NULL, gXsdt, gFacp);
+      }
+    }
+    if (Status == EFI_NOT_FOUND && Snapshot->Directory != NULL) {
+      Status = PatchAcpiTablesFromCache(Snapshot, gXsdt, gFacp);
+    }
+    if (Status == EFI_NOT_FOUND) {
+      Status = PatchAcpiTablesFromSnapshot((Snapshot->Directory != NULL) ? Snapshot : NULL, NULL, NULL, gXsdt, gFacp);
+    }
+  }
+  // Whichever of the two still owns the directory handle closes it
+  AcpiManifestFree(&Manifest);
+  DirSnapshotFree(Snapshot);
+  if (EFI_ERROR(Status)) {
+    AcpiDebugPrint(DEBUG_ERROR, L"[DXE] ACPI patching failed: %r\n", Status);
+    return Status;
+  }
+  
+  AcpiDebugPrint(DEBUG_VERBOSE, L"[DXE] === Delayed ACPI Patching Completed Successfully ===\n");
+  return EFI_SUCCESS;
+}
+
+/**
+  Finds the firmware RSDP, XSDT and FADT, unless they are already known.
+
+  @retval EFI_SUCCESS  gRsdp, gXsdt and gFacp are set.
+  @retval Other        The firmware has no usable ACPI tables.
+**/
+STATIC
+EFI_STATUS
+LocateFirmwareAcpiTables (
+  VOID
+  )
+{
+  EFI_STATUS Status;
+
+  // Get RSDP from the system table (if not already done)
+  if (gRsdp == NULL) {
+    Status = EfiGetSystemConfigurationTable(&gEfiAcpi20TableGuid, (VOID**)&gRsdp);
+    if (EFI_ERROR(Status)) {
+      // Try ACPI 1.0 table if 2.0 is not available
+      Status = EfiGetSystemConfigurationTable(&gEfiAcpiTableGuid, (VOID**)&gRsdp);
+      if (EFI_ERROR(Status)) {
+        AcpiDebugPrint(DEBUG_ERROR, L"[DXE] Failed to find ACPI tables: %r\n", Status);
+        return Status;
+      }
+      AcpiDebugPrint(DEBUG_VERBOSE, L"[DXE] Using ACPI 1.0 tables\n");
+    } else {
+      AcpiDebugPrint(DEBUG_VERBOSE, L"[DXE] Using ACPI 2.0+ tables\n");
+    }
   }
   
   // Get XSDT from RSDP (if not already done)
   if (gXsdt == NULL) {
     if (gRsdp->XsdtAddress == 0) {
-      Print(L"[DXE] ERROR: XSDT address is invalid\n");
+      AcpiDebugPrint(DEBUG_ERROR, L"[DXE] XSDT address is invalid\n");
       return EFI_UNSUPPORTED;
     }
     
     gXsdt = (EFI_ACPI_DESCRIPTION_HEADER*)(UINTN)gRsdp->XsdtAddress;
-    Print(L"[DXE] XSDT found at " PTR_FMT L"\n", PTR_TO_INT(gXsdt));
+    AcpiDebugPrint(DEBUG_VERBOSE, L"[DXE] XSDT found at " PTR_FMT L"\n", PTR_TO_INT(gXsdt));
   }
   
   // Find FADT in XSDT (if not already done)
   if (gFacp == NULL) {
     Status = FindFadtInXsdt();
     if (EFI_ERROR(Status)) {
-      Print(L"[DXE] ERROR: Failed to find FADT: %r\n", Status);
+      AcpiDebugPrint(DEBUG_ERROR, L"[DXE] Failed to find FADT: %r\n", Status);
       return Status;
     }
   }
   
-  // Perform ACPI patching with file system access
-  Status = PatchAcpiTables(SelfDir, gXsdt, gFacp);
+  return EFI_SUCCESS;
+}
+
+/**
+  Hands a started job to the timer and ReadyToBoot: OnAcpiPlanTick()
+  loads its tables a slice at a time, and OnReadyToBootCommit() commits
+  the plan.  The job keeps using Snapshot and Manifest after the caller
+  returns, so it takes them over and leaves the caller's copies zeroed.
+
+  @param[in,out] Job       Job started by BeginAcpiPlan(); it is taken over
+  @param[in,out] Snapshot  Snapshot the job loads from, or NULL
+  @param[in,out] Manifest  Manifest the job loads from, or NULL
+
+  @retval EFI_SUCCESS          The job was scheduled.
+  @retval EFI_ALREADY_STARTED  Another job is still pending; nothing was
+                               taken over.
+  @retval Other                An event could not be created; nothing was
+                               taken over.
+**/
+STATIC
+EFI_STATUS
+ScheduleAcpiPlan (
+  IN OUT ACPI_PLAN_JOB  *Job,
+  IN OUT DIR_SNAPSHOT   *Snapshot  OPTIONAL,
+  IN OUT ACPI_MANIFEST  *Manifest  OPTIONAL
+  )
+{
+  EFI_STATUS Status;
+
+  if (gAcpiCommitEvent != NULL) {
+    return EFI_ALREADY_STARTED;
+  }
+
+  Status = EfiCreateEventReadyToBootEx(TPL_CALLBACK, OnReadyToBootCommit, NULL, &gAcpiCommitEvent);
   if (EFI_ERROR(Status)) {
-    Print(L"[DXE] ERROR: ACPI patching failed: %r\n", Status);
+    gAcpiCommitEvent = NULL;
     return Status;
   }
-  
-  Print(L"[DXE] === Delayed ACPI Patching Completed Successfully ===\n");
+
+  if (Job->Next < Job->Count) {
+    Status = gBS->CreateEvent(EVT_TIMER | EVT_NOTIFY_SIGNAL, TPL_CALLBACK, OnAcpiPlanTick, NULL, &gAcpiPlanTimerEvent);
+    if (!EFI_ERROR(Status)) {
+      Status = gBS->SetTimer(gAcpiPlanTimerEvent, TimerPeriodic, ACPI_PLAN_TICK_MS * 10000);
+      if (EFI_ERROR(Status)) {
+        gBS->CloseEvent(gAcpiPlanTimerEvent);
+      }
+    }
+    if (EFI_ERROR(Status)) {
+      gAcpiPlanTimerEvent = NULL;
+      gBS->CloseEvent(gAcpiCommitEvent);
+      gAcpiCommitEvent = NULL;
+      return Status;
+    }
+  }
+
+  mAcpiPlanJob = *Job;
+  ZeroMem(Job, sizeof(*Job));
+  if (Manifest != NULL) {
+    mAcpiPlanManifest = *Manifest;
+    ZeroMem(Manifest, sizeof(*Manifest));
+    mAcpiPlanJob.Manifest = &mAcpiPlanManifest;
+    mAcpiPlanJob.Snapshot = &mAcpiPlanManifest.Snapshot;
+  } else if (Snapshot != NULL) {
+    mAcpiPlanSnapshot = *Snapshot;
+    ZeroMem(Snapshot, sizeof(*Snapshot));
+    mAcpiPlanJob.Snapshot = &mAcpiPlanSnapshot;
+  }
+
+  if (gAcpiPlanTimerEvent == NULL) {
+    FinishAcpiPlanLoad();
+  } else {
+    AcpiDebugPrint(DEBUG_INFO, L"[DXE] Loading %d tables, up to %d KB per %d ms tick\n",
+                   mAcpiPlanJob.Count, ACPI_PATCHER_SLICE_KB, ACPI_PLAN_TICK_MS);
+  }
   return EFI_SUCCESS;
 }
+
+/**
+  Ends the load phase of the scheduled job.  Only the plan and its arena
+  are kept for ReadyToBoot; the snapshot and manifest, and the directory
+  handle they hold, are released.
+**/
+STATIC
+VOID
+FinishAcpiPlanLoad (
+  VOID
+  )
+{
+  EFI_STATUS Status;
+
+  if (gAcpiPlanTimerEvent != NULL) {
+    gBS->CloseEvent(gAcpiPlanTimerEvent);
+    gAcpiPlanTimerEvent = NULL;
+  }
+
+  EndAcpiPlan(&mAcpiPlanJob);
+
+  // The names in the plan belong to the snapshot; without copies of them
+  // it has to stay until the commit
+  Status = XsdtPlanKeepSources(&mAcpiPlanJob.Plan);
+  if (!EFI_ERROR(Status)) {
+    AcpiManifestFree(&mAcpiPlanManifest);
+    DirSnapshotFree(&mAcpiPlanSnapshot);
+    mAcpiPlanJob.Snapshot = NULL;
+    mAcpiPlanJob.Manifest = NULL;
+  }
+
+  // The index is rebuilt at commit, from the XSDT as it is then
+  XsdtIndexFree(&gXsdtIndex);
+
+  AcpiDebugPrint(DEBUG_INFO, L"%d tables ready, patching at ReadyToBoot\n", mAcpiPlanJob.Plan.Count);
+}
+
+/**
+  Timer callback: loads the next slice of the scheduled job, at most
+  ACPI_PATCHER_SLICE_KB of files, so DXE dispatch and other notifications
+  run between slices.
+
+  @param[in] Event    The event that was signaled
+  @param[in] Context  Event context (unused)
+**/
+STATIC
+VOID
+EFIAPI
+OnAcpiPlanTick (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  if (PlanNextAcpiTables(&mAcpiPlanJob, ACPI_PATCHER_SLICE_KB * 1024)) {
+    FinishAcpiPlanLoad();
+  }
+}
+
+/**
+  ReadyToBoot callback: applies the plan of the scheduled job to the
+  firmware tables as they are now, first loading whatever the timer has
+  not got to.  Drivers that installed tables since discovery may have
+  moved the XSDT, so the tables are looked up again.
+
+  @param[in] Event    The event that was signaled
+  @param[in] Context  Event context (unused)
+**/
+STATIC
+VOID
+EFIAPI
+OnReadyToBootCommit (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  EFI_STATUS Status;
+
+  gBS->CloseEvent(Event);
+  gAcpiCommitEvent = NULL;
+
+  // Boot is starting, so the rest is loaded in one go
+  if (gAcpiPlanTimerEvent != NULL) {
+    AcpiDebugPrint(DEBUG_INFO, L"[DXE] ReadyToBoot: loading the last %d tables\n", mAcpiPlanJob.Count - mAcpiPlanJob.Next);
+    while (!PlanNextAcpiTables(&mAcpiPlanJob, MAX_UINTN)) {
+    }
+    FinishAcpiPlanLoad();
+  }
+
+  AcpiDebugPrint(DEBUG_INFO, L"[DXE] ReadyToBoot: committing %d planned tables\n", mAcpiPlanJob.Plan.Count);
+
+  gRsdp = NULL;
+  gXsdt = NULL;
+  gFacp = NULL;
+  Status = LocateFirmwareAcpiTables();
+  if (EFI_ERROR(Status)) {
+    // Nothing was published, so the tables can go
+    XsdtPlanFree(&mAcpiPlanJob.Plan);
+    TableArenaDestroy(&mAcpiPlanJob.Arena);
+  } else {
+    // FindFadtInXsdt() rebuilt the index the plan was made against
+    CommitAcpiPlan(&mAcpiPlanJob.Plan, &mAcpiPlanJob.Arena, gXsdt, gFacp);
+  }
+  AcpiManifestFree(&mAcpiPlanManifest);
+  DirSnapshotFree(&mAcpiPlanSnapshot);
+  ZeroMem(&mAcpiPlanJob, sizeof(mAcpiPlanJob));
+
+  AcpiLogComplete();
+}
 #endif
 
 /**
   Main ACPI table patching function.
   
+  If Directory or its ACPI subdirectory holds an ACPIPatcher.apb bundle,
+  the tables in it are installed and nothing else.  Failing that, an
+  ACPIPatcher.cfg manifest there names the files to load; otherwise the
+  directory is scanned, unless the boot cache a previous scan left behind
+  is still valid.
+
   @param[in] Directory  File system protocol for accessing ACPI files
   @param[in] Xsdt       Pointer to the Extended System Description Table
   @param[in] Facp       Pointer to the Fixed ACPI Description Table
@@ -879,425 +1570,940 @@ PatchAcpiTables (
   IN EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE *Facp
   )
 {
-  UINT32                      CurrentEntries;
-  UINT32                      MaxEntries;
-  UINTN                       NewXsdtSize;
-  EFI_ACPI_DESCRIPTION_HEADER *NewXsdt;
-  
-  AcpiDebugPrint(DEBUG_INFO, L"Starting ACPI patching process...\n");
-  
-  // For now, Directory can be NULL since we're not using file system operations yet
-  if (Xsdt == NULL || Facp == NULL) {
-    AcpiDebugPrint(DEBUG_ERROR, L"Invalid parameters for ACPI patching\n");
-    AcpiDebugPrint(DEBUG_VERBOSE, L"  Directory: " PTR_FMT L"\n", PTR_TO_INT(Directory));
-    AcpiDebugPrint(DEBUG_VERBOSE, L"  Xsdt: " PTR_FMT L"\n", PTR_TO_INT(Xsdt));
-    AcpiDebugPrint(DEBUG_VERBOSE, L"  Facp: " PTR_FMT L"\n", PTR_TO_INT(Facp));
-    return EFI_INVALID_PARAMETER;
+  EFI_STATUS     Status;
+  DIR_SNAPSHOT   Snapshot;
+  ACPI_MANIFEST  Manifest;
+
+  if (Directory == NULL) {
+    return PatchAcpiTablesFromSnapshot(NULL, NULL, NULL, Xsdt, Facp);
   }
 
-  CurrentEntries = (Xsdt->Length - sizeof(EFI_ACPI_DESCRIPTION_HEADER)) / sizeof(UINT64);
-  
-  // Determine maximum entries - use simpler approach for compatibility
-  MaxEntries = CurrentEntries + MAX_ADDITIONAL_TABLES;
-  AcpiDebugPrint(DEBUG_INFO, L"Allowing %d additional tables (%d total)\n",
-                 MAX_ADDITIONAL_TABLES, MaxEntries);
+  // A bundle holds every table in one file
+  Status = PatchAcpiTablesFromBundle(Directory, Xsdt, Facp);
+  if (Status != EFI_NOT_FOUND) {
+    return Status;
+  }
 
-  NewXsdtSize = sizeof(EFI_ACPI_DESCRIPTION_HEADER) + (MaxEntries * sizeof(UINT64));
-  
-  AcpiDebugPrint(DEBUG_INFO, L"Allocating new XSDT: %d bytes for %d entries\n", 
-                 NewXsdtSize, MaxEntries);
+  // A manifest names every file to load, so the directory is not read
+  Status = AcpiManifestLoad(Directory, &Manifest);
+  if (!EFI_ERROR(Status)) {
+    Status = PatchAcpiTablesFromSnapshot(&Manifest.Snapshot, &Manifest, NULL, Xsdt, Facp);
+    AcpiManifestFree(&Manifest);
+    return Status;
+  }
+  if (Status != EFI_NOT_FOUND) {
+    AcpiDebugPrint(DEBUG_WARN, L"Cannot read %s, scanning instead: %r\n", ACPI_MANIFEST_FILE_NAME, Status);
+  }
 
-  // Allocate memory for the new XSDT with additional entries
-  NewXsdt = AllocateZeroPool(NewXsdtSize);
-  if (NewXsdt == NULL) {
-    AcpiDebugPrint(DEBUG_ERROR, L"Failed to allocate memory for new XSDT\n");
-    return EFI_OUT_OF_RESOURCES;
+  Status = CreateAcpiDirSnapshot(Directory, &Snapshot);
+  if (EFI_ERROR(Status)) {
+    AcpiDebugPrint(DEBUG_WARN, L"Cannot read ACPI files directory: %r\n", Status);
+    return PatchAcpiTablesFromSnapshot(NULL, NULL, NULL, Xsdt, Facp);
   }
 
-  // Copy the existing XSDT
-  CopyMem(NewXsdt, Xsdt, Xsdt->Length);
+  // The listing is still needed to know whether the boot cache is current
+  Status = PatchAcpiTablesFromCache(&Snapshot, Xsdt, Facp);
+  if (Status == EFI_NOT_FOUND) {
+    Status = PatchAcpiTablesFromSnapshot(&Snapshot, NULL, NULL, Xsdt, Facp);
+  }
+  DirSnapshotFree(&Snapshot);
+  return Status;
+}
+
+/**
+  Patches the ACPI tables from the ACPIPatcher.apb bundle in Directory or
+  its ACPI subdirectory.  A bundle that cannot be read or is damaged is
+  logged and reported as missing, so the caller goes on to load files.
+
+  @retval EFI_NOT_FOUND  There is no usable bundle and nothing was changed.
+  @retval Other          As PatchAcpiTablesFromSnapshot().
+**/
+STATIC
+EFI_STATUS
+PatchAcpiTablesFromBundle (
+  IN EFI_FILE_PROTOCOL                 *Directory,
+  IN EFI_ACPI_DESCRIPTION_HEADER       *Xsdt,
+  IN EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE *Facp
+  )
+{
+  EFI_STATUS   Status;
+  ACPI_BUNDLE  Bundle;
+
+  Status = AcpiBundleOpen(Directory, &Bundle);
+  if (!EFI_ERROR(Status)) {
+    Status = PatchAcpiTablesFromSnapshot(NULL, NULL, &Bundle, Xsdt, Facp);
+    AcpiBundleFree(&Bundle);
+  }
+  if (EFI_ERROR(Status) && Status != EFI_NOT_FOUND) {
+    AcpiDebugPrint(DEBUG_WARN, L"Cannot use %s, loading files instead: %r\n", ACPI_BUNDLE_FILE_NAME, Status);
+    Status = EFI_NOT_FOUND;
+  }
+
+  return Status;
+}
+
+/**
+  Patches the ACPI tables from the boot cache in the snapshot's directory
+  if its fingerprint says the directory has not changed since the cache
+  was written.  A stale, missing or damaged cache is reported as missing,
+  so the caller scans the directory.
+
+  @retval EFI_NOT_FOUND  There is no usable cache and nothing was changed.
+  @retval Other          As PatchAcpiTablesFromSnapshot().
+**/
+STATIC
+EFI_STATUS
+PatchAcpiTablesFromCache (
+  IN DIR_SNAPSHOT                      *Snapshot,
+  IN EFI_ACPI_DESCRIPTION_HEADER       *Xsdt,
+  IN EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE *Facp
+  )
+{
+  EFI_STATUS   Status;
+  ACPI_BUNDLE  Bundle;
+
+  // A directory without tables has nothing worth caching
+  if (Xsdt == NULL || Snapshot->AmlCount == 0) {
+    return EFI_NOT_FOUND;
+  }
+
+  Status = BootCacheOpen(Snapshot, BootCacheFingerprint(Snapshot, Xsdt), &Bundle);
+  if (!EFI_ERROR(Status)) {
+    Status = PatchAcpiTablesFromSnapshot(NULL, NULL, &Bundle, Xsdt, Facp);
+    AcpiBundleFree(&Bundle);
+  }
+  if (EFI_ERROR(Status) && Status != EFI_NOT_FOUND) {
+    AcpiDebugPrint(DEBUG_WARN, L"Cannot use %s, scanning instead: %r\n", BOOT_CACHE_FILE_NAME, Status);
+    Status = EFI_NOT_FOUND;
+  }
+
+  return Status;
+}
+
+/**
+  Records what to do with a loaded table in the plan.  Tables the plan
+  already holds a copy of are dropped here.  An appended SSDT that is a
+  patched copy of a firmware one is only found out when the plan is
+  committed, against the XSDT of the time.
+**/
+STATIC
+VOID
+PlanAmlTable (
+  IN     CONST CHAR16                 *Name,
+  IN     EFI_ACPI_DESCRIPTION_HEADER  *Table,
+  IN     TABLE_ARENA                  *Arena,
+  IN OUT XSDT_PLAN                    *Plan,
+  IN     XSDT_OP_KIND                 Kind
+  )
+{
+  EFI_STATUS Status;
+
+  Status = XsdtPlanAdd(Plan, Kind, Table->Signature, Table, Name);
+  if (EFI_ERROR(Status)) {
+    // A duplicate has already been reported by the plan
+    if (Status != EFI_ALREADY_STARTED) {
+      AcpiDebugPrint(DEBUG_WARN, L"Failed to plan %s: %r\n", Name, Status);
+    }
+    FreeAmlTable(Arena, Table);
+  }
+}
+
+/**
+  Loads one snapshot entry and records what to do with it in the plan,
+  as PlanAmlTable().
+**/
+STATIC
+VOID
+PlanAmlEntry (
+  IN     DIR_SNAPSHOT        *Snapshot,
+  IN     DIR_SNAPSHOT_ENTRY  *Entry,
+  IN     TABLE_ARENA         *Arena,
+  IN OUT XSDT_PLAN           *Plan,
+  IN     XSDT_OP_KIND        Kind
+  )
+{
+  EFI_ACPI_DESCRIPTION_HEADER *Table = NULL;
+  UINTN TableSize = 0;
+  EFI_STATUS Status;
+
+  Status = LoadAmlEntry(Snapshot, Entry, Arena, &Table, &TableSize);
+  if (EFI_ERROR(Status)) {
+    AcpiDebugPrint(DEBUG_WARN, L"Failed to load %s: %r\n", Entry->Name, Status);
+    return;
+  }
+
+  PlanAmlTable(Entry->Name, Table, Arena, Plan, Kind);
+}
+
+/**
+  Appends the snapshot entries of one kind to a load queue, in snapshot
+  order.  Numbered SSDTs go in numeric order instead, so SSDT-2 comes
+  before SSDT-10 whatever the name order; every numbered file is queued,
+  not just SSDT-1 to SSDT-10.
+
+  @param[in]     Snapshot  Snapshot of the ACPI files directory
+  @param[in]     Kind      Kind of entry to queue
+  @param[in,out] Queue     Queue with room for every AML entry
+  @param[in,out] Count     Entries in Queue
+
+  @return The number of entries queued.
+**/
+STATIC
+UINTN
+QueueAcpiDirEntries (
+  IN     DIR_SNAPSHOT        *Snapshot,
+  IN     DIR_ENTRY_KIND      Kind,
+  IN OUT DIR_SNAPSHOT_ENTRY  **Queue,
+  IN OUT UINTN               *Count
+  )
+{
+  UINTN First;
+  UINTN Index;
+  UINTN Slot;
+  UINTN Number;
+
+  First = *Count;
+  for (Index = 0; Index < Snapshot->Count; Index++) {
+    if (Snapshot->Entries[Index].Kind != Kind) {
+      continue;
+    }
+
+    //
+    // Insertion by number.  The snapshot is in name order, which only
+    // differs from numeric order where the digit counts differ, so this
+    // stays close to linear.
+    //
+    Slot = *Count;
+    if (Kind == DirEntrySsdtNumbered) {
+      Number = StrDecimalToUintn(Snapshot->Entries[Index].Name + 5);
+      for ( ; Slot > First && StrDecimalToUintn(Queue[Slot - 1]->Name + 5) > Number; Slot--) {
+        Queue[Slot] = Queue[Slot - 1];
+      }
+    }
+    Queue[Slot] = &Snapshot->Entries[Index];
+    (*Count)++;
+  }
+
+  return *Count - First;
+}
+
+/**
+  Plans one manifest entry with the action the manifest gives, once its
+  table has been loaded.  A table whose hash differs from the manifest's
+  is not installed; the hash is the one the plan keys duplicates on, so
+  checking it costs nothing extra.
+
+  @param[in]     Entry  Manifest entry
+  @param[in]     Table  Its table, or NULL for a drop
+  @param[in]     Arena  Arena the table was placed in
+  @param[in,out] Plan   Plan to add the entry to
+**/
+STATIC
+VOID
+PlanManifestEntry (
+  IN     CONST ACPI_MANIFEST_ENTRY    *Entry,
+  IN     EFI_ACPI_DESCRIPTION_HEADER  *Table  OPTIONAL,
+  IN     TABLE_ARENA                  *Arena,
+  IN OUT XSDT_PLAN                    *Plan
+  )
+{
+  UINT64 Hash;
+  EFI_STATUS Status;
+
+  AcpiDebugPrint(DEBUG_VERBOSE, L"Manifest line %d: %s\n", Entry->Line, Entry->Name);
+  if (Entry->Kind == XsdtOpDrop) {
+    Status = XsdtPlanAdd(Plan, XsdtOpDrop, Entry->Signature, NULL, Entry->Name);
+    if (EFI_ERROR(Status)) {
+      AcpiDebugPrint(DEBUG_WARN, L"Failed to plan drop of %s: %r\n", Entry->Name, Status);
+    }
+    return;
+  }
+
+  Hash = XsdtPlanHash(Table, Table->Length);
+  if (Entry->HasHash && Hash != Entry->Hash) {
+    AcpiDebugPrint(DEBUG_WARN, L"%s: hash is %016lx, manifest expects %016lx, skipping\n",
+                   Entry->Name, Hash, Entry->Hash);
+    FreeAmlTable(Arena, Table);
+    return;
+  }
+
+  Status = XsdtPlanAddHashed(Plan, Entry->Kind, Table->Signature, Table, Hash, Entry->Name);
+  if (EFI_ERROR(Status)) {
+    if (Status != EFI_ALREADY_STARTED) {
+      AcpiDebugPrint(DEBUG_WARN, L"Failed to plan %s: %r\n", Entry->Name, Status);
+    }
+    FreeAmlTable(Arena, Table);
+  }
+}
+
+/**
+  Plans the entries of a bundle read into the arena, in bundle order.  The
+  tables stay where the read put them; one that fails its checks, or that
+  the plan turns away, is left unused in the arena.
+**/
+STATIC
+VOID
+PlanBundleEntries (
+  IN     CONST ACPI_BUNDLE  *Bundle,
+  IN OUT XSDT_PLAN          *Plan
+  )
+{
+  EFI_ACPI_DESCRIPTION_HEADER *Table;
+  CONST CHAR16 *Name;
+  XSDT_OP_KIND Kind;
+  UINTN Index;
+  UINT64 Hash;
+  UINT8 Sum;
+  EFI_STATUS Status;
+
+  for (Index = 0; Index < Bundle->Header->EntryCount; Index++) {
+    Name   = ACPI_BUNDLE_ENTRY_NAME(Bundle, Index);
+    Status = AcpiBundleTable(Bundle, Index, &Kind, &Table);
+    if (EFI_ERROR(Status)) {
+      continue;
+    }
+
+    if (Kind == XsdtOpDrop) {
+      Status = XsdtPlanAdd(Plan, XsdtOpDrop, Bundle->Entries[Index].Signature, NULL, Name);
+      if (EFI_ERROR(Status)) {
+        AcpiDebugPrint(DEBUG_WARN, L"Failed to plan drop of %s: %r\n", Name, Status);
+      }
+      continue;
+    }
+
+    Hash = XsdtPlanHash(Table, Table->Length);
+    if (Hash != Bundle->Entries[Index].Hash) {
+      AcpiDebugPrint(DEBUG_WARN, L"%s: hash is %016lx, bundle expects %016lx, skipping\n",
+                     Name, Hash, Bundle->Entries[Index].Hash);
+      continue;
+    }
+
+    Sum = AcpiChecksumSum(Table, Table->Length);
+    if (Sum != 0) {
+      AcpiDebugPrint(DEBUG_WARN, L"%s: checksum is off by 0x%02x\n", Name, Sum);
+    }
+
+    Status = XsdtPlanAddHashed(Plan, Kind, Table->Signature, Table, Hash, Name);
+    if (EFI_ERROR(Status) && Status != EFI_ALREADY_STARTED) {
+      AcpiDebugPrint(DEBUG_WARN, L"Failed to plan %s: %r\n", Name, Status);
+    }
+  }
+}
+
+#ifdef DXE_DRIVER_BUILD
+/**
+  Plans the tables embedded in the driver's firmware file, in section
+  order.  Each is copied into the arena, summed on the way, and checked as
+  a file would be; a DSDT is planned as a replacement and anything else as
+  an append.
+**/
+STATIC
+VOID
+PlanEmbeddedTables (
+  IN     CONST ACPI_EMBEDDED  *Embedded,
+  IN     TABLE_ARENA          *Arena,
+  IN OUT XSDT_PLAN            *Plan
+  )
+{
+  EFI_ACPI_DESCRIPTION_HEADER *Table;
+  CONST CHAR16 *Name;
+  UINTN Size;
+  UINTN Index;
+  UINT8 Sum;
+
+  for (Index = 0; Index < Embedded->Count; Index++) {
+    Name = Embedded->Tables[Index].Name;
+    Size = Embedded->Tables[Index].Size;
+    if (Size < sizeof(EFI_ACPI_DESCRIPTION_HEADER) || Size > MAX_UINT32) {
+      AcpiDebugPrint(DEBUG_WARN, L"%s: %d bytes is not an ACPI table, skipping\n", Name, Size);
+      continue;
+    }
+
+    // Sized for in AcpiEmbeddedOpen(), so there is always room
+    Table = TableArenaAllocate(Arena, Size);
+    if (Table == NULL) {
+      AcpiDebugPrint(DEBUG_WARN, L"Failed to place %s\n", Name);
+      continue;
+    }
+
+    Sum = AcpiChecksumCopy(Table, Embedded->Tables[Index].Table, Size);
+    if (EFI_ERROR(CheckAmlHeader(Table, Size, Name))) {
+      TableArenaFree(Arena, Table);
+      continue;
+    }
+    if (Sum != 0) {
+      AcpiDebugPrint(DEBUG_WARN, L"%s: checksum is off by 0x%02x\n", Name, Sum);
+    }
+
+    PlanAmlTable(Name, Table, Arena, Plan,
+                 (Table->Signature == EFI_ACPI_2_0_DIFFERENTIATED_SYSTEM_DESCRIPTION_TABLE_SIGNATURE) ?
+                 XsdtOpReplace : XsdtOpAppend);
+  }
+}
+
+/**
+  Plans the tables embedded in the driver's own firmware file, if it has
+  any, and schedules the commit for ReadyToBoot.  Nothing waits for a file
+  system: the tables are in memory as soon as the driver runs, so the
+  volumes are not searched at all.
+
+  The firmware's own tables are not needed until the commit, and are
+  often not published yet when the driver runs, so they are only looked
+  up at ReadyToBoot.  The new XSDT is sized there too, and gets pages of
+  its own then.
+
+  @retval EFI_SUCCESS    The embedded tables are planned and scheduled, or
+                         were committed straight away.
+  @retval EFI_NOT_FOUND  There are no embedded tables, or none of them
+                         could be planned; nothing was changed.
+  @retval Other          There was no memory for the tables, or they could
+                         be neither scheduled nor committed; nothing was
+                         changed.
+**/
+STATIC
+EFI_STATUS
+PatchAcpiTablesFromFv (
+  VOID
+  )
+{
+  ACPI_EMBEDDED   Embedded;
+  ACPI_PLAN_JOB   Job;
+  EFI_STATUS      Status;
+
+  Status = AcpiEmbeddedOpen(&Embedded);
+  if (EFI_ERROR(Status)) {
+    return Status;
+  }
+
+  ZeroMem(&Job, sizeof(Job));
+  Job.AmlCount = Embedded.Count;
+
+  // The plan is committed against gXsdtIndex as FindFadtInXsdt() builds
+  // it at ReadyToBoot; until then it may well be empty
+  Status = TableArenaCreate(&Job.Arena, Embedded.ArenaSize);
+  if (!EFI_ERROR(Status)) {
+    Status = XsdtPlanInit(&Job.Plan, &gXsdtIndex, Embedded.Count);
+    if (EFI_ERROR(Status)) {
+      TableArenaDestroy(&Job.Arena);
+    }
+  }
+  if (EFI_ERROR(Status)) {
+    AcpiEmbeddedFree(&Embedded);
+    return Status;
+  }
+
+  PlanEmbeddedTables(&Embedded, &Job.Arena, &Job.Plan);
+
+  // The names in the plan belong to the sections, which go now
+  if (Job.Plan.Count > 0) {
+    Status = XsdtPlanKeepSources(&Job.Plan);
+  }
+  AcpiEmbeddedFree(&Embedded);
+  if (Job.Plan.Count == 0 || EFI_ERROR(Status)) {
+    AcpiDebugPrint(DEBUG_WARN, L"No embedded table could be used, looking for ACPI files\n");
+    XsdtPlanFree(&Job.Plan);
+    TableArenaDestroy(&Job.Arena);
+    return EFI_NOT_FOUND;
+  }
+
+  // Other drivers may still install tables before boot
+  Status = ScheduleAcpiPlan(&Job, NULL, NULL);
+  if (EFI_ERROR(Status)) {
+    AcpiDebugPrint(DEBUG_WARN, L"[DXE] Cannot wait for ReadyToBoot, patching now: %r\n", Status);
+    EndAcpiPlan(&Job);
+    Status = LocateFirmwareAcpiTables();
+    if (EFI_ERROR(Status)) {
+      XsdtPlanFree(&Job.Plan);
+      TableArenaDestroy(&Job.Arena);
+      return Status;
+    }
+    CommitAcpiPlan(&Job.Plan, &Job.Arena, gXsdt, gFacp);
+  }
+
+  return EFI_SUCCESS;
+}
+#endif
+
+/**
+  Starts a plan: sizes and creates the arena and the plan, and works out
+  which tables to load.  A bundle is read and planned here, in one go;
+  a manifest's entries or the snapshot's AML files are left for
+  PlanNextAcpiTables() to load.
+
+  @param[out] Job       Job to start
+  @param[in]  Snapshot  Snapshot of the ACPI files directory, or NULL
+  @param[in]  Manifest  Manifest Snapshot was built from, or NULL to scan
+                        Snapshot for tables
+  @param[in]  Bundle    Bundle to plan from instead of Snapshot, or NULL
+  @param[in]  Xsdt      Firmware XSDT
+
+  @retval EFI_SUCCESS  The job is ready.  It has no plan if there was
+                       nothing to apply.
+  @retval Other        As PatchAcpiTablesFromSnapshot().
+**/
+STATIC
+EFI_STATUS
+BeginAcpiPlan (
+  OUT ACPI_PLAN_JOB                    *Job,
+  IN  DIR_SNAPSHOT                     *Snapshot  OPTIONAL,
+  IN  ACPI_MANIFEST                    *Manifest  OPTIONAL,
+  IN  ACPI_BUNDLE                      *Bundle    OPTIONAL,
+  IN  EFI_ACPI_DESCRIPTION_HEADER      *Xsdt
+  )
+{
+  UINTN                       OpCount;
+  UINT32                      CurrentEntries;
+  UINTN                       AmlCount;
+  UINTN                       ArenaSize;
+  UINTN                       Index;
+  UINTN                       Queued[4];
+  EFI_STATUS                  Status;
+
+  ZeroMem(Job, sizeof(*Job));
+  Job->Snapshot = Snapshot;
+  Job->Manifest = Manifest;
+  Job->Xsdt     = Xsdt;
+
+  CurrentEntries = (Xsdt->Length - sizeof(EFI_ACPI_DESCRIPTION_HEADER)) / sizeof(UINT64);
+  AmlCount = (Snapshot != NULL) ? Snapshot->AmlCount : 0;
+  // A manifest can also list drops, which load nothing
+  OpCount = (Manifest != NULL) ? Manifest->Count : AmlCount;
+  if (Bundle != NULL) {
+    // The entry count is only known once the bundle is read.  Every table
+    // in it takes an entry and at least a header, which bounds the count.
+    AmlCount = (Bundle->FileSize - sizeof(ACPI_BUNDLE_HEADER)) /
+               (sizeof(ACPI_BUNDLE_ENTRY) + TABLE_ARENA_SIZE(sizeof(EFI_ACPI_DESCRIPTION_HEADER)));
+    OpCount  = AmlCount;
+  }
+  Job->AmlCount = AmlCount;
 
-  // Enhanced debug output for patching process
-  Print(L"[INFO]  === ACPI Patching Analysis ===\n");
-  Print(L"[INFO]  Original XSDT: %d entries, %d bytes\n", CurrentEntries, Xsdt->Length);
-  Print(L"[INFO]  New XSDT capacity: %d entries, %d bytes\n", MaxEntries, NewXsdtSize);
-  
   // Show current XSDT contents before patching
   UINT64 *OriginalEntryPtr = (UINT64 *)(Xsdt + 1);
-  Print(L"[INFO]  Current ACPI tables in XSDT:\n");
+  AcpiDebugPrint(DEBUG_VERBOSE, L"=== ACPI Patching Analysis ===\n");
+  AcpiDebugPrint(DEBUG_VERBOSE, L"Original XSDT: %d entries, %d bytes at " PTR_FMT L"\n",
+                 CurrentEntries, Xsdt->Length, PTR_TO_INT(Xsdt));
+  AcpiDebugPrint(DEBUG_VERBOSE, L"Current ACPI tables in XSDT:\n");
   for (UINTN i = 0; i < CurrentEntries; i++) {
     EFI_ACPI_DESCRIPTION_HEADER *TableEntry = (EFI_ACPI_DESCRIPTION_HEADER *)(UINTN)OriginalEntryPtr[i];
     if (TableEntry != NULL) {
       CHAR8 TableSig[5];
       CopyMem(TableSig, &TableEntry->Signature, 4);
       TableSig[4] = '\0';
-      Print(L"[INFO]    [%d] %a - %d bytes, checksum=0x%02x\n", 
+      AcpiDebugPrint(DEBUG_VERBOSE, L"  [%d] %a - %d bytes, checksum=0x%02x\n", 
             i, TableSig, TableEntry->Length, TableEntry->Checksum);
     }
   }
 
-  // Show memory layout changes before patching
-  Print(L"[INFO]  === Memory Layout Changes ===\n");
-  Print(L"[INFO]  Original XSDT address: " PTR_FMT L"\n", PTR_TO_INT(Xsdt));
-  Print(L"[INFO]  New XSDT address: " PTR_FMT L"\n", PTR_TO_INT(NewXsdt));
-  Print(L"[INFO]  Memory allocated: %d bytes\n", NewXsdtSize);
+  if (OpCount == 0) {
+    AcpiDebugPrint(DEBUG_INFO, L"No ACPI files to apply, keeping firmware tables\n");
+    XsdtIndexFree(&gXsdtIndex);
+    return EFI_SUCCESS;
+  }
+
+  // Reserve one arena for every table that could be loaded plus the new
+  // XSDT at its largest, i.e. if every file turned out to be an append.
+  ArenaSize = TABLE_ARENA_SIZE(sizeof(EFI_ACPI_DESCRIPTION_HEADER) +
+                               (CurrentEntries + AmlCount + ACPI_XSDT_SPARE_ENTRIES) * sizeof(UINT64));
+  if (Bundle != NULL) {
+    ArenaSize += TABLE_ARENA_SIZE(Bundle->FileSize);
+  } else {
+    // StartAmlRead() skips the same files this leaves out, so one stray
+    // multi-gigabyte *.aml cannot make the whole arena fail.
+    for (Index = 0; Index < Snapshot->Count; Index++) {
+      if (Snapshot->Entries[Index].Kind >= DirEntryDsdt) {
+        ArenaSize += AmlEntryTableSize(&Snapshot->Entries[Index]);
+      }
+    }
+  }
+
+  Status = TableArenaCreate(&Job->Arena, ArenaSize);
+  if (EFI_ERROR(Status)) {
+    AcpiDebugPrint(DEBUG_ERROR, L"Failed to allocate memory for new tables\n");
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  // The index normally comes from FindFadtInXsdt(); build it here for a
+  // caller that located the tables itself.
+  if (gXsdtIndex.Xsdt != Xsdt) {
+    XsdtIndexFree(&gXsdtIndex);
+    Status = XsdtIndexBuild(&gXsdtIndex, Xsdt);
+    if (EFI_ERROR(Status)) {
+      TableArenaDestroy(&Job->Arena);
+      return Status;
+    }
+  }
+
+  // One read brings in the whole bundle, tables already in place
+  if (Bundle != NULL) {
+    Status = AcpiBundleRead(Bundle, &Job->Arena);
+    if (EFI_ERROR(Status)) {
+      XsdtIndexFree(&gXsdtIndex);
+      TableArenaDestroy(&Job->Arena);
+      return Status;
+    }
+    OpCount = Bundle->Header->EntryCount;
+  }
+
+  Status = XsdtPlanInit(&Job->Plan, &gXsdtIndex, OpCount);
+  if (EFI_ERROR(Status)) {
+    XsdtIndexFree(&gXsdtIndex);
+    TableArenaDestroy(&Job->Arena);
+    return Status;
+  }
+
+  if (Bundle != NULL) {
+    PlanBundleEntries(Bundle, &Job->Plan);
+    return EFI_SUCCESS;
+  }
+  if (Manifest != NULL) {
+    Job->Count = Manifest->Count;
+    return EFI_SUCCESS;
+  }
 
-  // Note: In a real implementation, you would:
-  // - Actually load and parse .aml files from the file system
-  // - Replace specific tables (like DSDT) with patched versions
-  // - Add new SSDT tables
-  // - Update the system's RSDP to point to the new XSDT
-  // - Properly validate all checksums
+  // DSDT.aml, the numbered SSDTs, the descriptively named SSDTs, then
+  // every other AML file
+  Job->Queue = AllocatePool(AmlCount * sizeof(*Job->Queue));
+  if (Job->Queue == NULL) {
+    XsdtPlanFree(&Job->Plan);
+    XsdtIndexFree(&gXsdtIndex);
+    TableArenaDestroy(&Job->Arena);
+    return EFI_OUT_OF_RESOURCES;
+  }
+  Queued[0] = QueueAcpiDirEntries(Snapshot, DirEntryDsdt, Job->Queue, &Job->Count);
+  Queued[1] = QueueAcpiDirEntries(Snapshot, DirEntrySsdtNumbered, Job->Queue, &Job->Count);
+  Queued[2] = QueueAcpiDirEntries(Snapshot, DirEntrySsdtNamed, Job->Queue, &Job->Count);
+  Queued[3] = QueueAcpiDirEntries(Snapshot, DirEntryAml, Job->Queue, &Job->Count);
+  if (Queued[0] == 0) {
+    AcpiDebugPrint(DEBUG_INFO, L"No DSDT.aml file found, keeping original\n");
+  }
+  AcpiDebugPrint(DEBUG_INFO, L"%d files to load: %d numbered SSDT, %d other SSDT, %d other AML\n",
+                 Job->Count, Queued[1], Queued[2], Queued[3]);
 
-  Print(L"[INFO]  === Patching Summary ===\n");
-  Print(L"[INFO]  Tables processed: %d\n", CurrentEntries);
-  Print(L"[INFO]  New table capacity: %d\n", MaxEntries);
-  Print(L"[INFO]  Memory usage: %d bytes\n", NewXsdtSize);
+  return EFI_SUCCESS;
+}
 
-  // *** ACTUAL PATCHING IMPLEMENTATION ***
-  Print(L"[INFO]  === Starting Real ACPI Patching ===\n");
+/**
+  Starts reading entry Index of a job, unless it is a manifest drop, which
+  reads nothing.
+**/
+STATIC
+VOID
+StartAcpiPlanRead (
+  IN OUT ACPI_PLAN_JOB  *Job,
+  IN     UINTN          Index
+  )
+{
+  ACPI_TABLE_READ           *Read;
+  CONST ACPI_MANIFEST_ENTRY *ManifestEntry;
+
+  Read = &Job->Reads[Index % ACPI_READ_AHEAD];
+  if (Job->Manifest != NULL) {
+    ManifestEntry = &Job->Manifest->Entries[Index];
+    if (ManifestEntry->Kind == XsdtOpDrop) {
+      ZeroMem(Read, sizeof(*Read));
+      return;
+    }
+    StartAmlRead(&Job->Manifest->Snapshot, ManifestEntry->File, &Job->Arena, Read);
+  } else {
+    StartAmlRead(Job->Snapshot, Job->Queue[Index], &Job->Arena, Read);
+  }
+}
+
+/**
+  Loads, checks and plans the next tables of a job, until Budget bytes of
+  files have been read.
+
+  Up to ACPI_READ_AHEAD files are kept reading ahead of the one being
+  planned, so a file system driver with ReadEx() can overlap them.  The
+  tables are still planned in order.  With a budget, a call stops early
+  rather than wait on a read that has not completed yet; the reads carry
+  on until the next call.
+
+  @param[in,out] Job     Job started by BeginAcpiPlan()
+  @param[in]     Budget  Bytes to read, or MAX_UINTN to load the rest
+
+  @retval TRUE   Every table of the job has been planned.
+  @retval FALSE  Tables are left for the next call.
+**/
+STATIC
+BOOLEAN
+PlanNextAcpiTables (
+  IN OUT ACPI_PLAN_JOB  *Job,
+  IN     UINTN          Budget
+  )
+{
+  CONST ACPI_MANIFEST_ENTRY   *ManifestEntry;
+  ACPI_TABLE_READ             *Read;
+  EFI_ACPI_DESCRIPTION_HEADER *Table;
+  UINTN                       TableSize;
+  UINT64                      Done;
+  EFI_STATUS                  Status;
+
+  Done = 0;
+  while (Job->Next < Job->Count && Done < Budget) {
+    while (Job->Issued < Job->Count && Job->Issued - Job->Next < ACPI_READ_AHEAD) {
+      StartAcpiPlanRead(Job, Job->Issued++);
+    }
+
+    Read = &Job->Reads[Job->Next % ACPI_READ_AHEAD];
+    if (Budget != MAX_UINTN && Read->File != NULL &&
+        FsReadAsyncPoll(&Read->Read) == EFI_NOT_READY) {
+      break;
+    }
+
+    ManifestEntry = (Job->Manifest != NULL) ? &Job->Manifest->Entries[Job->Next] : NULL;
+    Job->Next++;
+    if (ManifestEntry != NULL && ManifestEntry->Kind == XsdtOpDrop) {
+      PlanManifestEntry(ManifestEntry, NULL, &Job->Arena, &Job->Plan);
+      continue;
+    }
+
+    Status = FinishAmlRead(Read, &Job->Arena, &Table, &TableSize);
+    Done  += Read->Entry->FileSize;
+    if (EFI_ERROR(Status)) {
+      AcpiDebugPrint(DEBUG_WARN, L"Failed to load %s: %r\n", Read->Entry->Name, Status);
+    } else if (ManifestEntry != NULL) {
+      PlanManifestEntry(ManifestEntry, Table, &Job->Arena, &Job->Plan);
+    } else {
+      PlanAmlTable(Read->Entry->Name, Table, &Job->Arena, &Job->Plan,
+                   (Read->Entry->Kind == DirEntryDsdt) ? XsdtOpReplace : XsdtOpAppend);
+    }
+  }
+
+  return (BOOLEAN)(Job->Next >= Job->Count);
+}
+
+/**
+  Ends the load phase of a job.  A scan that planned every file leaves the
+  result in the boot cache, and the load queue is released; the plan and
+  arena are left for CommitAcpiPlan().
+**/
+STATIC
+VOID
+EndAcpiPlan (
+  IN OUT ACPI_PLAN_JOB  *Job
+  )
+{
+  EFI_STATUS Status;
+
+  if (Job->Queue != NULL) {
+    // Leave the result for the next boot, but only if every file made it
+    // into the plan: a file that failed to load this time must be tried
+    // again rather than be left out until the directory changes.
+    if (Job->Plan.Count + Job->Plan.Duplicates == Job->AmlCount) {
+      Status = BootCacheWrite(Job->Snapshot, BootCacheFingerprint(Job->Snapshot, Job->Xsdt), &Job->Plan);
+      if (EFI_ERROR(Status)) {
+        AcpiDebugPrint(DEBUG_INFO, L"Cannot write %s: %r\n", BOOT_CACHE_FILE_NAME, Status);
+      }
+    } else {
+      AcpiDebugPrint(DEBUG_VERBOSE, L"%d of %d files loaded, not writing %s\n",
+                     Job->Plan.Count + Job->Plan.Duplicates, Job->AmlCount, BOOT_CACHE_FILE_NAME);
+    }
+
+    FreePool(Job->Queue);
+    Job->Queue = NULL;
+  }
+
+  if (Job->Plan.Duplicates > 0) {
+    AcpiDebugPrint(DEBUG_INFO, L"Skipped %d duplicate tables\n", Job->Plan.Duplicates);
+  }
+}
+
+/**
+  Patches the ACPI tables with the files listed in a directory snapshot.
+
+  Patching runs in two phases.  The plan phase loads DSDT.aml, the numbered
+  SSDTs, the descriptively named SSDTs and then any other AML file, in that
+  order, and records a replace or append operation for each table that
+  loaded.  With a manifest it loads the files the manifest lists instead,
+  in its order and with its actions.  With a bundle it reads the bundle
+  into the arena and plans its entries.  The commit phase then builds the new
+  XSDT once, at its final size, and points the RSDP at it.
+
+  The driver build loads the files a slice at a time from a timer and
+  commits at ReadyToBoot; it takes over Snapshot and Manifest to do so,
+  and leaves them zeroed.
+  
+  @param[in,out] Snapshot  Snapshot of the ACPI files directory, or NULL
+  @param[in,out] Manifest  Manifest Snapshot was built from, or NULL to
+                           scan Snapshot for tables
+  @param[in]     Bundle    Bundle opened by AcpiBundleOpen() to patch from
+                           instead of Snapshot, or NULL
+  @param[in]     Xsdt      Pointer to the Extended System Description Table
+  @param[in]     Facp      Pointer to the Fixed ACPI Description Table
   
-  UINTN TablesPatched = 0;
-  EFI_STATUS PatchStatus;
+  @retval EFI_SUCCESS           Patching completed successfully
+  @retval EFI_INVALID_PARAMETER Invalid parameters provided
+  @retval EFI_OUT_OF_RESOURCES  Insufficient memory for operations
+  @retval EFI_VOLUME_CORRUPTED  Bundle is damaged; nothing was changed
+**/
+EFI_STATUS
+PatchAcpiTablesFromSnapshot (
+  IN OUT DIR_SNAPSHOT                  *Snapshot  OPTIONAL,
+  IN OUT ACPI_MANIFEST                 *Manifest  OPTIONAL,
+  IN ACPI_BUNDLE                       *Bundle    OPTIONAL,
+  IN EFI_ACPI_DESCRIPTION_HEADER       *Xsdt,
+  IN EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE *Facp
+  )
+{
+  ACPI_PLAN_JOB               Job;
+  EFI_STATUS                  Status;
   
-  // Try to load and replace DSDT.aml if present
-  if (Directory != NULL) {
-    EFI_ACPI_DESCRIPTION_HEADER *NewDsdt = NULL;
-    UINTN DsdtSize = 0;
-    
-    // Try to load DSDT.aml
-    EFI_STATUS DsdtStatus = LoadAmlFile(Directory, L"DSDT.aml", &NewDsdt, &DsdtSize);
-      if (!EFI_ERROR(DsdtStatus) && NewDsdt != NULL) {
-        // Replace DSDT in XSDT
-        PatchStatus = ReplaceTableInXsdt(NewXsdt, 
-                                       EFI_ACPI_2_0_DIFFERENTIATED_SYSTEM_DESCRIPTION_TABLE_SIGNATURE,
-                                       NewDsdt);
-        if (!EFI_ERROR(PatchStatus)) {
-          Print(L"[INFO]  ✓ DSDT replaced successfully\n");
-          TablesPatched++;
-          
-          // Update FADT pointers to new DSDT
-          if (Facp != NULL) {
-            Facp->Dsdt = (UINT32)(UINTN)NewDsdt;
-            Facp->XDsdt = (UINT64)(UINTN)NewDsdt;
-            Print(L"[INFO]  ✓ FADT DSDT pointers updated\n");
-          }
-        }
-      } else {
-        Print(L"[INFO]  No DSDT.aml file found, keeping original\n");
-      }
-      
-      // Try to load additional SSDT tables by scanning directory
-      Print(L"[INFO]  Scanning for SSDT-*.aml files...\n");
-      
-      // First, try the numeric pattern for backward compatibility
-      CHAR16 SsdtFileName[64];
-      for (UINTN SsdtIndex = 1; SsdtIndex <= 10; SsdtIndex++) {
-        UnicodeSPrint(SsdtFileName, sizeof(SsdtFileName), L"SSDT-%d.aml", SsdtIndex);
-        
-        EFI_ACPI_DESCRIPTION_HEADER *NewSsdt = NULL;
-        UINTN SsdtSize = 0;
-        
-        EFI_STATUS SsdtStatus = LoadAmlFile(Directory, SsdtFileName, &NewSsdt, &SsdtSize);
-        if (!EFI_ERROR(SsdtStatus) && NewSsdt != NULL) {
-          // Add new SSDT to XSDT (append to end)
-          PatchStatus = AddTableToXsdt(NewXsdt, NewSsdt, &MaxEntries);
-          if (!EFI_ERROR(PatchStatus)) {
-            Print(L"[INFO]  ✓ %s added successfully\n", SsdtFileName);
-            TablesPatched++;
-          }
-        }
-      }
-      
-      // Now scan directory for any other SSDT-*.aml files
-      EFI_STATUS ScanStatus = ScanDirectoryForSsdtFiles(Directory, NewXsdt, &MaxEntries, &TablesPatched);
-      if (EFI_ERROR(ScanStatus)) {
-        Print(L"[WARN]  Directory scanning failed: %r\n", ScanStatus);
-      }
+  AcpiDebugPrint(DEBUG_INFO, L"Starting ACPI patching process...\n");
+  
+  // Snapshot can be NULL when no ACPI files directory was found
+  if (Xsdt == NULL || Facp == NULL) {
+    AcpiDebugPrint(DEBUG_ERROR, L"Invalid parameters for ACPI patching\n");
+    AcpiDebugPrint(DEBUG_VERBOSE, L"  Snapshot: " PTR_FMT L"\n", PTR_TO_INT(Snapshot));
+    AcpiDebugPrint(DEBUG_VERBOSE, L"  Xsdt: " PTR_FMT L"\n", PTR_TO_INT(Xsdt));
+    AcpiDebugPrint(DEBUG_VERBOSE, L"  Facp: " PTR_FMT L"\n", PTR_TO_INT(Facp));
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Status = BeginAcpiPlan(&Job, Snapshot, Manifest, Bundle, Xsdt);
+  if (EFI_ERROR(Status) || Job.Plan.Ops == NULL) {
+    return Status;
+  }
+
+#ifdef DXE_DRIVER_BUILD
+  // Other drivers may still install tables before boot, and DXE dispatch
+  // should not wait for our reads
+  if (Job.Count > 0 || Job.Plan.Count > 0) {
+    Status = ScheduleAcpiPlan(&Job, Snapshot, Manifest);
+    if (!EFI_ERROR(Status)) {
+      return EFI_SUCCESS;
+    }
+    AcpiDebugPrint(DEBUG_WARN, L"[DXE] Cannot wait for ReadyToBoot, patching now: %r\n", Status);
+  }
+#endif
+
+  while (!PlanNextAcpiTables(&Job, MAX_UINTN)) {
+  }
+  EndAcpiPlan(&Job);
+
+  CommitAcpiPlan(&Job.Plan, &Job.Arena, Xsdt, Facp);
+  return EFI_SUCCESS;
+}
+
+/**
+  Builds the new XSDT a plan describes and points the RSDP at it.  The
+  plan and the index of Xsdt are freed, and so is the arena if nothing
+  was published from it.
+
+  @param[in,out] Plan   Plan to apply, made against the index of Xsdt
+  @param[in,out] Arena  Arena holding the planned tables
+  @param[in]     Xsdt   Firmware XSDT
+  @param[in]     Facp   Firmware FADT
+
+  @return The number of operations applied.
+**/
+STATIC
+UINTN
+CommitAcpiPlan (
+  IN OUT XSDT_PLAN                     *Plan,
+  IN OUT TABLE_ARENA                   *Arena,
+  IN EFI_ACPI_DESCRIPTION_HEADER       *Xsdt,
+  IN EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE *Facp
+  )
+{
+  UINTN                       TablesPatched;
+  EFI_ACPI_DESCRIPTION_HEADER *NewXsdt;
+  EFI_STATUS                  Status;
+
+  // Commit: build the new XSDT in one pass
+  TablesPatched = 0;
+  NewXsdt = NULL;
+  if (Plan->Count > 0) {
+    Status = XsdtPlanCommit(Plan, Xsdt, Facp, Arena, &NewXsdt, &TablesPatched);
+    if (EFI_ERROR(Status)) {
+      AcpiDebugPrint(DEBUG_ERROR, L"Failed to build the new XSDT: %r\n", Status);
+    }
   }
-  
-  // Recalculate XSDT checksum after all modifications
-  NewXsdt->Checksum = 0;
-  UINT8 NewXsdtChecksum = 0;
-  UINT8 *XsdtBytes = (UINT8 *)NewXsdt;
-  for (UINTN ChecksumIndex = 0; ChecksumIndex < NewXsdt->Length; ChecksumIndex++) {
-    NewXsdtChecksum += XsdtBytes[ChecksumIndex];
+  XsdtPlanFree(Plan);
+
+  // The index describes the firmware XSDT, which is about to be retired
+  XsdtIndexFree(&gXsdtIndex);
+
+  if (NewXsdt != NULL) {
+    AcpiDebugPrint(DEBUG_VERBOSE, L"New XSDT address: " PTR_FMT L", %d bytes\n", PTR_TO_INT(NewXsdt), NewXsdt->Length);
+    AcpiDebugPrint(DEBUG_VERBOSE, L"Memory allocated: %d bytes, %d used\n", Arena->Size, Arena->Used);
+    AcpiDebugPrint(DEBUG_INFO, L"✓ XSDT checksum recalculated: 0x%02x\n", NewXsdt->Checksum);
   }
-  NewXsdt->Checksum = (UINT8)(0x100 - NewXsdtChecksum);
-  
-  Print(L"[INFO]  ✓ XSDT checksum recalculated: 0x%02x\n", NewXsdt->Checksum);
   
   // Update system RSDP to point to new XSDT (critical step!)
-  if (gRsdp != NULL && TablesPatched > 0) {
+  if (gRsdp != NULL && NewXsdt != NULL && TablesPatched > 0) {
     UINT64 OriginalXsdtAddr = gRsdp->XsdtAddress;
-    gRsdp->XsdtAddress = (UINT64)(UINTN)NewXsdt;
-    
-    // Recalculate RSDP checksum
-    gRsdp->Checksum = 0;
-    UINT8 RsdpChecksum = 0;
-    UINT8 *RsdpBytes = (UINT8 *)gRsdp;
-    for (UINTN i = 0; i < sizeof(EFI_ACPI_2_0_ROOT_SYSTEM_DESCRIPTION_POINTER); i++) {
-      RsdpChecksum += RsdpBytes[i];
-    }
-    gRsdp->Checksum = (UINT8)(0x100 - RsdpChecksum);
+
+    // XsdtAddress is only covered by the extended checksum, which is
+    // adjusted by the change in its bytes
+    AcpiRsdpSetXsdt(gRsdp, (UINT64)(UINTN)NewXsdt);
     
-    Print(L"[INFO]  ✓ RSDP updated: 0x%llx -> 0x%llx\n", OriginalXsdtAddr, gRsdp->XsdtAddress);
-    Print(L"[INFO]  ✓ RSDP checksum recalculated: 0x%02x\n", gRsdp->Checksum);
+    AcpiDebugPrint(DEBUG_INFO, L"✓ RSDP updated: 0x%llx -> 0x%llx\n", OriginalXsdtAddr, gRsdp->XsdtAddress);
+    AcpiDebugPrint(DEBUG_INFO, L"✓ RSDP extended checksum updated: 0x%02x\n", gRsdp->ExtendedChecksum);
+  }
+
+  if (TablesPatched == 0) {
+    // Nothing was published, so the arena can go back to the firmware.
+    TableArenaDestroy(Arena);
+  } else {
+    TableArenaTrim(Arena);
   }
 
-  Print(L"[INFO]  Status: Successfully patched %d ACPI tables!\n", TablesPatched);
+  AcpiDebugPrint(DEBUG_INFO, L"Status: Successfully patched %d ACPI tables!\n", TablesPatched);
 
   AcpiDebugPrint(DEBUG_INFO, L"ACPI patching completed successfully\n");
-  return EFI_SUCCESS;
+  return TablesPatched;
 }
 
 /**
   Scan directory for SSDT-*.aml files with arbitrary naming.
   This function complements the numeric pattern scanning by finding
-  descriptively named files like SSDT-CPU.aml, SSDT-GPU.aml, etc.
+  descriptively named files like SSDT-CPU.aml, SSDT-GPU.aml, etc.,
+  followed by any other .aml files, in the order BeginAcpiPlan() queues
+  them.  The snapshot is walked, so the directory itself is not read
+  again.  Every table that loads is planned as an append.
   
-  @param[in]     Directory       File system directory to scan
-  @param[in,out] Xsdt           XSDT to add tables to
-  @param[in,out] MaxEntries     Maximum entries allowed in XSDT
-  @param[in,out] TablesPatched  Counter of successfully added tables
+  @param[in]     Snapshot       Snapshot of the ACPI files directory
+  @param[in]     Arena          Arena to place the tables in, or NULL
+  @param[in,out] Plan           Plan to add the tables to
   
-  @retval EFI_SUCCESS     Directory scanning completed successfully
-  @retval Other           Error during directory operations
+  @retval EFI_SUCCESS           Directory scanning completed successfully
+  @retval EFI_OUT_OF_RESOURCES  The files could not be queued
 **/
 EFI_STATUS
 ScanDirectoryForSsdtFiles (
-  IN     EFI_FILE_PROTOCOL             *Directory,
-  IN OUT EFI_ACPI_DESCRIPTION_HEADER   *Xsdt,
-  IN OUT UINT32                        *MaxEntries,
-  IN OUT UINTN                         *TablesPatched
+  IN     DIR_SNAPSHOT                  *Snapshot,
+  IN     TABLE_ARENA                   *Arena,
+  IN OUT XSDT_PLAN                     *Plan
   )
 {
-  EFI_STATUS Status;
-  EFI_FILE_PROTOCOL *AcpiDir = NULL;
-  EFI_FILE_PROTOCOL *SearchDir = NULL;
-  EFI_FILE_INFO *FileInfo = NULL;
-  UINTN FileInfoSize;
-  BOOLEAN EndOfDirectory = FALSE;
-  UINTN FilesScanned = 0;
-  UINTN SsdtFilesFound = 0;
-  BOOLEAN UsingAcpiSubdir = FALSE;
-  
-  if (Directory == NULL || Xsdt == NULL || MaxEntries == NULL || TablesPatched == NULL) {
-    return EFI_INVALID_PARAMETER;
-  }
-  
-  Print(L"[INFO]  Starting directory scan for additional SSDT files...\n");
-  
-  // Check if the provided Directory already contains .aml files (DXE driver case)
-  // If so, use it directly. Otherwise, try to find ACPI subdirectory (application case)
-  SearchDir = Directory;
-  
-  // Try to open ACPI subdirectory (for application mode)
-  Status = Directory->Open(
-    Directory,
-    &AcpiDir,
-    L"ACPI",
-    EFI_FILE_MODE_READ,
-    0
-  );
+  DIR_SNAPSHOT_ENTRY  **Queue;
+  UINTN               Count;
+  UINTN               Named;
+  UINTN               Other;
+  UINTN               Index;
   
-  if (!EFI_ERROR(Status)) {
-    Print(L"[INFO]  Found ACPI subdirectory, scanning ACPI/ subdirectory\n");
-    SearchDir = AcpiDir;
-    UsingAcpiSubdir = TRUE;
-  } else {
-    Print(L"[INFO]  No ACPI subdirectory found, scanning provided directory\n");
-    SearchDir = Directory;
+  if (Snapshot == NULL || Plan == NULL) {
+    return EFI_INVALID_PARAMETER;
   }
   
-  // Start directory enumeration
-  while (!EndOfDirectory) {
-    FileInfoSize = sizeof(EFI_FILE_INFO) + 512;  // Buffer for filename
-    FileInfo = AllocateZeroPool(FileInfoSize);
-    if (FileInfo == NULL) {
-      Status = EFI_OUT_OF_RESOURCES;
-      break;
-    }
-    
-    Status = SearchDir->Read(SearchDir, &FileInfoSize, FileInfo);
-    if (Status == EFI_BUFFER_TOO_SMALL) {
-      // Need larger buffer for filename
-      FreePool(FileInfo);
-      FileInfo = AllocateZeroPool(FileInfoSize);
-      if (FileInfo == NULL) {
-        Status = EFI_OUT_OF_RESOURCES;
-        break;
-      }
-      Status = SearchDir->Read(SearchDir, &FileInfoSize, FileInfo);
-    }
-    
-    if (EFI_ERROR(Status) || FileInfoSize == 0) {
-      // End of directory or error
-      EndOfDirectory = TRUE;
-      FreePool(FileInfo);
-      break;
-    }
-    
-    FilesScanned++;
-    
-    // Skip directories and non-.aml files
-    if ((FileInfo->Attribute & EFI_FILE_DIRECTORY) || 
-        FileInfo->FileSize == 0) {
-      FreePool(FileInfo);
-      continue;
-    }
-    
-    // Check if filename matches SSDT-*.aml pattern (but not numeric ones we already processed)
-    CHAR16 *FileName = FileInfo->FileName;
-    UINTN NameLen = StrLen(FileName);
-    
-    // Must be at least 9 chars: "SSDT-X.aml"
-    if (NameLen < 9) {
-      FreePool(FileInfo);
-      continue;
-    }
-    
-    // Check if it starts with "SSDT-" and ends with ".aml"
-    if (StrnCmp(FileName, L"SSDT-", 5) != 0 || 
-        StrnCmp(&FileName[NameLen-4], L".aml", 4) != 0) {
-      FreePool(FileInfo);
-      continue;
-    }
-    
-    // Extract the middle part (between "SSDT-" and ".aml")
-    CHAR16 MiddlePart[64];
-    UINTN MiddleLen = NameLen - 9;  // Total length minus "SSDT-" (5) and ".aml" (4)
-    if (MiddleLen >= sizeof(MiddlePart)/sizeof(CHAR16)) {
-      Print(L"[WARN]  Filename too long, skipping: %s\n", FileName);
-      FreePool(FileInfo);
-      continue;
-    }
-    
-    StrnCpyS(MiddlePart, sizeof(MiddlePart)/sizeof(CHAR16), &FileName[5], MiddleLen);
-    MiddlePart[MiddleLen] = L'\0';
-    
-    // Skip if it's a pure numeric pattern (already processed)
-    BOOLEAN IsNumeric = TRUE;
-    for (UINTN i = 0; i < MiddleLen; i++) {
-      if (MiddlePart[i] < L'0' || MiddlePart[i] > L'9') {
-        IsNumeric = FALSE;
-        break;
-      }
-    }
-    
-    if (IsNumeric) {
-      Print(L"[INFO]  Skipping numeric SSDT: %s (already processed)\n", FileName);
-      FreePool(FileInfo);
-      continue;
-    }
-    
-    // This is a descriptive SSDT file - try to load it
-    Print(L"[INFO]  Found descriptive SSDT: %s\n", FileName);
-    SsdtFilesFound++;
-    
-    EFI_ACPI_DESCRIPTION_HEADER *NewSsdt = NULL;
-    UINTN SsdtSize = 0;
-    
-    // Use the SearchDir (which is either the ACPI subdir or the main directory)
-    EFI_STATUS LoadStatus = LoadAmlFile(SearchDir, FileName, &NewSsdt, &SsdtSize);
-    if (!EFI_ERROR(LoadStatus) && NewSsdt != NULL) {
-      // Add to XSDT
-      EFI_STATUS AddStatus = AddTableToXsdt(Xsdt, NewSsdt, MaxEntries);
-      if (!EFI_ERROR(AddStatus)) {
-        Print(L"[INFO]  ✓ %s loaded and added successfully\n", FileName);
-        (*TablesPatched)++;
-      } else {
-        Print(L"[WARN]  Failed to add %s to XSDT: %r\n", FileName, AddStatus);
-        FreePool(NewSsdt);  // Clean up on failure
-      }
-    } else {
-      Print(L"[WARN]  Failed to load %s: %r\n", FileName, LoadStatus);
-    }
-    
-    FreePool(FileInfo);
+  AcpiDebugPrint(DEBUG_VERBOSE, L"Starting directory scan for additional SSDT files...\n");
+
+  Queue = AllocatePool(MAX(Snapshot->AmlCount, 1) * sizeof(*Queue));
+  if (Queue == NULL) {
+    return EFI_OUT_OF_RESOURCES;
   }
-  
-  // === PHASE 3: Scan for any other AML files (non-SSDT patterns) ===
-  Print(L"[INFO]  Scanning for other .aml files (non-SSDT patterns)...\n");
-  
-  // Reset directory to beginning for general AML scan
-  SearchDir->SetPosition(SearchDir, 0);
-  
-  UINTN GeneralAmlFound = 0;
-  while (TRUE) {
-    UINTN BufferSize = SIZE_OF_EFI_FILE_INFO + 256 * sizeof(CHAR16);
-    EFI_FILE_INFO *CurrentFileInfo = AllocatePool(BufferSize);
-    if (CurrentFileInfo == NULL) break;
-    
-    EFI_STATUS ReadStatus = SearchDir->Read(SearchDir, &BufferSize, CurrentFileInfo);
-    if (EFI_ERROR(ReadStatus) || BufferSize == 0) {
-      FreePool(CurrentFileInfo);
-      break;
-    }
-    
-    // Skip directories, . and .. entries
-    if ((CurrentFileInfo->Attribute & EFI_FILE_DIRECTORY) || 
-        CurrentFileInfo->FileSize == 0 ||
-        StrCmp(CurrentFileInfo->FileName, L".") == 0 || 
-        StrCmp(CurrentFileInfo->FileName, L"..") == 0) {
-      FreePool(CurrentFileInfo);
-      continue;
-    }
-    
-    CHAR16 *FileName = CurrentFileInfo->FileName;
-    UINTN NameLen = StrLen(FileName);
-    
-    // Check if it's an .aml file
-    if (NameLen <= 4 || StrCmp(&FileName[NameLen-4], L".aml") != 0) {
-      FreePool(CurrentFileInfo);
-      continue;
-    }
-    
-    // Skip macOS resource fork files
-    if (NameLen > 6 && StrnCmp(FileName, L"._", 2) == 0) {
-      FreePool(CurrentFileInfo);
-      continue;
-    }
-    
-    // Skip files we already processed (DSDT and SSDT-* patterns)
-    if (StrCmp(FileName, L"DSDT.aml") == 0 ||
-        (NameLen >= 9 && StrnCmp(FileName, L"SSDT-", 5) == 0)) {
-      FreePool(CurrentFileInfo);
-      continue;
-    }
-    
-    // This is a general AML file - try to load it
-    Print(L"[INFO]  Found general AML file: %s\n", FileName);
-    GeneralAmlFound++;
-    
-    EFI_ACPI_DESCRIPTION_HEADER *NewTable = NULL;
-    UINTN TableSize = 0;
-    
-    EFI_STATUS LoadStatus = LoadAmlFile(SearchDir, FileName, &NewTable, &TableSize);
-    if (!EFI_ERROR(LoadStatus) && NewTable != NULL) {
-      // Add to XSDT
-      EFI_STATUS AddStatus = AddTableToXsdt(Xsdt, NewTable, MaxEntries);
-      if (!EFI_ERROR(AddStatus)) {
-        Print(L"[INFO]  ✓ %s loaded and added successfully\n", FileName);
-        (*TablesPatched)++;
-      } else {
-        Print(L"[WARN]  Failed to add %s to XSDT: %r\n", FileName, AddStatus);
-        FreePool(NewTable);  // Clean up on failure
-      }
-    } else {
-      Print(L"[WARN]  Failed to load %s: %r\n", FileName, LoadStatus);
-    }
-    
-    FreePool(CurrentFileInfo);
+
+  Count = 0;
+  Named = QueueAcpiDirEntries(Snapshot, DirEntrySsdtNamed, Queue, &Count);
+  Other = QueueAcpiDirEntries(Snapshot, DirEntryAml, Queue, &Count);
+  for (Index = 0; Index < Count; Index++) {
+    PlanAmlEntry(Snapshot, Queue[Index], Arena, Plan, XsdtOpAppend);
   }
+  FreePool(Queue);
   
-  Print(L"[INFO]  Directory scan complete: %d files scanned, %d SSDT files found, %d other AML files found\n", 
-        FilesScanned, SsdtFilesFound, GeneralAmlFound);
-  
-  // Close ACPI directory if we opened it (different from input Directory)
-  if (UsingAcpiSubdir && AcpiDir != NULL) {
-    AcpiDir->Close(AcpiDir);
-  }
+  AcpiDebugPrint(DEBUG_INFO, L"Directory scan complete: %d files scanned, %d SSDT files found, %d other AML files found\n", 
+        Snapshot->Count, Named, Other);
   
   return EFI_SUCCESS;
 }
@@ -1323,33 +2529,50 @@ AcpiPatcherEntryPoint (
   
   // Very first thing - initialize debug and confirm we're running  
   DXE_DEBUG_INIT();
-  DXE_DEBUG(L"*** ACPIPatcher Entry Point Called ***\r\n");
+  DXE_DEBUG(DEBUG_INFO, L"*** ACPIPatcher Entry Point Called ***\r\n");
   
 #ifdef DXE_DRIVER_BUILD
-  DXE_DEBUG(L"[DXE] ACPIPatcher DXE Driver v%d.%d loading...\r\n",
+  DXE_DEBUG(DEBUG_INFO, L"[DXE] ACPIPatcher DXE Driver v%d.%d loading...\r\n",
         ACPI_PATCHER_VERSION_MAJOR, ACPI_PATCHER_VERSION_MINOR);
-  DXE_DEBUG(L"[DXE] Starting ACPI patching process...\r\n");
+  DXE_DEBUG(DEBUG_INFO, L"[DXE] Starting ACPI patching process...\r\n");
   
   // Store handles for delayed processing
   gAcpiPatcherImageHandle = ImageHandle;
   gAcpiPatcherSystemTable = SystemTable;
+
+  // Tables built into the driver's own file need no file system
+  Status = PatchAcpiTablesFromFv();
+  if (!EFI_ERROR(Status)) {
+    DXE_DEBUG(DEBUG_INFO, L"[DXE] Using the embedded tables, not waiting for a file system\r\n");
+    AcpiLogComplete();
+    return EFI_SUCCESS;
+  }
+  // Tables on disk may still do, so the driver stays
+  if (Status != EFI_NOT_FOUND) {
+    DXE_DEBUG(DEBUG_WARN, L"[DXE] WARNING: Cannot use the embedded tables, looking for ACPI files: %r\r\n", Status);
+  }
   
   // Check if file system is already available
   SelfDir = FsGetSelfDir();
   if (SelfDir != NULL) {
-    DXE_DEBUG(L"[DXE] File system already ready, proceeding with immediate patching\r\n");
+    DXE_DEBUG(DEBUG_INFO, L"[DXE] File system already ready, proceeding with immediate patching\r\n");
     gFileSystemReady = TRUE;
   } else {
-    DXE_DEBUG(L"[DXE] File system not ready yet, setting up delayed patching\r\n");
+    DXE_DEBUG(DEBUG_INFO, L"[DXE] File system not ready yet, setting up delayed patching\r\n");
     
     // Set up notification to wait for file system
     Status = WaitForFileSystemReady();
     if (EFI_ERROR(Status)) {
-      DXE_DEBUG(L"[DXE] ERROR: Failed to set up file system notification: %r\r\n", Status);
+      DXE_DEBUG(DEBUG_ERROR, L"[DXE] ERROR: Failed to set up file system notification: %r\r\n", Status);
       // Continue anyway - we can still do basic ACPI discovery
     } else {
-      DXE_DEBUG(L"[DXE] File system notification set up successfully\r\n");
-      DXE_DEBUG(L"[DXE] Driver will remain resident and patch ACPI when storage is ready\r\n");
+      DXE_DEBUG(DEBUG_INFO, L"[DXE] File system notification set up successfully\r\n");
+      // The volumes already there may be enough to patch right away
+      StartAcpiDiscovery();
+      if (!gFileSystemReady) {
+        DXE_DEBUG(DEBUG_INFO, L"[DXE] Driver will remain resident and patch ACPI when storage is ready\r\n");
+      }
+      AcpiLogComplete();
       // Return success so driver stays loaded and waits for file system
       return EFI_SUCCESS;
     }
@@ -1358,7 +2581,7 @@ AcpiPatcherEntryPoint (
   // If we get here, either file system is ready or notification setup failed
   // Continue with immediate processing
   if (SelfDir == NULL) {
-    DXE_DEBUG(L"[DXE] Proceeding without file system access\r\n");
+    DXE_DEBUG(DEBUG_INFO, L"[DXE] Proceeding without file system access\r\n");
   }
   
 #else
@@ -1373,6 +2596,7 @@ AcpiPatcherEntryPoint (
   SelfDir = FsGetSelfDir();
   if (SelfDir == NULL) {
     AcpiDebugPrint(DEBUG_ERROR, L"Failed to get file system - protocols may not be ready\n");
+    AcpiLogComplete();
     return EFI_UNSUPPORTED;
   }
 #endif
@@ -1395,12 +2619,14 @@ AcpiPatcherEntryPoint (
   
   if (gRsdp == NULL) {
     AcpiDebugPrint(DEBUG_ERROR, L"Failed to find ACPI tables\n");
+    AcpiLogComplete();
     return EFI_NOT_FOUND;
   }
 
   // Get XSDT from RSDP
   if (gRsdp->XsdtAddress == 0) {
     AcpiDebugPrint(DEBUG_ERROR, L"XSDT address is invalid\n");
+    AcpiLogComplete();
     return EFI_UNSUPPORTED;
   }
 
@@ -1411,6 +2637,7 @@ AcpiPatcherEntryPoint (
   Status = FindFadtInXsdt();
   if (EFI_ERROR(Status)) {
     AcpiDebugPrint(DEBUG_ERROR, L"Failed to find FADT: %r\n", Status);
+    AcpiLogComplete();
     return Status;
   }
 
@@ -1418,321 +2645,382 @@ AcpiPatcherEntryPoint (
   Status = PatchAcpiTables(SelfDir, gXsdt, gFacp);
   if (EFI_ERROR(Status)) {
     AcpiDebugPrint(DEBUG_ERROR, L"ACPI patching failed: %r\n", Status);
+    AcpiLogComplete();
     return Status;
   }
 
 #ifdef DXE_DRIVER_BUILD
-  Print(L"[DXE] ACPIPatcher DXE Driver loaded and patching completed!\n");
-  gST->ConOut->OutputString(gST->ConOut, L"[DXE] ACPI tables have been patched - driver staying resident\r\n");
+  AcpiDebugPrint(DEBUG_INFO, L"[DXE] ACPIPatcher DXE Driver loaded and patching completed!\n");
+  AcpiDebugPrint(DEBUG_INFO, L"[DXE] ACPI tables have been patched - driver staying resident\n");
 #else
   AcpiDebugPrint(DEBUG_INFO, L"ACPIPatcher completed successfully\n");
 #endif
+  AcpiLogComplete();
   return EFI_SUCCESS;
 }
 
 #ifdef DXE_DRIVER_BUILD
+//
+// Directories FindAcpiFilesDirectory() tries on each volume, as a prefix
+// tree in pre-order.  Each node is opened relative to the last node one
+// level up, so a shared parent such as EFI is looked up once per volume
+// and a missing one skips everything below it.  Only Candidate nodes are
+// read and scored; the rest are just passed through.
+//
+// Candidates of one priority tier come in the order the paths have always
+// been tried, which is all the selection depends on.
+//
+typedef struct {
+  CONST CHAR16  *Name;
+  UINT8         Depth;
+  BOOLEAN       Candidate;
+  CONST CHAR16  *Path;
+} ACPI_SEARCH_NODE;
+
+#define ACPI_SEARCH_MAX_DEPTH  5
+
+STATIC CONST ACPI_SEARCH_NODE mAcpiSearchTree[] = {
+  { L".",            0, TRUE,  L"."                                         },  // Current directory (where driver is located) - PRIORITY #1
+  { L"ACPI",         0, TRUE,  L"ACPI"                                      },  // Same directory level (most likely for drivers_x64/ACPI)
+  { L"..",           0, FALSE, L".."                                        },
+  {   L"ACPI",       1, TRUE,  L"..\\ACPI"                                  },  // One level up
+  {   L"..",         1, FALSE, L"..\\.."                                    },
+  {     L"ACPI",     2, TRUE,  L"..\\..\\ACPI"                              },  // Two levels up
+  { L"drivers_x64",  0, TRUE,  L"drivers_x64"                               },  // Driver directory itself (drivers_x64/)
+  {   L"ACPI",       1, TRUE,  L"drivers_x64\\ACPI"                         },  // From EFI root to drivers_x64/ACPI
+  { L"EFI",          0, FALSE, L"EFI"                                       },
+  {   L"drivers_x64", 1, TRUE, L"EFI\\drivers_x64"                          },  // Driver directory from filesystem root
+  {     L"ACPI",     2, TRUE,  L"EFI\\drivers_x64\\ACPI"                    },  // From filesystem root
+  {   L"OC",         1, FALSE, L"EFI\\OC"                                   },
+  {     L"ACPI",     2, TRUE,  L"EFI\\OC\\ACPI"                             },  // OpenCore ACPI location
+  {   L"ACPI",       1, TRUE,  L"EFI\\ACPI"                                 },  // Standard EFI ACPI location
+  {   L"ACPIPatcher", 1, TRUE, L"EFI\\ACPIPatcher"                          },  // Custom EFI location
+  { L"System",       0, FALSE, L"System"                                    },
+  {   L"Library",    1, FALSE, L"System\\Library"                           },
+  {     L"CoreServices", 2, FALSE, L"System\\Library\\CoreServices"         },
+  {       L"drivers_x64", 3, TRUE, L"System\\Library\\CoreServices\\drivers_x64" },        // macOS driver directory
+  {         L"ACPI", 4, TRUE,  L"System\\Library\\CoreServices\\drivers_x64\\ACPI" },  // Full macOS path
+  { L"ACPIPatcher",  0, TRUE,  L"ACPIPatcher"                               },  // Root level custom folder
+  { L"drivers",      0, FALSE, L"drivers"                                   },
+  {   L"ACPI",       1, TRUE,  L"drivers\\ACPI"                             },  // Alternative drivers folder
+  { L"Drivers",      0, FALSE, L"Drivers"                                   },
+  {   L"ACPI",       1, TRUE,  L"Drivers\\ACPI"                             }   // Windows-style capitalization
+};
+
+/**
+  Closes the directories a search of mAcpiSearchTree has open at Depth and
+  deeper.  The one Keep was read from stays open and Keep takes it over.
+**/
+STATIC
+VOID
+CloseSearchDirectories(
+  IN OUT EFI_FILE_PROTOCOL  **Opened,
+  IN     UINTN              Depth,
+  IN OUT DIR_SNAPSHOT       *Keep
+  )
+{
+  for (; Depth < ACPI_SEARCH_MAX_DEPTH; Depth++) {
+    if (Opened[Depth] == NULL) {
+      continue;
+    }
+    if (Opened[Depth] == Keep->Directory) {
+      Keep->OwnsDirectory = TRUE;
+    } else {
+      Opened[Depth]->Close(Opened[Depth]);
+    }
+    Opened[Depth] = NULL;
+  }
+}
+
 /**
-  Searches for ACPI files directory on available file systems.
+  Searches one volume for ACPI files directories and weighs each one found
+  against the best directory so far.
   This is used by DXE drivers since they can't use FsGetSelfDir().
-  
-  @retval File Protocol   Pointer to the directory containing ACPI files
-  @retval NULL           ACPI files directory not found
+
+  Each candidate directory is read once into a snapshot; the snapshot of
+  the chosen directory is kept so patching does not read it again.
+
+  The directories tried are walked as the prefix tree mAcpiSearchTree.  A
+  candidate's snapshot reads through the handle the walk opened, which
+  stays with the walk until its subtree is done.
+
+  @param[in]     Volume  Handle with the Simple File System Protocol.
+  @param[in]     Rank    Rank of the volume from FsRankVolumes().  The
+                         caller has checked it is no worse than Search's.
+  @param[in,out] Search  The directory chosen so far.
 **/
-EFI_FILE_PROTOCOL *
-FindAcpiFilesDirectory (
-  VOID
+STATIC
+VOID
+SearchVolumeForAcpiFiles (
+  IN     EFI_HANDLE       Volume,
+  IN     FS_VOLUME_RANK   Rank,
+  IN OUT ACPI_DIR_SEARCH  *Search
   )
 {
   EFI_STATUS Status;
-  UINTN HandleCount;
-  EFI_HANDLE *HandleBuffer;
-  UINTN Index;
   EFI_SIMPLE_FILE_SYSTEM_PROTOCOL *FileSystem;
   EFI_FILE_PROTOCOL *RootDir;
   EFI_FILE_PROTOCOL *AcpiDir;
-  
-  DXE_DEBUG(L"[DXE] Searching for ACPI files directory on available file systems...\r\n");
-  
-  // Get all handles that support Simple File System Protocol
-  Status = gBS->LocateHandleBuffer(
-    ByProtocol,
+  EFI_FILE_PROTOCOL *Parent;
+  EFI_FILE_PROTOCOL *Opened[ACPI_SEARCH_MAX_DEPTH];
+  CONST ACPI_SEARCH_NODE *Node;
+  DIR_SNAPSHOT Candidate;
+  UINTN Index;
+
+  // Numbered in the order they are searched, for the log
+  Index = Search->VolumeCount++;
+
+  Status = gBS->HandleProtocol(
+    Volume,
     &gEfiSimpleFileSystemProtocolGuid,
-    NULL,
-    &HandleCount,
-    &HandleBuffer
+    (VOID**)&FileSystem
   );
   
   if (EFI_ERROR(Status)) {
-    DXE_DEBUG(L"[DXE] ERROR: No file systems found: %r\r\n", Status);
-    return NULL;
+    return;
   }
   
-  DXE_DEBUG(L"[DXE] Found %d file system(s), searching for ACPI files...\r\n", HandleCount);
-  
-  EFI_FILE_PROTOCOL *BestAcpiDir = NULL;
-  UINTN BestFileCount = 0;
+  // Open root directory
+  Status = FileSystem->OpenVolume(FileSystem, &RootDir);
+  if (EFI_ERROR(Status)) {
+    return;
+  }
   
-  // Search each file system for ACPI directory
-  for (Index = 0; Index < HandleCount; Index++) {
-    Status = gBS->HandleProtocol(
-      HandleBuffer[Index],
-      &gEfiSimpleFileSystemProtocolGuid,
-      (VOID**)&FileSystem
-    );
-    
-    if (EFI_ERROR(Status)) {
+  // Opened[Depth] is the directory of mAcpiSearchTree last opened at that
+  // depth, or NULL if it is missing
+  ZeroMem(Opened, sizeof(Opened));
+
+  for (UINTN NodeIndex = 0; NodeIndex < ARRAY_SIZE(mAcpiSearchTree); NodeIndex++) {
+    Node = &mAcpiSearchTree[NodeIndex];
+
+    // Everything deeper belongs to subtrees that are done
+    CloseSearchDirectories(Opened, Node->Depth, &Search->Best);
+
+    Parent = (Node->Depth == 0) ? RootDir : Opened[Node->Depth - 1];
+    if (Parent == NULL) {
       continue;
     }
-    
-    // Open root directory
-    Status = FileSystem->OpenVolume(FileSystem, &RootDir);
-    if (EFI_ERROR(Status)) {
-      continue;
+
+    DXE_DEBUG(DEBUG_VERBOSE, L"[DXE] Trying path: %s on file system #%d (rank %d)\r\n", Node->Path, Index, Rank);
+    Status = Parent->Open(
+      Parent,
+      &AcpiDir,
+      (CHAR16 *)Node->Name,
+      EFI_FILE_MODE_READ,
+      0
+    );
+    if (!EFI_ERROR(Status)) {
+      Opened[Node->Depth] = AcpiDir;
     }
     
-    // Try common ACPI file locations in order of likelihood
-    // Since the absolute path is arbitrary, we try relative paths that would work
-    // from common driver locations like drivers_x64/, EFI/, or root
-    CHAR16* AcpiPaths[] = {
-      L".",                          // Current directory (where driver is located) - PRIORITY #1
-      L"ACPI",                       // Same directory level (most likely for drivers_x64/ACPI)
-      L"..\\ACPI",                   // One level up
-      L"..\\..\\ACPI",               // Two levels up  
-      L"drivers_x64",                // Driver directory itself (drivers_x64/)
-      L"drivers_x64\\ACPI",          // From EFI root to drivers_x64/ACPI
-      L"EFI\\drivers_x64",           // Driver directory from filesystem root
-      L"EFI\\drivers_x64\\ACPI",     // From filesystem root
-      L"System\\Library\\CoreServices\\drivers_x64",  // macOS driver directory
-      L"System\\Library\\CoreServices\\drivers_x64\\ACPI",  // Full macOS path
-      L"EFI\\OC\\ACPI",              // OpenCore ACPI location
-      L"EFI\\ACPI",                  // Standard EFI ACPI location
-      L"EFI\\ACPIPatcher",           // Custom EFI location
-      L"ACPIPatcher",                // Root level custom folder
-      L"drivers\\ACPI",              // Alternative drivers folder
-      L"Drivers\\ACPI",              // Windows-style capitalization
-      NULL
-    };
-    
-    // Priority tracking variables (outside the loop)
-    UINT32 BestPriority = 0; // Track the priority of current best directory
-    
-    for (UINTN PathIndex = 0; AcpiPaths[PathIndex] != NULL; PathIndex++) {
-      DXE_DEBUG(L"[DXE] Trying path: %s on file system #%d\r\n", AcpiPaths[PathIndex], Index);
-      Status = RootDir->Open(
-        RootDir,
-        &AcpiDir,
-        AcpiPaths[PathIndex],
-        EFI_FILE_MODE_READ,
-        0
-      );
+    if (!EFI_ERROR(Status) && Node->Candidate) {
+      DXE_DEBUG(DEBUG_INFO, L"[DXE] SUCCESS: Found ACPI directory at %s on file system #%d\r\n", Node->Path, Index);
       
-      if (!EFI_ERROR(Status)) {
-        DXE_DEBUG(L"[DXE] SUCCESS: Found ACPI directory at %s on file system #%d\r\n", AcpiPaths[PathIndex], Index);
-        
-        // List files in this directory to see what's available
-        EFI_FILE_INFO *FileInfo = NULL;
-        UINTN BufferSize = 0;
-        UINTN FileCount = 0;
-        DXE_DEBUG(L"[DXE] Listing files in ACPI directory:\r\n");
+      // Read the directory once; the listing and the .aml count both come
+      // from the snapshot.  The walk still owns the handle.
+      Status = DirSnapshotCreate(AcpiDir, &Candidate);
+      if (EFI_ERROR(Status)) {
+        continue;
+      }
+
+      UINTN FileCount = Candidate.AmlCount;
+      DXE_DEBUG(DEBUG_VERBOSE, L"[DXE] Listing files in ACPI directory:\r\n");
+      for (UINTN FileIndex = 0; FileIndex < Candidate.Count; FileIndex++) {
+        DXE_DEBUG(DEBUG_VERBOSE, L"[DXE]   - %s (%s, %d bytes)\r\n", 
+                 Candidate.Entries[FileIndex].Name,
+                 (Candidate.Entries[FileIndex].Kind == DirEntryDirectory) ? L"DIR" : L"FILE",
+                 (UINT32)Candidate.Entries[FileIndex].FileSize);
+      }
+      
+      DXE_DEBUG(DEBUG_VERBOSE, L"[DXE] Found %d .aml files in this directory\r\n", FileCount);
+
+      // .aml files in the volume root win outright, as they always have
+      if (NodeIndex == 0 && FileCount > 0) {
+        DXE_DEBUG(DEBUG_INFO, L"[DXE] SUCCESS: Using root directory on file system #%d (found .aml files)\r\n", Index);
+        DirSnapshotFree(&Search->Best);
+        CloseSearchDirectories(Opened, 0, &Candidate);
+        RootDir->Close(RootDir);
+        CopyMem(&Search->Best, &Candidate, sizeof(Candidate));
+        Search->FileCount = FileCount;
+        Search->Volume    = Volume;
+        Search->Path      = Node->Path;
+        Search->Rank      = Rank;
+        Search->Final     = TRUE;
+        return;
+      }
+      
+      // If this directory has SSDT files, consider it as a candidate
+      if (FileCount > 0) {
+        DXE_DEBUG(DEBUG_VERBOSE, L"[DXE] Found candidate directory with %d .aml files\r\n", FileCount);
         
-        // Reset directory position
-        AcpiDir->SetPosition(AcpiDir, 0);
+        // Enhanced priority-based directory selection logic
+        BOOLEAN ShouldUseThisDirectory = FALSE;
+        UINT32 CurrentPriority = 0;
         
-        // Read directory entries
-        for (UINTN FileIndex = 0; FileIndex < 50; FileIndex++) {
-          BufferSize = 0;
-          Status = AcpiDir->Read(AcpiDir, &BufferSize, NULL);
-          if (BufferSize == 0) break; // No more files
-          
-          FileInfo = AllocatePool(BufferSize);
-          if (FileInfo == NULL) break;
-          
-          Status = AcpiDir->Read(AcpiDir, &BufferSize, FileInfo);
-          if (EFI_ERROR(Status) || BufferSize == 0) {
-            FreePool(FileInfo);
-            break;
-          }
-          
-          // Skip . and .. entries
-          if (StrCmp(FileInfo->FileName, L".") != 0 && StrCmp(FileInfo->FileName, L"..") != 0) {
-            DXE_DEBUG(L"[DXE]   - %s (%s, %d bytes)\r\n", 
-                     FileInfo->FileName,
-                     (FileInfo->Attribute & EFI_FILE_DIRECTORY) ? L"DIR" : L"FILE",
-                     (UINT32)FileInfo->FileSize);
-            
-            // Count .aml files (exclude macOS resource fork files starting with ._)
-            UINTN NameLen = StrLen(FileInfo->FileName);
-            if (NameLen > 4 && StrCmp(&FileInfo->FileName[NameLen-4], L".aml") == 0) {
-              // Skip macOS resource fork files (._filename.aml)
-              if (!(NameLen > 6 && StrnCmp(FileInfo->FileName, L"._", 2) == 0)) {
-                FileCount++;
-              }
-            }
-          }
-          
-          FreePool(FileInfo);
+        // Calculate priority score for current directory
+        // Priority 1: Driver's own directory (same location as DXE driver)
+        if (StrCmp(Node->Path, L".") == 0) {
+          CurrentPriority = 1000; // Highest priority
+          DXE_DEBUG(DEBUG_VERBOSE, L"[DXE] PRIORITY: Current directory (co-located with driver) - Priority: %d\r\n", CurrentPriority);
+        }
+        // Priority 2: ACPI subdirectory of driver location
+        else if (StrCmp(Node->Path, L"ACPI") == 0) {
+          CurrentPriority = 900; // Very high priority
+          DXE_DEBUG(DEBUG_VERBOSE, L"[DXE] PRIORITY: Co-located ACPI subdirectory - Priority: %d\r\n", CurrentPriority);
+        }
+        // Priority 3: Driver-specific bootloader paths  
+        else if (StrStr(Node->Path, L"drivers_x64") != NULL) {
+          CurrentPriority = 800; // High priority
+          DXE_DEBUG(DEBUG_VERBOSE, L"[DXE] PRIORITY: Driver-specific bootloader path - Priority: %d\r\n", CurrentPriority);
+        }
+        // Priority 4: Standard bootloader ACPI directories
+        else if (StrStr(Node->Path, L"EFI\\OC\\ACPI") != NULL || 
+                 StrStr(Node->Path, L"EFI\\ACPI") != NULL ||
+                 StrStr(Node->Path, L"EFI\\ACPIPatcher") != NULL) {
+          CurrentPriority = 700; // Medium-high priority
+          DXE_DEBUG(DEBUG_VERBOSE, L"[DXE] PRIORITY: Standard bootloader ACPI directory - Priority: %d\r\n", CurrentPriority);
+        }
+        // Priority 5: Other relative paths
+        else if (StrStr(Node->Path, L"..\\") != NULL) {
+          CurrentPriority = 600; // Medium priority
+          DXE_DEBUG(DEBUG_VERBOSE, L"[DXE] PRIORITY: Relative path directory - Priority: %d\r\n", CurrentPriority);
+        }
+        // Priority 6: Generic ACPI directories
+        else {
+          CurrentPriority = 500; // Lower priority
+          DXE_DEBUG(DEBUG_VERBOSE, L"[DXE] PRIORITY: Generic directory - Priority: %d\r\n", CurrentPriority);
         }
         
-        DXE_DEBUG(L"[DXE] Found %d .aml files in this directory\r\n", FileCount);
+        // Add file count bonus (but don't let it override priority tiers)
+        CurrentPriority += (UINT32)(FileCount * 10); // Small bonus for more files
         
-        // Reset position for actual use
-        AcpiDir->SetPosition(AcpiDir, 0);
+        // Determine if we should use this directory.  One on a better
+        // ranked volume wins whatever its priority.
+        if (Search->Best.Directory == NULL || Rank > Search->Rank) {
+          // First valid directory found
+          ShouldUseThisDirectory = TRUE;
+          DXE_DEBUG(DEBUG_VERBOSE, L"[DXE] SELECTION: First valid directory selected (Priority: %d, Files: %d)\r\n", CurrentPriority, FileCount);
+        }
+        else if (CurrentPriority > Search->Priority) {
+          // Higher priority directory found
+          ShouldUseThisDirectory = TRUE;
+          DXE_DEBUG(DEBUG_VERBOSE, L"[DXE] SELECTION: Higher priority directory selected (Priority: %d vs %d, Files: %d)\r\n", CurrentPriority, Search->Priority, FileCount);
+        }
+        else if (CurrentPriority == Search->Priority && FileCount > Search->FileCount) {
+          // Same priority but more files
+          ShouldUseThisDirectory = TRUE;
+          DXE_DEBUG(DEBUG_VERBOSE, L"[DXE] SELECTION: Same priority but more files (%d vs %d)\r\n", FileCount, Search->FileCount);
+        }
+        else {
+          DXE_DEBUG(DEBUG_VERBOSE, L"[DXE] SELECTION: Directory not selected (Priority: %d vs %d, Files: %d vs %d)\r\n", 
+                   CurrentPriority, Search->Priority, FileCount, Search->FileCount);
+        }
         
-        // If this directory has SSDT files, consider it as a candidate
-        if (FileCount > 0) {
-          DXE_DEBUG(L"[DXE] Found candidate directory with %d .aml files\r\n", FileCount);
-          
-          // Enhanced priority-based directory selection logic
-          BOOLEAN ShouldUseThisDirectory = FALSE;
-          UINT32 CurrentPriority = 0;
-          // BestPriority is now declared outside the loop
-          
-          // Calculate priority score for current directory
-          // Priority 1: Driver's own directory (same location as DXE driver)
-          if (StrCmp(AcpiPaths[PathIndex], L".") == 0) {
-            CurrentPriority = 1000; // Highest priority
-            DXE_DEBUG(L"[DXE] PRIORITY: Current directory (co-located with driver) - Priority: %d\r\n", CurrentPriority);
-          }
-          // Priority 2: ACPI subdirectory of driver location
-          else if (StrCmp(AcpiPaths[PathIndex], L"ACPI") == 0) {
-            CurrentPriority = 900; // Very high priority
-            DXE_DEBUG(L"[DXE] PRIORITY: Co-located ACPI subdirectory - Priority: %d\r\n", CurrentPriority);
-          }
-          // Priority 3: Driver-specific bootloader paths  
-          else if (StrStr(AcpiPaths[PathIndex], L"drivers_x64") != NULL) {
-            CurrentPriority = 800; // High priority
-            DXE_DEBUG(L"[DXE] PRIORITY: Driver-specific bootloader path - Priority: %d\r\n", CurrentPriority);
-          }
-          // Priority 4: Standard bootloader ACPI directories
-          else if (StrStr(AcpiPaths[PathIndex], L"EFI\\OC\\ACPI") != NULL || 
-                   StrStr(AcpiPaths[PathIndex], L"EFI\\ACPI") != NULL ||
-                   StrStr(AcpiPaths[PathIndex], L"EFI\\ACPIPatcher") != NULL) {
-            CurrentPriority = 700; // Medium-high priority
-            DXE_DEBUG(L"[DXE] PRIORITY: Standard bootloader ACPI directory - Priority: %d\r\n", CurrentPriority);
-          }
-          // Priority 5: Other relative paths
-          else if (StrStr(AcpiPaths[PathIndex], L"..\\") != NULL) {
-            CurrentPriority = 600; // Medium priority
-            DXE_DEBUG(L"[DXE] PRIORITY: Relative path directory - Priority: %d\r\n", CurrentPriority);
-          }
-          // Priority 6: Generic ACPI directories
-          else {
-            CurrentPriority = 500; // Lower priority
-            DXE_DEBUG(L"[DXE] PRIORITY: Generic directory - Priority: %d\r\n", CurrentPriority);
-          }
-          
-          // Add file count bonus (but don't let it override priority tiers)
-          CurrentPriority += (UINT32)(FileCount * 10); // Small bonus for more files
-          
-          // Determine if we should use this directory
-          if (BestAcpiDir == NULL) {
-            // First valid directory found
-            ShouldUseThisDirectory = TRUE;
-            BestPriority = CurrentPriority;
-            DXE_DEBUG(L"[DXE] SELECTION: First valid directory selected (Priority: %d, Files: %d)\r\n", CurrentPriority, FileCount);
-          }
-          else if (CurrentPriority > BestPriority) {
-            // Higher priority directory found
-            ShouldUseThisDirectory = TRUE;
-            UINT32 PreviousBestPriority = BestPriority; // Save for debug message
-            BestPriority = CurrentPriority;
-            DXE_DEBUG(L"[DXE] SELECTION: Higher priority directory selected (Priority: %d vs %d, Files: %d)\r\n", CurrentPriority, PreviousBestPriority, FileCount);
-          }
-          else if (CurrentPriority == BestPriority && FileCount > BestFileCount) {
-            // Same priority but more files
-            ShouldUseThisDirectory = TRUE;
-            DXE_DEBUG(L"[DXE] SELECTION: Same priority but more files (%d vs %d)\r\n", FileCount, BestFileCount);
-          }
-          else {
-            DXE_DEBUG(L"[DXE] SELECTION: Directory not selected (Priority: %d vs %d, Files: %d vs %d)\r\n", 
-                     CurrentPriority, BestPriority, FileCount, BestFileCount);
-          }
-          
-          if (ShouldUseThisDirectory) {
-            if (BestAcpiDir != NULL) {
-              BestAcpiDir->Close(BestAcpiDir);
-            }
-            BestAcpiDir = AcpiDir;
-            BestFileCount = FileCount;
-            DXE_DEBUG(L"[DXE] New best directory with %d .aml files at %s\r\n", FileCount, AcpiPaths[PathIndex]);
-          } else {
-            DXE_DEBUG(L"[DXE] Directory not selected (%d files vs current best %d), continuing search\r\n", FileCount, BestFileCount);
-            AcpiDir->Close(AcpiDir);
-          }
+        if (ShouldUseThisDirectory) {
+          DirSnapshotFree(&Search->Best);
+          CopyMem(&Search->Best, &Candidate, sizeof(Candidate));
+          Search->FileCount = FileCount;
+          Search->Priority  = CurrentPriority;
+          Search->Volume    = Volume;
+          Search->Path      = Node->Path;
+          Search->Rank      = Rank;
+          DXE_DEBUG(DEBUG_VERBOSE, L"[DXE] New best directory with %d .aml files at %s\r\n", FileCount, Node->Path);
         } else {
-          DXE_DEBUG(L"[DXE] Directory has no .aml files, continuing search\r\n");
-          AcpiDir->Close(AcpiDir);
+          DXE_DEBUG(DEBUG_VERBOSE, L"[DXE] Directory not selected (%d files vs current best %d), continuing search\r\n", FileCount, Search->FileCount);
+          DirSnapshotFree(&Candidate);
         }
       } else {
-        DXE_DEBUG(L"[DXE] Path not found: %s (Status: %r)\r\n", AcpiPaths[PathIndex], Status);
-      }
-    }
-    
-    // If no ACPI subdirectories found, try using root directory itself
-    // Check if there are any .aml files in the root
-    EFI_FILE_INFO *FileInfo = NULL;
-    UINTN FileInfoSize = sizeof(EFI_FILE_INFO) + 512;
-    BOOLEAN FoundAmlFiles = FALSE;
-    
-    // Reset directory enumeration to the beginning
-    RootDir->SetPosition(RootDir, 0);
-    
-    // Scan for .aml files in root directory
-    while (TRUE) {
-      FileInfo = AllocateZeroPool(FileInfoSize);
-      if (FileInfo == NULL) {
-        break;
-      }
-      
-      Status = RootDir->Read(RootDir, &FileInfoSize, FileInfo);
-      if (Status == EFI_BUFFER_TOO_SMALL) {
-        FreePool(FileInfo);
-        FileInfo = AllocateZeroPool(FileInfoSize);
-        if (FileInfo == NULL) {
-          break;
-        }
-        Status = RootDir->Read(RootDir, &FileInfoSize, FileInfo);
-      }
-      
-      if (EFI_ERROR(Status) || FileInfoSize == 0) {
-        FreePool(FileInfo);
-        break;
-      }
-      
-      // Check for .aml files
-      if (!(FileInfo->Attribute & EFI_FILE_DIRECTORY) && FileInfo->FileSize > 0) {
-        CHAR16 *FileName = FileInfo->FileName;
-        UINTN NameLen = StrLen(FileName);
-        if (NameLen > 4 && StrnCmp(&FileName[NameLen-4], L".aml", 4) == 0) {
-          DXE_DEBUG(L"[DXE] Found .aml file in root: %s\r\n", FileName);
-          FoundAmlFiles = TRUE;
-          FreePool(FileInfo);
-          break;
-        }
+        DXE_DEBUG(DEBUG_VERBOSE, L"[DXE] Directory has no .aml files, continuing search\r\n");
+        DirSnapshotFree(&Candidate);
       }
-      
-      FreePool(FileInfo);
+    } else if (EFI_ERROR(Status)) {
+      DXE_DEBUG(DEBUG_VERBOSE, L"[DXE] Path not found: %s (Status: %r)\r\n", Node->Path, Status);
     }
-    
-    if (FoundAmlFiles) {
-      DXE_DEBUG(L"[DXE] SUCCESS: Using root directory on file system #%d (found .aml files)\r\n", Index);
-      DXE_DEBUG(L"[DXE] SUCCESS: Found ACPI files directory\r\n");
-      FreePool(HandleBuffer);
-      return RootDir;  // Return root directory instead of closing it
+  }
+  
+  CloseSearchDirectories(Opened, 0, &Search->Best);
+  RootDir->Close(RootDir);
+}
+
+/**
+  Searches for ACPI files directory on the file systems that are already
+  available, starting with the one remembered from the last boot.
+
+  Volumes are searched best first: the one the current boot option came
+  from, then EFI System Partitions, then the rest.  A directory on a
+  better volume beats any directory on a worse one, so once one is found
+  the worse volumes are not opened at all.
+  
+  @param[in,out] Search  Receives the directory chosen; Best owns the
+                         directory handle.
+
+  @retval EFI_SUCCESS     ACPI files directory found
+  @retval EFI_NOT_FOUND   ACPI files directory not found
+**/
+EFI_STATUS
+FindAcpiFilesDirectory (
+  IN OUT ACPI_DIR_SEARCH  *Search
+  )
+{
+  EFI_STATUS Status;
+  UINTN HandleCount;
+  EFI_HANDLE *HandleBuffer;
+  UINTN Index;
+  FS_VOLUME_RANK *Ranks;
+  
+  // The directory chosen on the last boot, if it is still there
+  if (!EFI_ERROR(AcpiDirHintOpen(&Search->Best))) {
+    Search->Final = TRUE;
+    return EFI_SUCCESS;
+  }
+  
+  DXE_DEBUG(DEBUG_INFO, L"[DXE] Searching for ACPI files directory on available file systems...\r\n");
+  
+  // Get all handles that support Simple File System Protocol
+  Status = gBS->LocateHandleBuffer(
+    ByProtocol,
+    &gEfiSimpleFileSystemProtocolGuid,
+    NULL,
+    &HandleCount,
+    &HandleBuffer
+  );
+  
+  if (EFI_ERROR(Status)) {
+    DXE_DEBUG(DEBUG_INFO, L"[DXE] No file systems yet: %r\r\n", Status);
+    return EFI_NOT_FOUND;
+  }
+  
+  DXE_DEBUG(DEBUG_INFO, L"[DXE] Found %d file system(s), searching for ACPI files...\r\n", HandleCount);
+
+  // Without memory for the ranks every volume is searched, in handle order
+  Ranks = AllocateZeroPool(HandleCount * sizeof(*Ranks));
+  if (Ranks != NULL) {
+    FsRankVolumes(HandleBuffer, HandleCount, Ranks);
+  }
+  
+  // Search each file system for ACPI directory
+  for (Index = 0; Index < HandleCount && !Search->Final; Index++) {
+    if (Ranks != NULL && Search->Best.Directory != NULL && Ranks[Index] < Search->Rank) {
+      DXE_DEBUG(DEBUG_INFO, L"[DXE] Found ACPI directory on a preferred volume, skipping %d other file system(s)\r\n", HandleCount - Index);
+      break;
     }
-    
-    RootDir->Close(RootDir);
+
+    SearchVolumeForAcpiFiles(HandleBuffer[Index], (Ranks != NULL) ? Ranks[Index] : FsVolumeOther, Search);
   }
   
+  if (Ranks != NULL) {
+    FreePool(Ranks);
+  }
+  FreePool(HandleBuffer);
+
   // Return the best ACPI directory found (if any)
-  if (BestAcpiDir != NULL) {
-    DXE_DEBUG(L"[DXE] SUCCESS: Using best ACPI directory with %d .aml files\r\n", BestFileCount);
-    FreePool(HandleBuffer);
-    return BestAcpiDir;
+  if (Search->Best.Directory != NULL) {
+    DXE_DEBUG(DEBUG_INFO, L"[DXE] SUCCESS: Using best ACPI directory with %d .aml files\r\n", Search->FileCount);
+    return EFI_SUCCESS;
   }
   
-  FreePool(HandleBuffer);
-  DXE_DEBUG(L"[DXE] INFO: No ACPI directory found on any file system\r\n");
-  return NULL;
+  DXE_DEBUG(DEBUG_INFO, L"[DXE] INFO: No ACPI directory found on any file system\r\n");
+  return EFI_NOT_FOUND;
 }
 #endif
+
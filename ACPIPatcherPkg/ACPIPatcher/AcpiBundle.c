@@ -0,0 +1,426 @@
+/** @file
+
+  ACPIPatcher.apb patch bundle.
+
+  Loading a patch set from loose files costs an Open() per table, and on
+  FAT each Open() is a walk of the directory for the name.  A bundle puts
+  the set in one file laid out the way the arena wants it, so the whole
+  set costs one Open() and one read, and the tables are used where the
+  read put them rather than copied again.
+
+  The header and table of contents are read into the arena along with the
+  tables.  They end up in ACPI reclaim memory next to them, which is
+  cheaper than reading the file twice to keep them out.
+
+  Even that one read walks the file's cluster chain in the firmware FAT
+  driver, which is slow on some boards.  A located bundle skips it: its
+  blocks are read in one Disk I/O transfer, and the file itself is only
+  opened and its 32-byte header read, which keeps a deleted or rebuilt
+  bundle from being taken from blocks the volume no longer uses for it.
+
+**/
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DevicePathLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+#include <Guid/FileInfo.h>
+#include <Protocol/BlockIo.h>
+
+#define ACPI_LOG_FILE_ID  10
+
+#include "AcpiBundle.h"
+#include "DebugLog.h"
+#include "FsHelpers.h"
+
+/**
+  Opens the bundle, preferring the ACPI subdirectory as the directory
+  snapshot does.
+**/
+STATIC
+EFI_STATUS
+AcpiBundleOpenFile (
+  IN  EFI_FILE_PROTOCOL  *Directory,
+  OUT EFI_FILE_PROTOCOL  **File,
+  OUT BOOLEAN            *InAcpiDir
+  )
+{
+  EFI_FILE_PROTOCOL  *AcpiDir;
+  EFI_STATUS         Status;
+
+  if (!EFI_ERROR (FsOpenFile (Directory, L"ACPI", &AcpiDir))) {
+    Status = FsOpenFile (AcpiDir, ACPI_BUNDLE_FILE_NAME, File);
+    AcpiDir->Close (AcpiDir);
+    if (!EFI_ERROR (Status)) {
+      *InAcpiDir = TRUE;
+      return EFI_SUCCESS;
+    }
+  }
+
+  *InAcpiDir = FALSE;
+  return FsOpenFile (Directory, ACPI_BUNDLE_FILE_NAME, File);
+}
+
+/**
+  Finds the partition a locator names and checks that the bundle's blocks
+  lie on it.
+
+  @param[in]  Locator  Locator whose own hash has been checked.
+  @param[out] Disk     Receives Disk I/O of the partition.
+  @param[out] MediaId  Receives the partition's media ID.
+
+  @retval EFI_SUCCESS    The partition is present and holds the blocks.
+  @retval EFI_NOT_FOUND  It is not, or its block size differs.
+**/
+STATIC
+EFI_STATUS
+AcpiBundleFindPartition (
+  IN  CONST ACPI_BUNDLE_LOCATOR  *Locator,
+  OUT EFI_DISK_IO_PROTOCOL       **Disk,
+  OUT UINT32                     *MediaId
+  )
+{
+  EFI_DEVICE_PATH_PROTOCOL  *DevicePath;
+  EFI_BLOCK_IO_PROTOCOL     *BlockIo;
+  EFI_HANDLE                *Handles;
+  EFI_GUID                  Partition;
+  EFI_STATUS                Status;
+  UINTN                     HandleCount;
+  UINTN                     Index;
+  UINT64                    Blocks;
+
+  Status = gBS->LocateHandleBuffer (ByProtocol, &gEfiDiskIoProtocolGuid, NULL, &HandleCount, &Handles);
+  if (EFI_ERROR (Status)) {
+    return EFI_NOT_FOUND;
+  }
+
+  Status = EFI_NOT_FOUND;
+  for (Index = 0; Index < HandleCount; Index++) {
+    DevicePath = DevicePathFromHandle (Handles[Index]);
+    if (DevicePath == NULL || !FsGetPartitionGuid (DevicePath, &Partition) ||
+        !CompareGuid (&Partition, &Locator->PartitionGuid)) {
+      continue;
+    }
+
+    if (EFI_ERROR (gBS->HandleProtocol (Handles[Index], &gEfiBlockIoProtocolGuid, (VOID **) &BlockIo)) ||
+        EFI_ERROR (gBS->HandleProtocol (Handles[Index], &gEfiDiskIoProtocolGuid, (VOID **) Disk))) {
+      break;
+    }
+
+    Blocks = DivU64x32 (Locator->Size + (UINT64) Locator->BlockSize - 1, Locator->BlockSize);
+    if (BlockIo->Media->MediaPresent &&
+        BlockIo->Media->BlockSize == Locator->BlockSize &&
+        Locator->Lba <= BlockIo->Media->LastBlock &&
+        Blocks <= BlockIo->Media->LastBlock - Locator->Lba + 1) {
+      *MediaId = BlockIo->Media->MediaId;
+      Status   = EFI_SUCCESS;
+    }
+    break;
+  }
+
+  FreePool (Handles);
+  return Status;
+}
+
+/**
+  Looks for a locator next to an open bundle and, if it describes the
+  bundle and its partition is present, sets the bundle up to be read from
+  its blocks.  The file is left at position 0 whatever the outcome.
+**/
+STATIC
+VOID
+AcpiBundleLocate (
+  IN     EFI_FILE_PROTOCOL  *Directory,
+  IN OUT ACPI_BUNDLE        *Bundle
+  )
+{
+  ACPI_BUNDLE_LOCATOR   Locator;
+  EFI_FILE_PROTOCOL     *File;
+  EFI_DISK_IO_PROTOCOL  *Disk;
+  UINT32                MediaId;
+  EFI_STATUS            Status;
+
+  Status = FsOpenFile (Directory, Bundle->InAcpiDir ? L"ACPI\\" ACPI_BUNDLE_LOCATOR_FILE_NAME : ACPI_BUNDLE_LOCATOR_FILE_NAME, &File);
+  if (EFI_ERROR (Status)) {
+    return;
+  }
+  Status = FsReadExact (File, sizeof (Locator), &Locator, NULL);
+  File->Close (File);
+
+  if (EFI_ERROR (Status) ||
+      Locator.Signature != ACPI_BUNDLE_LOCATOR_SIGNATURE ||
+      Locator.Version != ACPI_BUNDLE_LOCATOR_VERSION ||
+      Locator.LocatorHash != XsdtPlanHash (&Locator, OFFSET_OF (ACPI_BUNDLE_LOCATOR, LocatorHash)) ||
+      Locator.Size != Bundle->FileSize ||
+      Locator.BlockSize == 0) {
+    AcpiDebugPrint (DEBUG_WARN, L"%s does not describe %s, reading the file\n",
+                    ACPI_BUNDLE_LOCATOR_FILE_NAME, ACPI_BUNDLE_FILE_NAME);
+    return;
+  }
+
+  Status = AcpiBundleFindPartition (&Locator, &Disk, &MediaId);
+  if (EFI_ERROR (Status)) {
+    AcpiDebugPrint (DEBUG_INFO, L"Partition %g of %s is not present, reading the file\n",
+                    &Locator.PartitionGuid, ACPI_BUNDLE_LOCATOR_FILE_NAME);
+    return;
+  }
+
+  //
+  // The header of the file as it is now: the blocks must still hold it.
+  //
+  Status = FsReadExact (Bundle->File, sizeof (Bundle->FileHeader), &Bundle->FileHeader, NULL);
+  if (!EFI_ERROR (Status)) {
+    Status = Bundle->File->SetPosition (Bundle->File, 0);
+  }
+  if (EFI_ERROR (Status)) {
+    Bundle->File->SetPosition (Bundle->File, 0);
+    return;
+  }
+
+  Bundle->Disk       = Disk;
+  Bundle->MediaId    = MediaId;
+  Bundle->DiskOffset = MultU64x32 (Locator.Lba, Locator.BlockSize);
+  Bundle->DiskHash   = Locator.BundleHash;
+}
+
+/**
+  Reads a located bundle from its blocks, in one transfer, and checks it
+  is the bundle the locator and the file describe.
+
+  @retval EFI_SUCCESS           Buffer holds the bundle.
+  @retval EFI_VOLUME_CORRUPTED  The blocks hold something else.
+  @retval Other                 The read failed.
+**/
+STATIC
+EFI_STATUS
+AcpiBundleReadBlocks (
+  IN  CONST ACPI_BUNDLE  *Bundle,
+  OUT UINT8              *Buffer
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = Bundle->Disk->ReadDisk (Bundle->Disk, Bundle->MediaId, Bundle->DiskOffset, Bundle->FileSize, Buffer);
+  if (EFI_ERROR (Status)) {
+    AcpiDebugPrint (DEBUG_WARN, L"Cannot read %s at offset 0x%lx: %r, reading the file\n",
+                    Bundle->Name, Bundle->DiskOffset, Status);
+    return Status;
+  }
+
+  if (XsdtPlanHash (Buffer, Bundle->FileSize) != Bundle->DiskHash ||
+      CompareMem (Buffer, &Bundle->FileHeader, sizeof (Bundle->FileHeader)) != 0) {
+    AcpiDebugPrint (DEBUG_WARN, L"Blocks at offset 0x%lx are not %s, reading the file\n",
+                    Bundle->DiskOffset, Bundle->Name);
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+AcpiBundleOpen (
+  IN  EFI_FILE_PROTOCOL  *Directory,
+  OUT ACPI_BUNDLE        *Bundle
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       InfoSize;
+  UINT64      FileSize;
+  //
+  // Room for the name this file was opened by, so one GetInfo() is enough.
+  //
+  UINT64      Info[(SIZE_OF_EFI_FILE_INFO + sizeof (ACPI_BUNDLE_FILE_NAME) + 7) / 8];
+
+  ZeroMem (Bundle, sizeof (*Bundle));
+
+  if (EFI_ERROR (AcpiBundleOpenFile (Directory, &Bundle->File, &Bundle->InAcpiDir))) {
+    Bundle->File = NULL;
+    return EFI_NOT_FOUND;
+  }
+
+  InfoSize = sizeof (Info);
+  Status   = Bundle->File->GetInfo (Bundle->File, &gEfiFileInfoGuid, &InfoSize, Info);
+  if (EFI_ERROR (Status)) {
+    AcpiBundleFree (Bundle);
+    return Status;
+  }
+
+  FileSize = ((EFI_FILE_INFO *) Info)->FileSize;
+  if (FileSize < sizeof (ACPI_BUNDLE_HEADER) || FileSize > MAX_UINT32) {
+    AcpiBundleFree (Bundle);
+    return EFI_BAD_BUFFER_SIZE;
+  }
+
+  Bundle->FileSize = (UINTN) FileSize;
+  Bundle->Name     = ACPI_BUNDLE_FILE_NAME;
+  AcpiBundleLocate (Directory, Bundle);
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+AcpiBundleRead (
+  IN OUT ACPI_BUNDLE  *Bundle,
+  IN     TABLE_ARENA  *Arena
+  )
+{
+  CONST ACPI_BUNDLE_HEADER  *Header;
+  UINT8                     *Buffer;
+  UINTN                     TocSize;
+  UINTN                     Index;
+  UINTN                     Char;
+  EFI_STATUS                Status;
+
+  Buffer = TableArenaAllocate (Arena, Bundle->FileSize);
+  if (Buffer == NULL) {
+    AcpiBundleFree (Bundle);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = EFI_NOT_FOUND;
+  if (Bundle->Disk != NULL) {
+    Status = AcpiBundleReadBlocks (Bundle, Buffer);
+    if (EFI_ERROR (Status)) {
+      Bundle->Disk = NULL;
+    }
+  }
+  if (EFI_ERROR (Status)) {
+    //
+    // FsReadExact() splits only bundles larger than FS_READ_CHUNK_SIZE.
+    //
+    Status = FsReadExact (Bundle->File, Bundle->FileSize, Buffer, NULL);
+  }
+  Bundle->File->Close (Bundle->File);
+  Bundle->File = NULL;
+  if (EFI_ERROR (Status)) {
+    TableArenaFree (Arena, Buffer);
+    return Status;
+  }
+
+  Header  = (CONST ACPI_BUNDLE_HEADER *) Buffer;
+  TocSize = (UINTN) Header->EntryCount * sizeof (ACPI_BUNDLE_ENTRY);
+  if (Header->Signature != ACPI_BUNDLE_SIGNATURE ||
+      Header->Version != ACPI_BUNDLE_VERSION ||
+      Header->EntrySize != sizeof (ACPI_BUNDLE_ENTRY) ||
+      Header->Size != Bundle->FileSize ||
+      Header->EntryCount > (Bundle->FileSize - sizeof (*Header)) / sizeof (ACPI_BUNDLE_ENTRY)) {
+    AcpiDebugPrint (DEBUG_WARN, L"%s is not a version %d bundle of its own size\n",
+                    Bundle->Name, ACPI_BUNDLE_VERSION);
+    TableArenaFree (Arena, Buffer);
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  if (Header->Fingerprint != Bundle->Fingerprint) {
+    AcpiDebugPrint (DEBUG_INFO, L"%s was written for other files, not using it\n", Bundle->Name);
+    TableArenaFree (Arena, Buffer);
+    return EFI_NOT_FOUND;
+  }
+
+  if (XsdtPlanHash (Header + 1, TocSize) != Header->TocHash) {
+    AcpiDebugPrint (DEBUG_WARN, L"%s: table of contents does not match its hash\n", Bundle->Name);
+    TableArenaFree (Arena, Buffer);
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  Bundle->Names = AllocatePool (MAX (Header->EntryCount, 1) * ACPI_BUNDLE_NAME_SIZE * sizeof (CHAR16));
+  if (Bundle->Names == NULL) {
+    TableArenaFree (Arena, Buffer);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Bundle->Header  = Header;
+  Bundle->Entries = (CONST ACPI_BUNDLE_ENTRY *) (Header + 1);
+  for (Index = 0; Index < Header->EntryCount; Index++) {
+    //
+    // The last character is always the terminator, whatever the writer put
+    // there; anything outside printable ASCII is shown as '?'.
+    //
+    for (Char = 0; Char < ACPI_BUNDLE_NAME_SIZE - 1 && Bundle->Entries[Index].Name[Char] != '\0'; Char++) {
+      Bundle->Names[Index * ACPI_BUNDLE_NAME_SIZE + Char] =
+        (Bundle->Entries[Index].Name[Char] >= 0x20 && Bundle->Entries[Index].Name[Char] < 0x7F) ?
+        (CHAR16) Bundle->Entries[Index].Name[Char] : L'?';
+    }
+    Bundle->Names[Index * ACPI_BUNDLE_NAME_SIZE + Char] = L'\0';
+  }
+
+  AcpiDebugPrint (DEBUG_INFO, L"Using %s%s: %d entries, %d bytes%s\n",
+                  Bundle->InAcpiDir ? L"ACPI\\" : L"", Bundle->Name,
+                  Header->EntryCount, Header->Size,
+                  (Bundle->Disk != NULL) ? L", read from its blocks" : L"");
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+AcpiBundleTable (
+  IN  CONST ACPI_BUNDLE            *Bundle,
+  IN  UINTN                        Index,
+  OUT XSDT_OP_KIND                 *Kind,
+  OUT EFI_ACPI_DESCRIPTION_HEADER  **Table
+  )
+{
+  CONST ACPI_BUNDLE_ENTRY      *Entry;
+  EFI_ACPI_DESCRIPTION_HEADER  *Candidate;
+  UINTN                        TocEnd;
+
+  Entry  = &Bundle->Entries[Index];
+  *Table = NULL;
+  switch (Entry->Action) {
+    case ACPI_BUNDLE_ACTION_APPEND:
+      *Kind = XsdtOpAppend;
+      break;
+    case ACPI_BUNDLE_ACTION_REPLACE:
+      *Kind = XsdtOpReplace;
+      break;
+    case ACPI_BUNDLE_ACTION_DROP:
+      *Kind = XsdtOpDrop;
+      return EFI_SUCCESS;
+    default:
+      AcpiDebugPrint (DEBUG_WARN, L"%s: unknown action %d\n", ACPI_BUNDLE_ENTRY_NAME (Bundle, Index), Entry->Action);
+      return EFI_VOLUME_CORRUPTED;
+  }
+
+  //
+  // The table must sit past the table of contents, inside the bundle, at
+  // an aligned offset, and its own header must agree with the entry.
+  //
+  TocEnd = sizeof (ACPI_BUNDLE_HEADER) + (UINTN) Bundle->Header->EntryCount * sizeof (ACPI_BUNDLE_ENTRY);
+  if (Entry->Offset < TocEnd ||
+      Entry->Offset > Bundle->Header->Size ||
+      (Entry->Offset & (ACPI_BUNDLE_ALIGNMENT - 1)) != 0 ||
+      Entry->Length < sizeof (EFI_ACPI_DESCRIPTION_HEADER) ||
+      Entry->Length > Bundle->Header->Size - Entry->Offset) {
+    AcpiDebugPrint (DEBUG_WARN, L"%s: offset 0x%x length %d is outside the bundle, skipping\n",
+                    ACPI_BUNDLE_ENTRY_NAME (Bundle, Index), Entry->Offset, Entry->Length);
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  Candidate = (EFI_ACPI_DESCRIPTION_HEADER *) ((UINT8 *) Bundle->Header + Entry->Offset);
+  if (Candidate->Signature != Entry->Signature ||
+      Candidate->Length != Entry->Length ||
+      Candidate->OemTableId != Entry->OemTableId ||
+      CompareMem (Candidate->OemId, Entry->OemId, sizeof (Entry->OemId)) != 0) {
+    AcpiDebugPrint (DEBUG_WARN, L"%s: table header does not match the bundle entry, skipping\n",
+                    ACPI_BUNDLE_ENTRY_NAME (Bundle, Index));
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  *Table = Candidate;
+  return EFI_SUCCESS;
+}
+
+VOID
+AcpiBundleFree (
+  IN OUT ACPI_BUNDLE  *Bundle
+  )
+{
+  if (Bundle->File != NULL) {
+    Bundle->File->Close (Bundle->File);
+  }
+  if (Bundle->Names != NULL) {
+    FreePool (Bundle->Names);
+  }
+
+  ZeroMem (Bundle, sizeof (*Bundle));
+}
@@ -0,0 +1,265 @@
+/** @file
+
+  ACPIPatcher.apb patch bundle.
+
+  A bundle carries a whole patch set in one file: a header, a table of
+  contents and the tables themselves, each at an offset aligned for use in
+  place.  The patcher opens it once and reads it once, straight into the
+  table arena, and installs the tables from where they landed.
+
+  Layout, all fields little endian:
+
+    ACPI_BUNDLE_HEADER      at offset 0
+    ACPI_BUNDLE_ENTRY       EntryCount of them, straight after the header
+    tables                  each at an ACPI_BUNDLE_ALIGNMENT multiple
+
+  An entry either installs a table, with Action append or replace, or
+  removes every firmware table with its Signature, with Action drop and no
+  payload.  Hash is XsdtPlanHash() of the table and TocHash in the header
+  is XsdtPlanHash() of the whole table of contents.
+
+  Tools/AcpiBundle.py builds a bundle from a directory of tables and checks
+  an existing one.
+
+  A bundle can also come with an ACPIPatcher.apl locator next to it, which
+  Tools/AcpiBundle.py locate writes once the bundle sits in one contiguous
+  run of blocks on a GPT partition.  The locator gives the partition GUID,
+  the first LBA and the size of the bundle and the hash of all its bytes,
+  and its last field is the hash of the rest.  With a usable locator the
+  bundle is read with a single Disk I/O transfer rather than through the
+  file system driver's cluster chain walk.  The bytes are only trusted
+  when their hash is the locator's and their header is the one the file
+  has now; anything else falls back to reading the file.
+
+**/
+
+#ifndef __ACPI_PATCHER_ACPI_BUNDLE_H__
+#define __ACPI_PATCHER_ACPI_BUNDLE_H__
+
+#include <Uefi.h>
+#include <IndustryStandard/Acpi.h>
+#include <Protocol/DiskIo.h>
+#include <Protocol/SimpleFileSystem.h>
+
+#include "TableArena.h"
+#include "XsdtPlan.h"
+
+#define ACPI_BUNDLE_FILE_NAME          L"ACPIPatcher.apb"
+#define ACPI_BUNDLE_LOCATOR_FILE_NAME  L"ACPIPatcher.apl"
+
+#define ACPI_BUNDLE_SIGNATURE  SIGNATURE_32 ('A', 'P', 'B', '1')
+#define ACPI_BUNDLE_VERSION    1
+
+#define ACPI_BUNDLE_LOCATOR_SIGNATURE  SIGNATURE_32 ('A', 'P', 'L', '1')
+#define ACPI_BUNDLE_LOCATOR_VERSION    1
+
+//
+// Alignment of every table in a bundle, relative to its start.  It is the
+// arena's, so a bundle read into the arena leaves every table aligned.
+//
+#define ACPI_BUNDLE_ALIGNMENT  TABLE_ARENA_ALIGNMENT
+
+#define ACPI_BUNDLE_ACTION_APPEND   1
+#define ACPI_BUNDLE_ACTION_REPLACE  2
+#define ACPI_BUNDLE_ACTION_DROP     3
+
+//
+// Bytes of the file name kept in an entry, for the log, NUL padded.
+//
+#define ACPI_BUNDLE_NAME_SIZE  32
+
+#pragma pack(1)
+
+typedef struct {
+  UINT32  Signature;
+  UINT16  Version;
+  //
+  // sizeof (ACPI_BUNDLE_ENTRY) of the writer.
+  //
+  UINT16  EntrySize;
+  UINT32  EntryCount;
+  //
+  // Size of the whole bundle, which must be the size of the file.
+  //
+  UINT32  Size;
+  UINT64  TocHash;
+  //
+  // For a boot cache, the fingerprint of the directory it was written
+  // from (see BootCache.h); 0 in a bundle built on the host.
+  //
+  UINT64  Fingerprint;
+} ACPI_BUNDLE_HEADER;
+
+typedef struct {
+  UINT32  Signature;
+  UINT8   Action;
+  UINT8   Reserved[3];
+  //
+  // Where the table is, from the start of the bundle; both 0 for a drop.
+  //
+  UINT32  Offset;
+  UINT32  Length;
+  //
+  // Copies of the table's header fields, so a bundle can be listed and
+  // checked without reading the tables.
+  //
+  UINT8   OemId[6];
+  UINT8   Reserved2[2];
+  UINT64  OemTableId;
+  UINT64  Hash;
+  CHAR8   Name[ACPI_BUNDLE_NAME_SIZE];
+} ACPI_BUNDLE_ENTRY;
+
+typedef struct {
+  UINT32    Signature;
+  UINT16    Version;
+  UINT16    Reserved;
+  //
+  // Block size of the partition Lba counts in.
+  //
+  UINT32    BlockSize;
+  //
+  // Size of the bundle, which must be the size of the file.
+  //
+  UINT32    Size;
+  UINT64    Lba;
+  //
+  // GPT partition GUID of the volume the bundle is on.
+  //
+  EFI_GUID  PartitionGuid;
+  //
+  // XsdtPlanHash() of the Size bytes at Lba.
+  //
+  UINT64    BundleHash;
+  //
+  // XsdtPlanHash() of the fields above.
+  //
+  UINT64    LocatorHash;
+} ACPI_BUNDLE_LOCATOR;
+
+#pragma pack()
+
+typedef struct {
+  //
+  // The bundle file, open from AcpiBundleOpen() until AcpiBundleRead().
+  //
+  EFI_FILE_PROTOCOL         *File;
+  UINTN                     FileSize;
+  //
+  // File name, for the log, and whether it is in the ACPI subdirectory.
+  //
+  CONST CHAR16              *Name;
+  BOOLEAN                   InAcpiDir;
+  //
+  // Where to read the bundle from without the file system, if a locator
+  // was found for it: Disk I/O of its partition, and the byte offset and
+  // hash the locator gives.  Header is the file's own header, which the
+  // bytes there must start with.  Disk is NULL without a locator.
+  //
+  EFI_DISK_IO_PROTOCOL      *Disk;
+  UINT32                    MediaId;
+  UINT64                    DiskOffset;
+  UINT64                    DiskHash;
+  ACPI_BUNDLE_HEADER        FileHeader;
+  //
+  // Fingerprint the header must carry for the bundle to be used.
+  //
+  UINT64                    Fingerprint;
+  //
+  // The bundle in the arena, once read.
+  //
+  CONST ACPI_BUNDLE_HEADER  *Header;
+  CONST ACPI_BUNDLE_ENTRY   *Entries;
+  //
+  // Entry names for the log, ACPI_BUNDLE_NAME_SIZE characters each.
+  //
+  CHAR16                    *Names;
+} ACPI_BUNDLE;
+
+//
+// Name of entry Index of a bundle read by AcpiBundleRead().
+//
+#define ACPI_BUNDLE_ENTRY_NAME(Bundle, Index)  (&(Bundle)->Names[(Index) * ACPI_BUNDLE_NAME_SIZE])
+
+/**
+  Looks for ACPI\ACPIPatcher.apb, then ACPIPatcher.apb, under Directory
+  and opens the first one found.  If an ACPIPatcher.apl locator next to it
+  points at a partition that is present, only the bundle's header is read
+  now, for AcpiBundleRead() to compare with the blocks it reads.
+
+  @param[in]  Directory  Directory the patcher was started with.  It is
+                         not closed.
+  @param[out] Bundle     Receives the open bundle; release with
+                         AcpiBundleFree().
+
+  @retval EFI_SUCCESS           The bundle was opened.
+  @retval EFI_NOT_FOUND         There is no bundle.
+  @retval EFI_BAD_BUFFER_SIZE   The file is too small or too large to be a
+                                bundle.
+  @retval Other                 Reading the file's size failed.
+**/
+EFI_STATUS
+AcpiBundleOpen (
+  IN  EFI_FILE_PROTOCOL  *Directory,
+  OUT ACPI_BUNDLE        *Bundle
+  );
+
+/**
+  Reads an open bundle into Arena with one read and checks its header and
+  table of contents.  The file is closed whatever the outcome.
+
+  A located bundle is read from its blocks.  If that read fails, or the
+  bytes do not have the locator's hash or start with the file's header,
+  the file is read instead.
+
+  The tables are not checked here; AcpiBundleTable() does that for each.
+
+  @param[in,out] Bundle  Bundle from AcpiBundleOpen().
+  @param[in]     Arena   Arena with room for TABLE_ARENA_SIZE (FileSize).
+
+  @retval EFI_SUCCESS           The bundle is in the arena.
+  @retval EFI_NOT_FOUND         The bundle's fingerprint is not
+                                Bundle->Fingerprint: it is a boot cache of
+                                other files.  Nothing is left in the arena.
+  @retval EFI_OUT_OF_RESOURCES  The arena or the pool is out of room.
+  @retval EFI_VOLUME_CORRUPTED  The header or table of contents is bad.
+  @retval Other                 Reading the file failed.
+**/
+EFI_STATUS
+AcpiBundleRead (
+  IN OUT ACPI_BUNDLE  *Bundle,
+  IN     TABLE_ARENA  *Arena
+  );
+
+/**
+  Returns the table of a bundle entry after checking that it lies inside
+  the bundle, is aligned, and that its header matches the entry.  The hash
+  and checksum are left to the caller, which computes them anyway.
+
+  @param[in]  Bundle  Bundle read by AcpiBundleRead().
+  @param[in]  Index   Entry to look at.
+  @param[out] Kind    Receives what to do with the table.
+  @param[out] Table   Receives the table, or NULL for a drop.
+
+  @retval EFI_SUCCESS           The entry is usable.
+  @retval EFI_VOLUME_CORRUPTED  The entry does not describe its table.
+**/
+EFI_STATUS
+AcpiBundleTable (
+  IN  CONST ACPI_BUNDLE            *Bundle,
+  IN  UINTN                        Index,
+  OUT XSDT_OP_KIND                 *Kind,
+  OUT EFI_ACPI_DESCRIPTION_HEADER  **Table
+  );
+
+/**
+  Closes the bundle file if it is still open and frees the names.  The
+  bundle's arena space belongs to the arena.  Freeing a zeroed or already
+  freed bundle is allowed.
+**/
+VOID
+AcpiBundleFree (
+  IN OUT ACPI_BUNDLE  *Bundle
+  );
+
+#endif // __ACPI_PATCHER_ACPI_BUNDLE_H__
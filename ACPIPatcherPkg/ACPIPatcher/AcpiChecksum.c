@@ -0,0 +1,360 @@
+/** @file
+
+  ACPI checksum engine.
+
+  Every table was checksummed one byte at a time, which for a multi-MB DSDT
+  is millions of dependent adds.  Bytes can instead be added a word or a
+  vector at a time, each byte lane wrapping modulo 256 on its own, and the
+  lanes folded into one byte at the end; modular addition does not care
+  about the order.
+
+  SSE2 is part of every x64 CPU and NEON of every AArch64 one, so those
+  kernels are chosen at compile time and need no CPUID check.  Everything
+  else, including IA32 and EBC, uses the portable word kernel.
+
+  Edits in place used to be followed by a full recomputation of the
+  checksum, or by none at all: the FADT was left invalid after its DSDT
+  pointers changed, and the RSDP ExtendedChecksum was never updated.  An
+  edit of a few bytes only moves the sum by the difference between the old
+  and the new bytes, so that difference is all the edit calls compute.
+
+**/
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+
+#include "AcpiChecksum.h"
+
+#if !defined (ACPI_CHECKSUM_NO_SIMD) && (defined (__SSE2__) || defined (_M_X64))
+#define ACPI_CHECKSUM_SSE2
+#include <emmintrin.h>
+#elif !defined (ACPI_CHECKSUM_NO_SIMD) && defined (__aarch64__) && defined (__ARM_NEON)
+#define ACPI_CHECKSUM_NEON
+#include <arm_neon.h>
+#endif
+
+//
+// Bytes the portable kernel copies before summing what it just copied,
+// so the data is still in the L1 cache when it is read back.
+//
+#define ACPI_CHECKSUM_COPY_BLOCK  SIZE_4KB
+
+STATIC
+UINT8
+AcpiChecksumBytes (
+  IN CONST UINT8  *Bytes,
+  IN UINTN        Length
+  )
+{
+  UINT8  Sum;
+
+  for (Sum = 0; Length > 0; Length--) {
+    Sum = (UINT8) (Sum + *Bytes++);
+  }
+
+  return Sum;
+}
+
+#if defined (ACPI_CHECKSUM_SSE2)
+
+STATIC
+UINT8
+AcpiChecksumFold (
+  IN __m128i  Lanes
+  )
+{
+  __m128i  Halves;
+
+  Halves = _mm_sad_epu8 (Lanes, _mm_setzero_si128 ());
+  return (UINT8) (_mm_cvtsi128_si32 (Halves) + _mm_cvtsi128_si32 (_mm_srli_si128 (Halves, 8)));
+}
+
+UINT8
+AcpiChecksumSum (
+  IN CONST VOID  *Buffer,
+  IN UINTN       Length
+  )
+{
+  CONST UINT8  *Bytes;
+  __m128i      Acc0;
+  __m128i      Acc1;
+
+  Bytes = Buffer;
+  Acc0  = _mm_setzero_si128 ();
+  Acc1  = _mm_setzero_si128 ();
+  for ( ; Length >= 32; Length -= 32, Bytes += 32) {
+    Acc0 = _mm_add_epi8 (Acc0, _mm_loadu_si128 ((CONST __m128i *) Bytes));
+    Acc1 = _mm_add_epi8 (Acc1, _mm_loadu_si128 ((CONST __m128i *) (Bytes + 16)));
+  }
+
+  return (UINT8) (AcpiChecksumFold (_mm_add_epi8 (Acc0, Acc1)) + AcpiChecksumBytes (Bytes, Length));
+}
+
+UINT8
+AcpiChecksumCopy (
+  OUT VOID        *Destination,
+  IN  CONST VOID  *Source,
+  IN  UINTN       Length
+  )
+{
+  CONST UINT8  *Bytes;
+  UINT8        *Target;
+  __m128i      Acc0;
+  __m128i      Acc1;
+  __m128i      Data0;
+  __m128i      Data1;
+
+  Bytes  = Source;
+  Target = Destination;
+  Acc0   = _mm_setzero_si128 ();
+  Acc1   = _mm_setzero_si128 ();
+  for ( ; Length >= 32; Length -= 32, Bytes += 32, Target += 32) {
+    Data0 = _mm_loadu_si128 ((CONST __m128i *) Bytes);
+    Data1 = _mm_loadu_si128 ((CONST __m128i *) (Bytes + 16));
+    _mm_storeu_si128 ((__m128i *) Target, Data0);
+    _mm_storeu_si128 ((__m128i *) (Target + 16), Data1);
+    Acc0 = _mm_add_epi8 (Acc0, Data0);
+    Acc1 = _mm_add_epi8 (Acc1, Data1);
+  }
+
+  CopyMem (Target, Bytes, Length);
+  return (UINT8) (AcpiChecksumFold (_mm_add_epi8 (Acc0, Acc1)) + AcpiChecksumBytes (Bytes, Length));
+}
+
+CONST CHAR8 *
+AcpiChecksumKernel (
+  VOID
+  )
+{
+  return "sse2";
+}
+
+#elif defined (ACPI_CHECKSUM_NEON)
+
+UINT8
+AcpiChecksumSum (
+  IN CONST VOID  *Buffer,
+  IN UINTN       Length
+  )
+{
+  CONST UINT8  *Bytes;
+  uint8x16_t   Acc0;
+  uint8x16_t   Acc1;
+
+  Bytes = Buffer;
+  Acc0  = vdupq_n_u8 (0);
+  Acc1  = vdupq_n_u8 (0);
+  for ( ; Length >= 32; Length -= 32, Bytes += 32) {
+    Acc0 = vaddq_u8 (Acc0, vld1q_u8 (Bytes));
+    Acc1 = vaddq_u8 (Acc1, vld1q_u8 (Bytes + 16));
+  }
+
+  return (UINT8) (vaddvq_u8 (vaddq_u8 (Acc0, Acc1)) + AcpiChecksumBytes (Bytes, Length));
+}
+
+UINT8
+AcpiChecksumCopy (
+  OUT VOID        *Destination,
+  IN  CONST VOID  *Source,
+  IN  UINTN       Length
+  )
+{
+  CONST UINT8  *Bytes;
+  UINT8        *Target;
+  uint8x16_t   Acc0;
+  uint8x16_t   Acc1;
+  uint8x16_t   Data0;
+  uint8x16_t   Data1;
+
+  Bytes  = Source;
+  Target = Destination;
+  Acc0   = vdupq_n_u8 (0);
+  Acc1   = vdupq_n_u8 (0);
+  for ( ; Length >= 32; Length -= 32, Bytes += 32, Target += 32) {
+    Data0 = vld1q_u8 (Bytes);
+    Data1 = vld1q_u8 (Bytes + 16);
+    vst1q_u8 (Target, Data0);
+    vst1q_u8 (Target + 16, Data1);
+    Acc0 = vaddq_u8 (Acc0, Data0);
+    Acc1 = vaddq_u8 (Acc1, Data1);
+  }
+
+  CopyMem (Target, Bytes, Length);
+  return (UINT8) (vaddvq_u8 (vaddq_u8 (Acc0, Acc1)) + AcpiChecksumBytes (Bytes, Length));
+}
+
+CONST CHAR8 *
+AcpiChecksumKernel (
+  VOID
+  )
+{
+  return "neon";
+}
+
+#else
+
+//
+// Adds two words byte by byte, each byte modulo 256: the low seven bits of
+// every byte are added with room to spare and the top bit is fixed up by
+// XOR, so no carry crosses into the next byte.
+//
+#define ACPI_CHECKSUM_LOW7   ((UINTN) 0x7F7F7F7F7F7F7F7FULL)
+#define ACPI_CHECKSUM_HIGH1  ((UINTN) 0x8080808080808080ULL)
+
+#define ACPI_CHECKSUM_ADD_BYTES(A, B) \
+  ((((A) & ACPI_CHECKSUM_LOW7) + ((B) & ACPI_CHECKSUM_LOW7)) ^ (((A) ^ (B)) & ACPI_CHECKSUM_HIGH1))
+
+UINT8
+AcpiChecksumSum (
+  IN CONST VOID  *Buffer,
+  IN UINTN       Length
+  )
+{
+  CONST UINT8  *Bytes;
+  CONST UINTN  *Words;
+  UINTN        Head;
+  UINTN        Acc0;
+  UINTN        Acc1;
+  UINT8        Sum;
+  UINTN        Index;
+
+  //
+  // Bytes up to the first aligned word, then two words per step in two
+  // independent accumulators.
+  //
+  Bytes  = Buffer;
+  Head   = MIN ((0 - (UINTN) Bytes) & (sizeof (UINTN) - 1), Length);
+  Sum    = AcpiChecksumBytes (Bytes, Head);
+  Length -= Head;
+
+  Words = (CONST UINTN *) (Bytes + Head);
+  Acc0  = 0;
+  Acc1  = 0;
+  for ( ; Length >= 2 * sizeof (UINTN); Length -= 2 * sizeof (UINTN), Words += 2) {
+    Acc0 = ACPI_CHECKSUM_ADD_BYTES (Acc0, Words[0]);
+    Acc1 = ACPI_CHECKSUM_ADD_BYTES (Acc1, Words[1]);
+  }
+
+  Acc0 = ACPI_CHECKSUM_ADD_BYTES (Acc0, Acc1);
+  for (Index = 0; Index < sizeof (UINTN); Index++, Acc0 >>= 8) {
+    Sum = (UINT8) (Sum + (UINT8) Acc0);
+  }
+
+  return (UINT8) (Sum + AcpiChecksumBytes ((CONST UINT8 *) Words, Length));
+}
+
+UINT8
+AcpiChecksumCopy (
+  OUT VOID        *Destination,
+  IN  CONST VOID  *Source,
+  IN  UINTN       Length
+  )
+{
+  CONST UINT8  *Bytes;
+  UINT8        *Target;
+  UINTN        Block;
+  UINT8        Sum;
+
+  Bytes  = Source;
+  Target = Destination;
+  for (Sum = 0; Length > 0; Length -= Block, Bytes += Block, Target += Block) {
+    Block = MIN (Length, ACPI_CHECKSUM_COPY_BLOCK);
+    CopyMem (Target, Bytes, Block);
+    Sum = (UINT8) (Sum + AcpiChecksumSum (Target, Block));
+  }
+
+  return Sum;
+}
+
+CONST CHAR8 *
+AcpiChecksumKernel (
+  VOID
+  )
+{
+  return "word";
+}
+
+#endif
+
+VOID
+AcpiChecksumTable (
+  IN OUT EFI_ACPI_DESCRIPTION_HEADER  *Table
+  )
+{
+  Table->Checksum = 0;
+  Table->Checksum = (UINT8) (0 - AcpiChecksumSum (Table, Table->Length));
+}
+
+VOID
+AcpiChecksumUpdate (
+  IN OUT UINT8       *Checksum,
+  OUT    VOID        *Field,
+  IN     CONST VOID  *Value,
+  IN     UINTN       Size
+  )
+{
+  UINT8  Removed;
+
+  Removed = AcpiChecksumBytes (Field, Size);
+  CopyMem (Field, Value, Size);
+  *Checksum = (UINT8) (*Checksum + Removed - AcpiChecksumBytes (Value, Size));
+}
+
+VOID
+AcpiTableSet32 (
+  IN OUT EFI_ACPI_DESCRIPTION_HEADER  *Table,
+  OUT    VOID                         *Field,
+  IN     UINT32                       Value
+  )
+{
+  AcpiChecksumUpdate (&Table->Checksum, Field, &Value, sizeof (Value));
+}
+
+VOID
+AcpiTableSet64 (
+  IN OUT EFI_ACPI_DESCRIPTION_HEADER  *Table,
+  OUT    VOID                         *Field,
+  IN     UINT64                       Value
+  )
+{
+  AcpiChecksumUpdate (&Table->Checksum, Field, &Value, sizeof (Value));
+}
+
+VOID
+AcpiTableAppendEntry (
+  IN OUT EFI_ACPI_DESCRIPTION_HEADER  *Xsdt,
+  IN     UINT64                       Entry
+  )
+{
+  //
+  // The bytes past Length are not covered yet, so only the new ones count.
+  //
+  WriteUnaligned64 ((UINT64 *) ((UINT8 *) Xsdt + Xsdt->Length), Entry);
+  Xsdt->Checksum = (UINT8) (Xsdt->Checksum - AcpiChecksumBytes ((CONST UINT8 *) &Entry, sizeof (Entry)));
+  AcpiTableSet32 (Xsdt, &Xsdt->Length, Xsdt->Length + sizeof (Entry));
+}
+
+VOID
+AcpiTableReplaceEntry (
+  IN OUT EFI_ACPI_DESCRIPTION_HEADER  *Xsdt,
+  IN     UINTN                        Index,
+  IN     UINT64                       Entry
+  )
+{
+  AcpiTableSet64 (Xsdt, (UINT64 *) (Xsdt + 1) + Index, Entry);
+}
+
+VOID
+AcpiRsdpSetXsdt (
+  IN OUT EFI_ACPI_2_0_ROOT_SYSTEM_DESCRIPTION_POINTER  *Rsdp,
+  IN     UINT64                                        XsdtAddress
+  )
+{
+  //
+  // Checksum covers the first 20 bytes, the ACPI 1.0 structure, and
+  // XsdtAddress lies beyond them; only ExtendedChecksum, over the whole
+  // structure, sees the change.
+  //
+  AcpiChecksumUpdate (&Rsdp->ExtendedChecksum, &Rsdp->XsdtAddress, &XsdtAddress, sizeof (XsdtAddress));
+}
@@ -0,0 +1,142 @@
+/** @file
+
+  ACPI checksum engine.
+
+  An ACPI checksum is the sum of every byte of a structure, modulo 256.
+  The kernels here sum a machine word or a vector register at a time
+  instead of one byte, and can sum a buffer while copying it, so a table
+  moved into place is validated without reading it a second time.
+
+  Tables that are edited rather than built go through the AcpiTable*()
+  and AcpiRsdp*() calls, which adjust the checksum by the change in the
+  bytes they write.  A table that summed to zero before an edit still does
+  afterwards, and nothing is rescanned.
+
+  Build-time knobs (pass with -D):
+
+    ACPI_CHECKSUM_NO_SIMD   Use the portable word-at-a-time kernel even
+                            where SSE2 (x86) or NEON (AArch64) is available.
+
+**/
+
+#ifndef __ACPI_PATCHER_ACPI_CHECKSUM_H__
+#define __ACPI_PATCHER_ACPI_CHECKSUM_H__
+
+#include <Uefi.h>
+#include <IndustryStandard/Acpi.h>
+
+/**
+  Sums a buffer.
+
+  @param[in] Buffer  Bytes to sum.
+  @param[in] Length  Number of bytes.
+
+  @return The sum of the bytes modulo 256; 0 for a table whose checksum is
+          correct.
+**/
+UINT8
+AcpiChecksumSum (
+  IN CONST VOID  *Buffer,
+  IN UINTN       Length
+  );
+
+/**
+  Copies a buffer and sums the bytes copied, reading the source once.  The
+  buffers must not overlap.
+
+  @param[out] Destination  Where to copy to.
+  @param[in]  Source       Bytes to copy and sum.
+  @param[in]  Length       Number of bytes.
+
+  @return The sum of the bytes modulo 256.
+**/
+UINT8
+AcpiChecksumCopy (
+  OUT VOID        *Destination,
+  IN  CONST VOID  *Source,
+  IN  UINTN       Length
+  );
+
+/**
+  Sets the Checksum field of a table so that the whole table, Length bytes
+  from its header, sums to zero.
+**/
+VOID
+AcpiChecksumTable (
+  IN OUT EFI_ACPI_DESCRIPTION_HEADER  *Table
+  );
+
+/**
+  Writes Size bytes of Value over Field and adjusts *Checksum by the change
+  in their sum.  Field must lie inside the structure *Checksum covers and
+  must not include *Checksum itself.
+**/
+VOID
+AcpiChecksumUpdate (
+  IN OUT UINT8       *Checksum,
+  OUT    VOID        *Field,
+  IN     CONST VOID  *Value,
+  IN     UINTN       Size
+  );
+
+/**
+  Sets a 32-bit field of a table, keeping its checksum valid.  Field may
+  be unaligned.
+**/
+VOID
+AcpiTableSet32 (
+  IN OUT EFI_ACPI_DESCRIPTION_HEADER  *Table,
+  OUT    VOID                         *Field,
+  IN     UINT32                       Value
+  );
+
+/**
+  Sets a 64-bit field of a table, keeping its checksum valid.  Field may
+  be unaligned.
+**/
+VOID
+AcpiTableSet64 (
+  IN OUT EFI_ACPI_DESCRIPTION_HEADER  *Table,
+  OUT    VOID                         *Field,
+  IN     UINT64                       Value
+  );
+
+/**
+  Appends a 64-bit entry to an XSDT, growing its Length and keeping its
+  checksum valid.  The caller provides the room for the entry.
+**/
+VOID
+AcpiTableAppendEntry (
+  IN OUT EFI_ACPI_DESCRIPTION_HEADER  *Xsdt,
+  IN     UINT64                       Entry
+  );
+
+/**
+  Replaces entry Index of an XSDT, keeping its checksum valid.
+**/
+VOID
+AcpiTableReplaceEntry (
+  IN OUT EFI_ACPI_DESCRIPTION_HEADER  *Xsdt,
+  IN     UINTN                        Index,
+  IN     UINT64                       Entry
+  );
+
+/**
+  Points an ACPI 2.0+ RSDP at a new XSDT, keeping both its checksums
+  valid.
+**/
+VOID
+AcpiRsdpSetXsdt (
+  IN OUT EFI_ACPI_2_0_ROOT_SYSTEM_DESCRIPTION_POINTER  *Rsdp,
+  IN     UINT64                                        XsdtAddress
+  );
+
+/**
+  Name of the kernel this build uses, for diagnostics.
+**/
+CONST CHAR8 *
+AcpiChecksumKernel (
+  VOID
+  );
+
+#endif // __ACPI_PATCHER_ACPI_CHECKSUM_H__
@@ -0,0 +1,244 @@
+/** @file
+
+  Remembered ACPI files directory.
+
+  Only the remembered volume is opened on a hit; the others are told
+  apart by the device paths their handles already carry, which costs no
+  I/O.  The directory is still read into a snapshot as the search would,
+  so a directory emptied since the last boot is noticed and searched
+  past.
+
+**/
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DevicePathLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiRuntimeServicesTableLib.h>
+
+#define ACPI_LOG_FILE_ID  12
+
+#include "AcpiDirHint.h"
+#include "DebugLog.h"
+#include "FsHelpers.h"
+
+STATIC EFI_GUID  mAcpiPatcherVariableGuid = ACPI_PATCHER_VARIABLE_GUID;
+
+/**
+  Reads the variable into Buffer and checks that its parts fit together.
+
+  @return The hint, or NULL if there is none or it is malformed.
+**/
+STATIC
+CONST ACPI_DIR_HINT *
+AcpiDirHintRead (
+  OUT UINT64  *Buffer,
+  OUT UINTN   *Size
+  )
+{
+  CONST ACPI_DIR_HINT  *Hint;
+  CONST CHAR16         *Path;
+  EFI_STATUS           Status;
+
+  *Size  = ACPI_DIR_HINT_MAX_SIZE;
+  Status = gRT->GetVariable (ACPI_DIR_HINT_VARIABLE_NAME, &mAcpiPatcherVariableGuid, NULL, Size, Buffer);
+  if (EFI_ERROR (Status)) {
+    return NULL;
+  }
+
+  Hint = (CONST ACPI_DIR_HINT *) Buffer;
+  if (*Size < sizeof (*Hint) ||
+      Hint->Revision != ACPI_DIR_HINT_REVISION ||
+      *Size != sizeof (*Hint) + Hint->DevicePathSize + Hint->PathSize ||
+      Hint->DevicePathSize < END_DEVICE_PATH_LENGTH ||
+      !IsDevicePathValid ((CONST EFI_DEVICE_PATH_PROTOCOL *) (Hint + 1), Hint->DevicePathSize) ||
+      GetDevicePathSize ((CONST EFI_DEVICE_PATH_PROTOCOL *) (Hint + 1)) != Hint->DevicePathSize ||
+      Hint->PathSize < sizeof (CHAR16) || (Hint->PathSize % sizeof (CHAR16)) != 0) {
+    return NULL;
+  }
+
+  Path = (CONST CHAR16 *) ((CONST UINT8 *) (Hint + 1) + Hint->DevicePathSize);
+  if (ReadUnaligned16 ((CONST UINT16 *) ((CONST UINT8 *) Path + Hint->PathSize) - 1) != L'\0') {
+    return NULL;
+  }
+
+  return Hint;
+}
+
+/**
+  Builds the hint for a directory in Buffer.
+
+  @return Its size, or 0 if it does not fit ACPI_DIR_HINT_MAX_SIZE.
+**/
+STATIC
+UINTN
+AcpiDirHintBuild (
+  IN  CONST EFI_DEVICE_PATH_PROTOCOL  *DevicePath,
+  IN  CONST CHAR16                    *Path,
+  OUT UINT64                          *Buffer
+  )
+{
+  ACPI_DIR_HINT  *Hint;
+  UINTN          DevicePathSize;
+  UINTN          PathSize;
+
+  DevicePathSize = GetDevicePathSize (DevicePath);
+  PathSize       = StrSize (Path);
+  if (sizeof (*Hint) + DevicePathSize + PathSize > ACPI_DIR_HINT_MAX_SIZE) {
+    return 0;
+  }
+
+  ZeroMem (Buffer, sizeof (*Hint));
+  Hint = (ACPI_DIR_HINT *) Buffer;
+  Hint->Revision       = ACPI_DIR_HINT_REVISION;
+  Hint->DevicePathSize = (UINT16) DevicePathSize;
+  Hint->PathSize       = (UINT16) PathSize;
+  FsGetPartitionGuid (DevicePath, &Hint->PartitionGuid);
+  CopyMem (Hint + 1, DevicePath, DevicePathSize);
+  CopyMem ((UINT8 *) (Hint + 1) + DevicePathSize, Path, PathSize);
+  return sizeof (*Hint) + DevicePathSize + PathSize;
+}
+
+/**
+  Checks whether a volume is the one a hint remembers.
+**/
+STATIC
+BOOLEAN
+AcpiDirHintMatches (
+  IN CONST ACPI_DIR_HINT             *Hint,
+  IN CONST EFI_DEVICE_PATH_PROTOCOL  *DevicePath
+  )
+{
+  EFI_GUID  Partition;
+
+  if (!IsZeroGuid (&Hint->PartitionGuid)) {
+    return FsGetPartitionGuid (DevicePath, &Partition) && CompareGuid (&Partition, &Hint->PartitionGuid);
+  }
+
+  return GetDevicePathSize (DevicePath) == Hint->DevicePathSize &&
+         CompareMem (DevicePath, Hint + 1, Hint->DevicePathSize) == 0;
+}
+
+EFI_STATUS
+AcpiDirHintOpen (
+  OUT DIR_SNAPSHOT  *Snapshot
+  )
+{
+  UINT64                           Buffer[ACPI_DIR_HINT_MAX_SIZE / sizeof (UINT64)];
+  CONST ACPI_DIR_HINT              *Hint;
+  CONST CHAR16                     *Path;
+  EFI_DEVICE_PATH_PROTOCOL         *DevicePath;
+  EFI_SIMPLE_FILE_SYSTEM_PROTOCOL  *FileSystem;
+  EFI_FILE_PROTOCOL                *Root;
+  EFI_FILE_PROTOCOL                *Directory;
+  EFI_HANDLE                       *Handles;
+  EFI_STATUS                       Status;
+  UINTN                            HandleCount;
+  UINTN                            Size;
+  UINTN                            Index;
+
+  ZeroMem (Snapshot, sizeof (*Snapshot));
+
+  Hint = AcpiDirHintRead (Buffer, &Size);
+  if (Hint == NULL) {
+    return EFI_NOT_FOUND;
+  }
+  Path = (CONST CHAR16 *) ((CONST UINT8 *) (Hint + 1) + Hint->DevicePathSize);
+
+  Status = gBS->LocateHandleBuffer (ByProtocol, &gEfiSimpleFileSystemProtocolGuid, NULL, &HandleCount, &Handles);
+  if (EFI_ERROR (Status)) {
+    return EFI_NOT_FOUND;
+  }
+
+  Status = EFI_NOT_FOUND;
+  for (Index = 0; Index < HandleCount; Index++) {
+    DevicePath = DevicePathFromHandle (Handles[Index]);
+    if (DevicePath == NULL || !AcpiDirHintMatches (Hint, DevicePath)) {
+      continue;
+    }
+
+    Status = gBS->HandleProtocol (Handles[Index], &gEfiSimpleFileSystemProtocolGuid, (VOID **) &FileSystem);
+    if (!EFI_ERROR (Status)) {
+      Status = FileSystem->OpenVolume (FileSystem, &Root);
+    }
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    Status = Root->Open (Root, &Directory, (CHAR16 *) Path, EFI_FILE_MODE_READ, 0);
+    Root->Close (Root);
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    Status = DirSnapshotCreate (Directory, Snapshot);
+    if (EFI_ERROR (Status)) {
+      Directory->Close (Directory);
+      break;
+    }
+    Snapshot->OwnsDirectory = TRUE;
+
+    if (Snapshot->AmlCount == 0) {
+      DirSnapshotFree (Snapshot);
+      Status = EFI_NOT_FOUND;
+    }
+    break;
+  }
+
+  FreePool (Handles);
+  if (EFI_ERROR (Status)) {
+    AcpiDebugPrint (DEBUG_VERBOSE, L"ACPI files directory %s from the last boot is not usable: %r\n", Path, Status);
+    ZeroMem (Snapshot, sizeof (*Snapshot));
+    return EFI_NOT_FOUND;
+  }
+
+  AcpiDebugPrint (DEBUG_INFO, L"Using ACPI files directory %s from the last boot, %d .aml files\n",
+                  Path, Snapshot->AmlCount);
+  return EFI_SUCCESS;
+}
+
+VOID
+AcpiDirHintSave (
+  IN EFI_HANDLE    Volume,
+  IN CONST CHAR16  *Path
+  )
+{
+  UINT64                    Wanted[ACPI_DIR_HINT_MAX_SIZE / sizeof (UINT64)];
+  UINT64                    Current[ACPI_DIR_HINT_MAX_SIZE / sizeof (UINT64)];
+  EFI_DEVICE_PATH_PROTOCOL  *DevicePath;
+  EFI_STATUS                Status;
+  UINTN                     WantedSize;
+  UINTN                     CurrentSize;
+
+  DevicePath = DevicePathFromHandle (Volume);
+  if (DevicePath == NULL) {
+    AcpiDebugPrint (DEBUG_VERBOSE, L"Volume of %s has no device path, not remembering it\n", Path);
+    return;
+  }
+
+  WantedSize = AcpiDirHintBuild (DevicePath, Path, Wanted);
+  if (WantedSize == 0) {
+    return;
+  }
+
+  //
+  // NVRAM wears, so the variable is only written when it changes.
+  //
+  if (AcpiDirHintRead (Current, &CurrentSize) != NULL &&
+      CurrentSize == WantedSize && CompareMem (Current, Wanted, WantedSize) == 0) {
+    return;
+  }
+
+  Status = gRT->SetVariable (
+                  ACPI_DIR_HINT_VARIABLE_NAME,
+                  &mAcpiPatcherVariableGuid,
+                  EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS,
+                  WantedSize,
+                  Wanted
+                  );
+  if (EFI_ERROR (Status)) {
+    AcpiDebugPrint (DEBUG_VERBOSE, L"Cannot remember ACPI files directory %s: %r\n", Path, Status);
+  }
+}
@@ -0,0 +1,95 @@
+/** @file
+
+  Remembered ACPI files directory.
+
+  A driver dispatched from firmware has no directory of its own, so it
+  searches every volume for its tables: up to sixteen paths per volume,
+  each hit read in full to compare it with the others.  The directory
+  that search picks is remembered in a non-volatile variable, by the
+  volume's device path and GPT partition GUID and the path on it, and
+  later boots open it directly.  The full search only runs again when the
+  remembered directory is gone or no longer holds any tables.
+
+  A GPT volume is recognised by its partition GUID, which survives the
+  controller or port changes that alter a device path.  Any other volume
+  has to match by its whole device path.
+
+  The variable is only written when the search picks a different
+  directory, so a normal boot does not write NVRAM.  Deleting it forces a
+  full search on the next boot.
+
+**/
+
+#ifndef __ACPI_PATCHER_ACPI_DIR_HINT_H__
+#define __ACPI_PATCHER_ACPI_DIR_HINT_H__
+
+#include <Uefi.h>
+#include <Protocol/SimpleFileSystem.h>
+
+#include "DirSnapshot.h"
+
+#define ACPI_DIR_HINT_VARIABLE_NAME  L"ACPIPatcherAcpiDir"
+
+//
+// Vendor GUID of the patcher's variables.
+//
+#define ACPI_PATCHER_VARIABLE_GUID \
+  { 0x5b0ce6e1, 0x3f0a, 0x4c8e, { 0x9d, 0x61, 0x2a, 0x7e, 0x4b, 0x13, 0xc8, 0x5f } }
+
+#define ACPI_DIR_HINT_REVISION  1
+
+//
+// Largest variable written: the header, a device path and a directory
+// path.  Anything longer is searched for on every boot.
+//
+#define ACPI_DIR_HINT_MAX_SIZE  1024
+
+#pragma pack(1)
+
+//
+// Variable contents.  The volume's device path (DevicePathSize bytes) and
+// the NUL terminated directory path relative to its root (PathSize bytes)
+// follow the header.
+//
+typedef struct {
+  UINT32    Revision;
+  UINT16    DevicePathSize;
+  UINT16    PathSize;
+  //
+  // GPT partition GUID of the volume; all zero if it has none.
+  //
+  EFI_GUID  PartitionGuid;
+} ACPI_DIR_HINT;
+
+#pragma pack()
+
+/**
+  Opens and reads the directory remembered by AcpiDirHintSave().
+
+  @param[out] Snapshot  Receives a snapshot of the directory, which owns
+                        the directory handle.
+
+  @retval EFI_SUCCESS    The directory was found and holds AML files.
+  @retval EFI_NOT_FOUND  Nothing is remembered, the volume or directory is
+                         gone, or it has no AML files any more.
+**/
+EFI_STATUS
+AcpiDirHintOpen (
+  OUT DIR_SNAPSHOT  *Snapshot
+  );
+
+/**
+  Remembers the directory a search chose, unless it is already the one
+  remembered.  Failures are logged and otherwise ignored; the next boot
+  then searches again.
+
+  @param[in] Volume  Handle of the volume holding the directory.
+  @param[in] Path    Path of the directory relative to the volume root.
+**/
+VOID
+AcpiDirHintSave (
+  IN EFI_HANDLE    Volume,
+  IN CONST CHAR16  *Path
+  );
+
+#endif // __ACPI_PATCHER_ACPI_DIR_HINT_H__
@@ -0,0 +1,98 @@
+/** @file
+
+  ACPI tables built into the driver's own firmware file.
+
+  The tables are read once, at entry, each into pool memory by the
+  firmware volume driver, which also undoes any compression section.  They
+  are only copied into the table arena once it has been sized from them.
+
+**/
+
+#include <PiDxe.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DxeServicesLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PrintLib.h>
+#include <IndustryStandard/Acpi.h>
+
+#define ACPI_LOG_FILE_ID  13
+
+#include "AcpiEmbedded.h"
+#include "DebugLog.h"
+#include "TableArena.h"
+
+EFI_STATUS
+AcpiEmbeddedOpen (
+  OUT ACPI_EMBEDDED  *Embedded
+  )
+{
+  EFI_STATUS           Status;
+  ACPI_EMBEDDED_TABLE  *Tables;
+  ACPI_EMBEDDED_TABLE  *Entry;
+  VOID                 *Section;
+  UINTN                Size;
+  UINTN                Capacity;
+
+  ZeroMem (Embedded, sizeof (*Embedded));
+
+  for ( ; ; ) {
+    Section = NULL;
+    Status  = GetSectionFromFv (&gEfiCallerIdGuid, EFI_SECTION_RAW, Embedded->Count, &Section, &Size);
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    if (Embedded->Count == Embedded->Capacity) {
+      Capacity = MAX (Embedded->Capacity * 2, 16);
+      Tables   = ReallocatePool (
+                   Embedded->Capacity * sizeof (*Tables),
+                   Capacity * sizeof (*Tables),
+                   Embedded->Tables
+                   );
+      if (Tables == NULL) {
+        FreePool (Section);
+        AcpiEmbeddedFree (Embedded);
+        return EFI_OUT_OF_RESOURCES;
+      }
+
+      Embedded->Tables   = Tables;
+      Embedded->Capacity = Capacity;
+    }
+
+    Entry        = &Embedded->Tables[Embedded->Count];
+    Entry->Table = Section;
+    Entry->Size  = Size;
+    UnicodeSPrint (Entry->Name, sizeof (Entry->Name), L"FV section %d", Embedded->Count);
+    if (Size >= sizeof (EFI_ACPI_DESCRIPTION_HEADER) && Size <= MAX_UINT32) {
+      Embedded->ArenaSize += TABLE_ARENA_SIZE (Size);
+    }
+
+    Embedded->Count++;
+  }
+
+  if (Embedded->Count == 0) {
+    return EFI_NOT_FOUND;
+  }
+
+  AcpiDebugPrint (DEBUG_INFO, L"%d tables embedded in the driver\n", Embedded->Count);
+  return EFI_SUCCESS;
+}
+
+VOID
+AcpiEmbeddedFree (
+  IN OUT ACPI_EMBEDDED  *Embedded
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < Embedded->Count; Index++) {
+    FreePool (Embedded->Tables[Index].Table);
+  }
+
+  if (Embedded->Tables != NULL) {
+    FreePool (Embedded->Tables);
+  }
+
+  ZeroMem (Embedded, sizeof (*Embedded));
+}
@@ -0,0 +1,76 @@
+/** @file
+
+  ACPI tables built into the driver's own firmware file.
+
+  ACPIPatcher.py --embed puts each table in a RAW section of the
+  ACPIPatcherDxe FFS file, after its PE32 image, in the order they are to
+  be loaded: DSDT.aml, the numbered SSDTs, the descriptively named SSDTs,
+  then any other table, as a directory scan would.  The driver finds them
+  through its own file GUID in the firmware volume it was dispatched from,
+  so it needs no file system and does not wait for one.
+
+  A section holds one table exactly as it is on disk; the firmware
+  volume's own compression, if the FDF asks for it, covers the file.  A
+  DSDT replaces the firmware's, anything else is appended, and an SSDT
+  with the OEM Table ID of a firmware SSDT replaces it, as for a file.
+
+**/
+
+#ifndef __ACPI_PATCHER_ACPI_EMBEDDED_H__
+#define __ACPI_PATCHER_ACPI_EMBEDDED_H__
+
+#include <Uefi.h>
+
+//
+// Characters, with the NUL, of the name a section is logged under.
+//
+#define ACPI_EMBEDDED_NAME_LENGTH  16
+
+typedef struct {
+  //
+  // Copy of the section.
+  //
+  VOID    *Table;
+  UINTN   Size;
+  CHAR16  Name[ACPI_EMBEDDED_NAME_LENGTH];
+} ACPI_EMBEDDED_TABLE;
+
+typedef struct {
+  //
+  // The sections, in section order.
+  //
+  ACPI_EMBEDDED_TABLE  *Tables;
+  UINTN                Count;
+  UINTN                Capacity;
+  //
+  // Total of TABLE_ARENA_SIZE() over the sections that can hold a table.
+  //
+  UINTN                ArenaSize;
+} ACPI_EMBEDDED;
+
+/**
+  Reads the RAW sections of the driver's own FFS file.
+
+  @param[out] Embedded  Receives the sections; release with
+                        AcpiEmbeddedFree().
+
+  @retval EFI_SUCCESS           At least one section was read.
+  @retval EFI_NOT_FOUND         The file has no RAW sections, or the image
+                                was not dispatched from a firmware volume.
+  @retval EFI_OUT_OF_RESOURCES  The sections could not all be kept.
+**/
+EFI_STATUS
+AcpiEmbeddedOpen (
+  OUT ACPI_EMBEDDED  *Embedded
+  );
+
+/**
+  Releases the sections read by AcpiEmbeddedOpen().  Freeing a zeroed or
+  already freed set is allowed.
+**/
+VOID
+AcpiEmbeddedFree (
+  IN OUT ACPI_EMBEDDED  *Embedded
+  );
+
+#endif // __ACPI_PATCHER_ACPI_EMBEDDED_H__
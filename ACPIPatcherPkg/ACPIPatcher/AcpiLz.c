@@ -0,0 +1,151 @@
+/** @file
+
+  LZ4 block decoder for compressed AML files.
+
+  A block is a run of sequences.  Each starts with a token whose high
+  nibble is a literal count and low nibble a match length less four; a
+  nibble of 15 is continued by bytes that are added on until one is not
+  255.  The literals follow, then a 16-bit little-endian offset back into
+  the output and the match is copied from there.  The last sequence has
+  literals only.
+
+**/
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <IndustryStandard/Acpi.h>
+
+#include "AcpiLz.h"
+
+/**
+  Reads the bytes that continue a 15 in a token nibble and adds them to
+  *Count.  Fails if the input runs out or the count outgrows Limit.
+**/
+STATIC
+BOOLEAN
+AcpiLzExtend (
+  IN OUT CONST UINT8  **In,
+  IN     CONST UINT8  *InEnd,
+  IN OUT UINTN        *Count,
+  IN     UINTN        Limit
+  )
+{
+  UINT8  Byte;
+
+  do {
+    if (*In == InEnd) {
+      return FALSE;
+    }
+
+    Byte    = *(*In)++;
+    *Count += Byte;
+    if (*Count > Limit) {
+      return FALSE;
+    }
+  } while (Byte == 255);
+
+  return TRUE;
+}
+
+EFI_STATUS
+AcpiLzDecodedLength (
+  IN  CONST VOID  *Buffer,
+  IN  UINTN       Size,
+  OUT UINTN       *Length
+  )
+{
+  CONST ACPI_LZ_HEADER  *Header;
+
+  Header = Buffer;
+  if (Size < sizeof (*Header) || Header->Signature != ACPI_LZ_SIGNATURE ||
+      Header->Length < sizeof (EFI_ACPI_DESCRIPTION_HEADER) ||
+      Header->Length > MultU64x32 (Size, ACPI_LZ_MAX_RATIO)) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  *Length = Header->Length;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+AcpiLzDecode (
+  IN  CONST VOID  *Buffer,
+  IN  UINTN       Size,
+  OUT VOID        *Destination,
+  IN  UINTN       Length
+  )
+{
+  CONST UINT8  *In;
+  CONST UINT8  *InEnd;
+  UINT8        *Out;
+  UINT8        *OutEnd;
+  CONST UINT8  *Match;
+  UINTN        Count;
+  UINTN        Offset;
+  UINT8        Token;
+
+  In     = (CONST UINT8 *) Buffer + sizeof (ACPI_LZ_HEADER);
+  InEnd  = (CONST UINT8 *) Buffer + Size;
+  Out    = Destination;
+  OutEnd = Out + Length;
+
+  while (Out < OutEnd) {
+    if (In == InEnd) {
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    Token = *In++;
+    Count = Token >> 4;
+    if (Count == 15 && !AcpiLzExtend (&In, InEnd, &Count, Length)) {
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    if (Count > (UINTN) (InEnd - In) || Count > (UINTN) (OutEnd - Out)) {
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    CopyMem (Out, In, Count);
+    In  += Count;
+    Out += Count;
+    if (Out == OutEnd) {
+      break;
+    }
+
+    if (InEnd - In < 2) {
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    Offset = In[0] | ((UINTN) In[1] << 8);
+    In    += 2;
+    if (Offset == 0 || Offset > (UINTN) (Out - (UINT8 *) Destination)) {
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    Count = Token & 0x0F;
+    if (Count == 15 && !AcpiLzExtend (&In, InEnd, &Count, Length)) {
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    Count += 4;
+    if (Count > (UINTN) (OutEnd - Out)) {
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    //
+    // A match that overlaps its own output repeats the last Offset bytes,
+    // so it has to be copied forwards a byte at a time.
+    //
+    Match = Out - Offset;
+    if (Offset >= Count) {
+      CopyMem (Out, Match, Count);
+      Out += Count;
+    } else {
+      while (Count-- > 0) {
+        *Out++ = *Match++;
+      }
+    }
+  }
+
+  return EFI_SUCCESS;
+}
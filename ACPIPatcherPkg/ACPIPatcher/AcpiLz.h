@@ -0,0 +1,84 @@
+/** @file
+
+  Compressed AML files.
+
+  A table shipped as <name>.aml.lz is an ACPI_LZ_HEADER followed by the
+  table as one LZ4 block (the raw block format, without the LZ4 frame).
+  AML is mostly repeated opcodes and names and typically packs to a third
+  or a quarter of its size, so a slow device reads that much less, and
+  LZ4 decodes far faster than any such device delivers the bytes saved.
+
+  The patcher sizes its table arena before it reads anything, from the
+  file sizes in the directory listing.  A packed file is therefore never
+  allowed to expand by more than ACPI_LZ_MAX_RATIO: Tools/AcpiCompress.py
+  pads any block that would with zeros, which the decoder ignores, and
+  the patcher turns away a header that claims more.
+
+  Decoding is bounds checked against both buffers, so a damaged file
+  fails with EFI_VOLUME_CORRUPTED rather than writing outside the table.
+
+**/
+
+#ifndef __ACPI_PATCHER_ACPI_LZ_H__
+#define __ACPI_PATCHER_ACPI_LZ_H__
+
+#include <Uefi.h>
+
+#define ACPI_LZ_SIGNATURE  SIGNATURE_32 ('A', 'L', 'Z', '1')
+
+//
+// Largest decoded size a packed file may claim, as a multiple of the
+// file's own size.
+//
+#define ACPI_LZ_MAX_RATIO  8
+
+#pragma pack(1)
+
+typedef struct {
+  UINT32  Signature;      ///< ACPI_LZ_SIGNATURE
+  UINT32  Length;         ///< Decoded size: the table's own Length
+} ACPI_LZ_HEADER;
+
+#pragma pack()
+
+/**
+  Checks the header of a packed file and returns the size it decodes to.
+
+  @param[in]  Buffer    Start of the file.
+  @param[in]  Size      Size of the file.
+  @param[out] Length    Receives the decoded size.
+
+  @retval EFI_SUCCESS           The header is valid.
+  @retval EFI_VOLUME_CORRUPTED  The signature is wrong, or the decoded
+                                size is smaller than an ACPI header or
+                                larger than ACPI_LZ_MAX_RATIO allows.
+**/
+EFI_STATUS
+AcpiLzDecodedLength (
+  IN  CONST VOID  *Buffer,
+  IN  UINTN       Size,
+  OUT UINTN       *Length
+  );
+
+/**
+  Decodes a packed file into a buffer of exactly its decoded size.
+  Anything after the last sequence that fills Destination is ignored.
+
+  @param[in]  Buffer       Start of the file, header included.
+  @param[in]  Size         Size of the file.
+  @param[out] Destination  Receives the table.
+  @param[in]  Length       Size from AcpiLzDecodedLength().
+
+  @retval EFI_SUCCESS           Destination holds all Length bytes.
+  @retval EFI_VOLUME_CORRUPTED  The block is malformed, refers outside the
+                                output, or ends before Length bytes.
+**/
+EFI_STATUS
+AcpiLzDecode (
+  IN  CONST VOID  *Buffer,
+  IN  UINTN       Size,
+  OUT VOID        *Destination,
+  IN  UINTN       Length
+  );
+
+#endif // __ACPI_PATCHER_ACPI_LZ_H__
@@ -0,0 +1,484 @@
+/** @file
+
+  ACPIPatcher.cfg manifest.
+
+  Without a manifest every run reads the whole ACPI directory and sorts
+  what it finds into DSDT, numbered SSDT, named SSDT and other AML by
+  name.  On media whose contents are fixed that is wasted work: the
+  manifest already says which files to load and in what order, so the
+  patcher opens the manifest and then exactly the files it names.
+
+  The listed files are handed out as a DIR_SNAPSHOT so the usual loader
+  can open them, but the snapshot is built from the manifest rather than
+  from a Read() of the directory.
+
+**/
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#include <Guid/FileInfo.h>
+
+#define ACPI_LOG_FILE_ID  9
+
+#include "AcpiManifest.h"
+#include "DebugLog.h"
+#include "FsHelpers.h"
+
+//
+// Action, target and at most two options.
+//
+#define ACPI_MANIFEST_MAX_TOKENS  4
+
+//
+// Longest file name FAT allows.
+//
+#define ACPI_MANIFEST_MAX_NAME  255
+
+/**
+  Case-insensitive match of a token against a lower case keyword.
+**/
+STATIC
+BOOLEAN
+AcpiManifestIsKeyword (
+  IN CONST CHAR8  *Token,
+  IN CONST CHAR8  *Keyword
+  )
+{
+  CHAR8  Char;
+
+  for ( ; *Keyword != '\0'; Token++, Keyword++) {
+    Char = *Token;
+    if (Char >= 'A' && Char <= 'Z') {
+      Char += 'a' - 'A';
+    }
+    if (Char != *Keyword) {
+      return FALSE;
+    }
+  }
+
+  return (BOOLEAN) (*Token == '\0');
+}
+
+/**
+  Parses a decimal size of at most 32 bits or a hexadecimal hash of at
+  most 64.  Unlike AsciiStrDecimalToUintn() a stray character is an error
+  rather than the end of the number.
+**/
+STATIC
+BOOLEAN
+AcpiManifestParseNumber (
+  IN  CONST CHAR8  *Text,
+  IN  BOOLEAN      Hex,
+  OUT UINT64       *Value
+  )
+{
+  UINT64  Result;
+  UINTN   Digit;
+  UINTN   Digits;
+
+  if (Hex && Text[0] == '0' && (Text[1] == 'x' || Text[1] == 'X')) {
+    Text += 2;
+  }
+  if (*Text == '\0') {
+    return FALSE;
+  }
+
+  Result = 0;
+  for (Digits = 0; Text[Digits] != '\0'; Digits++) {
+    if (Text[Digits] >= '0' && Text[Digits] <= '9') {
+      Digit = Text[Digits] - '0';
+    } else if (Hex && Text[Digits] >= 'a' && Text[Digits] <= 'f') {
+      Digit = Text[Digits] - 'a' + 10;
+    } else if (Hex && Text[Digits] >= 'A' && Text[Digits] <= 'F') {
+      Digit = Text[Digits] - 'A' + 10;
+    } else {
+      return FALSE;
+    }
+
+    if (Hex) {
+      Result = LShiftU64 (Result, 4) | Digit;
+    } else {
+      Result = MultU64x32 (Result, 10) + Digit;
+      if (Result > MAX_UINT32) {
+        return FALSE;
+      }
+    }
+  }
+
+  if (Hex && Digits > 16) {
+    return FALSE;
+  }
+
+  *Value = Result;
+  return TRUE;
+}
+
+/**
+  Splits a line into whitespace separated tokens in place.
+
+  @return The number of tokens, or ACPI_MANIFEST_MAX_TOKENS + 1 if there
+          are too many.
+**/
+STATIC
+UINTN
+AcpiManifestSplit (
+  IN OUT CHAR8  *Line,
+  OUT    CHAR8  *Tokens[ACPI_MANIFEST_MAX_TOKENS]
+  )
+{
+  UINTN  Count;
+
+  Count = 0;
+  for (;;) {
+    while (*Line == ' ' || *Line == '\t' || *Line == '\r') {
+      *Line++ = '\0';
+    }
+    if (*Line == '\0') {
+      return Count;
+    }
+    if (Count == ACPI_MANIFEST_MAX_TOKENS) {
+      return Count + 1;
+    }
+
+    Tokens[Count++] = Line;
+    while (*Line != '\0' && *Line != ' ' && *Line != '\t' && *Line != '\r') {
+      Line++;
+    }
+  }
+}
+
+/**
+  Copies an ASCII token into the name pool as a CHAR16 string.
+
+  @return The copy.
+**/
+STATIC
+CHAR16 *
+AcpiManifestCopyName (
+  IN OUT CHAR16       **NextName,
+  IN     CONST CHAR8  *Token
+  )
+{
+  CHAR16  *Name;
+
+  Name = *NextName;
+  do {
+    *(*NextName)++ = (CHAR16) (UINT8) *Token;
+  } while (*Token++ != '\0');
+
+  return Name;
+}
+
+/**
+  Finds the size of a listed file that has no size= option, with one
+  Open() and GetInfo().
+**/
+STATIC
+EFI_STATUS
+AcpiManifestFileSize (
+  IN  EFI_FILE_PROTOCOL  *Directory,
+  IN  CHAR16             *Name,
+  OUT UINT64             *FileSize
+  )
+{
+  EFI_FILE_PROTOCOL  *File;
+  EFI_STATUS         Status;
+  UINTN              InfoSize;
+  //
+  // Room for the longest name FAT allows, so one GetInfo() is enough.
+  //
+  UINT64             Info[(SIZE_OF_EFI_FILE_INFO + (ACPI_MANIFEST_MAX_NAME + 1) * sizeof (CHAR16) + 7) / 8];
+
+  Status = FsOpenFile (Directory, Name, &File);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  InfoSize = sizeof (Info);
+  Status   = File->GetInfo (File, &gEfiFileInfoGuid, &InfoSize, Info);
+  File->Close (File);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  *FileSize = ((EFI_FILE_INFO *) Info)->FileSize;
+  return EFI_SUCCESS;
+}
+
+/**
+  Opens the manifest, preferring the ACPI subdirectory as the directory
+  snapshot does.
+
+  @param[in]  Directory      Directory the patcher was started with.
+  @param[out] TablesDir      Receives the directory the manifest is in.
+  @param[out] OwnsTablesDir  Receives TRUE if TablesDir was opened here.
+  @param[out] File           Receives the open manifest.
+**/
+STATIC
+EFI_STATUS
+AcpiManifestOpen (
+  IN  EFI_FILE_PROTOCOL  *Directory,
+  OUT EFI_FILE_PROTOCOL  **TablesDir,
+  OUT BOOLEAN            *OwnsTablesDir,
+  OUT EFI_FILE_PROTOCOL  **File
+  )
+{
+  EFI_FILE_PROTOCOL  *AcpiDir;
+  EFI_STATUS         Status;
+
+  if (!EFI_ERROR (FsOpenFile (Directory, L"ACPI", &AcpiDir))) {
+    if (!EFI_ERROR (FsOpenFile (AcpiDir, ACPI_MANIFEST_FILE_NAME, File))) {
+      *TablesDir     = AcpiDir;
+      *OwnsTablesDir = TRUE;
+      return EFI_SUCCESS;
+    }
+    AcpiDir->Close (AcpiDir);
+  }
+
+  Status = FsOpenFile (Directory, ACPI_MANIFEST_FILE_NAME, File);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  *TablesDir     = Directory;
+  *OwnsTablesDir = FALSE;
+  return EFI_SUCCESS;
+}
+
+/**
+  Parses one line into Manifest.  The line has been cut at its end and at
+  any comment.
+
+  @retval TRUE   The line was empty or added an entry.
+  @retval FALSE  The line is malformed; the reason has been logged.
+**/
+STATIC
+BOOLEAN
+AcpiManifestParseLine (
+  IN OUT ACPI_MANIFEST  *Manifest,
+  IN OUT CHAR8          *Line,
+  IN     UINTN          LineNumber,
+  IN OUT CHAR16         **NextName
+  )
+{
+  CHAR8                *Tokens[ACPI_MANIFEST_MAX_TOKENS];
+  UINTN                TokenCount;
+  UINTN                Index;
+  UINT64               Size;
+  BOOLEAN              HasSize;
+  ACPI_MANIFEST_ENTRY  *Entry;
+  DIR_SNAPSHOT_ENTRY   *File;
+  EFI_STATUS           Status;
+
+  TokenCount = AcpiManifestSplit (Line, Tokens);
+  if (TokenCount == 0) {
+    return TRUE;
+  }
+  if (TokenCount == 1 || TokenCount > ACPI_MANIFEST_MAX_TOKENS) {
+    AcpiDebugPrint (DEBUG_WARN, L"%s line %d: expected an action, a target and at most two options\n",
+                    ACPI_MANIFEST_FILE_NAME, LineNumber);
+    return FALSE;
+  }
+
+  Entry = &Manifest->Entries[Manifest->Count];
+  ZeroMem (Entry, sizeof (*Entry));
+  Entry->Line = LineNumber;
+
+  if (AcpiManifestIsKeyword (Tokens[0], "replace")) {
+    Entry->Kind = XsdtOpReplace;
+  } else if (AcpiManifestIsKeyword (Tokens[0], "append")) {
+    Entry->Kind = XsdtOpAppend;
+  } else if (AcpiManifestIsKeyword (Tokens[0], "drop")) {
+    Entry->Kind = XsdtOpDrop;
+  } else {
+    AcpiDebugPrint (DEBUG_WARN, L"%s line %d: unknown action '%a'\n",
+                    ACPI_MANIFEST_FILE_NAME, LineNumber, Tokens[0]);
+    return FALSE;
+  }
+
+  if (Entry->Kind == XsdtOpDrop) {
+    if (TokenCount != 2 || AsciiStrLen (Tokens[1]) != 4) {
+      AcpiDebugPrint (DEBUG_WARN, L"%s line %d: drop takes a four character signature only\n",
+                      ACPI_MANIFEST_FILE_NAME, LineNumber);
+      return FALSE;
+    }
+    Entry->Signature = SIGNATURE_32 (Tokens[1][0], Tokens[1][1], Tokens[1][2], Tokens[1][3]);
+    Entry->Name      = AcpiManifestCopyName (NextName, Tokens[1]);
+    Manifest->Count++;
+    return TRUE;
+  }
+
+  HasSize = FALSE;
+  Size    = 0;
+  for (Index = 2; Index < TokenCount; Index++) {
+    if (AsciiStrnCmp (Tokens[Index], "size=", 5) == 0 &&
+        AcpiManifestParseNumber (Tokens[Index] + 5, FALSE, &Size)) {
+      HasSize = TRUE;
+    } else if (AsciiStrnCmp (Tokens[Index], "hash=", 5) == 0 &&
+               AcpiManifestParseNumber (Tokens[Index] + 5, TRUE, &Entry->Hash)) {
+      Entry->HasHash = TRUE;
+    } else {
+      AcpiDebugPrint (DEBUG_WARN, L"%s line %d: bad option '%a'\n",
+                      ACPI_MANIFEST_FILE_NAME, LineNumber, Tokens[Index]);
+      return FALSE;
+    }
+  }
+
+  if (AsciiStrLen (Tokens[1]) > ACPI_MANIFEST_MAX_NAME) {
+    AcpiDebugPrint (DEBUG_WARN, L"%s line %d: file name too long\n", ACPI_MANIFEST_FILE_NAME, LineNumber);
+    return FALSE;
+  }
+
+  File = &Manifest->Snapshot.Entries[Manifest->Snapshot.Count];
+  ZeroMem (File, sizeof (*File));
+  File->Name       = AcpiManifestCopyName (NextName, Tokens[1]);
+  File->Kind       = DirEntryAml;
+  File->Compressed = DirSnapshotIsCompressedName (File->Name);
+
+  if (HasSize) {
+    File->FileSize = Size;
+  } else {
+    Status = AcpiManifestFileSize (Manifest->Snapshot.Directory, (CHAR16 *) File->Name, &File->FileSize);
+    if (EFI_ERROR (Status)) {
+      AcpiDebugPrint (DEBUG_WARN, L"%s line %d: cannot open %s: %r\n",
+                      ACPI_MANIFEST_FILE_NAME, LineNumber, File->Name, Status);
+      return FALSE;
+    }
+  }
+
+  Entry->Name = File->Name;
+  Entry->File = File;
+  Manifest->Snapshot.Count++;
+  Manifest->Snapshot.AmlCount++;
+  Manifest->Count++;
+  return TRUE;
+}
+
+EFI_STATUS
+AcpiManifestLoad (
+  IN  EFI_FILE_PROTOCOL  *Directory,
+  OUT ACPI_MANIFEST      *Manifest
+  )
+{
+  EFI_FILE_PROTOCOL  *File;
+  EFI_STATUS         Status;
+  CHAR8              *Text;
+  CHAR8              *Line;
+  CHAR8              *Cursor;
+  CHAR16             *NextName;
+  UINTN              Length;
+  UINTN              Lines;
+  UINTN              LineNumber;
+  UINTN              Skipped;
+
+  ZeroMem (Manifest, sizeof (*Manifest));
+
+  Status = AcpiManifestOpen (
+             Directory,
+             &Manifest->Snapshot.Directory,
+             &Manifest->Snapshot.OwnsDirectory,
+             &File
+             );
+  if (EFI_ERROR (Status)) {
+    return EFI_NOT_FOUND;
+  }
+
+  //
+  // One Read() of up to the maximum size; a manifest that fills the
+  // buffer may have been cut short, so it is refused.
+  //
+  Text = AllocatePool (ACPI_MANIFEST_MAX_SIZE + 1);
+  if (Text == NULL) {
+    File->Close (File);
+    AcpiManifestFree (Manifest);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Length = ACPI_MANIFEST_MAX_SIZE;
+  Status = File->Read (File, &Length, Text);
+  File->Close (File);
+  if (!EFI_ERROR (Status) && Length == ACPI_MANIFEST_MAX_SIZE) {
+    Status = EFI_BAD_BUFFER_SIZE;
+  }
+  if (EFI_ERROR (Status)) {
+    FreePool (Text);
+    AcpiManifestFree (Manifest);
+    return Status;
+  }
+  Text[Length] = '\0';
+
+  //
+  // Every line holds at most one entry and one name, and no name is
+  // longer than its line, so the line count bounds every allocation.
+  //
+  Lines = 1;
+  for (Cursor = Text; *Cursor != '\0'; Cursor++) {
+    if (*Cursor == '\n') {
+      Lines++;
+    }
+  }
+
+  Manifest->Entries          = AllocatePool (Lines * sizeof (ACPI_MANIFEST_ENTRY));
+  Manifest->Snapshot.Entries = AllocatePool (Lines * sizeof (DIR_SNAPSHOT_ENTRY));
+  Manifest->Snapshot.Names   = AllocatePool ((Length + Lines) * sizeof (CHAR16));
+  if (Manifest->Entries == NULL || Manifest->Snapshot.Entries == NULL || Manifest->Snapshot.Names == NULL) {
+    FreePool (Text);
+    AcpiManifestFree (Manifest);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  NextName = Manifest->Snapshot.Names;
+  Skipped  = 0;
+  Cursor   = Text;
+  //
+  // A UTF-8 byte order mark from a Windows editor is not part of the text.
+  //
+  if ((UINT8) Cursor[0] == 0xEF && (UINT8) Cursor[1] == 0xBB && (UINT8) Cursor[2] == 0xBF) {
+    Cursor += 3;
+  }
+
+  for (LineNumber = 1; *Cursor != '\0'; LineNumber++) {
+    Line = Cursor;
+    while (*Cursor != '\0' && *Cursor != '\n') {
+      if (*Cursor == '#') {
+        *Cursor = '\0';
+        Cursor++;
+        while (*Cursor != '\0' && *Cursor != '\n') {
+          Cursor++;
+        }
+        break;
+      }
+      Cursor++;
+    }
+    if (*Cursor == '\n') {
+      *Cursor++ = '\0';
+    }
+
+    if (!AcpiManifestParseLine (Manifest, Line, LineNumber, &NextName)) {
+      Skipped++;
+    }
+  }
+
+  FreePool (Text);
+
+  AcpiDebugPrint (DEBUG_INFO, L"Using %s%s: %d entries, %d lines skipped\n",
+                  Manifest->Snapshot.OwnsDirectory ? L"ACPI\\" : L"",
+                  ACPI_MANIFEST_FILE_NAME, Manifest->Count, Skipped);
+  return EFI_SUCCESS;
+}
+
+VOID
+AcpiManifestFree (
+  IN OUT ACPI_MANIFEST  *Manifest
+  )
+{
+  if (Manifest->Entries != NULL) {
+    FreePool (Manifest->Entries);
+  }
+
+  DirSnapshotFree (&Manifest->Snapshot);
+  ZeroMem (Manifest, sizeof (*Manifest));
+}
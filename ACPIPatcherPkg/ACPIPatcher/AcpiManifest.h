@@ -0,0 +1,113 @@
+/** @file
+
+  ACPIPatcher.cfg manifest.
+
+  A manifest lists the tables to load, in load order, with what to do with
+  each.  When one sits next to the tables the patcher opens exactly the
+  files it names: the directory is never enumerated and no file name is
+  matched against the SSDT-*.aml patterns.
+
+  The manifest is ASCII text, one table per line:
+
+    # action   file or signature   [size=<bytes>]  [hash=<hex>]
+    replace    DSDT.aml            size=142336
+    append     SSDT-EC.aml         size=1208 hash=5F0E3D2A91C47B60
+    replace    SSDT-CPU.aml
+    drop       DMAR
+
+  replace and append take a file name relative to the manifest.  drop
+  takes a four character table signature and removes every firmware table
+  with it.  size= is the number of bytes read and must equal the Length
+  in the table header; for a file over ACPI_HEADER_PROBE_SIZE the header
+  is read and checked before the body.  hash= is checked against
+  XsdtPlanHash() of the table once it is loaded.  A table that fails
+  either check is not installed.  Everything after a
+  '#' is a comment.  Tools/AcpiManifest.py writes a manifest for a
+  directory of tables.
+
+**/
+
+#ifndef __ACPI_PATCHER_ACPI_MANIFEST_H__
+#define __ACPI_PATCHER_ACPI_MANIFEST_H__
+
+#include <Uefi.h>
+#include <Protocol/SimpleFileSystem.h>
+
+#include "DirSnapshot.h"
+#include "XsdtPlan.h"
+
+#define ACPI_MANIFEST_FILE_NAME  L"ACPIPatcher.cfg"
+
+//
+// Largest manifest read; anything longer is rejected.
+//
+#define ACPI_MANIFEST_MAX_SIZE  SIZE_64KB
+
+typedef struct {
+  XSDT_OP_KIND        Kind;
+  //
+  // Table signature, for XsdtOpDrop.
+  //
+  UINT32              Signature;
+  //
+  // File to load, in the manifest's snapshot; NULL for XsdtOpDrop.
+  //
+  DIR_SNAPSHOT_ENTRY  *File;
+  //
+  // The file name, or the signature of a drop, for the log.
+  //
+  CONST CHAR16        *Name;
+  BOOLEAN             HasHash;
+  UINT64              Hash;
+  //
+  // Line of the manifest the entry came from, for the log.
+  //
+  UINTN               Line;
+} ACPI_MANIFEST_ENTRY;
+
+typedef struct {
+  //
+  // The files the manifest lists, as a snapshot of the directory it was
+  // found in.  The snapshot is not indexed: it is only ever walked through
+  // the manifest entries, never searched by name.
+  //
+  DIR_SNAPSHOT         Snapshot;
+  ACPI_MANIFEST_ENTRY  *Entries;
+  UINTN                Count;
+} ACPI_MANIFEST;
+
+/**
+  Looks for ACPI\ACPIPatcher.cfg, then ACPIPatcher.cfg, under Directory
+  and parses the first one found.
+
+  Lines that cannot be parsed are logged and skipped.  A file listed
+  without size= is opened once here to find its size.
+
+  @param[in]  Directory  Directory the patcher was started with.  It is
+                         not closed.
+  @param[out] Manifest   Receives the manifest; release with
+                         AcpiManifestFree().
+
+  @retval EFI_SUCCESS           The manifest was loaded.
+  @retval EFI_NOT_FOUND         There is no manifest.
+  @retval EFI_BAD_BUFFER_SIZE   The manifest is larger than
+                                ACPI_MANIFEST_MAX_SIZE.
+  @retval EFI_OUT_OF_RESOURCES  Memory allocation failed.
+  @retval Other                 Reading the manifest failed.
+**/
+EFI_STATUS
+AcpiManifestLoad (
+  IN  EFI_FILE_PROTOCOL  *Directory,
+  OUT ACPI_MANIFEST      *Manifest
+  );
+
+/**
+  Releases a manifest and its snapshot.  Freeing a zeroed or already freed
+  manifest is allowed.
+**/
+VOID
+AcpiManifestFree (
+  IN OUT ACPI_MANIFEST  *Manifest
+  );
+
+#endif // __ACPI_PATCHER_ACPI_MANIFEST_H__
@@ -0,0 +1,463 @@
+/** @file
+
+  Deferred-format binary log for ACPIPatcher.
+
+  With ACPI_PATCHER_BINARY_LOG defined, AcpiDebugPrint() and DXE_DEBUG() do
+  not run UnicodeVSPrint() on the boot path.  The format string is only
+  scanned to pull the arguments off the stack with the right widths, and the
+  record (message ID, TSC timestamp, raw arguments) is copied into a
+  lock-free ring.  The ring is drained over SerialPortLib when it is half
+  full and at the end of a run; Tools/AcpiBinLog.py turns the capture back
+  into text using a catalog generated from these sources.
+
+  Writers reserve space by advancing mBinLogWrite with
+  InterlockedCompareExchange32(), fill the record and publish it by storing
+  its magic last.  The single drainer only consumes records whose magic is
+  set, and zeroes every record it has sent before releasing the space, so a
+  record interrupted by a higher-TPL writer is never sent half written.
+
+**/
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/SerialPortLib.h>
+#include <Library/SynchronizationLib.h>
+
+#define ACPI_LOG_FILE_ID  4
+
+#include "DebugLog.h"
+
+#ifdef ACPI_PATCHER_BINARY_LOG
+
+#define BINLOG_RING_MASK  (ACPI_BINLOG_RING_SIZE - 1)
+
+STATIC UINT8            mBinLogRing[ACPI_BINLOG_RING_SIZE];
+STATIC volatile UINT32  mBinLogWrite       = 0;
+STATIC volatile UINT32  mBinLogRead        = 0;
+STATIC volatile UINT32  mBinLogDropped     = 0;
+STATIC volatile UINT32  mBinLogDraining    = 0;
+STATIC BOOLEAN          mBinLogSerialReady = FALSE;
+
+/**
+  Appends an integer argument to a record payload.
+
+  @param[in, out] Cursor  Write position, advanced past the item.
+  @param[in]      End     End of the payload buffer.
+  @param[in]      Value   Value to store.
+**/
+STATIC
+VOID
+BinLogPutInteger (
+  IN OUT UINT8  **Cursor,
+  IN     UINT8  *End,
+  IN     UINT64 Value
+  )
+{
+  if (*Cursor + sizeof (UINT64) <= End) {
+    WriteUnaligned64 ((UINT64 *) *Cursor, Value);
+    *Cursor += sizeof (UINT64);
+  }
+}
+
+/**
+  Appends a string argument to a record payload as a length byte followed
+  by ASCII characters.  Long strings are truncated to what fits.
+
+  @param[in, out] Cursor  Write position, advanced past the item.
+  @param[in]      End     End of the payload buffer.
+  @param[in]      String  CHAR8 or CHAR16 string, may be NULL.
+  @param[in]      Wide    TRUE if String is CHAR16.
+**/
+STATIC
+VOID
+BinLogPutString (
+  IN OUT UINT8       **Cursor,
+  IN     UINT8       *End,
+  IN     CONST VOID  *String,
+  IN     BOOLEAN     Wide
+  )
+{
+  UINT8  *Length;
+  UINTN  Index;
+  CHAR16 Char;
+
+  if (*Cursor >= End) {
+    return;
+  }
+
+  Length  = (*Cursor)++;
+  *Length = 0;
+  for (Index = 0; String != NULL && *Length < MAX_UINT8 && *Cursor < End; Index++) {
+    Char = Wide ? ((CONST CHAR16 *) String)[Index] : (CHAR16) ((CONST CHAR8 *) String)[Index];
+    if (Char == 0) {
+      break;
+    }
+    *(*Cursor)++ = (UINT8) Char;
+    (*Length)++;
+  }
+}
+
+/**
+  Walks an EDK2 PrintLib format string and copies each argument into the
+  payload with the width PrintLib itself would use.
+
+  @param[out] Payload  Buffer receiving the encoded arguments.
+  @param[in]  Size     Size of Payload in bytes.
+  @param[in]  Format   Format string.
+  @param[in]  Args     Arguments for the format string.
+
+  @return Number of bytes used in Payload.
+**/
+STATIC
+UINTN
+BinLogEncodeArguments (
+  OUT UINT8         *Payload,
+  IN  UINTN         Size,
+  IN  CONST CHAR16  *Format,
+  IN  VA_LIST       Args
+  )
+{
+  UINT8     *Cursor;
+  UINT8     *End;
+  BOOLEAN   Long;
+  EFI_GUID  *Guid;
+
+  Cursor = Payload;
+  End    = Payload + Size;
+
+  for ( ; *Format != L'\0'; Format++) {
+    if (*Format != L'%') {
+      continue;
+    }
+
+    Long = FALSE;
+    for (Format++; *Format != L'\0'; Format++) {
+      if (*Format == L'*') {
+        BinLogPutInteger (&Cursor, End, VA_ARG (Args, UINTN));
+      } else if (*Format == L'l' || *Format == L'L') {
+        Long = TRUE;
+      } else if ((*Format < L'0' || *Format > L'9') &&
+                 *Format != L'-' && *Format != L'+' && *Format != L' ' &&
+                 *Format != L',' && *Format != L'.') {
+        break;
+      }
+    }
+
+    switch (*Format) {
+      case L'd':
+      case L'i':
+        BinLogPutInteger (&Cursor, End, Long ? (UINT64) VA_ARG (Args, INT64) : (UINT64) (INT64) VA_ARG (Args, INT32));
+        break;
+
+      case L'u':
+      case L'x':
+      case L'X':
+        BinLogPutInteger (&Cursor, End, Long ? VA_ARG (Args, UINT64) : (UINT64) VA_ARG (Args, UINT32));
+        break;
+
+      case L'p':
+        BinLogPutInteger (&Cursor, End, (UINT64) (UINTN) VA_ARG (Args, VOID *));
+        break;
+
+      case L'c':
+      case L'r':
+        BinLogPutInteger (&Cursor, End, (UINT64) VA_ARG (Args, UINTN));
+        break;
+
+      case L'a':
+        BinLogPutString (&Cursor, End, VA_ARG (Args, CHAR8 *), FALSE);
+        break;
+
+      case L's':
+      case L'S':
+        BinLogPutString (&Cursor, End, VA_ARG (Args, CHAR16 *), TRUE);
+        break;
+
+      case L'g':
+        Guid = VA_ARG (Args, EFI_GUID *);
+        if (Cursor + sizeof (EFI_GUID) <= End) {
+          if (Guid != NULL) {
+            CopyMem (Cursor, Guid, sizeof (EFI_GUID));
+          } else {
+            ZeroMem (Cursor, sizeof (EFI_GUID));
+          }
+          Cursor += sizeof (EFI_GUID);
+        }
+        break;
+
+      case L'\0':
+        return (UINTN) (Cursor - Payload);
+
+      default:
+        //
+        // %% and unknown conversions take no argument.
+        //
+        break;
+    }
+  }
+
+  return (UINTN) (Cursor - Payload);
+}
+
+/**
+  Copies Length bytes into the ring at the free-running position Position.
+
+  @param[in]  Position  Ring position (not masked).
+  @param[in]  Buffer    Bytes to copy.
+  @param[in]  Length    Number of bytes.
+**/
+STATIC
+VOID
+BinLogCopyIn (
+  IN UINT32       Position,
+  IN CONST UINT8  *Buffer,
+  IN UINTN        Length
+  )
+{
+  UINTN  Offset;
+  UINTN  Chunk;
+
+  Offset = Position & BINLOG_RING_MASK;
+  Chunk  = MIN (Length, ACPI_BINLOG_RING_SIZE - Offset);
+  CopyMem (&mBinLogRing[Offset], Buffer, Chunk);
+  CopyMem (mBinLogRing, Buffer + Chunk, Length - Chunk);
+}
+
+/**
+  Writes Length bytes starting at the free-running ring position Position
+  to the serial port.
+
+  @param[in]  Position  Ring position (not masked).
+  @param[in]  Length    Number of bytes.
+**/
+STATIC
+VOID
+BinLogWriteOut (
+  IN UINT32  Position,
+  IN UINTN   Length
+  )
+{
+  UINTN  Offset;
+  UINTN  Chunk;
+
+  Offset = Position & BINLOG_RING_MASK;
+  Chunk  = MIN (Length, ACPI_BINLOG_RING_SIZE - Offset);
+  SerialPortWrite (&mBinLogRing[Offset], Chunk);
+  if (Length > Chunk) {
+    SerialPortWrite (mBinLogRing, Length - Chunk);
+  }
+}
+
+/**
+  Zeroes Length bytes of the ring starting at the free-running position
+  Position.
+
+  @param[in]  Position  Ring position (not masked).
+  @param[in]  Length    Number of bytes.
+**/
+STATIC
+VOID
+BinLogClear (
+  IN UINT32  Position,
+  IN UINTN   Length
+  )
+{
+  UINTN  Offset;
+  UINTN  Chunk;
+
+  Offset = Position & BINLOG_RING_MASK;
+  Chunk  = MIN (Length, ACPI_BINLOG_RING_SIZE - Offset);
+  ZeroMem (&mBinLogRing[Offset], Chunk);
+  ZeroMem (mBinLogRing, Length - Chunk);
+}
+
+/**
+  Writes the burst header that lets the decoder find binary records in a
+  serial capture shared with other firmware output.
+**/
+STATIC
+VOID
+BinLogStartBurst (
+  VOID
+  )
+{
+  UINT8  Burst[12];
+
+  CopyMem (Burst, ACPI_BINLOG_SIGNATURE, 8);
+  WriteUnaligned16 ((UINT16 *) &Burst[8], ACPI_BINLOG_VERSION);
+  WriteUnaligned16 ((UINT16 *) &Burst[10], 0);
+  SerialPortWrite (Burst, sizeof (Burst));
+}
+
+/**
+  Reserves Size bytes in the ring.
+
+  @param[in]  Size      Record size, a multiple of 8.
+  @param[out] Position  Free-running position of the reservation.
+
+  @retval TRUE   Space was reserved.
+  @retval FALSE  The ring is full.
+**/
+STATIC
+BOOLEAN
+BinLogReserve (
+  IN  UINT32  Size,
+  OUT UINT32  *Position
+  )
+{
+  UINT32  Head;
+
+  do {
+    Head = mBinLogWrite;
+    if (Head + Size - mBinLogRead > ACPI_BINLOG_RING_SIZE) {
+      return FALSE;
+    }
+  } while (InterlockedCompareExchange32 ((UINT32 *) &mBinLogWrite, Head, Head + Size) != Head);
+
+  *Position = Head;
+  return TRUE;
+}
+
+/**
+  Records a message in the binary log ring without formatting it.
+
+  @param[in]  Level      EDK2 DEBUG_* level of the message.
+  @param[in]  Sinks      ACPI_LOG_* destinations for the text copy of errors.
+  @param[in]  MessageId  ACPI_LOG_MESSAGE_ID of the call site.
+  @param[in]  Format     Format string; only scanned for argument types.
+  @param[in]  ...        Variable arguments for the format string.
+**/
+VOID
+AcpiBinLogRecord (
+  IN UINTN         Level,
+  IN UINT32        Sinks,
+  IN UINT32        MessageId,
+  IN CONST CHAR16  *Format,
+  ...
+  )
+{
+  VA_LIST             Args;
+  UINT8               Record[ACPI_BINLOG_RECORD_MAX];
+  ACPI_BINLOG_RECORD  *Header;
+  UINTN               Used;
+  UINTN               Size;
+  UINT32              Position;
+
+  Header            = (ACPI_BINLOG_RECORD *) Record;
+  Header->Magic     = 0;
+  Header->MessageId = MessageId;
+  Header->Timestamp = AsmReadTsc ();
+
+  VA_START (Args, Format);
+  Used = sizeof (*Header) + BinLogEncodeArguments (
+                              Record + sizeof (*Header),
+                              sizeof (Record) - sizeof (*Header),
+                              Format,
+                              Args
+                              );
+  VA_END (Args);
+
+  Size = ALIGN_VALUE (Used, sizeof (UINT64));
+  ZeroMem (Record + Used, Size - Used);
+  Header->Size = (UINT16) Size;
+
+  if (!BinLogReserve ((UINT32) Size, &Position)) {
+    AcpiBinLogDrain ();
+    if (!BinLogReserve ((UINT32) Size, &Position)) {
+      InterlockedIncrement ((UINT32 *) &mBinLogDropped);
+      goto PrintError;
+    }
+  }
+
+  //
+  // Everything but the magic first, then the magic: the drainer treats a
+  // record as published only once its magic is in place.
+  //
+  BinLogCopyIn (Position + sizeof (UINT16), Record + sizeof (UINT16), Size - sizeof (UINT16));
+  MemoryFence ();
+  *(volatile UINT16 *) &mBinLogRing[Position & BINLOG_RING_MASK] = ACPI_BINLOG_RECORD_MAGIC;
+
+  if (mBinLogWrite - mBinLogRead >= ACPI_BINLOG_RING_SIZE / 2) {
+    AcpiBinLogDrain ();
+  }
+
+PrintError:
+  if (ACPI_LOG_LEVEL_OF (Level) == ACPI_LOG_LEVEL_ERROR) {
+    VA_START (Args, Format);
+    AcpiLogVPrint (Level, Sinks, Format, Args);
+    VA_END (Args);
+  }
+}
+
+/**
+  Writes every committed record in the binary log ring to the serial port.
+**/
+VOID
+AcpiBinLogDrain (
+  VOID
+  )
+{
+  UINT8               Dropped[sizeof (ACPI_BINLOG_RECORD) + sizeof (UINT64)];
+  ACPI_BINLOG_RECORD  *Header;
+  UINT32              Read;
+  UINT32              Lost;
+  UINT16              Size;
+  BOOLEAN             Started;
+
+  if (InterlockedCompareExchange32 ((UINT32 *) &mBinLogDraining, 0, 1) != 0) {
+    return;
+  }
+
+  if (!mBinLogSerialReady) {
+    SerialPortInitialize ();
+    mBinLogSerialReady = TRUE;
+  }
+
+  Started = FALSE;
+  Read    = mBinLogRead;
+  while (Read != mBinLogWrite) {
+    if (*(volatile UINT16 *) &mBinLogRing[Read & BINLOG_RING_MASK] != ACPI_BINLOG_RECORD_MAGIC) {
+      //
+      // The writer that reserved this slot has not published it yet.
+      //
+      break;
+    }
+
+    if (!Started) {
+      BinLogStartBurst ();
+      Started = TRUE;
+    }
+
+    Size = *(UINT16 *) &mBinLogRing[(Read + sizeof (UINT16)) & BINLOG_RING_MASK];
+    BinLogWriteOut (Read, Size);
+    //
+    // Clear the whole record, not just its magic: records are not all the
+    // same size, so a later record may start where this one's body was, and
+    // a stale magic there would be taken as published before its writer has
+    // filled it.
+    //
+    BinLogClear (Read, Size);
+    Read += Size;
+    MemoryFence ();
+    mBinLogRead = Read;
+  }
+
+  Lost = mBinLogDropped;
+  if (Lost != 0 && InterlockedCompareExchange32 ((UINT32 *) &mBinLogDropped, Lost, 0) == Lost) {
+    if (!Started) {
+      BinLogStartBurst ();
+    }
+    Header            = (ACPI_BINLOG_RECORD *) Dropped;
+    Header->Magic     = ACPI_BINLOG_RECORD_MAGIC;
+    Header->Size      = sizeof (Dropped);
+    Header->MessageId = ACPI_BINLOG_DROPPED_ID;
+    Header->Timestamp = AsmReadTsc ();
+    WriteUnaligned64 ((UINT64 *) (Header + 1), Lost);
+    SerialPortWrite (Dropped, sizeof (Dropped));
+  }
+
+  mBinLogDraining = 0;
+}
+
+#endif
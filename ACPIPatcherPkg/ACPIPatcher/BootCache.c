@@ -0,0 +1,265 @@
+/** @file
+
+  Boot cache.
+
+  A scan costs a directory read plus an Open() and at least two reads per
+  table, and every table is checked again on every boot although the
+  files rarely change.  The first scan therefore leaves its result behind
+  as a bundle, and later boots with the same files read that instead.
+
+  Whether the files are the same is decided from the directory listing the
+  scan takes anyway, so a warm boot costs the listing, one Open() and one
+  read.  Table contents are not hashed for the fingerprint: that would mean
+  reading every file, which is the cost the cache exists to avoid.  A
+  table rewritten in place with the same size and modification time is
+  therefore not noticed; every tool that writes files updates the time.
+
+  The fingerprint is only checked once the cache has been read, so a stale
+  cache costs one wasted read.  That happens on the one boot after the
+  files change; checking first would cost a second read on every boot.
+
+**/
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#define ACPI_LOG_FILE_ID  11
+
+#include "BootCache.h"
+#include "DebugLog.h"
+
+/**
+  Folds Length bytes into a fingerprint.  The multiply makes the result
+  depend on the order things are folded in.
+**/
+STATIC
+UINT64
+BootCacheMix (
+  IN UINT64      Fingerprint,
+  IN CONST VOID  *Buffer,
+  IN UINTN       Length
+  )
+{
+  return MultU64x64 (Fingerprint, 0x9E3779B97F4A7C15ULL) ^ XsdtPlanHash (Buffer, Length);
+}
+
+UINT64
+BootCacheFingerprint (
+  IN CONST DIR_SNAPSHOT                 *Snapshot,
+  IN CONST EFI_ACPI_DESCRIPTION_HEADER  *Xsdt
+  )
+{
+  CONST DIR_SNAPSHOT_ENTRY  *Entry;
+  UINT64                    Fingerprint;
+  UINT64                    Stamp[3];
+  UINTN                     Index;
+
+  Fingerprint = BOOT_CACHE_REVISION;
+  Fingerprint = BootCacheMix (Fingerprint, Xsdt->OemId, sizeof (Xsdt->OemId));
+  Fingerprint = BootCacheMix (Fingerprint, &Xsdt->OemTableId, sizeof (Xsdt->OemTableId));
+  Fingerprint = BootCacheMix (Fingerprint, &Xsdt->OemRevision, sizeof (Xsdt->OemRevision));
+
+  for (Index = 0; Index < Snapshot->Count; Index++) {
+    Entry = &Snapshot->Entries[Index];
+    if (Entry->Kind < DirEntryDsdt) {
+      continue;
+    }
+
+    //
+    // The time field by field: EFI_TIME has padding that drivers need not
+    // clear.
+    //
+    Stamp[0] = Entry->FileSize;
+    Stamp[1] = LShiftU64 (Entry->ModificationTime.Year, 40) |
+               LShiftU64 (Entry->ModificationTime.Month, 32) |
+               LShiftU64 (Entry->ModificationTime.Day, 24) |
+               LShiftU64 (Entry->ModificationTime.Hour, 16) |
+               LShiftU64 (Entry->ModificationTime.Minute, 8) |
+               Entry->ModificationTime.Second;
+    Stamp[2] = Entry->ModificationTime.Nanosecond;
+    Fingerprint = BootCacheMix (Fingerprint, Entry->Name, StrSize (Entry->Name));
+    Fingerprint = BootCacheMix (Fingerprint, Stamp, sizeof (Stamp));
+  }
+
+  return (Fingerprint != 0) ? Fingerprint : 1;
+}
+
+EFI_STATUS
+BootCacheOpen (
+  IN  CONST DIR_SNAPSHOT  *Snapshot,
+  IN  UINT64              Fingerprint,
+  OUT ACPI_BUNDLE         *Bundle
+  )
+{
+#ifdef ACPI_PATCHER_NO_BOOT_CACHE
+  ZeroMem (Bundle, sizeof (*Bundle));
+  return EFI_NOT_FOUND;
+#else
+  CONST DIR_SNAPSHOT_ENTRY  *Entry;
+  EFI_STATUS                Status;
+
+  ZeroMem (Bundle, sizeof (*Bundle));
+
+  Entry = DirSnapshotFind (Snapshot, BOOT_CACHE_FILE_NAME);
+  if (Entry == NULL || Entry->Kind == DirEntryDirectory ||
+      Entry->FileSize < sizeof (ACPI_BUNDLE_HEADER) || Entry->FileSize > MAX_UINT32) {
+    return EFI_NOT_FOUND;
+  }
+
+  Status = DirSnapshotOpen (Snapshot, Entry, &Bundle->File);
+  if (EFI_ERROR (Status)) {
+    Bundle->File = NULL;
+    return Status;
+  }
+
+  Bundle->FileSize    = (UINTN) Entry->FileSize;
+  Bundle->Name        = BOOT_CACHE_FILE_NAME;
+  Bundle->Fingerprint = Fingerprint;
+  return EFI_SUCCESS;
+#endif
+}
+
+/**
+  Writes all of a buffer.
+**/
+STATIC
+EFI_STATUS
+BootCacheWriteAll (
+  IN EFI_FILE_PROTOCOL  *File,
+  IN CONST VOID         *Buffer,
+  IN UINTN              Length
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Written;
+
+  Written = Length;
+  Status  = File->Write (File, &Written, (VOID *) Buffer);
+  if (!EFI_ERROR (Status) && Written != Length) {
+    Status = EFI_VOLUME_FULL;
+  }
+
+  return Status;
+}
+
+EFI_STATUS
+BootCacheWrite (
+  IN CONST DIR_SNAPSHOT  *Snapshot,
+  IN UINT64              Fingerprint,
+  IN CONST XSDT_PLAN     *Plan
+  )
+{
+#ifdef ACPI_PATCHER_NO_BOOT_CACHE
+  return EFI_UNSUPPORTED;
+#else
+  STATIC CONST UINT8  Padding[ACPI_BUNDLE_ALIGNMENT];
+  ACPI_BUNDLE_HEADER  *Header;
+  ACPI_BUNDLE_ENTRY   *Entry;
+  CONST XSDT_OP       *Op;
+  EFI_FILE_PROTOCOL   *File;
+  EFI_STATUS          Status;
+  UINT64              Offset;
+  UINTN               TocSize;
+  UINTN               Index;
+  UINTN               Char;
+
+  //
+  // The header and table of contents go out in one Write(), padded to
+  // where the first table starts.
+  //
+  TocSize = ALIGN_VALUE (sizeof (ACPI_BUNDLE_HEADER) + Plan->Count * sizeof (ACPI_BUNDLE_ENTRY), ACPI_BUNDLE_ALIGNMENT);
+  Header  = AllocateZeroPool (TocSize);
+  if (Header == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Offset = TocSize;
+  for (Index = 0; Index < Plan->Count; Index++) {
+    Op    = &Plan->Ops[Index];
+    Entry = (ACPI_BUNDLE_ENTRY *) (Header + 1) + Index;
+
+    Entry->Signature = Op->Signature;
+    Entry->Action    = (Op->Kind == XsdtOpAppend) ? ACPI_BUNDLE_ACTION_APPEND :
+                       (Op->Kind == XsdtOpReplace) ? ACPI_BUNDLE_ACTION_REPLACE : ACPI_BUNDLE_ACTION_DROP;
+    for (Char = 0; Char < ACPI_BUNDLE_NAME_SIZE - 1 && Op->Source != NULL && Op->Source[Char] != L'\0'; Char++) {
+      Entry->Name[Char] = (Op->Source[Char] < 0x80) ? (CHAR8) Op->Source[Char] : '?';
+    }
+
+    if (Op->Kind != XsdtOpDrop) {
+      Entry->Offset     = (UINT32) Offset;
+      Entry->Length     = Op->Table->Length;
+      Entry->OemTableId = Op->Table->OemTableId;
+      Entry->Hash       = Op->Hash;
+      CopyMem (Entry->OemId, Op->Table->OemId, sizeof (Entry->OemId));
+      Offset += ALIGN_VALUE (Op->Table->Length, ACPI_BUNDLE_ALIGNMENT);
+    }
+  }
+
+  if (Offset > MAX_UINT32) {
+    FreePool (Header);
+    return EFI_BAD_BUFFER_SIZE;
+  }
+
+  Header->Signature   = ACPI_BUNDLE_SIGNATURE;
+  Header->Version     = ACPI_BUNDLE_VERSION;
+  Header->EntrySize   = sizeof (ACPI_BUNDLE_ENTRY);
+  Header->EntryCount  = (UINT32) Plan->Count;
+  Header->Size        = (UINT32) Offset;
+  Header->TocHash     = XsdtPlanHash (Header + 1, Plan->Count * sizeof (ACPI_BUNDLE_ENTRY));
+  Header->Fingerprint = Fingerprint;
+
+  //
+  // Open() cannot truncate, so an old cache is deleted rather than
+  // overwritten.
+  //
+  if (DirSnapshotFind (Snapshot, BOOT_CACHE_FILE_NAME) != NULL &&
+      !EFI_ERROR (Snapshot->Directory->Open (Snapshot->Directory, &File, BOOT_CACHE_FILE_NAME,
+                                             EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, 0))) {
+    File->Delete (File);
+  }
+
+  Status = Snapshot->Directory->Open (
+                                  Snapshot->Directory,
+                                  &File,
+                                  BOOT_CACHE_FILE_NAME,
+                                  EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE | EFI_FILE_MODE_CREATE,
+                                  EFI_FILE_ARCHIVE
+                                  );
+  if (EFI_ERROR (Status)) {
+    FreePool (Header);
+    return Status;
+  }
+
+  Status = BootCacheWriteAll (File, Header, TocSize);
+  for (Index = 0; Index < Plan->Count && !EFI_ERROR (Status); Index++) {
+    Op = &Plan->Ops[Index];
+    if (Op->Kind == XsdtOpDrop) {
+      continue;
+    }
+    Status = BootCacheWriteAll (File, Op->Table, Op->Table->Length);
+    if (!EFI_ERROR (Status) && (Op->Table->Length & (ACPI_BUNDLE_ALIGNMENT - 1)) != 0) {
+      Status = BootCacheWriteAll (File, Padding, ACPI_BUNDLE_ALIGNMENT - (Op->Table->Length & (ACPI_BUNDLE_ALIGNMENT - 1)));
+    }
+  }
+
+  //
+  // A partial cache would be refused for its size anyway, but it would
+  // cost a read on every boot until the files changed.
+  //
+  if (EFI_ERROR (Status)) {
+    File->Delete (File);
+  } else {
+    Status = File->Flush (File);
+    File->Close (File);
+  }
+
+  FreePool (Header);
+  if (!EFI_ERROR (Status)) {
+    AcpiDebugPrint (DEBUG_INFO, L"Wrote %s: %d tables, %d bytes\n", BOOT_CACHE_FILE_NAME, Plan->Count, (UINTN) Offset);
+  }
+
+  return Status;
+#endif
+}
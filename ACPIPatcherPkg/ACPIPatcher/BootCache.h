@@ -0,0 +1,97 @@
+/** @file
+
+  Boot cache.
+
+  After a scan, the patcher writes the tables it planned to
+  ACPIPatcher.cache in the ACPI directory, as an ACPIPatcher.apb style
+  bundle whose header carries a fingerprint of the directory.  While the
+  fingerprint still matches, later boots read that one file instead of
+  opening and checking every table.
+
+  The fingerprint covers the name, size and modification time of every
+  file the scan would load, the firmware XSDT's OEM identification and
+  BOOT_CACHE_REVISION.  Adding, removing, replacing or touching a table
+  changes it, as does a firmware update; the next boot then scans and
+  writes a new cache.  Deleting ACPIPatcher.cache is always safe.
+
+  Build-time knobs (pass with -D):
+
+    ACPI_PATCHER_NO_BOOT_CACHE  Never read or write the cache, for media
+                                the patcher must not write to.
+
+**/
+
+#ifndef __ACPI_PATCHER_BOOT_CACHE_H__
+#define __ACPI_PATCHER_BOOT_CACHE_H__
+
+#include <Uefi.h>
+#include <IndustryStandard/Acpi.h>
+
+#include "AcpiBundle.h"
+#include "DirSnapshot.h"
+#include "XsdtPlan.h"
+
+#define BOOT_CACHE_FILE_NAME  L"ACPIPatcher.cache"
+
+//
+// Bumped whenever the scan would plan the same files differently, so a
+// cache written by an older patcher is not trusted.
+//
+#define BOOT_CACHE_REVISION  1
+
+/**
+  Fingerprints the files a scan of Snapshot would load.
+
+  @param[in] Snapshot  Snapshot of the ACPI files directory.
+  @param[in] Xsdt      Firmware XSDT the tables will be applied to.
+
+  @return The fingerprint; never 0, which marks a bundle built on the host.
+**/
+UINT64
+BootCacheFingerprint (
+  IN CONST DIR_SNAPSHOT                 *Snapshot,
+  IN CONST EFI_ACPI_DESCRIPTION_HEADER  *Xsdt
+  );
+
+/**
+  Opens the cache in Snapshot's directory for AcpiBundleRead(), which only
+  accepts it if it carries Fingerprint.  A directory without a cache is
+  known from the snapshot, without an Open().
+
+  @param[in]  Snapshot     Snapshot of the ACPI files directory.
+  @param[in]  Fingerprint  BootCacheFingerprint() of Snapshot.
+  @param[out] Bundle       Receives the open cache; release with
+                           AcpiBundleFree().
+
+  @retval EFI_SUCCESS    The cache was opened.
+  @retval EFI_NOT_FOUND  There is no cache, or it cannot be a bundle.
+  @retval Other          Open() failed.
+**/
+EFI_STATUS
+BootCacheOpen (
+  IN  CONST DIR_SNAPSHOT  *Snapshot,
+  IN  UINT64              Fingerprint,
+  OUT ACPI_BUNDLE         *Bundle
+  );
+
+/**
+  Writes the tables of a plan, with their actions, as the cache of
+  Snapshot's directory, replacing any cache already there.  A cache that
+  cannot be written completely is deleted.
+
+  @param[in] Snapshot     Snapshot the plan was made from.
+  @param[in] Fingerprint  BootCacheFingerprint() of Snapshot.
+  @param[in] Plan         Plan of every table the scan loaded.
+
+  @retval EFI_SUCCESS           The cache was written.
+  @retval EFI_OUT_OF_RESOURCES  Memory allocation failed.
+  @retval Other                 The volume could not be written.
+**/
+EFI_STATUS
+BootCacheWrite (
+  IN CONST DIR_SNAPSHOT  *Snapshot,
+  IN UINT64              Fingerprint,
+  IN CONST XSDT_PLAN     *Plan
+  );
+
+#endif // __ACPI_PATCHER_BOOT_CACHE_H__
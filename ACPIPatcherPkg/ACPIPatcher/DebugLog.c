@@ -0,0 +1,400 @@
+/** @file
+
+  Logging for ACPIPatcher.
+
+  Every DXE_DEBUG line used to cost a Write() and two Flush() calls on the
+  ESP, which on slow FAT media took longer than the patching itself.  Lines
+  are now collected in a fixed ring and written out when the ring fills up,
+  when patching finishes and at ReadyToBoot.
+
+  Console output used to be followed by a 100 ms Stall() per message in the
+  DXE driver.  It is now written once per message and can be compiled out
+  completely with ACPI_PATCHER_CONSOLE_MODE.
+
+**/
+
+#include <Uefi.h>
+#include <Library/UefiLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PrintLib.h>
+
+#include <Protocol/SimpleFileSystem.h>
+
+#define ACPI_LOG_FILE_ID  3
+
+#include "DebugLog.h"
+
+STATIC UINTN              mAcpiLogErrors     = 0;
+
+#ifdef DXE_DRIVER_BUILD
+STATIC CHAR8              mDebugLogRing[DEBUG_LOG_RING_SIZE];
+STATIC UINTN              mDebugLogHead      = 0;
+STATIC UINTN              mDebugLogUsed      = 0;
+STATIC UINTN              mDebugLogDropped   = 0;
+STATIC UINTN              mDebugLogWritten   = 0;
+STATIC BOOLEAN            mDebugLogFlushing  = FALSE;
+STATIC EFI_FILE_PROTOCOL  *mDebugLogFile     = NULL;
+STATIC EFI_EVENT          mDebugLogReadyToBootEvent = NULL;
+
+/**
+  Opens (or creates) the log file in the root of the first file system.
+
+  @retval EFI_SUCCESS   mDebugLogFile is valid.
+  @retval Other         No file system is available yet.
+**/
+STATIC
+EFI_STATUS
+DebugLogOpenFile (
+  VOID
+  )
+{
+  EFI_STATUS                       Status;
+  UINTN                            HandleCount;
+  EFI_HANDLE                       *HandleBuffer;
+  EFI_SIMPLE_FILE_SYSTEM_PROTOCOL  *FileSystem;
+  EFI_FILE_PROTOCOL                *RootDir;
+
+  if (mDebugLogFile != NULL) {
+    return EFI_SUCCESS;
+  }
+
+  // Find the first available file system (usually ESP)
+  Status = gBS->LocateHandleBuffer (
+                  ByProtocol,
+                  &gEfiSimpleFileSystemProtocolGuid,
+                  NULL,
+                  &HandleCount,
+                  &HandleBuffer
+                  );
+  if (EFI_ERROR (Status) || HandleCount == 0) {
+    return EFI_ERROR (Status) ? Status : EFI_NOT_FOUND;
+  }
+
+  Status = gBS->HandleProtocol (
+                  HandleBuffer[0],
+                  &gEfiSimpleFileSystemProtocolGuid,
+                  (VOID **) &FileSystem
+                  );
+  FreePool (HandleBuffer);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = FileSystem->OpenVolume (FileSystem, &RootDir);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = RootDir->Open (
+                      RootDir,
+                      &mDebugLogFile,
+                      DEBUG_LOG_FILE_NAME,
+                      EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE | EFI_FILE_MODE_CREATE,
+                      0
+                      );
+  RootDir->Close (RootDir);
+  if (EFI_ERROR (Status)) {
+    mDebugLogFile = NULL;
+  }
+
+  return Status;
+}
+
+/**
+  Writes Length bytes to the log file, honouring DEBUG_LOG_MAX_FILE_SIZE.
+
+  @param[in]  Buffer  Bytes to write.
+  @param[in]  Length  Number of bytes in Buffer.
+**/
+STATIC
+VOID
+DebugLogWriteFile (
+  IN CONST CHAR8  *Buffer,
+  IN UINTN        Length
+  )
+{
+  if (Length == 0 || mDebugLogWritten >= DEBUG_LOG_MAX_FILE_SIZE) {
+    return;
+  }
+
+  Length = MIN (Length, DEBUG_LOG_MAX_FILE_SIZE - mDebugLogWritten);
+  mDebugLogFile->Write (mDebugLogFile, &Length, (VOID *) Buffer);
+  mDebugLogWritten += Length;
+}
+
+/**
+  Copies Length bytes into the ring, discarding the oldest bytes if the ring
+  cannot be flushed to make room.
+
+  @param[in]  Buffer  Bytes to append.
+  @param[in]  Length  Number of bytes in Buffer, at most DEBUG_LOG_RING_SIZE.
+**/
+STATIC
+VOID
+DebugLogAppend (
+  IN CONST CHAR8  *Buffer,
+  IN UINTN        Length
+  )
+{
+  UINTN  Tail;
+  UINTN  Chunk;
+  UINTN  Overflow;
+
+  if (mDebugLogUsed + Length > DEBUG_LOG_RING_SIZE) {
+    DebugLogFlush ();
+  }
+
+  if (mDebugLogUsed + Length > DEBUG_LOG_RING_SIZE) {
+    Overflow          = mDebugLogUsed + Length - DEBUG_LOG_RING_SIZE;
+    mDebugLogHead     = (mDebugLogHead + Overflow) % DEBUG_LOG_RING_SIZE;
+    mDebugLogUsed    -= Overflow;
+    mDebugLogDropped += Overflow;
+  }
+
+  Tail  = (mDebugLogHead + mDebugLogUsed) % DEBUG_LOG_RING_SIZE;
+  Chunk = MIN (Length, DEBUG_LOG_RING_SIZE - Tail);
+  CopyMem (&mDebugLogRing[Tail], Buffer, Chunk);
+  CopyMem (mDebugLogRing, Buffer + Chunk, Length - Chunk);
+  mDebugLogUsed += Length;
+}
+
+/**
+  ReadyToBoot callback: writes out whatever is still buffered before control
+  leaves the firmware.
+
+  @param[in] Event    The event that was signaled
+  @param[in] Context  Event context (unused)
+**/
+STATIC
+VOID
+EFIAPI
+DebugLogOnReadyToBoot (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  DebugLogFlush ();
+  gBS->CloseEvent (Event);
+  mDebugLogReadyToBootEvent = NULL;
+}
+
+/**
+  Initializes the debug log.
+
+  @retval EFI_SUCCESS   The log file was opened.
+  @retval Other         The log file could not be opened yet.
+**/
+EFI_STATUS
+DebugLogInitialize (
+  VOID
+  )
+{
+  STATIC CONST CHAR8  InitMsg[] = "\r\n=== ACPIPatcher DXE Driver Debug Log ===\r\n";
+
+  if (mDebugLogReadyToBootEvent == NULL) {
+    EfiCreateEventReadyToBootEx (
+      TPL_CALLBACK,
+      DebugLogOnReadyToBoot,
+      NULL,
+      &mDebugLogReadyToBootEvent
+      );
+  }
+
+  DebugLogAppend (InitMsg, sizeof (InitMsg) - 1);
+  return DebugLogOpenFile ();
+}
+
+/**
+  Writes the buffered lines to the log file with a single Flush().
+
+  @retval EFI_SUCCESS   The ring is empty or was written out.
+  @retval Other         The log file is not available; lines stay buffered.
+**/
+EFI_STATUS
+DebugLogFlush (
+  VOID
+  )
+{
+  EFI_STATUS  Status;
+  CHAR8       Marker[96];
+  UINTN       Chunk;
+
+  if (mDebugLogUsed == 0 || mDebugLogFlushing) {
+    return EFI_SUCCESS;
+  }
+
+  Status = DebugLogOpenFile ();
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  mDebugLogFlushing = TRUE;
+
+  if (mDebugLogDropped != 0) {
+    Chunk = AsciiSPrint (Marker, sizeof (Marker), "[LOG]   %u bytes dropped before log file was available\r\n", (UINT32) mDebugLogDropped);
+    DebugLogWriteFile (Marker, Chunk);
+    mDebugLogDropped = 0;
+  }
+
+  Chunk = MIN (mDebugLogUsed, DEBUG_LOG_RING_SIZE - mDebugLogHead);
+  DebugLogWriteFile (&mDebugLogRing[mDebugLogHead], Chunk);
+  DebugLogWriteFile (mDebugLogRing, mDebugLogUsed - Chunk);
+  mDebugLogFile->Flush (mDebugLogFile);
+
+  mDebugLogHead     = 0;
+  mDebugLogUsed     = 0;
+  mDebugLogFlushing = FALSE;
+  return EFI_SUCCESS;
+}
+#endif
+
+/**
+  Returns the prefix printed in front of AcpiDebugPrint() messages.
+
+  @param[in]  Level   EDK2 DEBUG_* level of the message.
+
+  @return Null-terminated prefix string.
+**/
+STATIC
+CONST CHAR16 *
+AcpiLogPrefix (
+  IN UINTN  Level
+  )
+{
+  switch (ACPI_LOG_LEVEL_OF (Level)) {
+    case ACPI_LOG_LEVEL_ERROR:
+      return L"ERROR: ";
+    case ACPI_LOG_LEVEL_WARN:
+      return L"WARN: ";
+    case ACPI_LOG_LEVEL_INFO:
+      return L"INFO: ";
+    default:
+      return L"VERBOSE: ";
+  }
+}
+
+/**
+  Formats a message and sends it to the requested destinations.
+
+  @param[in]  Level   EDK2 DEBUG_* level of the message.
+  @param[in]  Sinks   ACPI_LOG_* destination flags.
+  @param[in]  Format  Format string for the message.
+  @param[in]  Args    Arguments for the format string.
+**/
+VOID
+AcpiLogVPrint (
+  IN UINTN         Level,
+  IN UINT32        Sinks,
+  IN CONST CHAR16  *Format,
+  IN VA_LIST       Args
+  )
+{
+  CHAR16   Line[DEBUG_LOG_LINE_SIZE];
+  UINTN    Length;
+
+  if (ACPI_LOG_LEVEL_OF (Level) == ACPI_LOG_LEVEL_ERROR) {
+    mAcpiLogErrors++;
+  }
+
+#ifndef DXE_DRIVER_BUILD
+  Sinks &= ~ACPI_LOG_FILE;
+#endif
+#if ACPI_PATCHER_CONSOLE_MODE == ACPI_CONSOLE_FAST_BOOT
+  Sinks &= ~ACPI_LOG_CONSOLE;
+#endif
+  if ((Sinks & (ACPI_LOG_CONSOLE | ACPI_LOG_FILE)) == 0) {
+    return;
+  }
+
+  Length = 0;
+  if ((Sinks & ACPI_LOG_PREFIX) != 0) {
+    Length = UnicodeSPrint (Line, sizeof (Line), L"%s", AcpiLogPrefix (Level));
+  }
+
+  Length += UnicodeVSPrint (&Line[Length], sizeof (Line) - Length * sizeof (CHAR16), Format, Args);
+
+#ifdef DXE_DRIVER_BUILD
+  if ((Sinks & ACPI_LOG_FILE) != 0) {
+    CHAR8  Buffer[DEBUG_LOG_LINE_SIZE];
+    UINTN  Index;
+
+    // Convert to ASCII for file output
+    for (Index = 0; Index < Length; Index++) {
+      Buffer[Index] = (CHAR8) (Line[Index] & 0xFF);
+    }
+    DebugLogAppend (Buffer, Length);
+  }
+#endif
+
+  if ((Sinks & ACPI_LOG_CONSOLE) != 0 && gST->ConOut != NULL) {
+    gST->ConOut->OutputString (gST->ConOut, Line);
+  }
+}
+
+/**
+  Formats a message and sends it to the requested destinations.
+
+  @param[in]  Level   EDK2 DEBUG_* level of the message.
+  @param[in]  Sinks   ACPI_LOG_* destination flags.
+  @param[in]  Format  Format string for the message.
+  @param[in]  ...     Variable arguments for the format string.
+**/
+VOID
+AcpiLogPrint (
+  IN UINTN         Level,
+  IN UINT32        Sinks,
+  IN CONST CHAR16  *Format,
+  ...
+  )
+{
+  VA_LIST  Args;
+
+  VA_START (Args, Format);
+  AcpiLogVPrint (Level, Sinks, Format, Args);
+  VA_END (Args);
+}
+
+/**
+  Marks the end of a patching run: drains the binary log, flushes the DXE
+  log file and, in ACPI_CONSOLE_PAUSE_ON_ERROR mode, pauses if an error was
+  logged.
+**/
+VOID
+AcpiLogComplete (
+  VOID
+  )
+{
+#if ACPI_PATCHER_CONSOLE_MODE == ACPI_CONSOLE_PAUSE_ON_ERROR
+  EFI_INPUT_KEY  Key;
+  UINTN          Waited;
+#endif
+
+#ifdef ACPI_PATCHER_BINARY_LOG
+  AcpiBinLogDrain ();
+#endif
+#ifdef DXE_DRIVER_BUILD
+  DebugLogFlush ();
+#endif
+
+#if ACPI_PATCHER_CONSOLE_MODE == ACPI_CONSOLE_PAUSE_ON_ERROR
+  if (mAcpiLogErrors == 0 || gST->ConIn == NULL || gST->ConOut == NULL) {
+    return;
+  }
+
+  //
+  // Give the user a moment to read the errors, but never hold up an
+  // unattended boot for longer than ACPI_PATCHER_ERROR_PAUSE_MS.
+  //
+  gST->ConOut->OutputString (gST->ConOut, L"ACPIPatcher: errors were reported, press any key to continue...\r\n");
+  for (Waited = 0; Waited < ACPI_PATCHER_ERROR_PAUSE_MS; Waited += 50) {
+    if (!EFI_ERROR (gST->ConIn->ReadKeyStroke (gST->ConIn, &Key))) {
+      break;
+    }
+    gBS->Stall (50 * 1000);
+  }
+  mAcpiLogErrors = 0;
+#endif
+}
@@ -0,0 +1,297 @@
+/** @file
+
+  Logging for ACPIPatcher.
+
+  All messages go through AcpiLogPrint(), which applies a build-time level
+  threshold and routes each line to the console and, in the DXE driver, to
+  a buffered ACPIPatcher_Debug.log.  The DXE log is collected in an
+  in-memory ring and written in large chunks instead of one Write() and
+  Flush() per line.
+
+  Build-time knobs (pass with -D, e.g. from the DSC):
+
+    ACPI_PATCHER_LOG_LEVEL     0 none, 1 error, 2 warn, 3 info, 4 verbose.
+                               Messages above the threshold compile out.
+    ACPI_PATCHER_CONSOLE_MODE  0 fast boot (never touch the console),
+                               1 normal,
+                               2 normal, plus a short key-skippable pause at
+                                 the end of a run that logged an error.
+    ACPI_PATCHER_BINARY_LOG    When defined, messages are not formatted on
+                               the target.  Each one is recorded as a message
+                               ID, a timestamp and its raw arguments, and
+                               drained over SerialPortLib.  Errors are still
+                               printed as text.  Tools/AcpiBinLog.py rebuilds
+                               the text from a catalog of these sources.
+
+**/
+
+#ifndef __ACPI_PATCHER_DEBUG_LOG_H__
+#define __ACPI_PATCHER_DEBUG_LOG_H__
+
+#include <Uefi.h>
+#include <Library/DebugLib.h>
+
+//
+// Log levels, in increasing verbosity.
+//
+#define ACPI_LOG_LEVEL_NONE       0
+#define ACPI_LOG_LEVEL_ERROR      1
+#define ACPI_LOG_LEVEL_WARN       2
+#define ACPI_LOG_LEVEL_INFO       3
+#define ACPI_LOG_LEVEL_VERBOSE    4
+
+#ifndef ACPI_PATCHER_LOG_LEVEL
+#ifdef MDEPKG_NDEBUG
+#define ACPI_PATCHER_LOG_LEVEL    ACPI_LOG_LEVEL_WARN
+#else
+#define ACPI_PATCHER_LOG_LEVEL    ACPI_LOG_LEVEL_INFO
+#endif
+#endif
+
+//
+// Console modes.
+//
+#define ACPI_CONSOLE_FAST_BOOT       0
+#define ACPI_CONSOLE_NORMAL          1
+#define ACPI_CONSOLE_PAUSE_ON_ERROR  2
+
+#ifndef ACPI_PATCHER_CONSOLE_MODE
+#define ACPI_PATCHER_CONSOLE_MODE    ACPI_CONSOLE_NORMAL
+#endif
+
+//
+// Longest the end-of-run pause may hold up the boot, in milliseconds.
+//
+#ifndef ACPI_PATCHER_ERROR_PAUSE_MS
+#define ACPI_PATCHER_ERROR_PAUSE_MS  3000
+#endif
+
+//
+// Maps an EDK2 DEBUG_* mask to an ACPI_LOG_LEVEL_* value.  Both macros fold
+// to constants, so a disabled call and its format string are dropped by the
+// compiler.
+//
+#define ACPI_LOG_LEVEL_OF(DebugLevel)                                  \
+  ((((DebugLevel) & DEBUG_ERROR) != 0) ? ACPI_LOG_LEVEL_ERROR :        \
+   (((DebugLevel) & DEBUG_WARN)  != 0) ? ACPI_LOG_LEVEL_WARN  :        \
+   (((DebugLevel) & DEBUG_INFO)  != 0) ? ACPI_LOG_LEVEL_INFO  :        \
+                                         ACPI_LOG_LEVEL_VERBOSE)
+
+#define ACPI_LOG_ENABLED(DebugLevel) \
+  (ACPI_LOG_LEVEL_OF (DebugLevel) <= ACPI_PATCHER_LOG_LEVEL)
+
+//
+// Destinations for AcpiLogPrint().
+//
+#define ACPI_LOG_CONSOLE          BIT0
+#define ACPI_LOG_FILE             BIT1
+#define ACPI_LOG_PREFIX           BIT2
+
+//
+// DXE_DEBUG lines are diagnostics: they go to the log file in the driver
+// and to the console in the application, which has no log file.
+//
+#ifdef DXE_DRIVER_BUILD
+#define ACPI_LOG_DEBUG_SINKS      ACPI_LOG_FILE
+#else
+#define ACPI_LOG_DEBUG_SINKS      ACPI_LOG_CONSOLE
+#endif
+
+//
+// Binary log message IDs are (ACPI_LOG_FILE_ID << 16) | __LINE__.  Every
+// source file that logs defines its own ACPI_LOG_FILE_ID before including
+// this header; Tools/AcpiBinLog.py reads the same define to build the
+// catalog.
+//
+#ifndef ACPI_LOG_FILE_ID
+#define ACPI_LOG_FILE_ID          0
+#endif
+
+#define ACPI_LOG_MESSAGE_ID       (((UINT32) ACPI_LOG_FILE_ID << 16) | (UINT32) __LINE__)
+
+#if defined (ACPI_PATCHER_BINARY_LOG) && !defined (MDE_CPU_IA32) && !defined (MDE_CPU_X64)
+#error "ACPI_PATCHER_BINARY_LOG reads the TSC and needs a 16550 UART: IA32 and X64 only"
+#endif
+
+#ifdef ACPI_PATCHER_BINARY_LOG
+#define ACPI_LOG_EMIT(Level, Sinks, Format, ...) \
+  AcpiBinLogRecord ((Level), (Sinks), ACPI_LOG_MESSAGE_ID, Format, ##__VA_ARGS__)
+#else
+#define ACPI_LOG_EMIT(Level, Sinks, Format, ...) \
+  AcpiLogPrint ((Level), (Sinks), Format, ##__VA_ARGS__)
+#endif
+
+#define AcpiDebugPrint(Level, Format, ...)                                  \
+  do {                                                                      \
+    if (ACPI_LOG_ENABLED (Level)) {                                         \
+      ACPI_LOG_EMIT ((Level), ACPI_LOG_CONSOLE | ACPI_LOG_FILE | ACPI_LOG_PREFIX, \
+        Format, ##__VA_ARGS__);                                             \
+    }                                                                       \
+  } while (FALSE)
+
+#define DXE_DEBUG(Level, Format, ...)                                       \
+  do {                                                                      \
+    if (ACPI_LOG_ENABLED (Level)) {                                         \
+      ACPI_LOG_EMIT ((Level), ACPI_LOG_DEBUG_SINKS, Format, ##__VA_ARGS__); \
+    }                                                                       \
+  } while (FALSE)
+
+#ifdef DXE_DRIVER_BUILD
+#define DXE_DEBUG_INIT()          DebugLogInitialize ()
+#else
+#define DXE_DEBUG_INIT()
+#endif
+
+//
+// Name of the log file created in the root of the first file system.
+//
+#define DEBUG_LOG_FILE_NAME       L"ACPIPatcher_Debug.log"
+
+//
+// Size of the in-memory ring.  This is also the most log output that can be
+// lost if the machine hangs before the next flush.
+//
+#define DEBUG_LOG_RING_SIZE       SIZE_16KB
+
+//
+// Longest single line, in characters, accepted by AcpiLogPrint().
+//
+#define DEBUG_LOG_LINE_SIZE       512
+
+//
+// Upper bound on the bytes written to the log file during one boot.  Once
+// reached the file is left alone so that a driver stuck in a loop cannot
+// fill the ESP.
+//
+#define DEBUG_LOG_MAX_FILE_SIZE   SIZE_1MB
+
+//
+// Binary log wire format.  A drained burst starts with the 8-byte stream
+// signature, a UINT16 version and a UINT16 reserved field, followed by
+// records.  Each record is an ACPI_BINLOG_RECORD header and a payload
+// padded to 8 bytes.  The payload holds one item per conversion in the
+// format string: integers as UINT64, %g as 16 bytes, and %a/%s/%S as a
+// UINT8 length followed by that many ASCII bytes.
+//
+#define ACPI_BINLOG_SIGNATURE     "ACPIBLOG"
+#define ACPI_BINLOG_VERSION       1
+#define ACPI_BINLOG_RECORD_MAGIC  0xB10C
+#define ACPI_BINLOG_RECORD_MAX    256
+#define ACPI_BINLOG_RING_SIZE     SIZE_8KB
+
+//
+// Message ID of the record emitted when records had to be dropped.  Its
+// payload is the UINT64 number of lost records.
+//
+#define ACPI_BINLOG_DROPPED_ID    0xFFFFFFFF
+
+#pragma pack(1)
+typedef struct {
+  UINT16  Magic;
+  UINT16  Size;
+  UINT32  MessageId;
+  UINT64  Timestamp;
+} ACPI_BINLOG_RECORD;
+#pragma pack()
+
+/**
+  Formats a message and sends it to the requested destinations.
+
+  Callers normally use the AcpiDebugPrint() and DXE_DEBUG() macros, which
+  skip the call entirely for levels above ACPI_PATCHER_LOG_LEVEL.
+
+  @param[in]  Level   EDK2 DEBUG_* level of the message.
+  @param[in]  Sinks   ACPI_LOG_* destination flags.
+  @param[in]  Format  Format string for the message.
+  @param[in]  ...     Variable arguments for the format string.
+**/
+VOID
+AcpiLogPrint (
+  IN UINTN         Level,
+  IN UINT32        Sinks,
+  IN CONST CHAR16  *Format,
+  ...
+  );
+
+/**
+  Formats a message and sends it to the requested destinations.
+
+  @param[in]  Level   EDK2 DEBUG_* level of the message.
+  @param[in]  Sinks   ACPI_LOG_* destination flags.
+  @param[in]  Format  Format string for the message.
+  @param[in]  Args    Arguments for the format string.
+**/
+VOID
+AcpiLogVPrint (
+  IN UINTN         Level,
+  IN UINT32        Sinks,
+  IN CONST CHAR16  *Format,
+  IN VA_LIST       Args
+  );
+
+/**
+  Records a message in the binary log ring without formatting it.
+
+  Error messages are additionally printed as text to Sinks, so a failing
+  boot is still visible without the decoder.
+
+  @param[in]  Level      EDK2 DEBUG_* level of the message.
+  @param[in]  Sinks      ACPI_LOG_* destinations for the text copy of errors.
+  @param[in]  MessageId  ACPI_LOG_MESSAGE_ID of the call site.
+  @param[in]  Format     Format string; only scanned for argument types.
+  @param[in]  ...        Variable arguments for the format string.
+**/
+VOID
+AcpiBinLogRecord (
+  IN UINTN         Level,
+  IN UINT32        Sinks,
+  IN UINT32        MessageId,
+  IN CONST CHAR16  *Format,
+  ...
+  );
+
+/**
+  Writes every committed record in the binary log ring to the serial port.
+**/
+VOID
+AcpiBinLogDrain (
+  VOID
+  );
+
+/**
+  Marks the end of a patching run: drains the binary log, flushes the DXE
+  log file and, in ACPI_CONSOLE_PAUSE_ON_ERROR mode, pauses if an error was
+  logged.
+**/
+VOID
+AcpiLogComplete (
+  VOID
+  );
+
+/**
+  Initializes the DXE debug log.
+
+  Tries to open the log file and registers a ReadyToBoot callback that
+  flushes whatever is still buffered.  If no file system is available yet
+  the lines are kept in the ring and the file is opened on the next flush.
+
+  @retval EFI_SUCCESS   The log file was opened.
+  @retval Other         The log file could not be opened yet.
+**/
+EFI_STATUS
+DebugLogInitialize (
+  VOID
+  );
+
+/**
+  Writes the buffered lines to the log file with a single Flush().
+
+  @retval EFI_SUCCESS   The ring is empty or was written out.
+  @retval Other         The log file is not available; lines stay buffered.
+**/
+EFI_STATUS
+DebugLogFlush (
+  VOID
+  );
+
+#endif // __ACPI_PATCHER_DEBUG_LOG_H__
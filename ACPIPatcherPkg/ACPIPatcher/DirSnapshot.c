@@ -0,0 +1,430 @@
+/** @file
+
+  In-memory snapshot of an ACPI files directory.
+
+  Before the snapshot, one run could enumerate the same directory three
+  times and probe a dozen names that were not there: discovery counted the
+  .aml files in every candidate, PatchAcpiTables() opened DSDT.aml and
+  SSDT-1..SSDT-10 blindly, the scanner read the directory twice, and each
+  load retried under an ACPI subdirectory.  Every one of those was a FAT
+  directory walk.  Now the directory is read once and all later questions
+  are answered from memory.
+
+**/
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#include <Guid/FileInfo.h>
+
+#define ACPI_LOG_FILE_ID  5
+
+#include "DebugLog.h"
+#include "DirSnapshot.h"
+#include "FsHelpers.h"
+
+//
+// Initial sizes; both grow as needed.
+//
+#define DIR_SNAPSHOT_INITIAL_ENTRIES  64
+#define DIR_SNAPSHOT_INITIAL_NAMES    2048
+
+//
+// Entries are collected with name offsets and only turned into pointers
+// once the name pool has stopped moving.
+//
+#define DIR_SNAPSHOT_NAME_OFFSET(Entry)  ((UINTN) (Entry)->Name)
+
+/**
+  Case-insensitive comparison of two names, in the sense FAT uses.
+**/
+STATIC
+INTN
+DirSnapshotCompareNames (
+  IN CONST CHAR16  *First,
+  IN CONST CHAR16  *Second
+  )
+{
+  CHAR16  Left;
+  CHAR16  Right;
+
+  do {
+    Left  = CharToUpper (*First++);
+    Right = CharToUpper (*Second++);
+  } while (Left != L'\0' && Left == Right);
+
+  return (INTN) Left - (INTN) Right;
+}
+
+/**
+  Case-insensitive FNV-1a hash of a name.
+**/
+STATIC
+UINT32
+DirSnapshotHashName (
+  IN CONST CHAR16  *Name
+  )
+{
+  UINT32  Hash;
+
+  Hash = 2166136261U;
+  for ( ; *Name != L'\0'; Name++) {
+    Hash = (Hash ^ CharToUpper (*Name)) * 16777619U;
+  }
+
+  return Hash;
+}
+
+/**
+  Sorts entries by name.  FAT returns directory entries in creation order,
+  which for tables copied in by hand or by a script is usually already
+  sorted, so insertion sort is linear in the common case where a
+  last-element-pivot QuickSort() would be quadratic.
+**/
+STATIC
+VOID
+DirSnapshotSort (
+  IN OUT DIR_SNAPSHOT_ENTRY  *Entries,
+  IN     UINTN               Count
+  )
+{
+  DIR_SNAPSHOT_ENTRY  Moving;
+  UINTN               Index;
+  UINTN               Slot;
+
+  for (Index = 1; Index < Count; Index++) {
+    if (DirSnapshotCompareNames (Entries[Index - 1].Name, Entries[Index].Name) <= 0) {
+      continue;
+    }
+
+    Moving = Entries[Index];
+    for (Slot = Index; Slot > 0 && DirSnapshotCompareNames (Entries[Slot - 1].Name, Moving.Name) > 0; Slot--) {
+      Entries[Slot] = Entries[Slot - 1];
+    }
+
+    Entries[Slot] = Moving;
+  }
+}
+
+/**
+  Returns TRUE if Name ends with Suffix, ignoring case.
+**/
+STATIC
+BOOLEAN
+DirSnapshotHasSuffix (
+  IN CONST CHAR16  *Name,
+  IN UINTN         NameLength,
+  IN CONST CHAR16  *Suffix
+  )
+{
+  UINTN  SuffixLength;
+
+  SuffixLength = StrLen (Suffix);
+  return (BOOLEAN) (NameLength >= SuffixLength &&
+                    DirSnapshotCompareNames (Name + NameLength - SuffixLength, Suffix) == 0);
+}
+
+/**
+  Returns TRUE if Name starts with Prefix, ignoring case.
+**/
+STATIC
+BOOLEAN
+DirSnapshotHasPrefix (
+  IN CONST CHAR16  *Name,
+  IN CONST CHAR16  *Prefix
+  )
+{
+  for ( ; *Prefix != L'\0'; Name++, Prefix++) {
+    if (CharToUpper (*Name) != CharToUpper (*Prefix)) {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+BOOLEAN
+DirSnapshotIsCompressedName (
+  IN CONST CHAR16  *Name
+  )
+{
+  return DirSnapshotHasSuffix (Name, StrLen (Name), L".aml.lz");
+}
+
+/**
+  Decides what the patcher should do with an entry.  A .aml.lz file is
+  classified by the name without its .lz.
+**/
+STATIC
+DIR_ENTRY_KIND
+DirSnapshotClassify (
+  IN OUT DIR_SNAPSHOT_ENTRY  *Entry
+  )
+{
+  UINTN  Length;
+  UINTN  Index;
+
+  Length            = StrLen (Entry->Name);
+  Entry->Compressed = FALSE;
+  if ((Entry->Attribute & EFI_FILE_DIRECTORY) != 0) {
+    return DirEntryDirectory;
+  }
+
+  if (DirSnapshotHasSuffix (Entry->Name, Length, L".aml.lz")) {
+    Entry->Compressed = TRUE;
+    Length -= 3;
+  }
+
+  if (Entry->FileSize == 0 || Length < 4 ||
+      !DirSnapshotHasPrefix (Entry->Name + Length - 4, L".aml") ||
+      DirSnapshotHasPrefix (Entry->Name, L"._")) {
+    return DirEntryOther;
+  }
+
+  if (Length == 8 && DirSnapshotHasPrefix (Entry->Name, L"DSDT.aml")) {
+    return DirEntryDsdt;
+  }
+
+  if (Length < 9 || !DirSnapshotHasPrefix (Entry->Name, L"SSDT-")) {
+    return DirEntryAml;
+  }
+
+  for (Index = 5; Index < Length - 4; Index++) {
+    if (Entry->Name[Index] < L'0' || Entry->Name[Index] > L'9') {
+      return DirEntrySsdtNamed;
+    }
+  }
+
+  return DirEntrySsdtNumbered;
+}
+
+/**
+  Builds the sorted order, hash index and classification once all entries
+  have been read.
+**/
+STATIC
+EFI_STATUS
+DirSnapshotIndex (
+  IN OUT DIR_SNAPSHOT  *Snapshot
+  )
+{
+  DIR_SNAPSHOT_ENTRY  *Entry;
+  UINTN               Index;
+  UINT32              Bucket;
+  UINT32              Buckets;
+
+  for (Index = 0; Index < Snapshot->Count; Index++) {
+    Entry       = &Snapshot->Entries[Index];
+    Entry->Name = Snapshot->Names + DIR_SNAPSHOT_NAME_OFFSET (Entry);
+  }
+
+  DirSnapshotSort (Snapshot->Entries, Snapshot->Count);
+
+  //
+  // Open addressing, at most half full.
+  //
+  for (Buckets = 16; Buckets < Snapshot->Count * 2; Buckets <<= 1) {
+  }
+
+  Snapshot->Buckets = AllocateZeroPool (Buckets * sizeof (UINT32));
+  if (Snapshot->Buckets == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Snapshot->BucketMask = Buckets - 1;
+  Snapshot->AmlCount   = 0;
+  for (Index = 0; Index < Snapshot->Count; Index++) {
+    Entry       = &Snapshot->Entries[Index];
+    Entry->Hash = DirSnapshotHashName (Entry->Name);
+    Entry->Kind = DirSnapshotClassify (Entry);
+    if (Entry->Kind >= DirEntryDsdt) {
+      Snapshot->AmlCount++;
+    }
+
+    for (Bucket = Entry->Hash & Snapshot->BucketMask;
+         Snapshot->Buckets[Bucket] != 0;
+         Bucket = (Bucket + 1) & Snapshot->BucketMask) {
+    }
+
+    Snapshot->Buckets[Bucket] = (UINT32) (Index + 1);
+  }
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+DirSnapshotCreate (
+  IN  EFI_FILE_PROTOCOL  *Directory,
+  OUT DIR_SNAPSHOT       *Snapshot
+  )
+{
+  EFI_STATUS          Status;
+  EFI_FILE_INFO       *Info;
+  UINTN               InfoCapacity;
+  UINTN               InfoSize;
+  UINTN               EntryCapacity;
+  UINTN               NameCapacity;
+  UINTN               NameUsed;
+  UINTN               NameSize;
+  DIR_SNAPSHOT_ENTRY  *Entry;
+  VOID                *Grown;
+
+  ZeroMem (Snapshot, sizeof (*Snapshot));
+  if (Directory == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Snapshot->Directory = Directory;
+  EntryCapacity       = DIR_SNAPSHOT_INITIAL_ENTRIES;
+  NameCapacity        = DIR_SNAPSHOT_INITIAL_NAMES;
+  NameUsed            = 0;
+  InfoCapacity        = SIZE_OF_EFI_FILE_INFO + 256 * sizeof (CHAR16);
+  Info                = AllocatePool (InfoCapacity);
+  Snapshot->Entries   = AllocatePool (EntryCapacity * sizeof (DIR_SNAPSHOT_ENTRY));
+  Snapshot->Names     = AllocatePool (NameCapacity * sizeof (CHAR16));
+  if (Info == NULL || Snapshot->Entries == NULL || Snapshot->Names == NULL) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Done;
+  }
+
+  Directory->SetPosition (Directory, 0);
+  for ( ; ; ) {
+    InfoSize = InfoCapacity;
+    Status   = Directory->Read (Directory, &InfoSize, Info);
+    if (Status == EFI_BUFFER_TOO_SMALL) {
+      FreePool (Info);
+      InfoCapacity = InfoSize;
+      Info         = AllocatePool (InfoCapacity);
+      if (Info == NULL) {
+        Status = EFI_OUT_OF_RESOURCES;
+        goto Done;
+      }
+      Status = Directory->Read (Directory, &InfoSize, Info);
+    }
+
+    if (EFI_ERROR (Status)) {
+      goto Done;
+    }
+    if (InfoSize == 0) {
+      break;
+    }
+
+    if (StrCmp (Info->FileName, L".") == 0 || StrCmp (Info->FileName, L"..") == 0) {
+      continue;
+    }
+
+    if (Snapshot->Count == EntryCapacity) {
+      Grown = ReallocatePool (
+                EntryCapacity * sizeof (DIR_SNAPSHOT_ENTRY),
+                EntryCapacity * 2 * sizeof (DIR_SNAPSHOT_ENTRY),
+                Snapshot->Entries
+                );
+      if (Grown == NULL) {
+        Status = EFI_OUT_OF_RESOURCES;
+        goto Done;
+      }
+      Snapshot->Entries = Grown;
+      EntryCapacity    *= 2;
+    }
+
+    NameSize = StrLen (Info->FileName) + 1;
+    if (NameUsed + NameSize > NameCapacity) {
+      Grown = ReallocatePool (
+                NameCapacity * sizeof (CHAR16),
+                MAX (NameCapacity * 2, NameUsed + NameSize) * sizeof (CHAR16),
+                Snapshot->Names
+                );
+      if (Grown == NULL) {
+        Status = EFI_OUT_OF_RESOURCES;
+        goto Done;
+      }
+      Snapshot->Names = Grown;
+      NameCapacity    = MAX (NameCapacity * 2, NameUsed + NameSize);
+    }
+
+    CopyMem (Snapshot->Names + NameUsed, Info->FileName, NameSize * sizeof (CHAR16));
+    Entry            = &Snapshot->Entries[Snapshot->Count++];
+    Entry->Name      = (CONST CHAR16 *) NameUsed;
+    Entry->FileSize  = Info->FileSize;
+    Entry->Attribute = Info->Attribute;
+    CopyMem (&Entry->ModificationTime, &Info->ModificationTime, sizeof (Entry->ModificationTime));
+    NameUsed        += NameSize;
+  }
+
+  Status = DirSnapshotIndex (Snapshot);
+
+Done:
+  if (Info != NULL) {
+    FreePool (Info);
+  }
+
+  if (EFI_ERROR (Status)) {
+    AcpiDebugPrint (DEBUG_WARN, L"DirSnapshotCreate: %r after %d entries\n", Status, Snapshot->Count);
+    Snapshot->Count = 0;
+    DirSnapshotFree (Snapshot);
+    return Status;
+  }
+
+  AcpiDebugPrint (DEBUG_VERBOSE, L"Directory snapshot: %d entries, %d AML files\n", Snapshot->Count, Snapshot->AmlCount);
+  return EFI_SUCCESS;
+}
+
+DIR_SNAPSHOT_ENTRY *
+DirSnapshotFind (
+  IN CONST DIR_SNAPSHOT  *Snapshot,
+  IN CONST CHAR16        *Name
+  )
+{
+  DIR_SNAPSHOT_ENTRY  *Entry;
+  UINT32              Hash;
+  UINT32              Bucket;
+
+  if (Snapshot->Buckets == NULL) {
+    return NULL;
+  }
+
+  Hash = DirSnapshotHashName (Name);
+  for (Bucket = Hash & Snapshot->BucketMask;
+       Snapshot->Buckets[Bucket] != 0;
+       Bucket = (Bucket + 1) & Snapshot->BucketMask) {
+    Entry = &Snapshot->Entries[Snapshot->Buckets[Bucket] - 1];
+    if (Entry->Hash == Hash && DirSnapshotCompareNames (Entry->Name, Name) == 0) {
+      return Entry;
+    }
+  }
+
+  return NULL;
+}
+
+EFI_STATUS
+DirSnapshotOpen (
+  IN  CONST DIR_SNAPSHOT        *Snapshot,
+  IN  CONST DIR_SNAPSHOT_ENTRY  *Entry,
+  OUT EFI_FILE_PROTOCOL         **File
+  )
+{
+  return FsOpenFile (Snapshot->Directory, (CHAR16 *) Entry->Name, File);
+}
+
+VOID
+DirSnapshotFree (
+  IN OUT DIR_SNAPSHOT  *Snapshot
+  )
+{
+  if (Snapshot->Entries != NULL) {
+    FreePool (Snapshot->Entries);
+  }
+  if (Snapshot->Names != NULL) {
+    FreePool (Snapshot->Names);
+  }
+  if (Snapshot->Buckets != NULL) {
+    FreePool (Snapshot->Buckets);
+  }
+  if (Snapshot->OwnsDirectory && Snapshot->Directory != NULL) {
+    Snapshot->Directory->Close (Snapshot->Directory);
+  }
+
+  ZeroMem (Snapshot, sizeof (*Snapshot));
+}
@@ -0,0 +1,134 @@
+/** @file
+
+  In-memory snapshot of an ACPI files directory.
+
+  A snapshot is built with a single Read() pass over the directory.  The
+  entries are sorted by name and indexed by a case-insensitive hash, and
+  each one is classified (DSDT, numbered SSDT, named SSDT, other AML) at
+  build time.  A compressed <name>.aml.lz is classified as <name>.aml
+  would be.  Discovery, DSDT/SSDT lookup and the directory scan all work
+  from the snapshot, so every loaded file costs exactly one Open() and a
+  missing file costs none.
+
+**/
+
+#ifndef __ACPI_PATCHER_DIR_SNAPSHOT_H__
+#define __ACPI_PATCHER_DIR_SNAPSHOT_H__
+
+#include <Uefi.h>
+#include <Protocol/SimpleFileSystem.h>
+
+//
+// What a directory entry is to the patcher.
+//
+typedef enum {
+  DirEntryOther,          ///< Not loaded: not AML, empty or a macOS "._" file.
+  DirEntryDirectory,
+  DirEntryDsdt,           ///< DSDT.aml
+  DirEntrySsdtNumbered,   ///< SSDT-<digits>.aml
+  DirEntrySsdtNamed,      ///< SSDT-<name>.aml
+  DirEntryAml             ///< Any other .aml file
+} DIR_ENTRY_KIND;
+
+typedef struct {
+  CONST CHAR16    *Name;
+  UINT64          FileSize;
+  UINT64          Attribute;
+  EFI_TIME        ModificationTime;
+  UINT32          Hash;
+  DIR_ENTRY_KIND  Kind;
+  //
+  // TRUE for a .aml.lz file, which holds the table packed (AcpiLz.h).
+  //
+  BOOLEAN         Compressed;
+} DIR_SNAPSHOT_ENTRY;
+
+typedef struct {
+  //
+  // Directory the entries were read from; files are opened relative to it.
+  //
+  EFI_FILE_PROTOCOL   *Directory;
+  //
+  // TRUE if the snapshot opened Directory itself and closes it when freed.
+  //
+  BOOLEAN             OwnsDirectory;
+  DIR_SNAPSHOT_ENTRY  *Entries;
+  UINTN               Count;
+  //
+  // Number of entries the patcher would load (DSDT, SSDT and other AML).
+  //
+  UINTN               AmlCount;
+  UINT32              *Buckets;
+  UINT32              BucketMask;
+  CHAR16              *Names;
+} DIR_SNAPSHOT;
+
+/**
+  Reads every entry of Directory once and builds a sorted, hashed and
+  classified snapshot of it.
+
+  @param[in]  Directory  Open directory handle.  It is not closed.
+  @param[out] Snapshot   Receives the snapshot; release with DirSnapshotFree().
+
+  @retval EFI_SUCCESS           The snapshot was built.
+  @retval EFI_OUT_OF_RESOURCES  Memory allocation failed.
+  @retval Other                 Reading the directory failed.
+**/
+EFI_STATUS
+DirSnapshotCreate (
+  IN  EFI_FILE_PROTOCOL  *Directory,
+  OUT DIR_SNAPSHOT       *Snapshot
+  );
+
+/**
+  Looks up a name in a snapshot, ignoring case as FAT does.
+
+  @param[in]  Snapshot  Snapshot to search.
+  @param[in]  Name      File name without a path.
+
+  @return The matching entry, or NULL if the directory has no such entry.
+**/
+DIR_SNAPSHOT_ENTRY *
+DirSnapshotFind (
+  IN CONST DIR_SNAPSHOT  *Snapshot,
+  IN CONST CHAR16        *Name
+  );
+
+/**
+  Returns TRUE if Name is that of a compressed table, <name>.aml.lz,
+  ignoring case.
+**/
+BOOLEAN
+DirSnapshotIsCompressedName (
+  IN CONST CHAR16  *Name
+  );
+
+/**
+  Opens a file or subdirectory listed in a snapshot for reading.
+
+  @param[in]  Snapshot  Snapshot the entry belongs to.
+  @param[in]  Entry     Entry to open.
+  @param[out] File      Receives the opened handle.
+
+  @retval EFI_SUCCESS   The entry was opened.
+  @retval Other         Open() failed.
+**/
+EFI_STATUS
+DirSnapshotOpen (
+  IN  CONST DIR_SNAPSHOT        *Snapshot,
+  IN  CONST DIR_SNAPSHOT_ENTRY  *Entry,
+  OUT EFI_FILE_PROTOCOL         **File
+  );
+
+/**
+  Releases the memory held by a snapshot and, if it owns it, closes its
+  directory.  Freeing a zeroed or already freed snapshot is allowed.
+
+  @param[in, out] Snapshot  Snapshot to release.
+**/
+VOID
+DirSnapshotFree (
+  IN OUT DIR_SNAPSHOT  *Snapshot
+  );
+
+#endif // __ACPI_PATCHER_DIR_SNAPSHOT_H__
@@ -12,14 +12,21 @@
 #include <Library/BaseMemoryLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiRuntimeServicesTableLib.h>
 #include <Library/PrintLib.h>
 #include <Library/DevicePathLib.h>
 #include <Library/BaseLib.h>
 
 #include <Protocol/LoadedImage.h>
 
+#define ACPI_LOG_FILE_ID  2
+
+#include "DebugLog.h"
+
 #include <Guid/Gpt.h>
+#include <Guid/GlobalVariable.h>
 
+#include "AcpiChecksum.h"
 #include "FsHelpers.h"
 EFI_LOADED_IMAGE_PROTOCOL           *gAcpiPatcherLoadedImage;
 
@@ -52,13 +59,235 @@ FsReadFileToBuffer (
     }
     Status = FileProtocol->Read(FileProtocol, &BufferSize, *Buffer);
     if(Status != EFI_SUCCESS) {
-        gBS->FreePool(Buffer);
+        gBS->FreePool(*Buffer);
+        *Buffer = NULL;
         return Status;
     }
     
     return Status;
 }
 
+/*++
+ 
+ Routine Description:
+ 
+ Reads exactly BufferSize bytes from the current position of an open file
+ into a caller-provided buffer, in chunks of at most FS_READ_CHUNK_SIZE.
+ Some firmware FAT drivers fail or return short counts on very large
+ single reads, so multi-MB files are read piecewise.  Each piece is summed
+ right after it is read, while it is still in cache, so validating a table
+ does not mean reading all of it back from memory afterwards.
+ 
+ Arguments:
+ 
+ FileProtocol      - User-provided file handle/protocol to read.
+ BufferSize        - Number of bytes to read.
+ Buffer            - Caller-provided buffer of at least BufferSize bytes.
+ Checksum          - Optional; the ACPI byte sum of the data read is added to it.
+ 
+ Returns: EFI_STATUS, EFI_END_OF_FILE if the file ends early
+ 
+ --*/
+EFI_STATUS
+FsReadExact (
+  EFI_FILE_PROTOCOL* FileProtocol,
+  UINTN BufferSize,
+  VOID * Buffer,
+  UINT8 * Checksum
+  )
+{
+    EFI_STATUS Status;
+    UINT8      *Cursor;
+    UINTN      Chunk;
+
+    Cursor = Buffer;
+    while (BufferSize > 0) {
+        Chunk = MIN(BufferSize, FS_READ_CHUNK_SIZE);
+        Status = FileProtocol->Read(FileProtocol, &Chunk, Cursor);
+        if(Status != EFI_SUCCESS) {
+            return Status;
+        }
+        if(Chunk == 0) {
+            return EFI_END_OF_FILE;
+        }
+        if(Checksum != NULL) {
+            *Checksum = (UINT8)(*Checksum + AcpiChecksumSum(Cursor, Chunk));
+        }
+        Cursor     += Chunk;
+        BufferSize -= Chunk;
+    }
+    
+    return EFI_SUCCESS;
+}
+
+/*++
+ 
+ Routine Description:
+ 
+ Issues the next ReadEx() of an asynchronous read, of at most
+ FS_READ_CHUNK_SIZE bytes like FsReadExact().
+ 
+ --*/
+STATIC
+EFI_STATUS
+FsReadAsyncIssue (
+  FS_ASYNC_READ* Request
+  )
+{
+    Request->Token.Status     = EFI_NOT_READY;
+    Request->Token.BufferSize = MIN(Request->Size - Request->Done, FS_READ_CHUNK_SIZE);
+    Request->Token.Buffer     = Request->Buffer + Request->Done;
+    return Request->File->ReadEx(Request->File, &Request->Token);
+}
+
+/*++
+ 
+ Routine Description:
+ 
+ Ends an asynchronous read with the given result.
+ 
+ --*/
+STATIC
+EFI_STATUS
+FsReadAsyncComplete (
+  FS_ASYNC_READ* Request,
+  EFI_STATUS Status
+  )
+{
+    if(Request->Token.Event != NULL) {
+        gBS->CloseEvent(Request->Token.Event);
+        Request->Token.Event = NULL;
+    }
+    Request->Status = Status;
+    return Status;
+}
+
+/*++
+ 
+ Routine Description:
+ 
+ Starts reading exactly BufferSize bytes from an open file into a caller
+ buffer.  Reads that go through ReadEx() let the file system driver keep
+ several transfers going at once, so the device latency of one file
+ overlaps that of the next rather than adding up.  The token event has no
+ notification function: the patcher runs at TPL_CALLBACK in the driver,
+ where WaitForEvent() is not allowed, so completion is polled with
+ CheckEvent().  Drivers that only implement revision 1, or that have a
+ ReadEx() that fails up front, are read synchronously instead.
+ 
+ Arguments:
+ 
+ FileProtocol      - User-provided file handle/protocol to read.
+ BufferSize        - Number of bytes to read.
+ Buffer            - Caller-provided buffer of at least BufferSize bytes.
+ Request           - Request to start.
+ 
+ Returns: EFI_NOT_READY while the read is in flight, else as FsReadExact()
+ 
+ --*/
+EFI_STATUS
+FsReadAsync (
+  EFI_FILE_PROTOCOL* FileProtocol,
+  UINTN BufferSize,
+  VOID * Buffer,
+  FS_ASYNC_READ* Request
+  )
+{
+    EFI_STATUS Status;
+
+    ZeroMem(Request, sizeof(*Request));
+    Request->File   = FileProtocol;
+    Request->Buffer = Buffer;
+    Request->Size   = BufferSize;
+    Request->Status = EFI_NOT_READY;
+
+    if(BufferSize > 0 && FileProtocol->Revision >= EFI_FILE_PROTOCOL_REVISION2 && FileProtocol->ReadEx != NULL) {
+        Status = gBS->CreateEvent(0, TPL_CALLBACK, NULL, NULL, &Request->Token.Event);
+        if(Status == EFI_SUCCESS) {
+            Status = FsReadAsyncIssue(Request);
+            if(Status == EFI_SUCCESS) {
+                return EFI_NOT_READY;
+            }
+            gBS->CloseEvent(Request->Token.Event);
+            Request->Token.Event = NULL;
+        }
+    }
+
+    return FsReadAsyncComplete(Request, FsReadExact(FileProtocol, BufferSize, Buffer, NULL));
+}
+
+/*++
+ 
+ Routine Description:
+ 
+ Checks on a read started by FsReadAsync() without waiting for it.  A
+ ReadEx() that returns short is continued from where it stopped.
+ 
+ Arguments:
+ 
+ Request           - Request to check.
+ 
+ Returns: EFI_NOT_READY while the read is in flight, else as FsReadExact()
+ 
+ --*/
+EFI_STATUS
+FsReadAsyncPoll (
+  FS_ASYNC_READ* Request
+  )
+{
+    EFI_STATUS Status;
+
+    if(Request->Token.Event == NULL) {
+        return Request->Status;
+    }
+    if(gBS->CheckEvent(Request->Token.Event) != EFI_SUCCESS) {
+        return EFI_NOT_READY;
+    }
+
+    if(Request->Token.Status != EFI_SUCCESS) {
+        return FsReadAsyncComplete(Request, Request->Token.Status);
+    }
+    if(Request->Token.BufferSize == 0) {
+        return FsReadAsyncComplete(Request, EFI_END_OF_FILE);
+    }
+    Request->Done += Request->Token.BufferSize;
+    if(Request->Done >= Request->Size) {
+        return FsReadAsyncComplete(Request, EFI_SUCCESS);
+    }
+
+    Status = FsReadAsyncIssue(Request);
+    if(Status != EFI_SUCCESS) {
+        return FsReadAsyncComplete(Request, Status);
+    }
+    return EFI_NOT_READY;
+}
+
+/*++
+ 
+ Routine Description:
+ 
+ Waits for a read started by FsReadAsync() to complete, by polling.
+ 
+ Arguments:
+ 
+ Request           - Request to wait for.
+ 
+ Returns: EFI_STATUS, as FsReadExact()
+ 
+ --*/
+EFI_STATUS
+FsReadAsyncWait (
+  FS_ASYNC_READ* Request
+  )
+{
+    EFI_STATUS Status;
+
+    while((Status = FsReadAsyncPoll(Request)) == EFI_NOT_READY) {
+        CpuPause();
+    }
+    return Status;
+}
+
 /*++
  
  Routine Description:
@@ -155,16 +384,16 @@ FsGetLoadedImage(VOID)
 				);
 			
 			if (Status != EFI_SUCCESS) {
-				Print(L"FsGetLoadedImage: HandleProtocol(gEfiLoadedImageProtocolGuid) = %r\n", Status);
+				AcpiDebugPrint(DEBUG_WARN, L"FsGetLoadedImage: HandleProtocol(gEfiLoadedImageProtocolGuid) = %r\n", Status);
 				return;
 			}
 		} else {
-			Print(L"FsGetLoadedImage: gAcpiPatcherImageHandle is NULL - ImageHandle not set\n");
+			AcpiDebugPrint(DEBUG_ERROR, L"FsGetLoadedImage: gAcpiPatcherImageHandle is NULL - ImageHandle not set\n");
 			return;
 		}
 		
 		if (Status != EFI_SUCCESS) {
-			Print(L"FsGetLoadedImage: HandleProtocol(gEfiLoadedImageProtocolGuid) = %r\n", Status);
+			AcpiDebugPrint(DEBUG_WARN, L"FsGetLoadedImage: HandleProtocol(gEfiLoadedImageProtocolGuid) = %r\n", Status);
 			return;
 		}
 	}
@@ -186,7 +415,7 @@ FsGetFileSystem(IN EFI_HANDLE VolumeHandle)
 								 );
 	
 	if (Status != EFI_SUCCESS) {
-		Print(L"FsGetFileSystem: HandleProtocol(gEfiSimpleFileSystemProtocolGuid) = %r\n", Status);
+		AcpiDebugPrint(DEBUG_VERBOSE, L"FsGetFileSystem: HandleProtocol(gEfiSimpleFileSystemProtocolGuid) = %r\n", Status);
 		Volume = NULL;
 	}
 	
@@ -221,7 +450,7 @@ FsGetRootDir(IN EFI_SIMPLE_FILE_SYSTEM_PROTOCOL *Volume)
 	// open RootDir
 	Status = Volume->OpenVolume(Volume, &RootDir);
 	if (Status != EFI_SUCCESS) {
-		Print(L"FsGetRootDir: OpenVolume() = %r\n", Status);
+		AcpiDebugPrint(DEBUG_WARN, L"FsGetRootDir: OpenVolume() = %r\n", Status);
 		return NULL;
 	}
 	
@@ -263,7 +492,7 @@ FsGetSelfDir(VOID)
 	// extract FilePath
 	FilePath = FileDevicePathToText(gAcpiPatcherLoadedImage->FilePath);
 	if (FilePath == NULL) {
-		Print(L"FsGetSelfDir: FileDevicePathToText = NULL\n");
+		AcpiDebugPrint(DEBUG_VERBOSE, L"FsGetSelfDir: FileDevicePathToText = NULL\n");
 		return NULL;
 	}
 	
@@ -271,7 +500,7 @@ FsGetSelfDir(VOID)
 	Status = RootDir->Open(RootDir, &File, FilePath, EFI_FILE_MODE_READ, 0);
 	RootDir->Close(RootDir);
 	if (Status != EFI_SUCCESS) {
-		Print(L"FsGetSelfDir: Open(%s) = %r\n", FilePath, Status);
+		AcpiDebugPrint(DEBUG_WARN, L"FsGetSelfDir: Open(%s) = %r\n", FilePath, Status);
 		FreePool(FilePath);
 		return NULL;
 	}
@@ -290,7 +519,7 @@ FsGetSelfDir(VOID)
 	Status = File->Open(File, &Dir, DirName, EFI_FILE_MODE_READ, 0);
 	File->Close(File);
 	if (Status != EFI_SUCCESS) {
-		Print(L"FsGetSelfDir: Open(%s) = %r\n", DirName, Status);
+		AcpiDebugPrint(DEBUG_WARN, L"FsGetSelfDir: Open(%s) = %r\n", DirName, Status);
 		FreePool(FilePath);
 		return NULL;
 	}
@@ -298,3 +527,137 @@ FsGetSelfDir(VOID)
 	
 	return Dir;
 }
+
+/** Finds the GPT partition GUID in a device path. Returns FALSE, with Guid zeroed, if there is none. */
+BOOLEAN
+FsGetPartitionGuid(IN CONST EFI_DEVICE_PATH_PROTOCOL *DevicePath, OUT EFI_GUID *Guid)
+{
+    CONST EFI_DEVICE_PATH_PROTOCOL  *Node;
+    CONST HARDDRIVE_DEVICE_PATH     *HardDrive;
+
+    for (Node = DevicePath; !IsDevicePathEnd(Node); Node = NextDevicePathNode(Node)) {
+        if (DevicePathType(Node) == MEDIA_DEVICE_PATH && DevicePathSubType(Node) == MEDIA_HARDDRIVE_DP &&
+            DevicePathNodeLength(Node) >= sizeof(HARDDRIVE_DEVICE_PATH)) {
+            HardDrive = (CONST HARDDRIVE_DEVICE_PATH *) Node;
+            if (HardDrive->SignatureType == SIGNATURE_TYPE_GUID) {
+                CopyMem(Guid, HardDrive->Signature, sizeof(*Guid));
+                return TRUE;
+            }
+        }
+    }
+
+    ZeroMem(Guid, sizeof(*Guid));
+    return FALSE;
+}
+
+/** Returns the device path of the BootCurrent boot option in allocated memory, or NULL if there is none. */
+STATIC
+EFI_DEVICE_PATH_PROTOCOL *
+FsGetBootCurrentPath(VOID)
+{
+    EFI_STATUS                Status;
+    EFI_DEVICE_PATH_PROTOCOL  *Path;
+    UINT16                    BootCurrent;
+    CHAR16                    Name[16];
+    UINT8                     *Option;
+    UINTN                     Size;
+    UINTN                     Offset;
+    UINTN                     PathLength;
+
+    // Only set once the boot manager has started an option, e.g. a boot loader that loaded us
+    Size = sizeof(BootCurrent);
+    Status = gRT->GetVariable(L"BootCurrent", &gEfiGlobalVariableGuid, NULL, &Size, &BootCurrent);
+    if (EFI_ERROR(Status) || Size != sizeof(BootCurrent)) {
+        return NULL;
+    }
+
+    UnicodeSPrint(Name, sizeof(Name), L"Boot%04X", BootCurrent);
+    Size = 0;
+    Status = gRT->GetVariable(Name, &gEfiGlobalVariableGuid, NULL, &Size, NULL);
+    if (Status != EFI_BUFFER_TOO_SMALL) {
+        return NULL;
+    }
+    Option = AllocatePool(Size);
+    if (Option == NULL) {
+        return NULL;
+    }
+    Status = gRT->GetVariable(Name, &gEfiGlobalVariableGuid, NULL, &Size, Option);
+
+    // EFI_LOAD_OPTION: UINT32 Attributes, UINT16 FilePathListLength, the
+    // description string, then the device paths
+    Path = NULL;
+    if (!EFI_ERROR(Status) && Size >= sizeof(UINT32) + sizeof(UINT16)) {
+        PathLength = ReadUnaligned16((UINT16 *) (Option + sizeof(UINT32)));
+        Offset = sizeof(UINT32) + sizeof(UINT16);
+        while (Offset + sizeof(CHAR16) <= Size && ReadUnaligned16((UINT16 *) (Option + Offset)) != 0) {
+            Offset += sizeof(CHAR16);
+        }
+        Offset += sizeof(CHAR16);
+        if (Offset <= Size && PathLength <= Size - Offset &&
+            IsDevicePathValid((EFI_DEVICE_PATH_PROTOCOL *) (Option + Offset), PathLength)) {
+            Path = DuplicateDevicePath((EFI_DEVICE_PATH_PROTOCOL *) (Option + Offset));
+        }
+    }
+
+    FreePool(Option);
+    return Path;
+}
+
+/** Returns TRUE if the volume at VolumePath is the device BootPath was loaded from. */
+STATIC
+BOOLEAN
+FsIsBootVolume(IN CONST EFI_DEVICE_PATH_PROTOCOL *VolumePath, IN CONST EFI_DEVICE_PATH_PROTOCOL *BootPath)
+{
+    EFI_GUID  VolumeGuid;
+    EFI_GUID  BootGuid;
+    UINTN     Size;
+
+    // A short-form boot option names the partition only
+    if (FsGetPartitionGuid(BootPath, &BootGuid)) {
+        return FsGetPartitionGuid(VolumePath, &VolumeGuid) && CompareGuid(&VolumeGuid, &BootGuid);
+    }
+
+    // A full one starts with the volume's own device path
+    Size = GetDevicePathSize(VolumePath) - sizeof(EFI_DEVICE_PATH_PROTOCOL);
+    return Size > 0 && GetDevicePathSize(BootPath) > Size && CompareMem(VolumePath, BootPath, Size) == 0;
+}
+
+/** Sorts file system handles best first by FS_VOLUME_RANK, keeping their order within a rank.
+    Ranks receives the rank of each handle in its new position. */
+VOID
+FsRankVolumes(IN OUT EFI_HANDLE *Handles, IN UINTN Count, OUT FS_VOLUME_RANK *Ranks)
+{
+    EFI_DEVICE_PATH_PROTOCOL  *BootPath;
+    EFI_DEVICE_PATH_PROTOCOL  *VolumePath;
+    EFI_HANDLE                Handle;
+    FS_VOLUME_RANK            Rank;
+    VOID                      *Marker;
+    UINTN                     Index;
+    UINTN                     Slot;
+
+    BootPath = FsGetBootCurrentPath();
+    for (Index = 0; Index < Count; Index++) {
+        Handle = Handles[Index];
+        VolumePath = DevicePathFromHandle(Handle);
+        if (BootPath != NULL && VolumePath != NULL && FsIsBootVolume(VolumePath, BootPath)) {
+            Rank = FsVolumeBootDevice;
+        } else if (!EFI_ERROR(gBS->HandleProtocol(Handle, &gEfiPartTypeSystemPartGuid, &Marker))) {
+            // The partition driver marks ESPs with their type GUID
+            Rank = FsVolumeEsp;
+        } else {
+            Rank = FsVolumeOther;
+        }
+
+        // Insertion: there are only ever a handful of volumes
+        for (Slot = Index; Slot > 0 && Ranks[Slot - 1] < Rank; Slot--) {
+            Handles[Slot] = Handles[Slot - 1];
+            Ranks[Slot]   = Ranks[Slot - 1];
+        }
+        Handles[Slot] = Handle;
+        Ranks[Slot]   = Rank;
+    }
+
+    if (BootPath != NULL) {
+        FreePool(BootPath);
+    }
+}
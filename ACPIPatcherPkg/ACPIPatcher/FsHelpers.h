@@ -62,6 +62,112 @@ FsReadFileToBuffer (
   IN OUT  VOID                **Buffer
   );
 
+//
+// Largest single Read() issued by FsReadExact().
+//
+#define FS_READ_CHUNK_SIZE  SIZE_256KB
+
+/*++
+ 
+ Routine Description:
+ 
+ Reads exactly BufferSize bytes from an open file into a caller buffer,
+ in chunks of at most FS_READ_CHUNK_SIZE, optionally summing them.
+ 
+ Arguments:
+ 
+ FileProtocol      - User-provided file handle/protocol to read.
+ BufferSize        - Number of bytes to read.
+ Buffer            - Caller-provided buffer of at least BufferSize bytes.
+ Checksum          - Optional; the ACPI byte sum of the data read is added to it.
+ 
+ Returns: EFI_STATUS, EFI_END_OF_FILE if the file ends early
+ 
+ --*/
+EFI_STATUS
+FsReadExact (
+  IN      EFI_FILE_PROTOCOL   *FileProtocol,
+  IN      UINTN               BufferSize,
+  OUT     VOID                *Buffer,
+  IN OUT  UINT8               *Checksum   OPTIONAL
+  );
+
+//
+// A read started by FsReadAsync().  The file and the buffer must stay
+// valid, and the request must not move, until it has completed.
+//
+typedef struct {
+  EFI_FILE_PROTOCOL   *File;
+  EFI_FILE_IO_TOKEN   Token;      ///< Token of the ReadEx() in flight; no event once complete
+  UINT8               *Buffer;
+  UINTN               Size;
+  UINTN               Done;       ///< Bytes read so far
+  EFI_STATUS          Status;     ///< Result once complete
+} FS_ASYNC_READ;
+
+/*++
+ 
+ Routine Description:
+ 
+ Starts reading exactly BufferSize bytes from an open file into a caller
+ buffer.  On a revision 2 file protocol the read is issued with ReadEx()
+ and completes in the background; otherwise, or if ReadEx() turns it
+ down, the bytes are read right away with FsReadExact().
+ 
+ Arguments:
+ 
+ FileProtocol      - User-provided file handle/protocol to read.
+ BufferSize        - Number of bytes to read.
+ Buffer            - Caller-provided buffer of at least BufferSize bytes.
+ Request           - Request to start.
+ 
+ Returns: EFI_NOT_READY while the read is in flight, else as FsReadExact()
+ 
+ --*/
+EFI_STATUS
+FsReadAsync (
+  IN      EFI_FILE_PROTOCOL   *FileProtocol,
+  IN      UINTN               BufferSize,
+  OUT     VOID                *Buffer,
+  OUT     FS_ASYNC_READ       *Request
+  );
+
+/*++
+ 
+ Routine Description:
+ 
+ Checks on a read started by FsReadAsync() without waiting for it.
+ 
+ Arguments:
+ 
+ Request           - Request to check.
+ 
+ Returns: EFI_NOT_READY while the read is in flight, else as FsReadExact()
+ 
+ --*/
+EFI_STATUS
+FsReadAsyncPoll (
+  IN OUT  FS_ASYNC_READ       *Request
+  );
+
+/*++
+ 
+ Routine Description:
+ 
+ Waits for a read started by FsReadAsync() to complete.
+ 
+ Arguments:
+ 
+ Request           - Request to wait for.
+ 
+ Returns: EFI_STATUS, as FsReadExact()
+ 
+ --*/
+EFI_STATUS
+FsReadAsyncWait (
+  IN OUT  FS_ASYNC_READ       *Request
+  );
+
 /** Returns file path from FilePathProto in allocated memory. Mem should be released by caller.*/
 CHAR16 *
 EFIAPI
@@ -91,4 +197,22 @@ FsGetSelfRootDir(VOID);
 EFI_FILE_PROTOCOL *
 FsGetSelfDir(VOID);
 
+/** Finds the GPT partition GUID in a device path. Returns FALSE, with Guid zeroed, if there is none. */
+BOOLEAN
+FsGetPartitionGuid(IN CONST EFI_DEVICE_PATH_PROTOCOL *DevicePath, OUT EFI_GUID *Guid);
+
+//
+// How likely a file system is to hold the ACPI files, best last.
+//
+typedef enum {
+  FsVolumeOther,        ///< Data volumes, other disks, removable media
+  FsVolumeEsp,          ///< An EFI System Partition
+  FsVolumeBootDevice    ///< The volume the current boot option was loaded from
+} FS_VOLUME_RANK;
+
+/** Sorts file system handles best first by FS_VOLUME_RANK, keeping their order within a rank.
+    Ranks receives the rank of each handle in its new position. */
+VOID
+FsRankVolumes(IN OUT EFI_HANDLE *Handles, IN UINTN Count, OUT FS_VOLUME_RANK *Ranks);
+
 #endif // __DMP_FILE_LIB_H__
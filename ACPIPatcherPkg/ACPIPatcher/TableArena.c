@@ -0,0 +1,113 @@
+/** @file
+
+  Packed arena for the tables the patcher installs.
+
+  Each loaded table used to be its own EfiBootServicesData pool block, and
+  the new XSDT another.  The OS was free to reclaim all of them at
+  ExitBootServices(), and nothing kept them below 4 GB even though the
+  FADT's 32-bit Dsdt field is written from the same pointer.  The arena is
+  sized from the directory snapshot before anything is loaded, so one
+  AllocatePages() call covers the whole patch.
+
+**/
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+#define ACPI_LOG_FILE_ID  6
+
+#include "DebugLog.h"
+#include "TableArena.h"
+
+EFI_STATUS
+TableArenaCreate (
+  OUT TABLE_ARENA  *Arena,
+  IN  UINTN        Size
+  )
+{
+  EFI_STATUS  Status;
+
+  Arena->Base  = MAX_UINT32;
+  Arena->Pages = EFI_SIZE_TO_PAGES (Size);
+  Arena->Size  = EFI_PAGES_TO_SIZE (Arena->Pages);
+  Arena->Used  = 0;
+  Arena->Last  = 0;
+
+  Status = gBS->AllocatePages (AllocateMaxAddress, EfiACPIReclaimMemory, Arena->Pages, &Arena->Base);
+  if (EFI_ERROR (Status)) {
+    AcpiDebugPrint (DEBUG_ERROR, L"Cannot reserve %d pages of ACPI memory below 4GB: %r\n", Arena->Pages, Status);
+    Arena->Base  = 0;
+    Arena->Pages = 0;
+    Arena->Size  = 0;
+    return Status;
+  }
+
+  AcpiDebugPrint (DEBUG_VERBOSE, L"Table arena: %d bytes in %d pages at 0x%lx\n", Size, Arena->Pages, Arena->Base);
+  return EFI_SUCCESS;
+}
+
+VOID *
+TableArenaAllocate (
+  IN OUT TABLE_ARENA  *Arena,
+  IN     UINTN        Size
+  )
+{
+  UINTN  Needed;
+
+  Needed = TABLE_ARENA_SIZE (Size);
+  if (Arena->Base == 0 || Needed < Size || Needed > Arena->Size - Arena->Used) {
+    AcpiDebugPrint (DEBUG_WARN, L"Table arena full: %d bytes requested, %d free\n", Size, Arena->Size - Arena->Used);
+    return NULL;
+  }
+
+  Arena->Last  = Arena->Used;
+  Arena->Used += Needed;
+  return (VOID *) (UINTN) (Arena->Base + Arena->Last);
+}
+
+VOID
+TableArenaFree (
+  IN OUT TABLE_ARENA  *Arena,
+  IN     VOID         *Buffer
+  )
+{
+  if (Arena->Base != 0 && (UINTN) Buffer == (UINTN) (Arena->Base + Arena->Last) && Arena->Used > Arena->Last) {
+    Arena->Used = Arena->Last;
+  }
+}
+
+VOID
+TableArenaTrim (
+  IN OUT TABLE_ARENA  *Arena
+  )
+{
+  UINTN  Keep;
+
+  Keep = EFI_SIZE_TO_PAGES (Arena->Used);
+  if (Arena->Base == 0 || Keep == 0 || Keep >= Arena->Pages) {
+    return;
+  }
+
+  if (!EFI_ERROR (gBS->FreePages (Arena->Base + EFI_PAGES_TO_SIZE (Keep), Arena->Pages - Keep))) {
+    AcpiDebugPrint (DEBUG_VERBOSE, L"Table arena: %d unused pages returned\n", Arena->Pages - Keep);
+    Arena->Pages = Keep;
+    Arena->Size  = EFI_PAGES_TO_SIZE (Keep);
+  }
+}
+
+VOID
+TableArenaDestroy (
+  IN OUT TABLE_ARENA  *Arena
+  )
+{
+  if (Arena->Base != 0) {
+    gBS->FreePages (Arena->Base, Arena->Pages);
+  }
+
+  Arena->Base  = 0;
+  Arena->Pages = 0;
+  Arena->Size  = 0;
+  Arena->Used  = 0;
+  Arena->Last  = 0;
+}
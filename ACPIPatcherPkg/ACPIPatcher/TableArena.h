@@ -0,0 +1,95 @@
+/** @file
+
+  Packed arena for the tables the patcher installs.
+
+  The new XSDT and every table loaded from disk are carved back to back out
+  of one EfiACPIReclaimMemory page allocation below 4 GB.  The OS then sees
+  a single ACPI reclaim range instead of one boot services pool block per
+  table, and the 32-bit FADT and RSDT fields can always hold the addresses.
+
+**/
+
+#ifndef __ACPI_PATCHER_TABLE_ARENA_H__
+#define __ACPI_PATCHER_TABLE_ARENA_H__
+
+#include <Uefi.h>
+
+//
+// Alignment of every table in the arena.
+//
+#define TABLE_ARENA_ALIGNMENT  16
+
+//
+// Arena space taken by an allocation of Size bytes.
+//
+#define TABLE_ARENA_SIZE(Size)  ALIGN_VALUE ((Size), TABLE_ARENA_ALIGNMENT)
+
+typedef struct {
+  EFI_PHYSICAL_ADDRESS  Base;
+  UINTN                 Pages;
+  UINTN                 Size;
+  UINTN                 Used;
+  //
+  // Offset of the most recent allocation; only that one can be returned.
+  //
+  UINTN                 Last;
+} TABLE_ARENA;
+
+/**
+  Reserves EfiACPIReclaimMemory pages below 4 GB for Size bytes of tables.
+
+  @param[out] Arena  Receives the arena; release with TableArenaDestroy().
+  @param[in]  Size   Total of TABLE_ARENA_SIZE() over everything to be placed.
+
+  @retval EFI_SUCCESS           The pages were allocated.
+  @retval EFI_OUT_OF_RESOURCES  No room below 4 GB.
+**/
+EFI_STATUS
+TableArenaCreate (
+  OUT TABLE_ARENA  *Arena,
+  IN  UINTN        Size
+  );
+
+/**
+  Takes the next Size bytes from an arena.  The memory is not cleared.
+
+  @return The allocation, aligned to TABLE_ARENA_ALIGNMENT, or NULL if the
+          arena is full.
+**/
+VOID *
+TableArenaAllocate (
+  IN OUT TABLE_ARENA  *Arena,
+  IN     UINTN        Size
+  );
+
+/**
+  Gives back an allocation.  Only the most recent one is actually reused;
+  for anything else this does nothing, and the space stays reserved.
+**/
+VOID
+TableArenaFree (
+  IN OUT TABLE_ARENA  *Arena,
+  IN     VOID         *Buffer
+  );
+
+/**
+  Returns the whole pages past the last allocation to the firmware, once
+  nothing more will be placed in the arena.  The arena is sized for the
+  worst case, which compressed tables make generous.
+**/
+VOID
+TableArenaTrim (
+  IN OUT TABLE_ARENA  *Arena
+  );
+
+/**
+  Returns all of an arena's pages to the firmware.  Only valid while nothing
+  in the arena has been published to the OS.  Destroying a zeroed or already
+  destroyed arena is allowed.
+**/
+VOID
+TableArenaDestroy (
+  IN OUT TABLE_ARENA  *Arena
+  );
+
+#endif // __ACPI_PATCHER_TABLE_ARENA_H__
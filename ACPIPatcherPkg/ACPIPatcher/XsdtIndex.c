@@ -0,0 +1,173 @@
+/** @file
+
+  Hash index over the firmware XSDT.
+
+  Finding the FADT and every table to replace used to be a linear walk of
+  the XSDT that matched the signature only, so the first SSDT always won.
+  The index keeps two chained hash tables over one entry array: one keyed
+  on the signature and one on the signature and OEM Table ID.  Chains are
+  linked in XSDT order, so the first match is the one the old walk found.
+
+**/
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#define ACPI_LOG_FILE_ID  8
+
+#include "DebugLog.h"
+#include "XsdtIndex.h"
+
+//
+// Bucket count is a power of two at least this many times the entry count.
+//
+#define XSDT_INDEX_LOAD_FACTOR  2
+#define XSDT_INDEX_MIN_BUCKETS  16
+
+STATIC
+UINTN
+XsdtIndexHashSignature (
+  IN UINT32  Signature
+  )
+{
+  return (UINTN) ((Signature * 0x9E3779B1U) >> 7);
+}
+
+STATIC
+UINTN
+XsdtIndexHashTableId (
+  IN UINT32  Signature,
+  IN UINT64  OemTableId
+  )
+{
+  UINT64  Key;
+
+  Key = MultU64x64 (OemTableId ^ LShiftU64 (Signature, 32) ^ Signature, 0x9E3779B97F4A7C15ULL);
+  return (UINTN) RShiftU64 (Key, 32);
+}
+
+EFI_STATUS
+XsdtIndexBuild (
+  OUT XSDT_INDEX                         *Index,
+  IN  CONST EFI_ACPI_DESCRIPTION_HEADER  *Xsdt
+  )
+{
+  CONST UINT64                 *Slots;
+  EFI_ACPI_DESCRIPTION_HEADER  *Table;
+  XSDT_INDEX_ENTRY             *Entry;
+  UINTN                        Buckets;
+  UINTN                        Position;
+  UINTN                        Bucket;
+  VOID                         *Storage;
+
+  ZeroMem (Index, sizeof (*Index));
+
+  Index->Count = (Xsdt->Length - sizeof (EFI_ACPI_DESCRIPTION_HEADER)) / sizeof (UINT64);
+  Buckets      = XSDT_INDEX_MIN_BUCKETS;
+  while (Buckets < Index->Count * XSDT_INDEX_LOAD_FACTOR) {
+    Buckets *= 2;
+  }
+
+  //
+  // Entries and both bucket arrays come from one allocation.
+  //
+  Storage = AllocateZeroPool (Index->Count * sizeof (XSDT_INDEX_ENTRY) + 2 * Buckets * sizeof (UINT32));
+  if (Storage == NULL) {
+    Index->Count = 0;
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Index->Xsdt        = Xsdt;
+  Index->Entries     = Storage;
+  Index->BySignature = (UINT32 *) (Index->Entries + Index->Count);
+  Index->ByTableId   = Index->BySignature + Buckets;
+  Index->BucketMask  = Buckets - 1;
+
+  //
+  // Last to first, pushing onto the chain heads, leaves every chain in
+  // XSDT order.
+  //
+  Slots = (CONST UINT64 *) (Xsdt + 1);
+  for (Position = Index->Count; Position > 0; Position--) {
+    Entry = &Index->Entries[Position - 1];
+    Table = (EFI_ACPI_DESCRIPTION_HEADER *) (UINTN) ReadUnaligned64 (&Slots[Position - 1]);
+    if (Table == NULL) {
+      continue;
+    }
+
+    Entry->Table = Table;
+
+    Bucket                      = XsdtIndexHashSignature (Table->Signature) & Index->BucketMask;
+    Entry->NextBySignature      = Index->BySignature[Bucket];
+    Index->BySignature[Bucket]  = (UINT32) Position;
+
+    Bucket                      = XsdtIndexHashTableId (Table->Signature, ReadUnaligned64 (&Table->OemTableId)) & Index->BucketMask;
+    Entry->NextByTableId        = Index->ByTableId[Bucket];
+    Index->ByTableId[Bucket]    = (UINT32) Position;
+  }
+
+  AcpiDebugPrint (DEBUG_VERBOSE, L"XSDT index: %d entries in %d buckets\n", Index->Count, Buckets);
+  return EFI_SUCCESS;
+}
+
+XSDT_INDEX_ENTRY *
+XsdtIndexFind (
+  IN CONST XSDT_INDEX        *Index,
+  IN       UINT32            Signature,
+  IN CONST UINT64            *OemTableId  OPTIONAL,
+  IN CONST UINT8             *OemId       OPTIONAL,
+  IN CONST XSDT_INDEX_ENTRY  *After       OPTIONAL
+  )
+{
+  XSDT_INDEX_ENTRY             *Entry;
+  EFI_ACPI_DESCRIPTION_HEADER  *Table;
+  UINT32                       Next;
+
+  if (Index->Entries == NULL) {
+    return NULL;
+  }
+
+  if (After != NULL) {
+    Next = (OemTableId == NULL) ? After->NextBySignature : After->NextByTableId;
+  } else if (OemTableId == NULL) {
+    Next = Index->BySignature[XsdtIndexHashSignature (Signature) & Index->BucketMask];
+  } else {
+    Next = Index->ByTableId[XsdtIndexHashTableId (Signature, ReadUnaligned64 (OemTableId)) & Index->BucketMask];
+  }
+
+  while (Next != 0) {
+    Entry = &Index->Entries[Next - 1];
+    Table = Entry->Table;
+    Next  = (OemTableId == NULL) ? Entry->NextBySignature : Entry->NextByTableId;
+
+    if (Table->Signature != Signature) {
+      continue;
+    }
+    if (OemTableId != NULL) {
+      if (ReadUnaligned64 (&Table->OemTableId) != ReadUnaligned64 (OemTableId)) {
+        continue;
+      }
+      if (OemId != NULL && CompareMem (Table->OemId, OemId, sizeof (Table->OemId)) != 0) {
+        continue;
+      }
+    }
+
+    return Entry;
+  }
+
+  return NULL;
+}
+
+VOID
+XsdtIndexFree (
+  IN OUT XSDT_INDEX  *Index
+  )
+{
+  if (Index->Entries != NULL) {
+    FreePool (Index->Entries);
+  }
+
+  ZeroMem (Index, sizeof (*Index));
+}
@@ -0,0 +1,98 @@
+/** @file
+
+  Hash index over the firmware XSDT.
+
+  The index is built once per run and answers "which firmware table has
+  this signature", and "this signature and OEM Table ID, and optionally
+  this OEM ID", without walking the XSDT.  Tables that can occur more than
+  once, such as SSDTs, are told apart by their OEM Table ID, so a patched
+  copy of one firmware SSDT can replace exactly that SSDT.
+
+**/
+
+#ifndef __ACPI_PATCHER_XSDT_INDEX_H__
+#define __ACPI_PATCHER_XSDT_INDEX_H__
+
+#include <Uefi.h>
+#include <IndustryStandard/Acpi.h>
+
+typedef struct {
+  EFI_ACPI_DESCRIPTION_HEADER  *Table;
+  //
+  // Next entry in the same bucket, as an Entries index plus one; 0 ends
+  // the chain.  Chains are kept in XSDT order.
+  //
+  UINT32                       NextBySignature;
+  UINT32                       NextByTableId;
+} XSDT_INDEX_ENTRY;
+
+typedef struct {
+  //
+  // XSDT the index describes.
+  //
+  CONST EFI_ACPI_DESCRIPTION_HEADER  *Xsdt;
+  //
+  // One entry per XSDT slot, in XSDT order; NULL slots have a NULL Table.
+  //
+  XSDT_INDEX_ENTRY                   *Entries;
+  UINTN                              Count;
+  //
+  // Bucket heads, encoded like the Next fields.
+  //
+  UINT32                             *BySignature;
+  UINT32                             *ByTableId;
+  UINTN                              BucketMask;
+} XSDT_INDEX;
+
+/**
+  Indexes every entry of an XSDT.
+
+  @param[out] Index  Receives the index; release with XsdtIndexFree().
+  @param[in]  Xsdt   XSDT to index.
+
+  @retval EFI_SUCCESS           The index was built.
+  @retval EFI_OUT_OF_RESOURCES  Memory allocation failed.
+**/
+EFI_STATUS
+XsdtIndexBuild (
+  OUT XSDT_INDEX                         *Index,
+  IN  CONST EFI_ACPI_DESCRIPTION_HEADER  *Xsdt
+  );
+
+/**
+  Finds the next firmware table with Signature and, if given, OemTableId
+  and OemId.
+
+  @param[in] Index       Index to search.
+  @param[in] Signature   Table signature.
+  @param[in] OemTableId  OEM Table ID to match, or NULL for any.
+  @param[in] OemId       Six byte OEM ID to match, or NULL for any.  Only
+                         used together with OemTableId.
+  @param[in] After       Previous match, to continue the search, or NULL
+                         to start from the beginning of the XSDT.
+
+  @return The matching entry, or NULL if there are no more.
+**/
+XSDT_INDEX_ENTRY *
+XsdtIndexFind (
+  IN CONST XSDT_INDEX        *Index,
+  IN       UINT32            Signature,
+  IN CONST UINT64            *OemTableId  OPTIONAL,
+  IN CONST UINT8             *OemId       OPTIONAL,
+  IN CONST XSDT_INDEX_ENTRY  *After       OPTIONAL
+  );
+
+/**
+  Returns the position of an entry in the XSDT it was built from.
+**/
+#define XSDT_INDEX_POSITION(Index, Entry)  ((UINTN) ((Entry) - (Index)->Entries))
+
+/**
+  Releases an index.  Freeing a zeroed or already freed index is allowed.
+**/
+VOID
+XsdtIndexFree (
+  IN OUT XSDT_INDEX  *Index
+  );
+
+#endif // __ACPI_PATCHER_XSDT_INDEX_H__
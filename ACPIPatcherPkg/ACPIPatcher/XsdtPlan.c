@@ -0,0 +1,658 @@
+/** @file
+
+  Two-phase XSDT builder.
+
+  The new XSDT used to be allocated up front with room for the firmware
+  entries plus MAX_ADDITIONAL_TABLES, and every table beyond that failed
+  to install after it had already been loaded.  Planning first means the
+  final entry count is known before the XSDT is allocated, so there is no
+  cap and no growth: the cost is one pass over the firmware entries and
+  one over the plan.
+
+  The same SSDT often sits on an ESP twice, as SSDT-1.aml and SSDT-CPU.aml
+  or in both ACPI\ and its parent, and installing both makes the OS load
+  every object in it twice.  The plan hashes each table as it is added and
+  keeps two chained hash tables over its operations, one keyed on the
+  content hash and one on the signature and OEM Table ID, so a duplicate
+  costs one bucket lookup to find.  A content match is confirmed byte for
+  byte before the table is turned away.
+
+**/
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#define ACPI_LOG_FILE_ID  7
+
+#include "AcpiChecksum.h"
+#include "DebugLog.h"
+#include "XsdtPlan.h"
+
+//
+// Bucket count is a power of two at least this many times the capacity.
+//
+#define XSDT_PLAN_LOAD_FACTOR  2
+#define XSDT_PLAN_MIN_BUCKETS  16
+
+//
+// Eight bytes at a time.  A collision only costs a CompareMem(), so the
+// mixing is kept cheap.
+//
+UINT64
+XsdtPlanHash (
+  IN CONST VOID  *Buffer,
+  IN UINTN       Length
+  )
+{
+  CONST UINT8  *Bytes;
+  UINT64       Hash;
+  UINT64       Word;
+
+  Bytes = Buffer;
+  Hash  = 0x9E3779B97F4A7C15ULL ^ Length;
+  for ( ; Length >= sizeof (UINT64); Length -= sizeof (UINT64), Bytes += sizeof (UINT64)) {
+    Hash  = MultU64x64 (Hash ^ ReadUnaligned64 ((CONST UINT64 *) Bytes), 0xFF51AFD7ED558CCDULL);
+    Hash ^= RShiftU64 (Hash, 32);
+  }
+
+  if (Length > 0) {
+    Word = 0;
+    CopyMem (&Word, Bytes, Length);
+    Hash  = MultU64x64 (Hash ^ Word, 0xFF51AFD7ED558CCDULL);
+    Hash ^= RShiftU64 (Hash, 32);
+  }
+
+  Hash  = MultU64x64 (Hash ^ RShiftU64 (Hash, 29), 0xC4CEB9FE1A85EC53ULL);
+  return Hash ^ RShiftU64 (Hash, 32);
+}
+
+STATIC
+UINTN
+XsdtPlanHashTableId (
+  IN UINT32  Signature,
+  IN UINT64  OemTableId
+  )
+{
+  UINT64  Key;
+
+  Key = MultU64x64 (OemTableId ^ LShiftU64 (Signature, 32) ^ Signature, 0x9E3779B97F4A7C15ULL);
+  return (UINTN) RShiftU64 (Key, 32);
+}
+
+/**
+  An OEM Table ID of all spaces or all zeros does not name a table, so it
+  is not used to match one.
+**/
+STATIC
+BOOLEAN
+XsdtPlanIsBlankTableId (
+  IN UINT64  OemTableId
+  )
+{
+  return (BOOLEAN) (OemTableId == 0 || OemTableId == 0x2020202020202020ULL);
+}
+
+/**
+  Pushes Ops[Position] onto its content and OEM Table ID chains.
+**/
+STATIC
+VOID
+XsdtPlanLink (
+  IN OUT XSDT_PLAN  *Plan,
+  IN     UINTN      Position
+  )
+{
+  XSDT_OP  *Op;
+  UINT64   OemTableId;
+  UINTN    Bucket;
+
+  Op = &Plan->Ops[Position];
+  if (Op->Table == NULL) {
+    return;
+  }
+
+  Bucket                   = (UINTN) Op->Hash & Plan->BucketMask;
+  Op->NextByHash           = Plan->ByHash[Bucket];
+  Plan->ByHash[Bucket]     = (UINT32) (Position + 1);
+
+  OemTableId = ReadUnaligned64 (&Op->Table->OemTableId);
+  if (!XsdtPlanIsBlankTableId (OemTableId)) {
+    Bucket                   = XsdtPlanHashTableId (Op->Signature, OemTableId) & Plan->BucketMask;
+    Op->NextByTableId        = Plan->ByTableId[Bucket];
+    Plan->ByTableId[Bucket]  = (UINT32) (Position + 1);
+  }
+}
+
+/**
+  Allocates the bucket arrays for Capacity operations and links the ones
+  already in the plan into them.
+**/
+STATIC
+EFI_STATUS
+XsdtPlanRehash (
+  IN OUT XSDT_PLAN  *Plan,
+  IN     UINTN      Capacity
+  )
+{
+  UINT32  *Heads;
+  UINTN   Buckets;
+  UINTN   Position;
+
+  Buckets = XSDT_PLAN_MIN_BUCKETS;
+  while (Buckets < Capacity * XSDT_PLAN_LOAD_FACTOR) {
+    Buckets *= 2;
+  }
+
+  Heads = AllocateZeroPool (2 * Buckets * sizeof (UINT32));
+  if (Heads == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  if (Plan->ByHash != NULL) {
+    FreePool (Plan->ByHash);
+  }
+
+  Plan->ByHash     = Heads;
+  Plan->ByTableId  = Heads + Buckets;
+  Plan->BucketMask = Buckets - 1;
+  for (Position = 0; Position < Plan->Count; Position++) {
+    Plan->Ops[Position].NextByHash    = 0;
+    Plan->Ops[Position].NextByTableId = 0;
+    XsdtPlanLink (Plan, Position);
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Finds an operation in the plan whose table Table duplicates: one with
+  the same contents or, if Table has an OEM Table ID, the same signature
+  and OEM Table ID.
+
+  @param[in]  Plan       Plan to search.
+  @param[in]  Table      Table about to be added.
+  @param[in]  Hash       XsdtPlanHash() of Table.
+  @param[out] Identical  TRUE if the match has the same contents.
+
+  @return The matching operation, or NULL if Table is new.
+**/
+STATIC
+CONST XSDT_OP *
+XsdtPlanFindDuplicate (
+  IN  CONST XSDT_PLAN                    *Plan,
+  IN  CONST EFI_ACPI_DESCRIPTION_HEADER  *Table,
+  IN  UINT64                             Hash,
+  OUT BOOLEAN                            *Identical
+  )
+{
+  CONST XSDT_OP  *Op;
+  UINT64         OemTableId;
+  UINT32         Next;
+
+  *Identical = TRUE;
+  for (Next = Plan->ByHash[(UINTN) Hash & Plan->BucketMask]; Next != 0; Next = Op->NextByHash) {
+    Op = &Plan->Ops[Next - 1];
+    if (Op->Hash == Hash && Op->Table->Length == Table->Length &&
+        CompareMem (Op->Table, Table, Table->Length) == 0) {
+      return Op;
+    }
+  }
+
+  *Identical = FALSE;
+  OemTableId = ReadUnaligned64 (&Table->OemTableId);
+  if (XsdtPlanIsBlankTableId (OemTableId)) {
+    return NULL;
+  }
+
+  for (Next = Plan->ByTableId[XsdtPlanHashTableId (Table->Signature, OemTableId) & Plan->BucketMask];
+       Next != 0;
+       Next = Op->NextByTableId) {
+    Op = &Plan->Ops[Next - 1];
+    if (Op->Signature == Table->Signature && ReadUnaligned64 (&Op->Table->OemTableId) == OemTableId) {
+      return Op;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  Checks whether a replacement would put back the very table it replaces:
+  the firmware table it matches by signature, OEM Table ID and OEM ID has
+  the same contents.
+**/
+STATIC
+BOOLEAN
+XsdtPlanMatchesFirmware (
+  IN CONST XSDT_PLAN                    *Plan,
+  IN CONST EFI_ACPI_DESCRIPTION_HEADER  *Table
+  )
+{
+  XSDT_INDEX_ENTRY  *Entry;
+
+  if (Plan->Index == NULL) {
+    return FALSE;
+  }
+
+  Entry = XsdtIndexFind (Plan->Index, Table->Signature, &Table->OemTableId, Table->OemId, NULL);
+  return (BOOLEAN) (Entry != NULL && Entry->Table->Length == Table->Length &&
+                    CompareMem (Entry->Table, Table, Table->Length) == 0);
+}
+
+EFI_STATUS
+XsdtPlanInit (
+  OUT XSDT_PLAN         *Plan,
+  IN  CONST XSDT_INDEX  *Index  OPTIONAL,
+  IN  UINTN             Capacity
+  )
+{
+  ZeroMem (Plan, sizeof (*Plan));
+  Plan->Index    = Index;
+  Plan->Capacity = MAX (Capacity, 8);
+  Plan->Ops      = AllocatePool (Plan->Capacity * sizeof (XSDT_OP));
+  if (Plan->Ops == NULL || EFI_ERROR (XsdtPlanRehash (Plan, Plan->Capacity))) {
+    XsdtPlanFree (Plan);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+XsdtPlanAdd (
+  IN OUT XSDT_PLAN                    *Plan,
+  IN     XSDT_OP_KIND                 Kind,
+  IN     UINT32                       Signature,
+  IN     EFI_ACPI_DESCRIPTION_HEADER  *Table,
+  IN     CONST CHAR16                 *Source
+  )
+{
+  return XsdtPlanAddHashed (
+           Plan,
+           Kind,
+           Signature,
+           Table,
+           (Kind == XsdtOpDrop) ? 0 : XsdtPlanHash (Table, Table->Length),
+           Source
+           );
+}
+
+EFI_STATUS
+XsdtPlanAddHashed (
+  IN OUT XSDT_PLAN                    *Plan,
+  IN     XSDT_OP_KIND                 Kind,
+  IN     UINT32                       Signature,
+  IN     EFI_ACPI_DESCRIPTION_HEADER  *Table,
+  IN     UINT64                       Hash,
+  IN     CONST CHAR16                 *Source
+  )
+{
+  XSDT_OP        *Grown;
+  XSDT_OP        *Op;
+  CONST XSDT_OP  *Duplicate;
+  BOOLEAN        Identical;
+
+  if (Kind != XsdtOpDrop) {
+    Duplicate = XsdtPlanFindDuplicate (Plan, Table, Hash, &Identical);
+    if (Duplicate != NULL) {
+      AcpiDebugPrint (DEBUG_INFO, L"%s skipped: %s %s\n", Source,
+                      Identical ? L"identical to" : L"same signature and OEM Table ID as",
+                      Duplicate->Source);
+      Plan->Duplicates++;
+      return EFI_ALREADY_STARTED;
+    }
+
+    if ((Kind == XsdtOpReplace || Signature == EFI_ACPI_2_0_SECONDARY_SYSTEM_DESCRIPTION_TABLE_SIGNATURE) &&
+        XsdtPlanMatchesFirmware (Plan, Table)) {
+      AcpiDebugPrint (DEBUG_INFO, L"%s skipped: identical to the firmware table\n", Source);
+      Plan->Duplicates++;
+      return EFI_ALREADY_STARTED;
+    }
+  }
+
+  if (Plan->Count == Plan->Capacity) {
+    Grown = ReallocatePool (
+              Plan->Capacity * sizeof (XSDT_OP),
+              Plan->Capacity * 2 * sizeof (XSDT_OP),
+              Plan->Ops
+              );
+    if (Grown == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+    Plan->Ops       = Grown;
+    Plan->Capacity *= 2;
+    if (EFI_ERROR (XsdtPlanRehash (Plan, Plan->Capacity))) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+  }
+
+  Op                = &Plan->Ops[Plan->Count];
+  Op->Kind          = Kind;
+  Op->Signature     = Signature;
+  Op->Table         = (Kind == XsdtOpDrop) ? NULL : Table;
+  Op->Source        = Source;
+  Op->Hash          = Hash;
+  Op->NextByHash    = 0;
+  Op->NextByTableId = 0;
+  XsdtPlanLink (Plan, Plan->Count++);
+  if (Kind == XsdtOpAppend) {
+    Plan->Appends++;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Points the FADT at a new DSDT, keeping the FADT checksum valid.
+**/
+STATIC
+VOID
+XsdtPlanSetDsdt (
+  IN EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE  *Facp,
+  IN EFI_ACPI_DESCRIPTION_HEADER                *Dsdt
+  )
+{
+  AcpiTableSet32 (&Facp->Header, &Facp->Dsdt, (UINT32)(UINTN)Dsdt);
+  if (Facp->Header.Length >= OFFSET_OF (EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE, XDsdt) + sizeof (UINT64)) {
+    AcpiTableSet64 (&Facp->Header, &Facp->XDsdt, (UINT64)(UINTN)Dsdt);
+  }
+}
+
+/**
+  Finds the firmware table a replacement goes in place of: the first one
+  not already claimed by another operation, matching on signature, OEM
+  Table ID and OEM ID, then signature and OEM Table ID, then, except for
+  SSDTs, signature alone.
+**/
+STATIC
+XSDT_INDEX_ENTRY *
+XsdtPlanFindTarget (
+  IN CONST XSDT_INDEX                   *Index,
+  IN CONST XSDT_OP                      **Slots,
+  IN CONST EFI_ACPI_DESCRIPTION_HEADER  *Table
+  )
+{
+  XSDT_INDEX_ENTRY  *Entry;
+  UINTN             Pass;
+
+  for (Pass = 0; Pass < 3; Pass++) {
+    if (Pass == 2 && Table->Signature == EFI_ACPI_2_0_SECONDARY_SYSTEM_DESCRIPTION_TABLE_SIGNATURE) {
+      break;
+    }
+
+    Entry = NULL;
+    do {
+      Entry = XsdtIndexFind (
+                Index,
+                Table->Signature,
+                (Pass < 2) ? &Table->OemTableId : NULL,
+                (Pass == 0) ? Table->OemId : NULL,
+                Entry
+                );
+    } while (Entry != NULL && Slots[XSDT_INDEX_POSITION (Index, Entry)] != NULL);
+
+    if (Entry != NULL) {
+      return Entry;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  Finds the firmware SSDT an appended SSDT is a patched copy of: the first
+  one not already claimed with the same OEM Table ID and OEM ID.  Loading
+  both would define everything in it twice.
+**/
+STATIC
+XSDT_INDEX_ENTRY *
+XsdtPlanFindPatchedSsdt (
+  IN CONST XSDT_INDEX                   *Index,
+  IN CONST XSDT_OP                      **Slots,
+  IN CONST EFI_ACPI_DESCRIPTION_HEADER  *Table
+  )
+{
+  XSDT_INDEX_ENTRY  *Entry;
+
+  if (Table->Signature != EFI_ACPI_2_0_SECONDARY_SYSTEM_DESCRIPTION_TABLE_SIGNATURE) {
+    return NULL;
+  }
+
+  Entry = NULL;
+  do {
+    Entry = XsdtIndexFind (Index, Table->Signature, &Table->OemTableId, Table->OemId, Entry);
+  } while (Entry != NULL && Slots[XSDT_INDEX_POSITION (Index, Entry)] != NULL);
+
+  return Entry;
+}
+
+EFI_STATUS
+XsdtPlanCommit (
+  IN  CONST XSDT_PLAN                            *Plan,
+  IN  CONST EFI_ACPI_DESCRIPTION_HEADER          *Xsdt,
+  IN  EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE  *Facp,
+  IN  TABLE_ARENA                                *Arena,
+  OUT EFI_ACPI_DESCRIPTION_HEADER                **NewXsdt,
+  OUT UINTN                                      *TablesPatched
+  )
+{
+  CONST XSDT_INDEX             *TableIndex;
+  CONST XSDT_OP                *Op;
+  CONST XSDT_OP                *DsdtOp;
+  CONST XSDT_OP                **Slots;
+  BOOLEAN                      *Placed;
+  XSDT_INDEX_ENTRY             *Target;
+  CONST UINT64                 *Entries;
+  UINTN                        EntryCount;
+  UINTN                        Kept;
+  UINTN                        Appended;
+  UINTN                        Patched;
+  UINTN                        Size;
+  UINTN                        Index;
+  BOOLEAN                      Applied;
+  EFI_ACPI_DESCRIPTION_HEADER  *Built;
+  TABLE_ARENA                  Overflow;
+
+  *NewXsdt       = NULL;
+  *TablesPatched = 0;
+
+  TableIndex = Plan->Index;
+  if (TableIndex == NULL || TableIndex->Xsdt != Xsdt) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // Slots[n] is the operation that claimed firmware entry n, if any, and
+  // Placed[n] is set for an append that took the place of a firmware SSDT.
+  // Each operation finds its entry through the index, so this costs one
+  // lookup per operation rather than a walk of the XSDT.
+  //
+  EntryCount = TableIndex->Count;
+  Slots      = AllocateZeroPool (MAX (EntryCount, 1) * sizeof (*Slots) + Plan->Count * sizeof (*Placed));
+  if (Slots == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  Placed = (BOOLEAN *) (Slots + MAX (EntryCount, 1));
+
+  Kept     = EntryCount;
+  Appended = Plan->Appends;
+  Patched  = 0;
+  DsdtOp   = NULL;
+  for (Index = 0; Index < Plan->Count; Index++) {
+    Op = &Plan->Ops[Index];
+
+    //
+    // Whether an appended SSDT is a patched firmware one is only decided
+    // here, against the XSDT being replaced: the firmware SSDT it was
+    // planned against may be gone by the time the plan is committed.
+    //
+    if (Op->Kind == XsdtOpAppend) {
+      Target = XsdtPlanFindPatchedSsdt (TableIndex, Slots, Op->Table);
+      if (Target != NULL) {
+        AcpiDebugPrint (DEBUG_VERBOSE, L"%s matches a firmware SSDT by OEM Table ID, replacing it\n", Op->Source);
+        AcpiDebugPrint (DEBUG_INFO, L"✓ %s replaced\n", Op->Source);
+        Slots[XSDT_INDEX_POSITION (TableIndex, Target)] = Op;
+        Placed[Index] = TRUE;
+        Appended--;
+        Patched++;
+      }
+      continue;
+    }
+
+    //
+    // A DSDT is not an XSDT entry; replacing it only touches the FADT,
+    // which is left alone until the new XSDT is sure to fit.
+    //
+    if (Op->Kind == XsdtOpReplace &&
+        Op->Signature == EFI_ACPI_2_0_DIFFERENTIATED_SYSTEM_DESCRIPTION_TABLE_SIGNATURE) {
+      DsdtOp = Op;
+      continue;
+    }
+
+    Applied = FALSE;
+    if (Op->Kind == XsdtOpDrop) {
+      Target = NULL;
+      while ((Target = XsdtIndexFind (TableIndex, Op->Signature, NULL, NULL, Target)) != NULL) {
+        if (Slots[XSDT_INDEX_POSITION (TableIndex, Target)] == NULL) {
+          Slots[XSDT_INDEX_POSITION (TableIndex, Target)] = Op;
+          Kept--;
+          Applied = TRUE;
+        }
+      }
+    } else {
+      Target = XsdtPlanFindTarget (TableIndex, Slots, Op->Table);
+      if (Target != NULL) {
+        Slots[XSDT_INDEX_POSITION (TableIndex, Target)] = Op;
+        Applied = TRUE;
+      }
+    }
+
+    if (Applied) {
+      AcpiDebugPrint (DEBUG_INFO, L"✓ %s %s\n", Op->Source,
+                      (Op->Kind == XsdtOpDrop) ? L"dropped" : L"replaced");
+      Patched++;
+    } else {
+      AcpiDebugPrint (DEBUG_WARN, L"%s: no firmware table to %s\n", Op->Source,
+                      (Op->Kind == XsdtOpDrop) ? L"drop" : L"replace");
+    }
+  }
+
+  //
+  // The arena was sized for the XSDT, if at all, before the firmware XSDT
+  // was final.  Tables installed since can outgrow that, and the tables
+  // are worth more than keeping the XSDT next to them, so it then gets
+  // pages of its own.
+  //
+  Size  = sizeof (EFI_ACPI_DESCRIPTION_HEADER) + (Kept + Appended) * sizeof (UINT64);
+  Built = NULL;
+  if (TABLE_ARENA_SIZE (Size) <= Arena->Size - Arena->Used) {
+    Built = TableArenaAllocate (Arena, Size);
+  } else if (!EFI_ERROR (TableArenaCreate (&Overflow, Size))) {
+    AcpiDebugPrint (DEBUG_VERBOSE, L"New XSDT does not fit the table arena, placed apart\n");
+    Built = TableArenaAllocate (&Overflow, Size);
+  }
+  if (Built == NULL) {
+    FreePool (Slots);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  if (DsdtOp != NULL) {
+    XsdtPlanSetDsdt (Facp, DsdtOp->Table);
+    AcpiDebugPrint (DEBUG_INFO, L"✓ DSDT replaced from %s\n", DsdtOp->Source);
+    Patched++;
+  }
+
+  //
+  // An empty XSDT with the firmware header, then the firmware entries that
+  // survive, with replacements applied, then the appended tables in plan
+  // order.  Every append keeps the checksum current, so the entries are
+  // never read back.
+  //
+  CopyMem (Built, Xsdt, sizeof (EFI_ACPI_DESCRIPTION_HEADER));
+  Built->Length = sizeof (EFI_ACPI_DESCRIPTION_HEADER);
+  AcpiChecksumTable (Built);
+
+  Entries = (CONST UINT64 *)(Xsdt + 1);
+  for (Index = 0; Index < EntryCount; Index++) {
+    Op = Slots[Index];
+    if (Op == NULL) {
+      AcpiTableAppendEntry (Built, ReadUnaligned64 (&Entries[Index]));
+    } else if (Op->Kind != XsdtOpDrop) {
+      AcpiTableAppendEntry (Built, (UINT64)(UINTN)Op->Table);
+    }
+  }
+
+  for (Index = 0; Index < Plan->Count; Index++) {
+    Op = &Plan->Ops[Index];
+    if (Op->Kind == XsdtOpAppend && !Placed[Index]) {
+      AcpiTableAppendEntry (Built, (UINT64)(UINTN)Op->Table);
+      AcpiDebugPrint (DEBUG_INFO, L"✓ %s added successfully\n", Op->Source);
+      Patched++;
+    }
+  }
+
+  FreePool (Slots);
+
+  AcpiDebugPrint (DEBUG_INFO, L"New XSDT: %d entries, %d appended\n", Kept + Appended, Appended);
+  *NewXsdt       = Built;
+  *TablesPatched = Patched;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+XsdtPlanKeepSources (
+  IN OUT XSDT_PLAN  *Plan
+  )
+{
+  CHAR16  *Sources;
+  CHAR16  *Cursor;
+  UINTN   Size;
+  UINTN   Index;
+
+  Size = 0;
+  for (Index = 0; Index < Plan->Count; Index++) {
+    Size += StrSize (Plan->Ops[Index].Source);
+  }
+
+  //
+  // All the names go in one block, which also replaces any earlier copy.
+  //
+  Sources = AllocatePool (MAX (Size, sizeof (CHAR16)));
+  if (Sources == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Cursor = Sources;
+  for (Index = 0; Index < Plan->Count; Index++) {
+    Size = StrSize (Plan->Ops[Index].Source);
+    CopyMem (Cursor, Plan->Ops[Index].Source, Size);
+    Plan->Ops[Index].Source = Cursor;
+    Cursor += Size / sizeof (CHAR16);
+  }
+
+  if (Plan->Sources != NULL) {
+    FreePool (Plan->Sources);
+  }
+  Plan->Sources = Sources;
+  return EFI_SUCCESS;
+}
+
+VOID
+XsdtPlanFree (
+  IN OUT XSDT_PLAN  *Plan
+  )
+{
+  if (Plan->Ops != NULL) {
+    FreePool (Plan->Ops);
+  }
+  if (Plan->ByHash != NULL) {
+    FreePool (Plan->ByHash);
+  }
+  if (Plan->Sources != NULL) {
+    FreePool (Plan->Sources);
+  }
+
+  ZeroMem (Plan, sizeof (*Plan));
+}
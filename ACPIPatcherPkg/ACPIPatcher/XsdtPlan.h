@@ -0,0 +1,212 @@
+/** @file
+
+  Two-phase XSDT builder.
+
+  Loading a directory first produces a plan: an ordered list of replace,
+  append and drop operations, each carrying its loaded table.  Committing
+  the plan then sizes the new XSDT exactly and writes every entry in one
+  pass, keeping the checksum current as it goes, however many tables were
+  found.
+
+  The plan also keeps every table it holds hashed by content and by
+  signature and OEM Table ID, so a second copy of a table, under another
+  name or in another directory, is turned away before it is installed.
+
+**/
+
+#ifndef __ACPI_PATCHER_XSDT_PLAN_H__
+#define __ACPI_PATCHER_XSDT_PLAN_H__
+
+#include <Uefi.h>
+#include <IndustryStandard/Acpi.h>
+
+#include "TableArena.h"
+#include "XsdtIndex.h"
+
+typedef enum {
+  XsdtOpAppend,     ///< Add Table as a new XSDT entry, or see XsdtPlanCommit().
+  XsdtOpReplace,    ///< Put Table in place of the matching firmware table.
+  XsdtOpDrop        ///< Remove every firmware entry with Signature.
+} XSDT_OP_KIND;
+
+typedef struct {
+  XSDT_OP_KIND                 Kind;
+  UINT32                       Signature;
+  EFI_ACPI_DESCRIPTION_HEADER  *Table;
+  //
+  // Where the table came from, for the log.
+  //
+  CONST CHAR16                 *Source;
+  //
+  // Hash of the whole table, and the next operation in the same content
+  // and OEM Table ID buckets, as an Ops index plus one; 0 ends the chain.
+  //
+  UINT64                       Hash;
+  UINT32                       NextByHash;
+  UINT32                       NextByTableId;
+} XSDT_OP;
+
+typedef struct {
+  XSDT_OP           *Ops;
+  UINTN             Count;
+  UINTN             Capacity;
+  UINTN             Appends;
+  //
+  // Tables turned away by XsdtPlanAdd() as duplicates.
+  //
+  UINTN             Duplicates;
+  //
+  // Bucket heads, encoded like the XSDT_OP Next fields.
+  //
+  UINT32            *ByHash;
+  UINT32            *ByTableId;
+  UINTN             BucketMask;
+  //
+  // Index of the firmware XSDT the plan will be committed against.
+  //
+  CONST XSDT_INDEX  *Index;
+  //
+  // Copies of the Source names, once XsdtPlanKeepSources() has made them.
+  //
+  CHAR16            *Sources;
+} XSDT_PLAN;
+
+/**
+  Prepares an empty plan.
+
+  @param[out] Plan      Plan to initialize; release with XsdtPlanFree().
+  @param[in]  Index     Index of the firmware XSDT, or NULL if the plan is
+                        never committed.
+  @param[in]  Capacity  Expected number of operations.  The plan grows past
+                        it if needed.
+
+  @retval EFI_SUCCESS           The plan is ready.
+  @retval EFI_OUT_OF_RESOURCES  Memory allocation failed.
+**/
+EFI_STATUS
+XsdtPlanInit (
+  OUT XSDT_PLAN         *Plan,
+  IN  CONST XSDT_INDEX  *Index  OPTIONAL,
+  IN  UINTN             Capacity
+  );
+
+/**
+  Appends an operation to a plan.  Table is required for XsdtOpAppend and
+  XsdtOpReplace and ignored for XsdtOpDrop.
+
+  A table is not added if it is byte for byte a table already in the plan,
+  if an earlier table in the plan has the same signature and OEM Table ID,
+  or if it replaces, or is an SSDT appended over, a firmware table with the
+  same contents.  Tables with a
+  blank OEM Table ID are only compared by content.  Each such table is
+  logged and counted in Plan->Duplicates; the caller still owns it.
+
+  @retval EFI_SUCCESS           The operation was recorded.
+  @retval EFI_ALREADY_STARTED   Table duplicates one already planned or in
+                                the firmware, and was not added.
+  @retval EFI_OUT_OF_RESOURCES  Memory allocation failed.
+**/
+EFI_STATUS
+XsdtPlanAdd (
+  IN OUT XSDT_PLAN                    *Plan,
+  IN     XSDT_OP_KIND                 Kind,
+  IN     UINT32                       Signature,
+  IN     EFI_ACPI_DESCRIPTION_HEADER  *Table,
+  IN     CONST CHAR16                 *Source
+  );
+
+/**
+  Like XsdtPlanAdd(), for a table whose XsdtPlanHash() the caller has
+  already computed.  Hash is ignored for XsdtOpDrop.
+**/
+EFI_STATUS
+XsdtPlanAddHashed (
+  IN OUT XSDT_PLAN                    *Plan,
+  IN     XSDT_OP_KIND                 Kind,
+  IN     UINT32                       Signature,
+  IN     EFI_ACPI_DESCRIPTION_HEADER  *Table,
+  IN     UINT64                       Hash,
+  IN     CONST CHAR16                 *Source
+  );
+
+/**
+  Hashes a table's contents with the 64-bit hash the plan uses to find
+  duplicates.  The hash= values in ACPIPatcher.cfg are this hash, as
+  computed by Tools/AcpiManifest.py.
+**/
+UINT64
+XsdtPlanHash (
+  IN CONST VOID  *Buffer,
+  IN UINTN       Length
+  );
+
+/**
+  Builds the XSDT a plan describes.
+
+  The new XSDT is allocated once, from Arena, at its final size.  Firmware
+  entries are copied with drops and replacements applied and appended
+  tables follow in plan order, each one adjusting the checksum as it is
+  written.  A DSDT replacement is made through the FADT, which is where the
+  DSDT is referenced from, and the FADT checksum is kept valid.
+
+  A replacement takes the first firmware table not already replaced with
+  the same signature, OEM Table ID and OEM ID as the new table, then the
+  same signature and OEM Table ID.  Tables other than SSDTs, of which
+  there is normally only one, fall back to the signature alone.
+
+  An appended SSDT with the OEM Table ID and OEM ID of a firmware SSDT is
+  a patched copy of it, and takes its place.  This is decided against
+  Xsdt, not when the table is planned, so the copy is still appended if
+  the firmware SSDT is gone by the time the plan is committed.
+
+  The new XSDT goes in Arena, or in pages of its own below 4 GB if the
+  arena has no room left for it.  Nothing is changed if neither can be
+  had.
+
+  @param[in]  Plan           Plan to apply; it must have been given the
+                             index of Xsdt.
+  @param[in]  Xsdt           Firmware XSDT.
+  @param[in]  Facp           Firmware FADT.
+  @param[in]  Arena          Arena to allocate the new XSDT from.
+  @param[out] NewXsdt        Receives the new XSDT.
+  @param[out] TablesPatched  Receives the number of operations applied, or
+                             0 on error.
+
+  @retval EFI_SUCCESS           The new XSDT was built.
+  @retval EFI_INVALID_PARAMETER The plan has no index of Xsdt.
+  @retval EFI_OUT_OF_RESOURCES  There was no memory for the XSDT.
+**/
+EFI_STATUS
+XsdtPlanCommit (
+  IN  CONST XSDT_PLAN                            *Plan,
+  IN  CONST EFI_ACPI_DESCRIPTION_HEADER          *Xsdt,
+  IN  EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE  *Facp,
+  IN  TABLE_ARENA                                *Arena,
+  OUT EFI_ACPI_DESCRIPTION_HEADER                **NewXsdt,
+  OUT UINTN                                      *TablesPatched
+  );
+
+/**
+  Copies the Source name of every operation into memory the plan owns, so
+  the plan can be committed after the snapshot, manifest or bundle the
+  names came from is gone.  XsdtPlanFree() releases the copies.
+
+  @retval EFI_SUCCESS           Every Source now points into the plan.
+  @retval EFI_OUT_OF_RESOURCES  Memory allocation failed; the plan is
+                                unchanged.
+**/
+EFI_STATUS
+XsdtPlanKeepSources (
+  IN OUT XSDT_PLAN  *Plan
+  );
+
+/**
+  Releases a plan's operation list, buckets and source names.  The tables
+  it refers to are not freed.
+**/
+VOID
+XsdtPlanFree (
+  IN OUT XSDT_PLAN  *Plan
+  );
+
+#endif // __ACPI_PATCHER_XSDT_PLAN_H__
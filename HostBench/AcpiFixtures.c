@@ -0,0 +1,462 @@
+/** @file
+  Synthetic firmware ACPI trees for the host harness.
+
+  Tables are laid out in a single low mapping (below 4 GB) so that the
+  32-bit RSDT/FADT pointer fields the patcher may consult stay valid.
+
+**/
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "HostBench.h"
+#include "AcpiLz.h"
+
+#define FIXTURE_DSDT_SIZE   0x8000
+#define FIXTURE_SSDT_SIZE   0x800
+#define FIXTURE_APIC_SIZE   0xBC
+#define FIXTURE_MCFG_SIZE   0x3C
+#define FIXTURE_FIXED_COUNT 3      // FACP, APIC, MCFG
+
+UINT8
+HostChecksum (
+  IN CONST VOID  *Buffer,
+  IN UINTN       Length
+  )
+{
+  CONST UINT8  *Bytes;
+  UINT8        Sum;
+  UINTN        Index;
+
+  Bytes = Buffer;
+  Sum   = 0;
+  for (Index = 0; Index < Length; Index++) {
+    Sum = (UINT8) (Sum + Bytes[Index]);
+  }
+  return Sum;
+}
+
+VOID
+HostMakeAcpiTable (
+  OUT VOID         *Buffer,
+  IN  UINT32       Signature,
+  IN  UINT32       Length,
+  IN  CONST CHAR8  *OemTableId,
+  IN  UINT32       Seed
+  )
+{
+  EFI_ACPI_DESCRIPTION_HEADER  *Header;
+  UINT8                        *Body;
+  UINT32                       State;
+  UINTN                        Index;
+  CHAR8                        TableId[8];
+
+  Header = Buffer;
+  ZeroMem (Header, sizeof (*Header));
+  Header->Signature       = Signature;
+  Header->Length          = Length;
+  Header->Revision        = 2;
+  CopyMem (Header->OemId, "HOSTBN", sizeof (Header->OemId));
+  SetMem (TableId, sizeof (TableId), ' ');
+  CopyMem (TableId, OemTableId, MIN (strlen (OemTableId), sizeof (TableId)));
+  CopyMem (&Header->OemTableId, TableId, sizeof (TableId));
+  Header->OemRevision     = 1;
+  Header->CreatorId       = SIGNATURE_32 ('H', 'O', 'S', 'T');
+  Header->CreatorRevision = 0x20250101;
+
+  //
+  // xorshift32 keeps bodies deterministic per Seed.
+  //
+  State = Seed * 2654435761U + 1;
+  Body  = (UINT8 *) Buffer + sizeof (*Header);
+  for (Index = 0; Index < Length - sizeof (*Header); Index++) {
+    State ^= State << 13;
+    State ^= State >> 17;
+    State ^= State << 5;
+    Body[Index] = (UINT8) State;
+  }
+
+  Header->Checksum = (UINT8) (0 - HostChecksum (Buffer, Length));
+}
+
+VOID
+HostMakeAmlBody (
+  IN OUT VOID    *Table,
+  IN     UINT32  Seed
+  )
+{
+  //
+  // Device (Dxxx) { Name (_ADR, n) Name (_STA, 0x0F) Method (_DSM, 4) },
+  // Scope (_SB.PCI0.Dxxx) { Name (_HID, ...) }, a field of registers and a
+  // buffer: the shapes a decompiled DSDT is mostly made of.
+  //
+  STATIC CONST UINT8  Records[][24] = {
+    { 0x5B, 0x82, 0x16, 'D', '0', '0', '0', 0x08, '_', 'A', 'D', 'R', 0x0C, 0, 0, 0, 0, 0x08, '_', 'S', 'T', 'A', 0x0A, 0x0F },
+    { 0x10, 0x16, 0x5C, 0x2F, 0x03, '_', 'S', 'B', '_', 'P', 'C', 'I', '0', 'D', '0', '0', '0', 0x08, '_', 'H', 'I', 'D', 0x0D, 'P' },
+    { 0x5B, 0x81, 0x14, 'R', 'E', 'G', '0', 0x01, 'F', '0', '0', '0', 0x08, 'F', '0', '0', '1', 0x08, 0x00, 0x10, 'F', '0', '0', '2' },
+    { 0x14, 0x16, '_', 'D', 'S', 'M', 0x04, 0xA0, 0x0A, 0x93, 0x6A, 0x0A, 0x00, 0xA4, 0x11, 0x03, 0x01, 0x03, 0xA4, 0x0A, 0x00, 0x5B, 0x31, 0x00 },
+    { 0x08, 'B', 'U', 'F', '0', 0x11, 0x11, 0x0A, 0x0E, 0x86, 0x09, 0x00, 0x01, 0x00, 0x00, 0xD0, 0xFE, 0x00, 0x10, 0x00, 0x00, 0x79, 0x00, 0x00 }
+  };
+  EFI_ACPI_DESCRIPTION_HEADER  *Header;
+  UINT8                        *Body;
+  UINTN                        Length;
+  UINTN                        Index;
+  UINTN                        Size;
+  UINT32                       State;
+
+  Header = Table;
+  Body   = (UINT8 *) Table + sizeof (*Header);
+  Length = Header->Length - sizeof (*Header);
+  State  = Seed * 2654435761U + 1;
+  for (Index = 0; Index < Length; Index += Size) {
+    State ^= State << 13;
+    State ^= State >> 17;
+    State ^= State << 5;
+    Size = MIN (sizeof (Records[0]), Length - Index);
+    CopyMem (Body + Index, Records[State % ARRAY_SIZE (Records)], Size);
+    //
+    // A device number and an address that differ from record to record.
+    //
+    if (Size > 6) {
+      Body[Index + 4] = (UINT8) ('0' + (State >> 8) % 10);
+      Body[Index + 5] = (UINT8) ('0' + (State >> 16) % 10);
+    }
+    if (Size > 14) {
+      Body[Index + 13] = (UINT8) (State >> 24);
+    }
+  }
+
+  Header->Checksum = 0;
+  Header->Checksum = (UINT8) (0 - HostChecksum (Table, Header->Length));
+}
+
+/**
+  Appends a literal or match length of Count to Out, after its token
+  nibble of 15.
+**/
+STATIC
+UINT8 *
+HostLzLength (
+  OUT UINT8  *Out,
+  IN  UINTN  Count
+  )
+{
+  for ( ; Count >= 255; Count -= 255) {
+    *Out++ = 255;
+  }
+  *Out++ = (UINT8) Count;
+  return Out;
+}
+
+/**
+  Appends one LZ4 sequence: Literals bytes from Source, then a match of
+  MatchLength at Offset, or no match if MatchLength is 0.
+**/
+STATIC
+UINT8 *
+HostLzSequence (
+  OUT UINT8        *Out,
+  IN  CONST UINT8  *Source,
+  IN  UINTN        Literals,
+  IN  UINTN        Offset,
+  IN  UINTN        MatchLength
+  )
+{
+  UINT8  *Token;
+
+  Token  = Out++;
+  *Token = (UINT8) (MIN (Literals, 15) << 4);
+  if (Literals >= 15) {
+    Out = HostLzLength (Out, Literals - 15);
+  }
+  CopyMem (Out, Source, Literals);
+  Out += Literals;
+  if (MatchLength == 0) {
+    return Out;
+  }
+
+  *Out++  = (UINT8) Offset;
+  *Out++  = (UINT8) (Offset >> 8);
+  *Token |= (UINT8) MIN (MatchLength - 4, 15);
+  if (MatchLength - 4 >= 15) {
+    Out = HostLzLength (Out, MatchLength - 4 - 15);
+  }
+  return Out;
+}
+
+UINTN
+HostLzPack (
+  IN  CONST VOID  *Table,
+  IN  UINTN       Length,
+  OUT VOID        *Packed
+  )
+{
+  STATIC UINT32   Recent[1 << 12];
+  CONST UINT8     *Source;
+  UINT8           *Out;
+  ACPI_LZ_HEADER  *Header;
+  UINTN           Anchor;
+  UINTN           Index;
+  UINTN           Candidate;
+  UINTN           Match;
+  UINT32          Sequence;
+  UINT32          Hash;
+  UINTN           Size;
+
+  Source = Table;
+  Header = Packed;
+  Header->Signature = ACPI_LZ_SIGNATURE;
+  Header->Length    = (UINT32) Length;
+  Out    = (UINT8 *) (Header + 1);
+  ZeroMem (Recent, sizeof (Recent));
+
+  //
+  // Greedy, with one candidate per hash of four bytes.  As LZ4 requires,
+  // no match starts in the last 12 bytes and the last 5 are literals.
+  //
+  Anchor = 0;
+  for (Index = 0; Index + 12 < Length; ) {
+    CopyMem (&Sequence, Source + Index, sizeof (Sequence));
+    Hash      = (Sequence * 2654435761U) >> 20;
+    Candidate = Recent[Hash];
+    Recent[Hash] = (UINT32) (Index + 1);
+    if (Candidate == 0 || Index - (Candidate - 1) > 0xFFFF ||
+        CompareMem (Source + Candidate - 1, Source + Index, sizeof (Sequence)) != 0) {
+      Index++;
+      continue;
+    }
+
+    Candidate--;
+    for (Match = 4; Index + Match + 5 < Length && Source[Candidate + Match] == Source[Index + Match]; Match++) {
+    }
+
+    Out    = HostLzSequence (Out, Source + Anchor, Index - Anchor, Index - Candidate, Match);
+    Index += Match;
+    Anchor = Index;
+  }
+
+  Out  = HostLzSequence (Out, Source + Anchor, Length - Anchor, 0, 0);
+  Size = (UINTN) (Out - (UINT8 *) Packed);
+
+  //
+  // Pad a file that would expand past ACPI_LZ_MAX_RATIO, as
+  // Tools/AcpiCompress.py does.
+  //
+  if (Size * ACPI_LZ_MAX_RATIO < Length) {
+    ZeroMem (Out, (Length + ACPI_LZ_MAX_RATIO - 1) / ACPI_LZ_MAX_RATIO - Size);
+    Size = (Length + ACPI_LZ_MAX_RATIO - 1) / ACPI_LZ_MAX_RATIO;
+  }
+  return Size;
+}
+
+VOID
+HostBuildAcpiTree (
+  OUT HOST_ACPI_TREE  *Tree,
+  IN  UINTN           FirmwareSsdtCount
+  )
+{
+  UINTN        EntryCount;
+  UINTN        XsdtSize;
+  UINTN        Size;
+  UINT8        *Cursor;
+  UINT64       *Entries;
+  UINTN        Index;
+  EFI_ACPI_2_0_ROOT_SYSTEM_DESCRIPTION_POINTER  *Rsdp;
+  EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE     *Facp;
+  int          Flags;
+
+  ZeroMem (Tree, sizeof (*Tree));
+
+  EntryCount = FIXTURE_FIXED_COUNT + FirmwareSsdtCount;
+  XsdtSize   = sizeof (EFI_ACPI_DESCRIPTION_HEADER) + EntryCount * sizeof (UINT64);
+  Size       = ALIGN_VALUE (sizeof (*Rsdp), 16)
+             + ALIGN_VALUE (XsdtSize, 16)
+             + ALIGN_VALUE (sizeof (*Facp), 16)
+             + FIXTURE_DSDT_SIZE
+             + ALIGN_VALUE (FIXTURE_APIC_SIZE, 16)
+             + ALIGN_VALUE (FIXTURE_MCFG_SIZE, 16)
+             + FirmwareSsdtCount * FIXTURE_SSDT_SIZE;
+  Size       = ALIGN_VALUE (Size, EFI_PAGE_SIZE);
+
+  Flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_32BIT
+  Flags |= MAP_32BIT;
+#endif
+  Cursor = mmap (NULL, Size, PROT_READ | PROT_WRITE, Flags, -1, 0);
+  if (Cursor == MAP_FAILED) {
+    return;
+  }
+  ZeroMem (Cursor, Size);
+  Tree->Storage     = Cursor;
+  Tree->StorageSize = Size;
+
+  Rsdp    = (VOID *) Cursor;
+  Cursor += ALIGN_VALUE (sizeof (*Rsdp), 16);
+  Tree->Xsdt = (VOID *) Cursor;
+  Cursor += ALIGN_VALUE (XsdtSize, 16);
+  Facp    = (VOID *) Cursor;
+  Cursor += ALIGN_VALUE (sizeof (*Facp), 16);
+  Tree->Dsdt = (VOID *) Cursor;
+  Cursor += FIXTURE_DSDT_SIZE;
+
+  //
+  // The XSDT body is rewritten below, so the generated noise does not matter;
+  // its checksum is recomputed once every entry is in place.
+  //
+  HostMakeAcpiTable (Tree->Xsdt, EFI_ACPI_2_0_EXTENDED_SYSTEM_DESCRIPTION_TABLE_SIGNATURE, (UINT32) XsdtSize, "FWXSDT", 5);
+  HostMakeAcpiTable (Tree->Dsdt, EFI_ACPI_2_0_DIFFERENTIATED_SYSTEM_DESCRIPTION_TABLE_SIGNATURE, FIXTURE_DSDT_SIZE, "FWDSDT", 1);
+
+  //
+  // The FADT body must be real fields, not noise: only the DSDT pointers
+  // and a plausible profile are filled in.
+  //
+  HostMakeAcpiTable (Facp, EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE_SIGNATURE, sizeof (*Facp), "FWFACP", 2);
+  ZeroMem ((UINT8 *) Facp + sizeof (EFI_ACPI_DESCRIPTION_HEADER), sizeof (*Facp) - sizeof (EFI_ACPI_DESCRIPTION_HEADER));
+  Facp->Header.Revision   = 4;
+  Facp->PreferredPmProfile = 1;
+  Facp->Dsdt              = (UINT32) (UINTN) Tree->Dsdt;
+  Facp->XDsdt             = (UINT64) (UINTN) Tree->Dsdt;
+  Facp->Header.Checksum   = 0;
+  Facp->Header.Checksum   = (UINT8) (0 - HostChecksum (Facp, sizeof (*Facp)));
+
+  Entries    = (UINT64 *) ((UINT8 *) Tree->Xsdt + sizeof (EFI_ACPI_DESCRIPTION_HEADER));
+  Entries[0] = (UINT64) (UINTN) Facp;
+
+  HostMakeAcpiTable (Cursor, EFI_ACPI_2_0_MULTIPLE_APIC_DESCRIPTION_TABLE_SIGNATURE, FIXTURE_APIC_SIZE, "FWAPIC", 3);
+  Entries[1] = (UINT64) (UINTN) Cursor;
+  Cursor    += ALIGN_VALUE (FIXTURE_APIC_SIZE, 16);
+
+  HostMakeAcpiTable (Cursor, EFI_ACPI_2_0_MEMORY_MAPPED_CONFIGURATION_BASE_ADDRESS_TABLE_SIGNATURE, FIXTURE_MCFG_SIZE, "FWMCFG", 4);
+  Entries[2] = (UINT64) (UINTN) Cursor;
+  Cursor    += ALIGN_VALUE (FIXTURE_MCFG_SIZE, 16);
+
+  for (Index = 0; Index < FirmwareSsdtCount; Index++) {
+    CHAR8  TableId[9];
+
+    AsciiSPrint (TableId, sizeof (TableId), "FWSSDT%02d", (UINT32) Index);
+    HostMakeAcpiTable (Cursor, EFI_ACPI_2_0_SECONDARY_SYSTEM_DESCRIPTION_TABLE_SIGNATURE, FIXTURE_SSDT_SIZE, TableId, (UINT32) (100 + Index));
+    Entries[FIXTURE_FIXED_COUNT + Index] = (UINT64) (UINTN) Cursor;
+    Cursor += FIXTURE_SSDT_SIZE;
+  }
+
+  Tree->Xsdt->Checksum = 0;
+  Tree->Xsdt->Checksum = (UINT8) (0 - HostChecksum (Tree->Xsdt, XsdtSize));
+
+  Rsdp->Signature   = EFI_ACPI_2_0_ROOT_SYSTEM_DESCRIPTION_POINTER_SIGNATURE;
+  CopyMem (Rsdp->OemId, "HOSTBN", sizeof (Rsdp->OemId));
+  Rsdp->Revision    = 2;
+  Rsdp->Length      = sizeof (*Rsdp);
+  Rsdp->XsdtAddress = (UINT64) (UINTN) Tree->Xsdt;
+  Rsdp->Checksum    = (UINT8) (0 - HostChecksum (Rsdp, 20));
+  Rsdp->ExtendedChecksum = (UINT8) (0 - HostChecksum (Rsdp, sizeof (*Rsdp)));
+
+  Tree->Rsdp = Rsdp;
+  Tree->Facp = Facp;
+}
+
+VOID
+HostFreeAcpiTree (
+  IN HOST_ACPI_TREE  *Tree
+  )
+{
+  if (Tree->Storage != NULL) {
+    munmap (Tree->Storage, Tree->StorageSize);
+  }
+  ZeroMem (Tree, sizeof (*Tree));
+}
+
+STATIC
+BOOLEAN
+HostTableValid (
+  IN UINT64  Address
+  )
+{
+  EFI_ACPI_DESCRIPTION_HEADER  *Table;
+
+  if (Address == 0) {
+    return FALSE;
+  }
+  Table = (EFI_ACPI_DESCRIPTION_HEADER *) (UINTN) Address;
+  return (BOOLEAN) (Table->Length >= sizeof (*Table) && HostChecksum (Table, Table->Length) == 0);
+}
+
+INTN
+HostVerifyAcpiTree (
+  IN EFI_ACPI_2_0_ROOT_SYSTEM_DESCRIPTION_POINTER  *Rsdp
+  )
+{
+  EFI_ACPI_DESCRIPTION_HEADER                *Xsdt;
+  EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE  *Facp;
+  UINT64                                     *Entries;
+  UINTN                                      Count;
+  UINTN                                      Index;
+  UINT64                                     Dsdt;
+
+  if (Rsdp == NULL || Rsdp->Signature != EFI_ACPI_2_0_ROOT_SYSTEM_DESCRIPTION_POINTER_SIGNATURE) {
+    return -1;
+  }
+  if (HostChecksum (Rsdp, 20) != 0 || HostChecksum (Rsdp, Rsdp->Length) != 0) {
+    return -1;
+  }
+
+  Xsdt = (EFI_ACPI_DESCRIPTION_HEADER *) (UINTN) Rsdp->XsdtAddress;
+  if (!HostTableValid (Rsdp->XsdtAddress) ||
+      Xsdt->Signature != EFI_ACPI_2_0_EXTENDED_SYSTEM_DESCRIPTION_TABLE_SIGNATURE) {
+    return -1;
+  }
+
+  Count   = (Xsdt->Length - sizeof (*Xsdt)) / sizeof (UINT64);
+  Entries = (UINT64 *) (Xsdt + 1);
+  for (Index = 0; Index < Count; Index++) {
+    if (!HostTableValid (ReadUnaligned64 (&Entries[Index]))) {
+      return -1;
+    }
+    Facp = (VOID *) (UINTN) ReadUnaligned64 (&Entries[Index]);
+    if (Facp->Header.Signature == EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE_SIGNATURE) {
+      Dsdt = (Facp->Header.Length >= OFFSET_OF (EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE, XDsdt) + sizeof (UINT64) &&
+              Facp->XDsdt != 0) ? Facp->XDsdt : Facp->Dsdt;
+      if (!HostTableValid (Dsdt)) {
+        return -1;
+      }
+    }
+  }
+  return (INTN) Count;
+}
+
+UINT64 *
+HostListAcpiTables (
+  IN  EFI_ACPI_2_0_ROOT_SYSTEM_DESCRIPTION_POINTER  *Rsdp,
+  OUT UINTN                                         *Count
+  )
+{
+  EFI_ACPI_DESCRIPTION_HEADER                *Xsdt;
+  EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE  *Facp;
+  UINT64                                     *Tables;
+  UINT64                                     *Entries;
+  UINTN                                      EntryCount;
+  UINTN                                      Index;
+  BOOLEAN                                    HaveDsdt;
+
+  Xsdt       = (EFI_ACPI_DESCRIPTION_HEADER *) (UINTN) Rsdp->XsdtAddress;
+  EntryCount = (Xsdt->Length - sizeof (*Xsdt)) / sizeof (UINT64);
+  Entries    = (UINT64 *) (Xsdt + 1);
+
+  //
+  // The XSDT, its entries, and both DSDT pointers of the FADT.
+  //
+  Tables   = malloc ((EntryCount + 3) * sizeof (UINT64));
+  *Count   = 0;
+  HaveDsdt = FALSE;
+  Tables[(*Count)++] = Rsdp->XsdtAddress;
+  for (Index = 0; Index < EntryCount; Index++) {
+    Tables[(*Count)++] = ReadUnaligned64 (&Entries[Index]);
+    Facp = (VOID *) (UINTN) ReadUnaligned64 (&Entries[Index]);
+    if (Facp->Header.Signature == EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE_SIGNATURE && !HaveDsdt) {
+      Tables[(*Count)++] = Facp->Dsdt;
+      Tables[(*Count)++] = Facp->XDsdt;
+      HaveDsdt           = TRUE;
+    }
+  }
+  return Tables;
+}
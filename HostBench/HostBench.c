@@ -0,0 +1,2166 @@
+/** @file
+  Host microbenchmark driver for the ACPIPatcher core.
+
+  Builds a synthetic firmware ACPI tree and an in-memory ESP populated with
+  an AML corpus, then drives the patcher's own entry points through each
+  phase of a boot: checksum, per-file load, directory scan, full patch on a
+  first and a later boot, and the image entry point.  For every phase and corpus size it reports the
+  median wall-clock time together with the allocation, file I/O, console
+  and stall counters collected by the UEFI shim, and whether the resulting
+  RSDP/XSDT/FADT tree is still self-consistent.
+
+  The same driver is linked twice: hostbench (UEFI application build) and
+  hostbench-dxe (ACPIPatcherDxe build, -DDXE_DRIVER_BUILD).
+
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "HostBench.h"
+#include "AcpiBundle.h"
+#include "AcpiChecksum.h"
+#include "AcpiDirHint.h"
+#include "AcpiLz.h"
+#include "DirSnapshot.h"
+#include "TableArena.h"
+#include "XsdtPlan.h"
+
+//
+// Entry points of the code under test (ACPIPatcher.c, AcpiChecksum.c, DirSnapshot.c,
+// FsHelpers.c, TableArena.c, XsdtIndex.c, XsdtPlan.c, AcpiManifest.c, AcpiBundle.c).
+//
+extern EFI_ACPI_2_0_ROOT_SYSTEM_DESCRIPTION_POINTER  *gRsdp;
+extern EFI_ACPI_DESCRIPTION_HEADER                    *gXsdt;
+extern EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE      *gFacp;
+extern XSDT_INDEX                                     gXsdtIndex;
+extern EFI_LOADED_IMAGE_PROTOCOL                      *gAcpiPatcherLoadedImage;
+
+EFI_STATUS  CreateAcpiDirSnapshot (EFI_FILE_PROTOCOL *Directory, DIR_SNAPSHOT *Snapshot);
+EFI_STATUS  LoadAmlFile (CONST DIR_SNAPSHOT *Snapshot, CONST CHAR16 *FileName, TABLE_ARENA *Arena, EFI_ACPI_DESCRIPTION_HEADER **AmlTable, UINTN *TableSize);
+EFI_STATUS  ScanDirectoryForSsdtFiles (DIR_SNAPSHOT *Snapshot, TABLE_ARENA *Arena, XSDT_PLAN *Plan);
+EFI_STATUS  PatchAcpiTables (EFI_FILE_PROTOCOL *Directory, EFI_ACPI_DESCRIPTION_HEADER *Xsdt, EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE *Facp);
+EFI_STATUS  EFIAPI AcpiPatcherEntryPoint (EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE *SystemTable);
+
+#ifdef DXE_DRIVER_BUILD
+#define BENCH_MODE          "dxe"
+//
+// A firmware-loaded driver has no file path on the ESP, so the corpus lives
+// where FindAcpiFilesDirectory() looks for it.
+//
+#define BENCH_ACPI_DIR      "\\EFI\\OC\\ACPI"
+#define BENCH_SELF_DIR      BENCH_ACPI_DIR
+#else
+#define BENCH_MODE          "app"
+#define BENCH_ACPI_DIR      "\\EFI\\ACPIPatcher\\ACPI"
+#define BENCH_SELF_DIR      "\\EFI\\ACPIPatcher"
+#endif
+#define BENCH_IMAGE_PATH    L"\\EFI\\ACPIPatcher\\ACPIPatcher.efi"
+
+#define BENCH_MAX_ITERATIONS  64
+#define BENCH_FIRMWARE_SSDTS  8
+
+//
+// Data volumes the firmware enumerates ahead of the ESP, as it does for an
+// internal disk on a lower port.  None of them holds any tables.
+//
+#define BENCH_DATA_VOLUMES  3
+
+//
+// The emulated slow disk the disk-* phases read from: each file read waits
+// this long for the device.  Corpora smaller than BENCH_DISK_MIN_FILES
+// skip them.
+//
+#define BENCH_DISK_ACCESS_NS   (200ULL * 1000)
+#define BENCH_DISK_MIN_FILES   50
+
+//
+// What the bundle-* phases add to the slow disk: the FAT driver's walk of
+// a file's cluster chain, per 4 KB cluster read, and the block the bundle
+// is laid out from when it is located.
+//
+#define BENCH_DISK_CLUSTER_NS  (20ULL * 1000)
+#define BENCH_BUNDLE_LBA       4096
+
+//
+// What the read-* phases add to the slow disk instead: the transfer of
+// each 4 KB at USB 2 stick speed, about 20 MB/s.
+//
+#define BENCH_SLOW_CLUSTER_NS  (200ULL * 1000)
+
+//
+// A stray file in the corpus directory that ends in .aml but is far too
+// large to be a table, such as a disk image someone renamed.  It is larger
+// than all memory below 4 GB the host can give.
+//
+#define BENCH_STRAY_SIZE  (3ULL * SIZE_1GB)
+
+//
+// Simulated time from the driver's entry to ReadyToBoot.
+//
+#define BENCH_DXE_DISPATCH_NS  (100ULL * 1000 * 1000)
+
+typedef struct {
+  UINTN         Iterations;
+  CONST CHAR8   *CorpusDirectory;
+  UINTN         Sizes[8];
+  UINTN         SizeCount;
+  BOOLEAN       Quick;
+} BENCH_OPTIONS;
+
+typedef struct {
+  UINT64         Nanoseconds[BENCH_MAX_ITERATIONS];
+  UINTN          Count;
+  HOST_COUNTERS  Counters;
+  UINT64         Leaks;
+  INTN           XsdtEntries;
+} PHASE_RESULT;
+
+//
+// Everything a single phase iteration needs: a fresh ACPI tree, the image
+// and volume handles, and the directory the patcher should read from.
+//
+typedef struct {
+  HOST_FS_NODE               *Volume;
+  HOST_FS_NODE               *DataVolume;
+  HOST_ACPI_TREE             Tree;
+  EFI_HANDLE                 ImageHandle;
+  EFI_HANDLE                 VolumeHandle;
+  EFI_LOADED_IMAGE_PROTOCOL  LoadedImage;
+  UINT8                      ImagePath[512];
+  UINT8                      VolumePath[sizeof (HARDDRIVE_DEVICE_PATH) + sizeof (EFI_DEVICE_PATH_PROTOCOL)];
+  //
+  // The corpus volume is only connected after the entry point has run, as
+  // a slow disk would be.
+  //
+  BOOLEAN                    LateCorpus;
+  //
+  // The firmware's ACPI tables are only published after the entry point
+  // has run, as a platform driver dispatched later would.
+  //
+  BOOLEAN                    LateAcpi;
+  //
+  // Tables in the synthetic corpus, which says what the patched tree must
+  // hold; 0 for an imported corpus, which is only checked for consistency.
+  //
+  UINTN                      CorpusTables;
+  //
+  // Corpus table the phase has made unfit to load, which must not be in
+  // the patched tree; 0 if there is none.
+  //
+  UINTN                      SkippedTable;
+  //
+  // Corpus table the phase has rewritten, and the XsdtPlanHash() of its
+  // new contents, which the patched tree must hold; 0 if there is none.
+  //
+  UINTN                      ChangedTable;
+  UINT64                     ChangedHash;
+} BENCH_ENV;
+
+STATIC HOST_COUNTERS  mStart;
+//
+// Phases that left a broken tree or leaked memory, and self-tests that
+// failed; main() fails if there are any.
+//
+STATIC UINTN          mFailedPhases;
+
+STATIC
+VOID
+CounterBegin (
+  VOID
+  )
+{
+  mStart = gHostCounters;
+}
+
+STATIC
+VOID
+CounterEnd (
+  OUT HOST_COUNTERS  *Delta
+  )
+{
+  UINT64  *Out;
+  UINT64  *Now;
+  UINT64  *Then;
+  UINTN   Index;
+
+  Out  = (UINT64 *) Delta;
+  Now  = (UINT64 *) &gHostCounters;
+  Then = (UINT64 *) &mStart;
+  for (Index = 0; Index < sizeof (HOST_COUNTERS) / sizeof (UINT64); Index++) {
+    Out[Index] = Now[Index] - Then[Index];
+  }
+}
+
+STATIC
+int
+CompareU64 (
+  const void  *A,
+  const void  *B
+  )
+{
+  UINT64  Left;
+  UINT64  Right;
+
+  Left  = *(const UINT64 *) A;
+  Right = *(const UINT64 *) B;
+  return (Left > Right) - (Left < Right);
+}
+
+STATIC
+UINT64
+Median (
+  IN PHASE_RESULT  *Result
+  )
+{
+  qsort (Result->Nanoseconds, Result->Count, sizeof (UINT64), CompareU64);
+  return Result->Nanoseconds[Result->Count / 2];
+}
+
+STATIC
+VOID
+PrintHeader (
+  VOID
+  )
+{
+  printf (
+    "%-4s %-10s %5s %12s %7s %9s %6s %6s %6s %9s %6s %6s %7s %9s %8s %8s %6s %5s\n",
+    "mode", "phase", "files", "median_us", "allocs", "alloc_kb", "opens", "misses",
+    "reads", "read_kb", "dirrd", "writes", "flushes", "console", "serial", "stall_ms", "leaks", "xsdt"
+    );
+}
+
+STATIC
+VOID
+PrintResult (
+  IN CONST CHAR8   *Phase,
+  IN UINTN         Files,
+  IN PHASE_RESULT  *Result
+  )
+{
+  HOST_COUNTERS  *C;
+  CHAR8          Xsdt[24];
+
+  C = &Result->Counters;
+  if ((Result->XsdtEntries < 0 && Result->XsdtEntries != -2) || Result->Leaks != 0) {
+    mFailedPhases++;
+  }
+
+  if (Result->XsdtEntries == -2) {
+    snprintf (Xsdt, sizeof (Xsdt), "-");
+  } else if (Result->XsdtEntries < 0) {
+    snprintf (Xsdt, sizeof (Xsdt), "BAD");
+  } else {
+    snprintf (Xsdt, sizeof (Xsdt), "%ld", (long) Result->XsdtEntries);
+  }
+
+  printf (
+    "%-4s %-10s %5lu %12.1f %7llu %9llu %6llu %6llu %6llu %9llu %6llu %6llu %7llu %9llu %8llu %8llu %6llu %5s\n",
+    BENCH_MODE,
+    Phase,
+    (unsigned long) Files,
+    Median (Result) / 1000.0,
+    (unsigned long long) (C->PoolAllocations + C->PageAllocations),
+    (unsigned long long) ((C->PoolBytes + C->PageBytes) / 1024),
+    (unsigned long long) C->FileOpens,
+    (unsigned long long) C->FileOpenMisses,
+    (unsigned long long) C->FileReads,
+    (unsigned long long) (C->FileReadBytes / 1024),
+    (unsigned long long) C->DirectoryReads,
+    (unsigned long long) C->FileWrites,
+    (unsigned long long) C->FileFlushes,
+    (unsigned long long) C->ConsoleCharacters,
+    (unsigned long long) C->SerialBytes,
+    (unsigned long long) (C->StallMicroseconds / 1000),
+    (unsigned long long) Result->Leaks,
+    Xsdt
+    );
+  fflush (stdout);
+}
+
+//
+// An ACPIPatcher.apb being built in memory, laid out as
+// Tools/AcpiBundle.py writes it.
+//
+typedef struct {
+  UINT8   *Data;
+  UINTN   Size;
+  UINTN   Count;
+} BENCH_BUNDLE;
+
+/**
+  Starts a bundle with room for MaxCount entries.
+**/
+STATIC
+VOID
+BundleBegin (
+  OUT BENCH_BUNDLE  *Bundle,
+  IN  UINTN         MaxCount
+  )
+{
+  Bundle->Size  = ALIGN_VALUE (sizeof (ACPI_BUNDLE_HEADER) + MaxCount * sizeof (ACPI_BUNDLE_ENTRY), ACPI_BUNDLE_ALIGNMENT);
+  Bundle->Data  = calloc (1, Bundle->Size);
+  Bundle->Count = 0;
+}
+
+/**
+  Appends a table to a bundle started with room for it.
+**/
+STATIC
+VOID
+BundleAdd (
+  IN OUT BENCH_BUNDLE                       *Bundle,
+  IN     UINT8                              Action,
+  IN     CONST EFI_ACPI_DESCRIPTION_HEADER  *Table,
+  IN     CONST CHAR8                        *Name
+  )
+{
+  ACPI_BUNDLE_ENTRY  *Entry;
+  UINTN              Offset;
+
+  Offset       = Bundle->Size;
+  Bundle->Size = Offset + ALIGN_VALUE (Table->Length, ACPI_BUNDLE_ALIGNMENT);
+  Bundle->Data = realloc (Bundle->Data, Bundle->Size);
+  memset (Bundle->Data + Offset, 0, Bundle->Size - Offset);
+  memcpy (Bundle->Data + Offset, Table, Table->Length);
+
+  Entry = (ACPI_BUNDLE_ENTRY *) (Bundle->Data + sizeof (ACPI_BUNDLE_HEADER)) + Bundle->Count++;
+  Entry->Signature  = Table->Signature;
+  Entry->Action     = Action;
+  Entry->Offset     = (UINT32) Offset;
+  Entry->Length     = Table->Length;
+  memcpy (Entry->OemId, Table->OemId, sizeof (Entry->OemId));
+  Entry->OemTableId = Table->OemTableId;
+  Entry->Hash       = XsdtPlanHash (Table, Table->Length);
+  snprintf (Entry->Name, sizeof (Entry->Name), "%s", Name);
+}
+
+/**
+  Fills in the header of a bundle whose entries have all been added.
+**/
+STATIC
+VOID
+BundleEnd (
+  IN OUT BENCH_BUNDLE  *Bundle
+  )
+{
+  ACPI_BUNDLE_HEADER  *Header;
+
+  Header             = (ACPI_BUNDLE_HEADER *) Bundle->Data;
+  Header->Signature  = ACPI_BUNDLE_SIGNATURE;
+  Header->Version    = ACPI_BUNDLE_VERSION;
+  Header->EntrySize  = sizeof (ACPI_BUNDLE_ENTRY);
+  Header->EntryCount = (UINT32) Bundle->Count;
+  Header->Size       = (UINT32) Bundle->Size;
+  Header->TocHash    = XsdtPlanHash (Header + 1, Bundle->Count * sizeof (ACPI_BUNDLE_ENTRY));
+}
+
+/**
+  Populates Directory with Count AML files shaped like a typical
+  OpenCore/Clover ACPI folder: a DSDT, the legacy SSDT-1..SSDT-10 names,
+  descriptive SSDT-*.aml names and a few other tables, plus the clutter
+  real ESPs carry (macOS resource forks, non-AML files, a duplicate SSDT).
+
+  Manifest receives the ACPIPatcher.cfg that loads the same tables, with
+  sizes and hashes, and Bundle an ACPIPatcher.apb holding them; neither is
+  added to the directory.  Free Manifest and Bundle->Data with free().
+**/
+STATIC
+VOID
+PopulateSyntheticCorpus (
+  IN  HOST_FS_NODE  *Volume,
+  IN  CONST CHAR8   *Directory,
+  IN  UINTN         Count,
+  OUT CHAR8         **Manifest,
+  OUT BENCH_BUNDLE  *Bundle
+  )
+{
+  STATIC UINT8  Table[0x10000];
+  CHAR8         Path[512];
+  CHAR8         TableId[9];
+  UINTN         Index;
+  UINT32        Length;
+  size_t        Used;
+
+  HostFsAddDirectory (Volume, Directory);
+
+  //
+  // One line per table, each well under 96 bytes.
+  //
+  *Manifest = malloc (Count * 96 + 64);
+  Used      = (size_t) snprintf (*Manifest, 64, "# HostBench corpus\r\n");
+  BundleBegin (Bundle, Count);
+
+  for (Index = 0; Index < Count; Index++) {
+    if (Index == 0) {
+      snprintf (Path, sizeof (Path), "%s\\DSDT.aml", Directory);
+      HostMakeAcpiTable (Table, EFI_ACPI_2_0_DIFFERENTIATED_SYSTEM_DESCRIPTION_TABLE_SIGNATURE, sizeof (Table), "PATCHDSD", 1);
+      HostFsAddFile (Volume, Path, Table, sizeof (Table));
+      Used += (size_t) snprintf (*Manifest + Used, 96, "replace DSDT.aml size=%lu hash=%016llX\r\n",
+                                 (unsigned long) sizeof (Table),
+                                 (unsigned long long) XsdtPlanHash (Table, sizeof (Table)));
+      BundleAdd (Bundle, ACPI_BUNDLE_ACTION_REPLACE, (EFI_ACPI_DESCRIPTION_HEADER *) Table, "DSDT.aml");
+      continue;
+    }
+
+    if (Index <= 10) {
+      snprintf (Path, sizeof (Path), "%s\\SSDT-%lu.aml", Directory, (unsigned long) Index);
+    } else if (Index % 4 == 0) {
+      snprintf (Path, sizeof (Path), "%s\\Tbl%04lu.aml", Directory, (unsigned long) Index);
+    } else {
+      snprintf (Path, sizeof (Path), "%s\\SSDT-Dev%04lu.aml", Directory, (unsigned long) Index);
+    }
+
+    //
+    // 1 KB .. 16 KB, deterministic per index.
+    //
+    Length = (UINT32) (0x400 + ((Index * 2654435761U) % 0x3C00));
+    //
+    // SSDT-1 is a patched copy of the first firmware SSDT and replaces it.
+    //
+    if (Index == 1) {
+      snprintf (TableId, sizeof (TableId), "FWSSDT00");
+    } else {
+      snprintf (TableId, sizeof (TableId), "P%07lu", (unsigned long) (Index % 10000000));
+    }
+    HostMakeAcpiTable (Table, EFI_ACPI_2_0_SECONDARY_SYSTEM_DESCRIPTION_TABLE_SIGNATURE, Length, TableId, (UINT32) (1000 + Index));
+    HostFsAddFile (Volume, Path, Table, Length);
+
+    //
+    // Lines carry a size and hash, as Tools/AcpiManifest.py writes them,
+    // except every tenth, which leaves the size to be looked up.
+    //
+    if (Index % 10 != 5) {
+      Used += (size_t) snprintf (*Manifest + Used, 96, "%s %s size=%lu hash=%016llX\r\n",
+                                 (Index == 1) ? "replace" : "append", strrchr (Path, '\\') + 1,
+                                 (unsigned long) Length, (unsigned long long) XsdtPlanHash (Table, Length));
+    } else {
+      Used += (size_t) snprintf (*Manifest + Used, 96, "%s %s\r\n",
+                                 (Index == 1) ? "replace" : "append", strrchr (Path, '\\') + 1);
+    }
+    BundleAdd (Bundle, (Index == 1) ? ACPI_BUNDLE_ACTION_REPLACE : ACPI_BUNDLE_ACTION_APPEND,
+               (EFI_ACPI_DESCRIPTION_HEADER *) Table, strrchr (Path, '\\') + 1);
+  }
+
+  //
+  // A stray second copy of SSDT-2 under a descriptive name, which the plan
+  // should turn away.
+  //
+  if (Count > 2) {
+    Length = (UINT32) (0x400 + (((UINTN) 2 * 2654435761U) % 0x3C00));
+    HostMakeAcpiTable (Table, EFI_ACPI_2_0_SECONDARY_SYSTEM_DESCRIPTION_TABLE_SIGNATURE, Length, "P0000002", 1002);
+    snprintf (Path, sizeof (Path), "%s\\SSDT-CPU.aml", Directory);
+    HostFsAddFile (Volume, Path, Table, Length);
+  }
+
+  BundleEnd (Bundle);
+
+  snprintf (Path, sizeof (Path), "%s\\._SSDT-Dev0011.aml", Directory);
+  HostFsAddFile (Volume, Path, "\0\5\26\7", 4);
+  snprintf (Path, sizeof (Path), "%s\\README.txt", Directory);
+  HostFsAddFile (Volume, Path, "ACPI patches\n", 13);
+}
+
+STATIC
+VOID
+BuildImagePath (
+  OUT BENCH_ENV  *Env
+  )
+{
+  FILEPATH_DEVICE_PATH      *FilePath;
+  EFI_DEVICE_PATH_PROTOCOL  *End;
+  UINTN                     NodeLength;
+
+  NodeLength = SIZE_OF_FILEPATH_DEVICE_PATH + StrSize (BENCH_IMAGE_PATH);
+  FilePath   = (FILEPATH_DEVICE_PATH *) Env->ImagePath;
+  FilePath->Header.Type      = MEDIA_DEVICE_PATH;
+  FilePath->Header.SubType   = MEDIA_FILEPATH_DP;
+  FilePath->Header.Length[0] = (UINT8) NodeLength;
+  FilePath->Header.Length[1] = (UINT8) (NodeLength >> 8);
+  CopyMem (FilePath->PathName, BENCH_IMAGE_PATH, StrSize (BENCH_IMAGE_PATH));
+
+  End = (EFI_DEVICE_PATH_PROTOCOL *) (Env->ImagePath + NodeLength);
+  End->Type      = END_DEVICE_PATH_TYPE;
+  End->SubType   = END_ENTIRE_DEVICE_PATH_SUBTYPE;
+  End->Length[0] = sizeof (*End);
+  End->Length[1] = 0;
+}
+
+/**
+  Builds the device path of the corpus volume: a GPT ESP partition, as
+  the firmware reports one.
+**/
+STATIC
+VOID
+BuildVolumePath (
+  OUT BENCH_ENV  *Env
+  )
+{
+  STATIC CONST UINT8        PartitionGuid[16] = {
+    0x3d, 0x8a, 0x51, 0x6c, 0x27, 0x0e, 0x4b, 0x45, 0x91, 0x4f, 0x0a, 0x2c, 0x61, 0xd7, 0x3e, 0x88
+  };
+  HARDDRIVE_DEVICE_PATH     *HardDrive;
+  EFI_DEVICE_PATH_PROTOCOL  *End;
+
+  HardDrive = (HARDDRIVE_DEVICE_PATH *) Env->VolumePath;
+  ZeroMem (HardDrive, sizeof (*HardDrive));
+  HardDrive->Header.Type      = MEDIA_DEVICE_PATH;
+  HardDrive->Header.SubType   = MEDIA_HARDDRIVE_DP;
+  HardDrive->Header.Length[0] = sizeof (*HardDrive);
+  HardDrive->PartitionNumber  = 1;
+  HardDrive->PartitionStart   = 2048;
+  HardDrive->PartitionSize    = 409600;
+  HardDrive->MBRType          = MBR_TYPE_EFI_PARTITION_TABLE_HEADER;
+  HardDrive->SignatureType    = SIGNATURE_TYPE_GUID;
+  CopyMem (HardDrive->Signature, PartitionGuid, sizeof (PartitionGuid));
+
+  End = (EFI_DEVICE_PATH_PROTOCOL *) (HardDrive + 1);
+  End->Type      = END_DEVICE_PATH_TYPE;
+  End->SubType   = END_ENTIRE_DEVICE_PATH_SUBTYPE;
+  End->Length[0] = sizeof (*End);
+  End->Length[1] = 0;
+}
+
+/**
+  Points BootCurrent at a boot option that loads OpenCore from the corpus
+  volume, in the short form boot managers create for GPT disks.
+**/
+STATIC
+VOID
+BuildBootOption (
+  IN BENCH_ENV  *Env
+  )
+{
+  STATIC CONST CHAR16       Description[] = L"OpenCore";
+  STATIC CONST CHAR16       Loader[]      = L"\\EFI\\OC\\OpenCore.efi";
+  UINT8                     Option[256];
+  FILEPATH_DEVICE_PATH      *FilePath;
+  EFI_DEVICE_PATH_PROTOCOL  *End;
+  UINTN                     PathOffset;
+  UINTN                     NodeLength;
+  UINTN                     Size;
+  UINT16                    BootCurrent;
+
+  //
+  // Attributes (LOAD_OPTION_ACTIVE), FilePathListLength, Description, FilePathList
+  //
+  ZeroMem (Option, sizeof (Option));
+  WriteUnaligned32 ((UINT32 *) Option, 0x00000001);
+  PathOffset = sizeof (UINT32) + sizeof (UINT16) + sizeof (Description);
+  CopyMem (Option + sizeof (UINT32) + sizeof (UINT16), Description, sizeof (Description));
+
+  CopyMem (Option + PathOffset, Env->VolumePath, sizeof (HARDDRIVE_DEVICE_PATH));
+  NodeLength = SIZE_OF_FILEPATH_DEVICE_PATH + sizeof (Loader);
+  FilePath   = (FILEPATH_DEVICE_PATH *) (Option + PathOffset + sizeof (HARDDRIVE_DEVICE_PATH));
+  FilePath->Header.Type      = MEDIA_DEVICE_PATH;
+  FilePath->Header.SubType   = MEDIA_FILEPATH_DP;
+  FilePath->Header.Length[0] = (UINT8) NodeLength;
+  FilePath->Header.Length[1] = (UINT8) (NodeLength >> 8);
+  CopyMem (FilePath->PathName, Loader, sizeof (Loader));
+
+  End = (EFI_DEVICE_PATH_PROTOCOL *) ((UINT8 *) FilePath + NodeLength);
+  End->Type      = END_DEVICE_PATH_TYPE;
+  End->SubType   = END_ENTIRE_DEVICE_PATH_SUBTYPE;
+  End->Length[0] = sizeof (*End);
+  End->Length[1] = 0;
+
+  Size = (UINT8 *) (End + 1) - (Option + PathOffset);
+  WriteUnaligned16 ((UINT16 *) (Option + sizeof (UINT32)), (UINT16) Size);
+  Size += PathOffset;
+
+  BootCurrent = 0x0001;
+  gRT->SetVariable (L"Boot0001", &gEfiGlobalVariableGuid, EFI_VARIABLE_BOOTSERVICE_ACCESS, Size, Option);
+  gRT->SetVariable (L"BootCurrent", &gEfiGlobalVariableGuid, EFI_VARIABLE_BOOTSERVICE_ACCESS, sizeof (BootCurrent), &BootCurrent);
+}
+
+/**
+  Connects the corpus volume.
+**/
+STATIC
+VOID
+InstallCorpusVolume (
+  IN OUT BENCH_ENV  *Env
+  )
+{
+  //
+  // The device path and the partition driver's ESP marker go first: the
+  // driver may look at them as soon as the file system is installed.
+  //
+  HostInstallProtocol (&Env->VolumeHandle, &gEfiDevicePathProtocolGuid, Env->VolumePath);
+  HostInstallProtocol (&Env->VolumeHandle, &gEfiPartTypeSystemPartGuid, NULL);
+  HostInstallProtocol (&Env->VolumeHandle, &gEfiBlockIoProtocolGuid, HostFsGetBlockIo (Env->Volume));
+  HostInstallProtocol (&Env->VolumeHandle, &gEfiDiskIoProtocolGuid, HostFsGetDiskIo (Env->Volume));
+  HostInstallProtocol (&Env->VolumeHandle, &gEfiSimpleFileSystemProtocolGuid, HostFsGetProtocol (Env->Volume));
+}
+
+/**
+  Resets every piece of global state the patcher keeps between calls and
+  gives it a fresh firmware ACPI tree and handle database.
+**/
+STATIC
+VOID
+EnvironmentReset (
+  IN OUT BENCH_ENV  *Env
+  )
+{
+  EFI_HANDLE  DataHandle;
+  UINTN       Index;
+
+  HostReleaseAllocations ();
+  HostFreeAcpiTree (&Env->Tree);
+  HostBuildAcpiTree (&Env->Tree, BENCH_FIRMWARE_SSDTS);
+
+  HostShimInitialize ();
+  HostResetHandleDatabase ();
+  if (!Env->LateAcpi) {
+    HostInstallConfigurationTable (&gEfiAcpi20TableGuid, Env->Tree.Rsdp);
+  }
+
+  gRsdp                   = NULL;
+  gXsdt                   = NULL;
+  gFacp                   = NULL;
+  gAcpiPatcherLoadedImage = NULL;
+  //
+  // Its storage went with HostReleaseAllocations(); the next tree may well
+  // be mapped at the same address, so it must not look valid.
+  //
+  ZeroMem (&gXsdtIndex, sizeof (gXsdtIndex));
+
+  //
+  // Data volumes come first in handle order, so a search that takes the
+  // volumes as they come opens every one of them before the ESP.
+  //
+  for (Index = 0; Index < BENCH_DATA_VOLUMES; Index++) {
+    DataHandle = NULL;
+    HostInstallProtocol (&DataHandle, &gEfiSimpleFileSystemProtocolGuid, HostFsGetProtocol (Env->DataVolume));
+  }
+
+  Env->VolumeHandle = NULL;
+  if (!Env->LateCorpus) {
+    InstallCorpusVolume (Env);
+  }
+
+  ZeroMem (&Env->LoadedImage, sizeof (Env->LoadedImage));
+  Env->LoadedImage.Revision     = 0x1000;
+  Env->LoadedImage.SystemTable  = gST;
+#ifdef DXE_DRIVER_BUILD
+  //
+  // Drivers dispatched from a firmware volume carry no file path on the ESP.
+  //
+  Env->LoadedImage.DeviceHandle = NULL;
+  Env->LoadedImage.FilePath     = NULL;
+#else
+  Env->LoadedImage.DeviceHandle = Env->VolumeHandle;
+  Env->LoadedImage.FilePath     = (EFI_DEVICE_PATH_PROTOCOL *) Env->ImagePath;
+#endif
+  Env->ImageHandle = NULL;
+  HostInstallProtocol (&Env->ImageHandle, &gEfiLoadedImageProtocolGuid, &Env->LoadedImage);
+  gImageHandle = Env->ImageHandle;
+
+  ZeroMem (&gHostCounters, sizeof (gHostCounters));
+}
+
+STATIC
+EFI_FILE_PROTOCOL *
+OpenDirectory (
+  IN BENCH_ENV    *Env,
+  IN CONST CHAR16 *Path
+  )
+{
+  EFI_SIMPLE_FILE_SYSTEM_PROTOCOL  *Fs;
+  EFI_FILE_PROTOCOL                *Root;
+  EFI_FILE_PROTOCOL                *Dir;
+
+  Fs = HostFsGetProtocol (Env->Volume);
+  if (EFI_ERROR (Fs->OpenVolume (Fs, &Root))) {
+    return NULL;
+  }
+  if (EFI_ERROR (Root->Open (Root, &Dir, (CHAR16 *) Path, EFI_FILE_MODE_READ, 0))) {
+    Dir = NULL;
+  }
+  Root->Close (Root);
+  return Dir;
+}
+
+/**
+  Checks the patched tree against what the synthetic corpus of
+  Env->CorpusTables tables makes of the firmware tree:
+
+  - DSDT.aml in place of the firmware DSDT, through both FADT pointers
+  - SSDT-1.aml in place of the firmware SSDT with its OEM Table ID, and
+    every other firmware entry where it was
+  - then each other corpus SSDT once, in whatever order the phase loads
+    them; the stray copy of SSDT-2, the AppleDouble file and
+    Env->SkippedTable are not there, and Env->ChangedTable has its new
+    contents
+**/
+STATIC
+BOOLEAN
+BenchCheckPatched (
+  IN BENCH_ENV  *Env
+  )
+{
+  EFI_ACPI_DESCRIPTION_HEADER                *Xsdt;
+  EFI_ACPI_DESCRIPTION_HEADER                *Table;
+  EFI_ACPI_DESCRIPTION_HEADER                *Firmware;
+  EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE  *Facp;
+  UINT64                                     *Entries;
+  UINT64                                     *FirmwareEntries;
+  UINTN                                      FirmwareCount;
+  UINTN                                      Count;
+  UINTN                                      Files;
+  UINTN                                      Index;
+  UINTN                                      Position;
+  CHAR8                                      TableId[9];
+  BOOLEAN                                    *Seen;
+  BOOLEAN                                    Ok;
+
+  Files           = Env->CorpusTables;
+  Xsdt            = (EFI_ACPI_DESCRIPTION_HEADER *) (UINTN) Env->Tree.Rsdp->XsdtAddress;
+  Count           = (Xsdt->Length - sizeof (*Xsdt)) / sizeof (UINT64);
+  Entries         = (UINT64 *) (Xsdt + 1);
+  FirmwareCount   = (Env->Tree.Xsdt->Length - sizeof (*Xsdt)) / sizeof (UINT64);
+  FirmwareEntries = (UINT64 *) (Env->Tree.Xsdt + 1);
+  if (Count != FirmwareCount + ((Files > 2) ? Files - 2 : 0) - ((Env->SkippedTable >= 2) ? 1 : 0)) {
+    return FALSE;
+  }
+
+  for (Index = 0; Index < FirmwareCount; Index++) {
+    Firmware = (VOID *) (UINTN) ReadUnaligned64 (&FirmwareEntries[Index]);
+    Table    = (VOID *) (UINTN) ReadUnaligned64 (&Entries[Index]);
+    if (Files > 1 && Firmware->Signature == EFI_ACPI_2_0_SECONDARY_SYSTEM_DESCRIPTION_TABLE_SIGNATURE &&
+        CompareMem (&Firmware->OemTableId, "FWSSDT00", 8) == 0) {
+      if (Table == Firmware || Table->Signature != Firmware->Signature ||
+          CompareMem (&Table->OemTableId, "FWSSDT00", 8) != 0) {
+        return FALSE;
+      }
+    } else if (Table != Firmware) {
+      return FALSE;
+    }
+  }
+
+  Seen = calloc (Files + 1, sizeof (*Seen));
+  Ok   = TRUE;
+  for (Position = FirmwareCount; Position < Count && Ok; Position++) {
+    Table = (VOID *) (UINTN) ReadUnaligned64 (&Entries[Position]);
+    CopyMem (TableId, &Table->OemTableId, 8);
+    TableId[8] = '\0';
+    Index      = (TableId[0] == 'P') ? (UINTN) strtoul (TableId + 1, NULL, 10) : 0;
+    Ok = (BOOLEAN) (Table->Signature == EFI_ACPI_2_0_SECONDARY_SYSTEM_DESCRIPTION_TABLE_SIGNATURE &&
+                    Index >= 2 && Index < Files && Index != Env->SkippedTable && !Seen[Index] &&
+                    (Index != Env->ChangedTable || XsdtPlanHash (Table, Table->Length) == Env->ChangedHash));
+    if (Ok) {
+      Seen[Index] = TRUE;
+    }
+  }
+  free (Seen);
+
+  //
+  // The FADT is patched in place, so it is still the firmware's.
+  //
+  Facp  = Env->Tree.Facp;
+  Table = (VOID *) (UINTN) Facp->XDsdt;
+  if (Files > 0) {
+    Ok = (BOOLEAN) (Ok && Facp->Dsdt == (UINT32) Facp->XDsdt && Table != Env->Tree.Dsdt &&
+                    Table->Signature == EFI_ACPI_2_0_DIFFERENTIATED_SYSTEM_DESCRIPTION_TABLE_SIGNATURE &&
+                    CompareMem (&Table->OemTableId, "PATCHDSD", 8) == 0);
+  }
+  return Ok;
+}
+
+/**
+  Records one iteration.  With Verify, the tree is checked, and against
+  the synthetic corpus if there is one, and the tables it now references
+  do not count as leaks.
+**/
+STATIC
+VOID
+PhaseRecord (
+  IN OUT PHASE_RESULT  *Result,
+  IN     UINT64        Started,
+  IN     BENCH_ENV     *Env,
+  IN     BOOLEAN       Verify
+  )
+{
+  UINT64  *Published;
+  UINTN   Count;
+
+  Result->Nanoseconds[Result->Count++] = HostNanoseconds () - Started;
+  CounterEnd (&Result->Counters);
+  if (!Verify) {
+    Result->Leaks       = HostOutstandingAllocations ();
+    Result->XsdtEntries = -2;
+    return;
+  }
+
+  Result->XsdtEntries = HostVerifyAcpiTree (Env->Tree.Rsdp);
+  if (Result->XsdtEntries < 0) {
+    Result->Leaks = HostOutstandingAllocations ();
+    return;
+  }
+
+  if (Env->CorpusTables > 0 && !BenchCheckPatched (Env)) {
+    Result->XsdtEntries = -1;
+  }
+
+  Published     = HostListAcpiTables (Env->Tree.Rsdp, &Count);
+  Result->Leaks = HostLeakedAllocations (Published, Count);
+  free (Published);
+}
+
+/**
+  The byte-at-a-time loop the checksum engine replaced, kept as the
+  reference for both speed and correctness.
+**/
+STATIC
+UINT8
+ReferenceChecksum (
+  IN CONST UINT8  *Buffer,
+  IN UINTN        Length
+  )
+{
+  UINT8  Sum;
+  UINTN  Index;
+
+  Sum = 0;
+  for (Index = 0; Index < Length; Index++) {
+    Sum += Buffer[Index];
+  }
+
+  return Sum;
+}
+
+/**
+  Compares every checksum kernel with the reference loop over all small
+  lengths and alignments, where the head and tail handling lives.
+**/
+STATIC
+BOOLEAN
+ChecksumSelfTest (
+  IN UINT8  *Buffer,
+  IN UINT8  *Scratch
+  )
+{
+  UINTN  Offset;
+  UINTN  Length;
+  UINT8  Expected;
+
+  for (Offset = 0; Offset < 16; Offset++) {
+    for (Length = 0; Length < 300; Length++) {
+      Expected = ReferenceChecksum (Buffer + Offset, Length);
+      if (AcpiChecksumSum (Buffer + Offset, Length) != Expected ||
+          AcpiChecksumCopy (Scratch + 15 - Offset, Buffer + Offset, Length) != Expected ||
+          CompareMem (Scratch + 15 - Offset, Buffer + Offset, Length) != 0) {
+        fprintf (stderr, "hostbench: %s checksum kernel wrong at offset %lu, length %lu\n",
+                 AcpiChecksumKernel (), (unsigned long) Offset, (unsigned long) Length);
+        return FALSE;
+      }
+    }
+  }
+
+  return TRUE;
+}
+
+//
+// One XsdtPlan duplicate check: tables appended in order to a plan over the
+// firmware tree, and which of them the committed XSDT must end with.
+//
+typedef struct {
+  CONST CHAR8  *Name;
+  UINTN        Count;
+  CONST CHAR8  *OemTableId[4];
+  UINT32       Seed[4];
+  UINTN        Duplicates;
+  UINTN        KeptCount;
+  UINTN        Kept[4];
+} PLAN_SELF_TEST;
+
+//
+// Seeds at or above PLAN_SEED_FIRMWARE copy the firmware SSDT of that
+// index instead of making a new table.
+//
+#define PLAN_SEED_FIRMWARE  0x10000
+
+STATIC CONST PLAN_SELF_TEST  mPlanSelfTests[] = {
+  //
+  // The same bytes under another name: only the first is kept.
+  //
+  { "identical",  2, { "PDUP0001", "PDUP0001" }, { 1, 1 }, 1, 1, { 0 } },
+  //
+  // Another build of the same table: only the first is kept.
+  //
+  { "table-id",   3, { "PDUP0001", "PDUP0001", "PDUP0002" }, { 1, 2, 3 }, 1, 2, { 0, 2 } },
+  //
+  // Tables without an OEM Table ID are only told apart by their contents.
+  //
+  { "blank-id",   3, { "", "", "" }, { 4, 5, 4 }, 1, 2, { 0, 1 } },
+  //
+  // A copy of a firmware SSDT adds nothing.
+  //
+  { "firmware",   2, { "FWSSDT03", "PDUP0003" }, { PLAN_SEED_FIRMWARE + 3, 6 }, 1, 1, { 1 } },
+};
+
+/**
+  Plans and commits each of mPlanSelfTests against a fresh firmware tree
+  and checks the XSDT it gives and the duplicates counted on the way.
+**/
+STATIC
+BOOLEAN
+PlanSelfTest (
+  VOID
+  )
+{
+  CONST PLAN_SELF_TEST         *Test;
+  HOST_ACPI_TREE               Tree;
+  XSDT_INDEX                   Index;
+  XSDT_PLAN                    Plan;
+  TABLE_ARENA                  Arena;
+  EFI_ACPI_DESCRIPTION_HEADER  *Tables[4];
+  EFI_ACPI_DESCRIPTION_HEADER  *Firmware;
+  EFI_ACPI_DESCRIPTION_HEADER  *Xsdt;
+  UINT64                       *Entries;
+  UINT64                       *FirmwareEntries;
+  UINTN                        FirmwareCount;
+  UINTN                        Patched;
+  UINTN                        Case;
+  UINTN                        Table;
+  UINTN                        Entry;
+  BOOLEAN                      Ok;
+
+  Ok = TRUE;
+  ZeroMem (&Tree, sizeof (Tree));
+  for (Case = 0; Case < ARRAY_SIZE (mPlanSelfTests); Case++) {
+    Test = &mPlanSelfTests[Case];
+    HostBuildAcpiTree (&Tree, BENCH_FIRMWARE_SSDTS);
+    FirmwareCount   = (Tree.Xsdt->Length - sizeof (*Tree.Xsdt)) / sizeof (UINT64);
+    FirmwareEntries = (UINT64 *) (Tree.Xsdt + 1);
+
+    ZeroMem (&Index, sizeof (Index));
+    ZeroMem (&Plan, sizeof (Plan));
+    ZeroMem (&Arena, sizeof (Arena));
+    Xsdt = NULL;
+    XsdtIndexBuild (&Index, Tree.Xsdt);
+    XsdtPlanInit (&Plan, &Index, Test->Count);
+    for (Table = 0; Table < Test->Count; Table++) {
+      if (Test->Seed[Table] >= PLAN_SEED_FIRMWARE) {
+        //
+        // FACP, APIC and MCFG come before the firmware SSDTs.
+        //
+        Firmware      = (VOID *) (UINTN) FirmwareEntries[3 + Test->Seed[Table] - PLAN_SEED_FIRMWARE];
+        Tables[Table] = malloc (Firmware->Length);
+        CopyMem (Tables[Table], Firmware, Firmware->Length);
+      } else {
+        Tables[Table] = malloc (0x200);
+        HostMakeAcpiTable (Tables[Table], EFI_ACPI_2_0_SECONDARY_SYSTEM_DESCRIPTION_TABLE_SIGNATURE, 0x200,
+                           Test->OemTableId[Table], Test->Seed[Table]);
+      }
+      XsdtPlanAdd (&Plan, XsdtOpAppend, Tables[Table]->Signature, Tables[Table], L"self-test");
+    }
+    TableArenaCreate (&Arena, SIZE_4KB);
+    XsdtPlanCommit (&Plan, Tree.Xsdt, Tree.Facp, &Arena, &Xsdt, &Patched);
+
+    if (Xsdt == NULL || Plan.Duplicates != Test->Duplicates ||
+        (Xsdt->Length - sizeof (*Xsdt)) / sizeof (UINT64) != FirmwareCount + Test->KeptCount ||
+        CompareMem (Xsdt + 1, FirmwareEntries, FirmwareCount * sizeof (UINT64)) != 0) {
+      Ok = FALSE;
+    } else {
+      Entries = (UINT64 *) (Xsdt + 1) + FirmwareCount;
+      for (Entry = 0; Entry < Test->KeptCount; Entry++) {
+        if (Entries[Entry] != (UINT64) (UINTN) Tables[Test->Kept[Entry]]) {
+          Ok = FALSE;
+        }
+      }
+    }
+    if (!Ok) {
+      fprintf (stderr, "hostbench: plan self-test %s: %lu duplicates, %ld entries\n", Test->Name,
+               (unsigned long) Plan.Duplicates,
+               (Xsdt == NULL) ? -1L : (long) ((Xsdt->Length - sizeof (*Xsdt)) / sizeof (UINT64)));
+    }
+
+    TableArenaDestroy (&Arena);
+    XsdtPlanFree (&Plan);
+    XsdtIndexFree (&Index);
+    for (Table = 0; Table < Test->Count; Table++) {
+      free (Tables[Table]);
+    }
+    if (!Ok) {
+      break;
+    }
+  }
+
+  HostFreeAcpiTree (&Tree);
+  HostReleaseAllocations ();
+  return Ok;
+}
+
+//
+// How LzSelfTest damages a packed table before decoding it.
+//
+typedef enum {
+  LzDamageNone,
+  LzDamageSignature,    ///< The header signature is wrong
+  LzDamageRatio,        ///< The header claims one byte past ACPI_LZ_MAX_RATIO
+  LzDamageTruncated,    ///< The file ends halfway through the block
+  LzDamageOffset        ///< The first match reaches back before the output
+} LZ_DAMAGE;
+
+typedef struct {
+  CONST CHAR8  *Name;
+  LZ_DAMAGE    Damage;
+  EFI_STATUS   LengthStatus;
+  EFI_STATUS   DecodeStatus;
+} LZ_SELF_TEST;
+
+STATIC CONST LZ_SELF_TEST  mLzSelfTests[] = {
+  { "intact",    LzDamageNone,      EFI_SUCCESS,          EFI_SUCCESS          },
+  { "signature", LzDamageSignature, EFI_VOLUME_CORRUPTED, EFI_SUCCESS          },
+  { "ratio",     LzDamageRatio,     EFI_VOLUME_CORRUPTED, EFI_SUCCESS          },
+  { "truncated", LzDamageTruncated, EFI_SUCCESS,          EFI_VOLUME_CORRUPTED },
+  { "offset",    LzDamageOffset,    EFI_SUCCESS,          EFI_VOLUME_CORRUPTED },
+};
+
+/**
+  Packs a table, damages it as each of mLzSelfTests says and checks that
+  AcpiLzDecodedLength() or AcpiLzDecode() turns it away, and that the
+  intact file decodes to the table.  DecodeStatus is only checked when
+  the header was accepted.
+**/
+STATIC
+BOOLEAN
+LzSelfTest (
+  VOID
+  )
+{
+  CONST LZ_SELF_TEST  *Test;
+  ACPI_LZ_HEADER      *Header;
+  UINT8               *Table;
+  UINT8               *Packed;
+  UINT8               *Damaged;
+  UINT8               *Decoded;
+  UINT8               *In;
+  UINTN               PackedSize;
+  UINTN               Size;
+  UINTN               Length;
+  UINTN               Count;
+  UINTN               Case;
+  EFI_STATUS          Status;
+  BOOLEAN             Ok;
+
+  Table   = malloc (SIZE_4KB);
+  Packed  = malloc (SIZE_4KB * 2);
+  Damaged = malloc (SIZE_4KB * 2);
+  Decoded = malloc (SIZE_4KB);
+  HostMakeAcpiTable (Table, EFI_ACPI_2_0_SECONDARY_SYSTEM_DESCRIPTION_TABLE_SIGNATURE, SIZE_4KB, "PLZ00001", 7);
+  PackedSize = HostLzPack (Table, SIZE_4KB, Packed);
+
+  Ok = TRUE;
+  for (Case = 0; Case < ARRAY_SIZE (mLzSelfTests) && Ok; Case++) {
+    Test   = &mLzSelfTests[Case];
+    Size   = PackedSize;
+    Header = (ACPI_LZ_HEADER *) Damaged;
+    CopyMem (Damaged, Packed, PackedSize);
+    switch (Test->Damage) {
+      case LzDamageSignature:
+        Header->Signature ^= 1;
+        break;
+      case LzDamageRatio:
+        Header->Length = (UINT32) (Size * ACPI_LZ_MAX_RATIO + 1);
+        break;
+      case LzDamageTruncated:
+        Size /= 2;
+        break;
+      case LzDamageOffset:
+        //
+        // Skip the first sequence's literals to its match offset, which
+        // then points one byte before the start of the table.
+        //
+        In    = Damaged + sizeof (*Header);
+        Count = *In++ >> 4;
+        if (Count == 15) {
+          do {
+            Count += *In;
+          } while (*In++ == 255);
+        }
+        In   += Count;
+        In[0] = (UINT8) (Count + 1);
+        In[1] = (UINT8) ((Count + 1) >> 8);
+        break;
+      default:
+        break;
+    }
+
+    Status = AcpiLzDecodedLength (Damaged, Size, &Length);
+    if (Status != Test->LengthStatus) {
+      Ok = FALSE;
+    } else if (!EFI_ERROR (Status)) {
+      SetMem (Decoded, SIZE_4KB, 0xA5);
+      Status = AcpiLzDecode (Damaged, Size, Decoded, Length);
+      if (Status != Test->DecodeStatus ||
+          (!EFI_ERROR (Status) && (Length != SIZE_4KB || CompareMem (Decoded, Table, SIZE_4KB) != 0))) {
+        Ok = FALSE;
+      }
+    }
+    if (!Ok) {
+      fprintf (stderr, "hostbench: lz self-test %s: status 0x%lx\n", Test->Name, (unsigned long) Status);
+    }
+  }
+
+  free (Decoded);
+  free (Damaged);
+  free (Packed);
+  free (Table);
+  return Ok;
+}
+
+/**
+  Raw checksum throughput over buffers of increasing size: the old byte
+  loop, the checksum engine, a copy followed by a checksum, and the fused
+  copy and checksum that the loader uses.
+**/
+STATIC
+VOID
+BenchChecksum (
+  IN BENCH_OPTIONS  *Options
+  )
+{
+  STATIC CONST UINTN  Sizes[] = { SIZE_4KB, SIZE_64KB, SIZE_1MB, SIZE_8MB };
+  STATIC CONST CHAR8  *Kernels[] = { "byteloop", "checksum", "copy+sum", "copysum" };
+  UINT8               *Buffer;
+  UINT8               *Scratch;
+  UINTN               Kernel;
+  UINTN               SizeIndex;
+  UINTN               Repeat;
+  UINTN               Rounds;
+  UINTN               Index;
+  UINT64              Started;
+  UINT64              Best;
+  UINT64              Elapsed;
+  volatile UINT8      Sink;
+
+  Buffer  = malloc (SIZE_8MB);
+  Scratch = malloc (SIZE_8MB);
+  for (Index = 0; Index < SIZE_8MB; Index++) {
+    Buffer[Index] = (UINT8) (Index * 31 + 7);
+  }
+
+  if (!ChecksumSelfTest (Buffer, Scratch)) {
+    exit (1);
+  }
+
+  printf ("%-4s %-10s %9s %12s %10s  (%s kernel)\n", "mode", "phase", "bytes", "ns_per_call", "mb_per_s", AcpiChecksumKernel ());
+  for (Kernel = 0; Kernel < ARRAY_SIZE (Kernels); Kernel++) {
+    for (SizeIndex = 0; SizeIndex < ARRAY_SIZE (Sizes); SizeIndex++) {
+      Rounds = MAX ((Options->Quick ? SIZE_8MB : 8 * SIZE_8MB) / Sizes[SizeIndex], 1);
+      Best   = MAX_UINT64;
+      for (Repeat = 0; Repeat < 5; Repeat++) {
+        Started = HostNanoseconds ();
+        for (Index = 0; Index < Rounds; Index++) {
+          switch (Kernel) {
+            case 0:
+              Sink = ReferenceChecksum (Buffer, Sizes[SizeIndex]);
+              break;
+            case 1:
+              Sink = AcpiChecksumSum (Buffer, Sizes[SizeIndex]);
+              break;
+            case 2:
+              CopyMem (Scratch, Buffer, Sizes[SizeIndex]);
+              Sink = AcpiChecksumSum (Scratch, Sizes[SizeIndex]);
+              break;
+            default:
+              Sink = AcpiChecksumCopy (Scratch, Buffer, Sizes[SizeIndex]);
+              break;
+          }
+        }
+        Elapsed = HostNanoseconds () - Started;
+        Best    = MIN (Best, Elapsed);
+      }
+      printf (
+        "%-4s %-10s %9lu %12.1f %10.1f\n",
+        BENCH_MODE,
+        Kernels[Kernel],
+        (unsigned long) Sizes[SizeIndex],
+        (double) Best / Rounds,
+        ((double) Sizes[SizeIndex] * Rounds / (1024.0 * 1024.0)) / ((double) Best / 1e9)
+        );
+    }
+  }
+  (VOID) Sink;
+  free (Scratch);
+  free (Buffer);
+}
+
+STATIC
+VOID
+BenchLoad (
+  IN BENCH_ENV      *Env,
+  IN BENCH_OPTIONS  *Options,
+  IN UINTN          Files
+  )
+{
+  PHASE_RESULT                 Result;
+  EFI_FILE_PROTOCOL            *Dir;
+  EFI_FILE_PROTOCOL            *Entry;
+  EFI_FILE_INFO                *Info;
+  UINT8                        InfoBuffer[SIZE_OF_EFI_FILE_INFO + 512];
+  UINTN                        InfoSize;
+  CHAR16                       (*Names)[128];
+  UINTN                        NameCount;
+  EFI_ACPI_DESCRIPTION_HEADER  *Table;
+  UINTN                        TableSize;
+  UINTN                        Iteration;
+  UINTN                        Index;
+  UINT64                       Started;
+  CHAR16                       AcpiPath[128];
+  DIR_SNAPSHOT                 Snapshot;
+
+  //
+  // Collect the file names up front so the timed loop measures only the
+  // one directory snapshot and what LoadAmlFile() does per file.
+  //
+  Names     = calloc (Files + 8, sizeof (*Names));
+  NameCount = 0;
+  EnvironmentReset (Env);
+  AsciiStrToUnicodeStrS (BENCH_ACPI_DIR, AcpiPath, ARRAY_SIZE (AcpiPath));
+  Dir = OpenDirectory (Env, AcpiPath);
+  if (Dir == NULL) {
+    free (Names);
+    return;
+  }
+  Info = (EFI_FILE_INFO *) InfoBuffer;
+  for ( ; ; ) {
+    InfoSize = sizeof (InfoBuffer);
+    if (EFI_ERROR (Dir->Read (Dir, &InfoSize, Info)) || InfoSize == 0) {
+      break;
+    }
+    if ((Info->Attribute & EFI_FILE_DIRECTORY) == 0 && NameCount < Files + 8) {
+      StrCpyS (Names[NameCount++], 128, Info->FileName);
+    }
+  }
+  Dir->Close (Dir);
+
+  ZeroMem (&Result, sizeof (Result));
+  for (Iteration = 0; Iteration < Options->Iterations; Iteration++) {
+    EnvironmentReset (Env);
+    AsciiStrToUnicodeStrS (BENCH_SELF_DIR, AcpiPath, ARRAY_SIZE (AcpiPath));
+    Dir = OpenDirectory (Env, AcpiPath);
+    CounterBegin ();
+    Started = HostNanoseconds ();
+    CreateAcpiDirSnapshot (Dir, &Snapshot);
+    for (Index = 0; Index < NameCount; Index++) {
+      Table = NULL;
+      if (!EFI_ERROR (LoadAmlFile (&Snapshot, Names[Index], NULL, &Table, &TableSize)) && Table != NULL) {
+        FreePool (Table);
+      }
+    }
+    DirSnapshotFree (&Snapshot);
+    PhaseRecord (&Result, Started, Env, FALSE);
+    Entry = Dir;
+    Entry->Close (Entry);
+  }
+  PrintResult ("load", Files, &Result);
+  free (Names);
+}
+
+STATIC
+VOID
+BenchScan (
+  IN BENCH_ENV      *Env,
+  IN BENCH_OPTIONS  *Options,
+  IN UINTN          Files
+  )
+{
+  PHASE_RESULT                 Result;
+  EFI_FILE_PROTOCOL            *Dir;
+  UINTN                        Iteration;
+  UINTN                        Index;
+  UINT64                       Started;
+  CHAR16                       SelfPath[128];
+  DIR_SNAPSHOT                 Snapshot;
+  XSDT_PLAN                    Plan;
+
+  ZeroMem (&Result, sizeof (Result));
+  AsciiStrToUnicodeStrS (BENCH_SELF_DIR, SelfPath, ARRAY_SIZE (SelfPath));
+  for (Iteration = 0; Iteration < Options->Iterations; Iteration++) {
+    EnvironmentReset (Env);
+    Dir = OpenDirectory (Env, SelfPath);
+
+    //
+    // The scan only plans; the loaded tables stay outstanding until after
+    // the phase is recorded, as they would until the commit.
+    //
+    CounterBegin ();
+    Started = HostNanoseconds ();
+    ZeroMem (&Plan, sizeof (Plan));
+    if (!EFI_ERROR (CreateAcpiDirSnapshot (Dir, &Snapshot))) {
+      if (!EFI_ERROR (XsdtPlanInit (&Plan, NULL, Snapshot.AmlCount))) {
+        ScanDirectoryForSsdtFiles (&Snapshot, NULL, &Plan);
+      }
+      DirSnapshotFree (&Snapshot);
+    }
+    PhaseRecord (&Result, Started, Env, FALSE);
+
+    for (Index = 0; Index < Plan.Count; Index++) {
+      FreePool (Plan.Ops[Index].Table);
+    }
+    XsdtPlanFree (&Plan);
+    Dir->Close (Dir);
+
+    //
+    // Leaks are whatever is still outstanding once the tables are gone.
+    //
+    Result.Leaks = HostOutstandingAllocations ();
+  }
+  PrintResult ("scan", Files, &Result);
+}
+
+/**
+  Times PatchAcpiTables() on the corpus.  Unless KeepCache is set, the boot
+  cache an earlier run left is removed first, so every iteration is a
+  first boot.
+**/
+STATIC
+VOID
+BenchPatch (
+  IN BENCH_ENV      *Env,
+  IN BENCH_OPTIONS  *Options,
+  IN UINTN          Files,
+  IN CONST CHAR8    *Phase,
+  IN BOOLEAN        KeepCache
+  )
+{
+  PHASE_RESULT       Result;
+  EFI_FILE_PROTOCOL  *Dir;
+  UINTN              Iteration;
+  UINT64             Started;
+  CHAR16             SelfPath[128];
+
+  ZeroMem (&Result, sizeof (Result));
+  AsciiStrToUnicodeStrS (BENCH_SELF_DIR, SelfPath, ARRAY_SIZE (SelfPath));
+  for (Iteration = 0; Iteration < Options->Iterations; Iteration++) {
+    EnvironmentReset (Env);
+    if (!KeepCache) {
+      HostFsRemoveFile (Env->Volume, BENCH_ACPI_DIR "\\ACPIPatcher.cache");
+    }
+    Dir   = OpenDirectory (Env, SelfPath);
+    gRsdp = Env->Tree.Rsdp;
+    gXsdt = Env->Tree.Xsdt;
+    gFacp = Env->Tree.Facp;
+
+    CounterBegin ();
+    Started = HostNanoseconds ();
+    PatchAcpiTables (Dir, gXsdt, gFacp);
+#ifdef DXE_DRIVER_BUILD
+    //
+    // The driver build loads the tables from a timer and only puts them in
+    // at ReadyToBoot.  Here ReadyToBoot comes straight away, so it loads
+    // them all itself.
+    //
+    HostSignalEventGroup (&gEfiEventReadyToBootGuid);
+#endif
+    PhaseRecord (&Result, Started, Env, TRUE);
+
+    Dir->Close (Dir);
+  }
+  PrintResult (Phase, Files, &Result);
+}
+
+/**
+  Times later boots after SSDT-3.aml has been rewritten since the cache
+  was written: once at the same size, so only its modification time
+  gives it away, and once at another size with the time set back.  The
+  patched tree must hold the new table both times, not the cached one.
+  The original file is put back afterwards.
+**/
+STATIC
+VOID
+BenchCacheChange (
+  IN BENCH_ENV      *Env,
+  IN BENCH_OPTIONS  *Options,
+  IN UINTN          Files
+  )
+{
+  STATIC CONST CHAR8  Path[] = BENCH_ACPI_DIR "\\SSDT-3.aml";
+  CONST VOID          *Data;
+  VOID                *Saved;
+  UINT8               *Table;
+  UINTN               Size;
+  UINT64              Time;
+
+  Data = HostFsGetFile (Env->Volume, Path, &Size);
+  if (Data == NULL || Size < sizeof (EFI_ACPI_DESCRIPTION_HEADER)) {
+    return;
+  }
+  Saved = malloc (Size);
+  Table = malloc (Size + 16);
+  CopyMem (Saved, Data, Size);
+
+  Env->ChangedTable = 3;
+  HostMakeAcpiTable (Table, EFI_ACPI_2_0_SECONDARY_SYSTEM_DESCRIPTION_TABLE_SIGNATURE, (UINT32) Size, "P0000003", 3003);
+  HostFsAddFile (Env->Volume, Path, Table, Size);
+  Env->ChangedHash = XsdtPlanHash (Table, Size);
+  BenchPatch (Env, Options, Files, "cache-time", TRUE);
+
+  Time = HostFsGetFileTime (Env->Volume, Path);
+  HostMakeAcpiTable (Table, EFI_ACPI_2_0_SECONDARY_SYSTEM_DESCRIPTION_TABLE_SIGNATURE, (UINT32) Size + 16, "P0000003", 4003);
+  HostFsAddFile (Env->Volume, Path, Table, Size + 16);
+  HostFsSetFileTime (Env->Volume, Path, Time);
+  Env->ChangedHash = XsdtPlanHash (Table, Size + 16);
+  BenchPatch (Env, Options, Files, "cache-size", TRUE);
+
+  Env->ChangedTable = 0;
+  HostFsAddFile (Env->Volume, Path, Saved, Size);
+  free (Table);
+  free (Saved);
+}
+
+/**
+  Times a first boot with stray .aml files beside the tables: one of
+  several gigabytes, which must be skipped without taking the arena down
+  with it, and one of a few megabytes, which must be turned away on its
+  header alone.  The tree is checked as for the patch phase, and the
+  header check on its own afterwards.
+**/
+STATIC
+VOID
+BenchStray (
+  IN BENCH_ENV      *Env,
+  IN BENCH_OPTIONS  *Options,
+  IN UINTN          Files
+  )
+{
+  EFI_FILE_PROTOCOL            *Dir;
+  DIR_SNAPSHOT                 Snapshot;
+  EFI_ACPI_DESCRIPTION_HEADER  *Table;
+  UINTN                        TableSize;
+  EFI_STATUS                   Status;
+  CHAR16                       AcpiPath[64];
+
+  if (EFI_ERROR (HostFsAddZeroFile (Env->Volume, BENCH_ACPI_DIR "\\Backup.aml", (UINTN) BENCH_STRAY_SIZE)) ||
+      EFI_ERROR (HostFsAddZeroFile (Env->Volume, BENCH_ACPI_DIR "\\Image.aml", SIZE_8MB))) {
+    return;
+  }
+  BenchPatch (Env, Options, Files, "stray", FALSE);
+
+  EnvironmentReset (Env);
+  AsciiStrToUnicodeStrS (BENCH_ACPI_DIR, AcpiPath, ARRAY_SIZE (AcpiPath));
+  Dir = OpenDirectory (Env, AcpiPath);
+  if (Dir != NULL && !EFI_ERROR (CreateAcpiDirSnapshot (Dir, &Snapshot))) {
+    ZeroMem (&gHostCounters, sizeof (gHostCounters));
+    Status = LoadAmlFile (&Snapshot, L"Image.aml", NULL, &Table, &TableSize);
+    if (Status != EFI_UNSUPPORTED || gHostCounters.FileReadBytes > sizeof (EFI_ACPI_DESCRIPTION_HEADER)) {
+      fprintf (stderr, "hostbench: Image.aml gave %s after reading %llu bytes\n",
+               EFI_ERROR (Status) ? "an error" : "a table", (unsigned long long) gHostCounters.FileReadBytes);
+      mFailedPhases++;
+    }
+    DirSnapshotFree (&Snapshot);
+  }
+  if (Dir != NULL) {
+    Dir->Close (Dir);
+  }
+
+  HostFsRemoveFile (Env->Volume, BENCH_ACPI_DIR "\\Image.aml");
+  HostFsRemoveFile (Env->Volume, BENCH_ACPI_DIR "\\Backup.aml");
+}
+
+/**
+  Times the manifest with the hash= of SSDT-3.aml altered, so the table
+  no longer matches it and must be left out while the others load.  The
+  intact manifest is put back afterwards.
+**/
+STATIC
+VOID
+BenchManifestHash (
+  IN BENCH_ENV      *Env,
+  IN BENCH_OPTIONS  *Options,
+  IN UINTN          Files,
+  IN CONST CHAR8    *Manifest
+  )
+{
+  CHAR8  *Altered;
+  CHAR8  *Hash;
+
+  Altered = strdup (Manifest);
+  Hash    = strstr (Altered, " SSDT-3.aml ");
+  Hash    = (Hash != NULL) ? strstr (Hash, "hash=") : NULL;
+  if (Hash != NULL) {
+    Hash += 5;
+    *Hash = (*Hash == '0') ? '1' : '0';
+    HostFsAddFile (Env->Volume, BENCH_ACPI_DIR "\\ACPIPatcher.cfg", Altered, strlen (Altered));
+    Env->SkippedTable = 3;
+    BenchPatch (Env, Options, Files, "cfg-hash", FALSE);
+    Env->SkippedTable = 0;
+    HostFsAddFile (Env->Volume, BENCH_ACPI_DIR "\\ACPIPatcher.cfg", Manifest, strlen (Manifest));
+  }
+  free (Altered);
+}
+
+/**
+  Times a first boot from an emulated slow disk, once through a file
+  system driver that only has Read() and once through one with ReadEx(),
+  where the patcher keeps several table reads in flight.
+**/
+STATIC
+VOID
+BenchDisk (
+  IN BENCH_ENV      *Env,
+  IN BENCH_OPTIONS  *Options,
+  IN UINTN          Files
+  )
+{
+  HostFsSetDevice (BENCH_DISK_ACCESS_NS, FALSE);
+  BenchPatch (Env, Options, Files, "disk-sync", FALSE);
+  HostFsSetDevice (BENCH_DISK_ACCESS_NS, TRUE);
+  BenchPatch (Env, Options, Files, "disk-async", FALSE);
+  HostFsSetDevice (0, TRUE);
+}
+
+/**
+  Times a first boot from a slow disk whose every table is shipped packed
+  as .aml.lz, against the same tables as plain .aml files.  The synthetic
+  corpus's random table bodies do not compress, so they are first
+  rewritten as AML-like ones; an imported corpus is used as it is.  The
+  read_kb column shows what packing saved.  The original files are put
+  back afterwards.
+**/
+STATIC
+VOID
+BenchCompressed (
+  IN BENCH_ENV      *Env,
+  IN BENCH_OPTIONS  *Options,
+  IN UINTN          Files
+  )
+{
+  EFI_FILE_PROTOCOL   *Dir;
+  DIR_SNAPSHOT        Snapshot;
+  DIR_SNAPSHOT_ENTRY  *Entry;
+  CHAR16              AcpiPath[64];
+  CHAR8               (*Paths)[256];
+  VOID                **Saved;
+  UINTN               *SavedSize;
+  UINTN               Count;
+  CONST VOID          *Data;
+  UINT8               *Table;
+  UINT8               *Packed;
+  UINTN               Size;
+  UINTN               Index;
+  UINTN               Used;
+
+  //
+  // The snapshot's pool goes with the next EnvironmentReset(), so the
+  // table paths are copied out of it first.
+  //
+  AsciiStrToUnicodeStrS (BENCH_ACPI_DIR, AcpiPath, ARRAY_SIZE (AcpiPath));
+  EnvironmentReset (Env);
+  Dir = OpenDirectory (Env, AcpiPath);
+  if (Dir == NULL) {
+    return;
+  }
+  if (EFI_ERROR (DirSnapshotCreate (Dir, &Snapshot))) {
+    Dir->Close (Dir);
+    return;
+  }
+
+  Paths = calloc (Snapshot.Count, sizeof (*Paths));
+  Count = 0;
+  for (Index = 0; Index < Snapshot.Count; Index++) {
+    Entry = &Snapshot.Entries[Index];
+    if (Entry->Kind >= DirEntryDsdt && !Entry->Compressed) {
+      Used = (UINTN) snprintf (Paths[Count], sizeof (Paths[Count]), "%s\\", BENCH_ACPI_DIR);
+      UnicodeStrToAsciiStrS (Entry->Name, Paths[Count] + Used, sizeof (Paths[Count]) - Used - 3);
+      Count++;
+    }
+  }
+  DirSnapshotFree (&Snapshot);
+  Dir->Close (Dir);
+
+  Saved     = calloc (Count, sizeof (*Saved));
+  SavedSize = calloc (Count, sizeof (*SavedSize));
+  for (Index = 0; Index < Count; Index++) {
+    Data = HostFsGetFile (Env->Volume, Paths[Index], &Size);
+    if (Data == NULL || Size < sizeof (EFI_ACPI_DESCRIPTION_HEADER)) {
+      continue;
+    }
+    Saved[Index]     = malloc (Size);
+    SavedSize[Index] = Size;
+    CopyMem (Saved[Index], Data, Size);
+    if (Options->CorpusDirectory == NULL) {
+      //
+      // Seeded from the contents, so the stray copy of SSDT-2 is still
+      // the same table as SSDT-2.
+      //
+      Table = malloc (Size);
+      CopyMem (Table, Data, Size);
+      HostMakeAmlBody (Table, (UINT32) XsdtPlanHash (Table, Size));
+      HostFsAddFile (Env->Volume, Paths[Index], Table, Size);
+      free (Table);
+    }
+  }
+
+  HostFsSetDevice (BENCH_DISK_ACCESS_NS, TRUE);
+  HostFsSetClusterWalk (BENCH_SLOW_CLUSTER_NS);
+  BenchPatch (Env, Options, Files, "read-aml", FALSE);
+
+  for (Index = 0; Index < Count; Index++) {
+    if (Saved[Index] == NULL) {
+      continue;
+    }
+    Data   = HostFsGetFile (Env->Volume, Paths[Index], &Size);
+    Table  = malloc (Size);
+    Packed = malloc (Size + Size / 255 + 32);
+    CopyMem (Table, Data, Size);
+    HostFsRemoveFile (Env->Volume, Paths[Index]);
+    Size = HostLzPack (Table, Size, Packed);
+    strcat (Paths[Index], ".lz");
+    HostFsAddFile (Env->Volume, Paths[Index], Packed, Size);
+    free (Packed);
+    free (Table);
+  }
+
+  BenchPatch (Env, Options, Files, "read-lz", FALSE);
+  HostFsSetClusterWalk (0);
+  HostFsSetDevice (0, TRUE);
+
+  for (Index = 0; Index < Count; Index++) {
+    if (Saved[Index] == NULL) {
+      continue;
+    }
+    HostFsRemoveFile (Env->Volume, Paths[Index]);
+    Paths[Index][strlen (Paths[Index]) - 3] = '\0';
+    HostFsAddFile (Env->Volume, Paths[Index], Saved[Index], SavedSize[Index]);
+    free (Saved[Index]);
+  }
+
+  free (Saved);
+  free (SavedSize);
+  free (Paths);
+}
+
+/**
+  Lays a bundle out on the corpus partition from block BENCH_BUNDLE_LBA
+  and writes the ACPIPatcher.apl that points at it, as
+  Tools/AcpiBundle.py locate would.
+**/
+STATIC
+VOID
+LocateBundle (
+  IN BENCH_ENV           *Env,
+  IN CONST BENCH_BUNDLE  *Bundle
+  )
+{
+  ACPI_BUNDLE_LOCATOR  Locator;
+
+  ZeroMem (&Locator, sizeof (Locator));
+  Locator.Signature  = ACPI_BUNDLE_LOCATOR_SIGNATURE;
+  Locator.Version    = ACPI_BUNDLE_LOCATOR_VERSION;
+  Locator.BlockSize  = HOST_FS_BLOCK_SIZE;
+  Locator.Size       = (UINT32) Bundle->Size;
+  Locator.Lba        = BENCH_BUNDLE_LBA;
+  CopyMem (&Locator.PartitionGuid, ((HARDDRIVE_DEVICE_PATH *) Env->VolumePath)->Signature, sizeof (EFI_GUID));
+  Locator.BundleHash  = XsdtPlanHash (Bundle->Data, Bundle->Size);
+  Locator.LocatorHash = XsdtPlanHash (&Locator, OFFSET_OF (ACPI_BUNDLE_LOCATOR, LocatorHash));
+
+  HostFsPlaceFile (Env->Volume, BENCH_ACPI_DIR "\\ACPIPatcher.apb", BENCH_BUNDLE_LBA);
+  HostFsAddFile (Env->Volume, BENCH_ACPI_DIR "\\ACPIPatcher.apl", &Locator, sizeof (Locator));
+}
+
+/**
+  Times the bundle on an emulated slow disk whose FAT driver walks cluster
+  chains, once read through the file system and once from its blocks.
+  The bundle must already be in the corpus directory.
+**/
+STATIC
+VOID
+BenchBundleDisk (
+  IN BENCH_ENV           *Env,
+  IN BENCH_OPTIONS       *Options,
+  IN UINTN               Files,
+  IN CONST BENCH_BUNDLE  *Bundle
+  )
+{
+  HostFsSetDevice (BENCH_DISK_ACCESS_NS, TRUE);
+  HostFsSetClusterWalk (BENCH_DISK_CLUSTER_NS);
+  BenchPatch (Env, Options, Files, "bundle-fs", FALSE);
+  LocateBundle (Env, Bundle);
+  BenchPatch (Env, Options, Files, "bundle-raw", FALSE);
+  HostFsRemoveFile (Env->Volume, BENCH_ACPI_DIR "\\ACPIPatcher.apl");
+  HostFsSetClusterWalk (0);
+  HostFsSetDevice (0, TRUE);
+}
+
+/**
+  Writes Locator as the ACPIPatcher.apl, rehashing it unless BreakHash is
+  set, in which case its own hash is made wrong.
+**/
+STATIC
+VOID
+WriteLocator (
+  IN BENCH_ENV            *Env,
+  IN ACPI_BUNDLE_LOCATOR  *Locator,
+  IN BOOLEAN              BreakHash
+  )
+{
+  Locator->LocatorHash = XsdtPlanHash (Locator, OFFSET_OF (ACPI_BUNDLE_LOCATOR, LocatorHash));
+  if (BreakHash) {
+    Locator->LocatorHash ^= 1;
+  }
+  HostFsAddFile (Env->Volume, BENCH_ACPI_DIR "\\ACPIPatcher.apl", Locator, sizeof (*Locator));
+}
+
+/**
+  Times the bundle with an ACPIPatcher.apl that must not be trusted, so
+  the patcher falls back to reading the file and loads the same tables
+  the file holds:
+
+  - apl-self: the blocks hold a copy of the bundle with SSDT-3.aml
+    altered, and the locator describes that copy but fails its own hash
+  - apl-hash: the same blocks, with a locator made for the file instead
+  - apl-stale: the blocks and locator are the bundle's, but the file has
+    since been rebuilt with a new SSDT-3.aml at the same size
+
+  The bundle must already be in the corpus directory; it is put back and
+  the locator removed afterwards.
+**/
+STATIC
+VOID
+BenchBundleLocator (
+  IN BENCH_ENV           *Env,
+  IN BENCH_OPTIONS       *Options,
+  IN UINTN               Files,
+  IN CONST BENCH_BUNDLE  *Bundle
+  )
+{
+  STATIC CONST CHAR8   Path[] = BENCH_ACPI_DIR "\\ACPIPatcher.apb";
+  ACPI_BUNDLE_ENTRY    *Entries;
+  ACPI_BUNDLE_ENTRY    *Entry;
+  ACPI_BUNDLE_LOCATOR  Locator;
+  BENCH_BUNDLE         Copy;
+  CONST VOID           *Data;
+  UINT8                *Table;
+  UINTN                Size;
+  UINTN                Index;
+
+  Entries = (ACPI_BUNDLE_ENTRY *) (Bundle->Data + sizeof (ACPI_BUNDLE_HEADER));
+  for (Index = 0; Index < Bundle->Count && AsciiStrCmp (Entries[Index].Name, "SSDT-3.aml") != 0; Index++) {
+  }
+  if (Index == Bundle->Count) {
+    return;
+  }
+
+  Copy       = *Bundle;
+  Copy.Data  = malloc (Bundle->Size);
+  CopyMem (Copy.Data, Bundle->Data, Bundle->Size);
+  Entry      = (ACPI_BUNDLE_ENTRY *) (Copy.Data + sizeof (ACPI_BUNDLE_HEADER)) + Index;
+  Table      = Copy.Data + Entry->Offset;
+
+  Table[sizeof (EFI_ACPI_DESCRIPTION_HEADER)] ^= 0xFF;
+  HostFsAddFile (Env->Volume, Path, Copy.Data, Copy.Size);
+  LocateBundle (Env, &Copy);
+  HostFsAddFile (Env->Volume, Path, Bundle->Data, Bundle->Size);
+  Data = HostFsGetFile (Env->Volume, BENCH_ACPI_DIR "\\ACPIPatcher.apl", &Size);
+  CopyMem (&Locator, Data, sizeof (Locator));
+
+  WriteLocator (Env, &Locator, TRUE);
+  BenchPatch (Env, Options, Files, "apl-self", FALSE);
+
+  Locator.BundleHash = XsdtPlanHash (Bundle->Data, Bundle->Size);
+  WriteLocator (Env, &Locator, FALSE);
+  BenchPatch (Env, Options, Files, "apl-hash", FALSE);
+
+  LocateBundle (Env, Bundle);
+  HostMakeAcpiTable (Table, EFI_ACPI_2_0_SECONDARY_SYSTEM_DESCRIPTION_TABLE_SIGNATURE, Entry->Length, "P0000003", 5003);
+  Entry->Hash = XsdtPlanHash (Table, Entry->Length);
+  BundleEnd (&Copy);
+  HostFsAddFile (Env->Volume, Path, Copy.Data, Copy.Size);
+  Env->ChangedTable = 3;
+  Env->ChangedHash  = Entry->Hash;
+  BenchPatch (Env, Options, Files, "apl-stale", FALSE);
+  Env->ChangedTable = 0;
+
+  HostFsAddFile (Env->Volume, Path, Bundle->Data, Bundle->Size);
+  HostFsRemoveFile (Env->Volume, BENCH_ACPI_DIR "\\ACPIPatcher.apl");
+  free (Copy.Data);
+}
+
+/**
+  Times the image entry point.  Unless KeepHint is set, the directory the
+  driver remembered on an earlier run is forgotten first, so every
+  iteration searches the volumes.  With LateCorpus the driver build finds
+  only the data volumes at entry and the corpus volume arrives afterwards.
+**/
+STATIC
+VOID
+BenchEntry (
+  IN BENCH_ENV      *Env,
+  IN BENCH_OPTIONS  *Options,
+  IN UINTN          Files,
+  IN CONST CHAR8    *Phase,
+  IN BOOLEAN        KeepHint,
+  IN BOOLEAN        LateCorpus
+  )
+{
+  PHASE_RESULT  Result;
+  UINTN         Iteration;
+  UINT64        Started;
+  EFI_GUID      VariableGuid = ACPI_PATCHER_VARIABLE_GUID;
+#ifdef DXE_DRIVER_BUILD
+  EFI_HANDLE    LateVolume;
+  HOST_FS_NODE  *Empty;
+
+  Empty = HostFsCreateVolume ();
+#endif
+
+  ZeroMem (&Result, sizeof (Result));
+  Env->LateCorpus = LateCorpus;
+  for (Iteration = 0; Iteration < Options->Iterations; Iteration++) {
+    EnvironmentReset (Env);
+    if (!KeepHint) {
+      gRT->SetVariable (ACPI_DIR_HINT_VARIABLE_NAME, &VariableGuid, 0, 0, NULL);
+    }
+
+    CounterBegin ();
+    Started = HostNanoseconds ();
+    AcpiPatcherEntryPoint (Env->ImageHandle, gST);
+#ifdef DXE_DRIVER_BUILD
+    //
+    // Volumes keep arriving after the driver has started.  It searches
+    // each one as it comes; an empty one changes nothing.
+    //
+    if (LateCorpus) {
+      InstallCorpusVolume (Env);
+    }
+    if (Env->LateAcpi) {
+      HostInstallConfigurationTable (&gEfiAcpi20TableGuid, Env->Tree.Rsdp);
+    }
+    LateVolume = NULL;
+    HostInstallProtocol (&LateVolume, &gEfiSimpleFileSystemProtocolGuid, HostFsGetProtocol (Empty));
+
+    //
+    // The rest of DXE gives the driver's timer time to load the tables;
+    // the XSDT is only rebuilt once the boot manager is about to start a
+    // boot option.
+    //
+    HostAdvanceTime (BENCH_DXE_DISPATCH_NS);
+    HostSignalEventGroup (&gEfiEventReadyToBootGuid);
+#endif
+    PhaseRecord (&Result, Started, Env, TRUE);
+  }
+  PrintResult (Phase, Files, &Result);
+  Env->LateCorpus = FALSE;
+
+#ifdef DXE_DRIVER_BUILD
+  //
+  // The driver keeps a handle to its log file on the corpus volume, so only
+  // the empty trigger volume is released here.
+  //
+  HostFsDestroyVolume (Empty);
+#endif
+}
+
+#ifdef DXE_DRIVER_BUILD
+/**
+  Times the driver with the corpus tables embedded in its own FFS file,
+  as ACPIPatcher.py --embed builds it, against the ESP path.  As in
+  entry-late, the ESP only shows up after the driver has started; here
+  the driver does not need it.  Packed tables are embedded decoded, as
+  the tool does.  On a large corpus both are timed again on the emulated
+  slow disk, where the ESP path pays for every read.
+**/
+STATIC
+VOID
+BenchEmbedded (
+  IN BENCH_ENV      *Env,
+  IN BENCH_OPTIONS  *Options,
+  IN UINTN          Files
+  )
+{
+  EFI_FILE_PROTOCOL   *Dir;
+  DIR_SNAPSHOT        Snapshot;
+  DIR_SNAPSHOT_ENTRY  *Entry;
+  CHAR16              AcpiPath[64];
+  CHAR8               Path[256];
+  DIR_ENTRY_KIND      Kind;
+  CONST VOID          *Data;
+  VOID                *Table;
+  UINTN               Size;
+  UINTN               Length;
+  UINTN               Index;
+  UINTN               Used;
+  BOOLEAN             Disk;
+
+  Disk = (Files >= BENCH_DISK_MIN_FILES || Options->CorpusDirectory != NULL);
+  if (Disk) {
+    HostFsSetDevice (BENCH_DISK_ACCESS_NS, TRUE);
+    BenchEntry (Env, Options, Files, "disk-late", FALSE, TRUE);
+    HostFsSetDevice (0, TRUE);
+  }
+
+  //
+  // Sections go in the order the scan loads the files: DSDT.aml, the
+  // numbered SSDTs, the named SSDTs, then the rest.
+  //
+  AsciiStrToUnicodeStrS (BENCH_ACPI_DIR, AcpiPath, ARRAY_SIZE (AcpiPath));
+  EnvironmentReset (Env);
+  Dir = OpenDirectory (Env, AcpiPath);
+  if (Dir == NULL) {
+    return;
+  }
+  if (EFI_ERROR (DirSnapshotCreate (Dir, &Snapshot))) {
+    Dir->Close (Dir);
+    return;
+  }
+
+  for (Kind = DirEntryDsdt; Kind <= DirEntryAml; Kind++) {
+    for (Index = 0; Index < Snapshot.Count; Index++) {
+      Entry = &Snapshot.Entries[Index];
+      if (Entry->Kind != Kind) {
+        continue;
+      }
+      Used = (UINTN) snprintf (Path, sizeof (Path), "%s\\", BENCH_ACPI_DIR);
+      UnicodeStrToAsciiStrS (Entry->Name, Path + Used, sizeof (Path) - Used);
+      Data = HostFsGetFile (Env->Volume, Path, &Size);
+      if (Data == NULL) {
+        continue;
+      }
+      if (!Entry->Compressed) {
+        HostFvAddSection (EFI_SECTION_RAW, Data, Size);
+      } else if (!EFI_ERROR (AcpiLzDecodedLength (Data, Size, &Length))) {
+        Table = malloc (Length);
+        if (!EFI_ERROR (AcpiLzDecode (Data, Size, Table, Length))) {
+          HostFvAddSection (EFI_SECTION_RAW, Table, Length);
+        }
+        free (Table);
+      }
+    }
+  }
+  DirSnapshotFree (&Snapshot);
+  Dir->Close (Dir);
+
+  BenchEntry (Env, Options, Files, "entry-fv", FALSE, TRUE);
+
+  //
+  // The same with the firmware's ACPI tables only published after the
+  // driver has started; it has to wait for them until ReadyToBoot.
+  //
+  Env->LateAcpi = TRUE;
+  BenchEntry (Env, Options, Files, "fv-noacpi", FALSE, TRUE);
+  Env->LateAcpi = FALSE;
+
+  if (Disk) {
+    HostFsSetDevice (BENCH_DISK_ACCESS_NS, TRUE);
+    BenchEntry (Env, Options, Files, "disk-fv", FALSE, TRUE);
+    HostFsSetDevice (0, TRUE);
+  }
+
+  HostFvRemoveSections ();
+}
+#endif
+
+STATIC
+VOID
+Usage (
+  IN CONST CHAR8  *Program
+  )
+{
+  fprintf (
+    stderr,
+    "usage: %s [--iterations N] [--sizes N,N,...] [--corpus DIR] [--latency OPEN_NS,READ_NS_PER_KB]\n"
+    "          [--quick] [--echo] [--serial FILE]\n",
+    Program
+    );
+}
+
+int
+main (
+  int   argc,
+  char  **argv
+  )
+{
+  BENCH_OPTIONS  Options;
+  BENCH_ENV      Env;
+  HOST_FS_NODE   **Volumes;
+  CHAR8          *Manifest;
+  BENCH_BUNDLE   Bundle;
+  UINTN          SizeIndex;
+  UINTN          Files;
+  int            Arg;
+  char           *Cursor;
+
+  ZeroMem (&Options, sizeof (Options));
+  Options.Iterations = 7;
+  Options.Sizes[0]   = 1;
+  Options.Sizes[1]   = 10;
+  Options.Sizes[2]   = 100;
+  Options.Sizes[3]   = 1000;
+  Options.SizeCount  = 4;
+
+  for (Arg = 1; Arg < argc; Arg++) {
+    if (strcmp (argv[Arg], "--iterations") == 0 && Arg + 1 < argc) {
+      Options.Iterations = (UINTN) strtoul (argv[++Arg], NULL, 0);
+      Options.Iterations = MIN (Options.Iterations, BENCH_MAX_ITERATIONS);
+    } else if (strcmp (argv[Arg], "--sizes") == 0 && Arg + 1 < argc) {
+      Options.SizeCount = 0;
+      for (Cursor = argv[++Arg]; *Cursor != 0 && Options.SizeCount < ARRAY_SIZE (Options.Sizes); ) {
+        Options.Sizes[Options.SizeCount++] = strtoul (Cursor, &Cursor, 0);
+        if (*Cursor == ',') {
+          Cursor++;
+        }
+      }
+    } else if (strcmp (argv[Arg], "--corpus") == 0 && Arg + 1 < argc) {
+      Options.CorpusDirectory = argv[++Arg];
+    } else if (strcmp (argv[Arg], "--latency") == 0 && Arg + 1 < argc) {
+      Cursor = argv[++Arg];
+      UINT64 OpenNs = strtoull (Cursor, &Cursor, 0);
+      HostFsSetLatency (OpenNs, (*Cursor == ',') ? strtoull (Cursor + 1, NULL, 0) : 0);
+    } else if (strcmp (argv[Arg], "--quick") == 0) {
+      Options.Quick      = TRUE;
+      Options.Iterations = 3;
+    } else if (strcmp (argv[Arg], "--echo") == 0) {
+      gHostConsoleEcho = TRUE;
+    } else if (strcmp (argv[Arg], "--serial") == 0 && Arg + 1 < argc) {
+      if (EFI_ERROR (HostSerialCapture (argv[++Arg]))) {
+        fprintf (stderr, "hostbench: cannot create %s\n", argv[Arg]);
+        return 1;
+      }
+    } else {
+      Usage (argv[0]);
+      return 2;
+    }
+  }
+  if (Options.Iterations == 0) {
+    Options.Iterations = 1;
+  }
+  if (Options.CorpusDirectory != NULL) {
+    Options.SizeCount = 1;
+    Options.Sizes[0]  = 0;
+  }
+
+  HostShimInitialize ();
+  BuildImagePath (&Env);
+  BuildVolumePath (&Env);
+  BuildBootOption (&Env);
+  ZeroMem (&Env.Tree, sizeof (Env.Tree));
+  Env.LateCorpus = FALSE;
+  Env.LateAcpi   = FALSE;
+  Env.CorpusTables = 0;
+  Env.SkippedTable = 0;
+  Env.ChangedTable = 0;
+  Env.DataVolume = HostFsCreateVolume ();
+  HostFsAddFile (Env.DataVolume, "\\EFI\\BOOT\\BOOTX64.EFI", "MZ", 2);
+
+  BenchChecksum (&Options);
+  if (!PlanSelfTest ()) {
+    mFailedPhases++;
+  }
+  if (!LzSelfTest ()) {
+    mFailedPhases++;
+  }
+  printf ("\n");
+  PrintHeader ();
+
+  //
+  // Volumes stay alive until exit: the DXE build keeps its debug log file
+  // open across entry point calls.
+  //
+  Volumes  = calloc (Options.SizeCount, sizeof (*Volumes));
+  Manifest = NULL;
+  ZeroMem (&Bundle, sizeof (Bundle));
+  for (SizeIndex = 0; SizeIndex < Options.SizeCount; SizeIndex++) {
+    Files      = Options.Sizes[SizeIndex];
+    Env.Volume = HostFsCreateVolume ();
+    Volumes[SizeIndex] = Env.Volume;
+    HostFsAddFile (Env.Volume, "\\EFI\\ACPIPatcher\\ACPIPatcher.efi", "MZ", 2);
+    if (Options.CorpusDirectory != NULL) {
+      if (EFI_ERROR (HostFsImportDirectory (Env.Volume, BENCH_ACPI_DIR, Options.CorpusDirectory))) {
+        fprintf (stderr, "hostbench: cannot read corpus directory %s\n", Options.CorpusDirectory);
+        return 1;
+      }
+    } else {
+      PopulateSyntheticCorpus (Env.Volume, BENCH_ACPI_DIR, Files, &Manifest, &Bundle);
+      Env.CorpusTables = Files;
+    }
+
+    //
+    // The entry phase runs first so that, in the DXE build, the debug log is
+    // already open on this volume for the phases that follow.
+    //
+    BenchEntry (&Env, &Options, Files, "entry", FALSE, FALSE);
+#ifdef DXE_DRIVER_BUILD
+    //
+    // Later boots, which open the directory the first one remembered, and
+    // a boot where the ESP only shows up after the driver has started.
+    //
+    BenchEntry (&Env, &Options, Files, "entry-nv", TRUE, FALSE);
+    BenchEntry (&Env, &Options, Files, "entry-late", FALSE, TRUE);
+
+    //
+    // The same boot with the tables built into the driver instead.
+    //
+    BenchEmbedded (&Env, &Options, Files);
+#endif
+    BenchLoad (&Env, &Options, Files);
+    BenchScan (&Env, &Options, Files);
+    BenchPatch (&Env, &Options, Files, "patch", FALSE);
+
+    //
+    // The same scan on later boots: the cache the last "patch" iteration
+    // wrote is current, so it is read instead of the files.
+    //
+    BenchPatch (&Env, &Options, Files, "cache", TRUE);
+    BenchCacheChange (&Env, &Options, Files);
+    BenchStray (&Env, &Options, Files);
+
+    //
+    // First boots again, from a slow disk.  The corpus is still scanned:
+    // the manifest and bundle are only added below.
+    //
+    if (Files >= BENCH_DISK_MIN_FILES || Options.CorpusDirectory != NULL) {
+      BenchDisk (&Env, &Options, Files);
+      BenchCompressed (&Env, &Options, Files);
+    }
+
+    //
+    // The same tables again, this time named by a manifest rather than
+    // found by the scan.
+    //
+    if (Manifest != NULL) {
+      HostFsAddFile (Env.Volume, BENCH_ACPI_DIR "\\ACPIPatcher.cfg", Manifest, strlen (Manifest));
+      BenchPatch (&Env, &Options, Files, "manifest", FALSE);
+#ifdef DXE_DRIVER_BUILD
+      //
+      // The driver finds the manifest beside the tables in the directory
+      // its search chose, and loads them on its timer after the entry
+      // point has returned.
+      //
+      BenchEntry (&Env, &Options, Files, "entry-cfg", FALSE, FALSE);
+#endif
+      BenchManifestHash (&Env, &Options, Files, Manifest);
+      free (Manifest);
+      Manifest = NULL;
+    }
+
+    //
+    // And once more from a bundle, which takes precedence over both.
+    //
+    if (Bundle.Data != NULL) {
+      HostFsAddFile (Env.Volume, BENCH_ACPI_DIR "\\ACPIPatcher.apb", Bundle.Data, Bundle.Size);
+      BenchPatch (&Env, &Options, Files, "bundle", FALSE);
+      BenchBundleDisk (&Env, &Options, Files, &Bundle);
+      BenchBundleLocator (&Env, &Options, Files, &Bundle);
+      free (Bundle.Data);
+      ZeroMem (&Bundle, sizeof (Bundle));
+    }
+  }
+
+  HostReleaseAllocations ();
+  HostFreeAcpiTree (&Env.Tree);
+  for (SizeIndex = 0; SizeIndex < Options.SizeCount; SizeIndex++) {
+    HostFsDestroyVolume (Volumes[SizeIndex]);
+  }
+  free (Volumes);
+  if (mFailedPhases > 0) {
+    fprintf (stderr, "hostbench: %lu phases or self-tests failed\n", (unsigned long) mFailedPhases);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,423 @@
+/** @file
+  Host-side harness for the ACPIPatcher core.
+
+  Declares the pieces of the UEFI shim that the benchmark driver controls
+  directly: allocation and I/O counters, the in-memory volume, synthetic
+  ACPI trees and the handle database used to publish them.
+
+**/
+
+#ifndef __HOST_BENCH_H__
+#define __HOST_BENCH_H__
+
+#include <Uefi.h>
+#include <Library/UefiLib.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+//
+// Counters maintained by the shim.  The benchmark driver snapshots them
+// around each phase and reports the difference.
+//
+typedef struct {
+  UINT64  PoolAllocations;
+  UINT64  PoolFrees;
+  UINT64  PoolBytes;
+  UINT64  PageAllocations;
+  UINT64  PageBytes;
+  UINT64  FileOpens;
+  UINT64  FileOpenMisses;
+  UINT64  FileReads;
+  UINT64  FileReadBytes;
+  UINT64  DirectoryReads;
+  UINT64  FileWrites;
+  UINT64  FileWriteBytes;
+  UINT64  FileFlushes;
+  UINT64  ConsoleCharacters;
+  UINT64  StallMicroseconds;
+  UINT64  SerialBytes;
+} HOST_COUNTERS;
+
+extern HOST_COUNTERS  gHostCounters;
+
+//
+// When FALSE (the default) console output produced by Print() and
+// ConOut->OutputString() is formatted but discarded.
+//
+extern BOOLEAN        gHostConsoleEcho;
+
+//
+// UefiShim.c
+//
+VOID
+HostShimInitialize (
+  VOID
+  );
+
+UINT64
+HostNanoseconds (
+  VOID
+  );
+
+/**
+  Appends everything written through SerialPortLib to the file at Path,
+  like QEMU's -serial file:.
+
+  @retval EFI_SUCCESS     The file was opened.
+  @retval EFI_NOT_FOUND   The file could not be created.
+**/
+EFI_STATUS
+HostSerialCapture (
+  IN CONST CHAR8  *Path
+  );
+
+/**
+  Frees every pool and page allocation that is still outstanding.  Used
+  between benchmark iterations so that leaks in the code under test do not
+  accumulate.
+**/
+VOID
+HostReleaseAllocations (
+  VOID
+  );
+
+UINT64
+HostOutstandingAllocations (
+  VOID
+  );
+
+/**
+  Counts the outstanding allocations other than the EfiACPIReclaimMemory
+  pages that hold one of the Published addresses, which the OS is meant
+  to keep.
+**/
+UINT64
+HostLeakedAllocations (
+  IN CONST UINT64  *Published,
+  IN UINTN         Count
+  );
+
+EFI_HANDLE
+HostCreateHandle (
+  VOID
+  );
+
+EFI_STATUS
+HostInstallProtocol (
+  IN OUT EFI_HANDLE  *Handle,
+  IN     EFI_GUID    *Protocol,
+  IN     VOID        *Interface
+  );
+
+VOID
+HostResetHandleDatabase (
+  VOID
+  );
+
+VOID
+HostInstallConfigurationTable (
+  IN EFI_GUID  *Guid,
+  IN VOID      *Table
+  );
+
+VOID
+HostSignalEventGroup (
+  IN CONST EFI_GUID  *EventGroup
+  );
+
+/**
+  Advances the simulated clock used by timer events and fires every timer
+  whose trigger time has passed.
+**/
+VOID
+HostAdvanceTime (
+  IN UINT64  Nanoseconds
+  );
+
+/**
+  Adds a section to the driver's own FFS file, after those already there,
+  for GetSectionFromFv() to return.  The data is copied.
+**/
+EFI_STATUS
+HostFvAddSection (
+  IN EFI_SECTION_TYPE  Type,
+  IN CONST VOID        *Data,
+  IN UINTN             Size
+  );
+
+/**
+  Empties the driver's FFS file again.
+**/
+VOID
+HostFvRemoveSections (
+  VOID
+  );
+
+//
+// HostFileSystem.c
+//
+typedef struct _HOST_FS_NODE HOST_FS_NODE;
+
+HOST_FS_NODE *
+HostFsCreateVolume (
+  VOID
+  );
+
+VOID
+HostFsDestroyVolume (
+  IN HOST_FS_NODE  *Root
+  );
+
+/**
+  Adds (or replaces) a file below Root.  Intermediate directories in the
+  backslash separated Path are created as needed.
+**/
+EFI_STATUS
+HostFsAddFile (
+  IN HOST_FS_NODE  *Root,
+  IN CONST CHAR8   *Path,
+  IN CONST VOID    *Data,
+  IN UINTN         Size
+  );
+
+/**
+  Adds (or replaces) a file of Size zero bytes.  Host memory is only
+  committed for the parts that are written, so the file can be far larger
+  than the bench could copy.
+**/
+EFI_STATUS
+HostFsAddZeroFile (
+  IN HOST_FS_NODE  *Root,
+  IN CONST CHAR8   *Path,
+  IN UINTN         Size
+  );
+
+EFI_STATUS
+HostFsAddDirectory (
+  IN HOST_FS_NODE  *Root,
+  IN CONST CHAR8   *Path
+  );
+
+/**
+  Copies a Linux directory tree into the in-memory volume at Path.
+**/
+EFI_STATUS
+HostFsImportDirectory (
+  IN HOST_FS_NODE  *Root,
+  IN CONST CHAR8   *Path,
+  IN CONST CHAR8   *HostDirectory
+  );
+
+/**
+  Gets and sets a file's modification time, as the counter GetInfo()
+  reports in ModificationTime.Nanosecond.  Every write moves it forward;
+  setting it back makes a changed file look untouched.  A missing file
+  reads as 0.
+**/
+UINT64
+HostFsGetFileTime (
+  IN HOST_FS_NODE  *Root,
+  IN CONST CHAR8   *Path
+  );
+
+EFI_STATUS
+HostFsSetFileTime (
+  IN HOST_FS_NODE  *Root,
+  IN CONST CHAR8   *Path,
+  IN UINT64        Time
+  );
+
+/**
+  Deletes a file below Root.
+**/
+EFI_STATUS
+HostFsRemoveFile (
+  IN HOST_FS_NODE  *Root,
+  IN CONST CHAR8   *Path
+  );
+
+/**
+  Returns the contents of a file, or NULL if it does not exist.
+**/
+CONST VOID *
+HostFsGetFile (
+  IN  HOST_FS_NODE  *Root,
+  IN  CONST CHAR8   *Path,
+  OUT UINTN         *Size
+  );
+
+EFI_SIMPLE_FILE_SYSTEM_PROTOCOL *
+HostFsGetProtocol (
+  IN HOST_FS_NODE  *Root
+  );
+
+//
+// Geometry of the partition under every volume.
+//
+#define HOST_FS_BLOCK_SIZE   512
+#define HOST_FS_BLOCK_COUNT  409600
+
+/**
+  Block I/O and Disk I/O of the partition under the volume, for the
+  volume's handle.  Its blocks read as zero except where
+  HostFsPlaceFile() has put a file.
+**/
+EFI_BLOCK_IO_PROTOCOL *
+HostFsGetBlockIo (
+  IN HOST_FS_NODE  *Root
+  );
+
+EFI_DISK_IO_PROTOCOL *
+HostFsGetDiskIo (
+  IN HOST_FS_NODE  *Root
+  );
+
+/**
+  Copies a file's current contents to the partition, starting at block
+  Lba, as a tool laying it out contiguously would.  Later changes to the
+  file do not reach the blocks.  Only the last file placed is kept.
+**/
+EFI_STATUS
+HostFsPlaceFile (
+  IN HOST_FS_NODE  *Root,
+  IN CONST CHAR8   *Path,
+  IN EFI_LBA       Lba
+  );
+
+/**
+  Adds a cost per path component to Open() and a per-byte cost to Read(),
+  to approximate slow FAT media.  Both default to zero.
+**/
+VOID
+HostFsSetLatency (
+  IN UINT64  OpenNanoseconds,
+  IN UINT64  ReadNanosecondsPerKb
+  );
+
+/**
+  Puts the volume on an emulated slow block device: every file read first
+  waits AccessNanoseconds for the device.  Read() calls wait one after
+  another.  ReadEx() calls with an event complete in the background, side
+  by side, and only their transfers at the Read cost per KB are
+  serialised.  With ReadEx FALSE, file handles report revision 1, as an
+  older file system driver's would.
+**/
+VOID
+HostFsSetDevice (
+  IN UINT64   AccessNanoseconds,
+  IN BOOLEAN  ReadEx
+  );
+
+/**
+  Makes every file read also pay NanosecondsPerCluster for each 4 KB of
+  data, as a FAT driver following the file's cluster chain would.  Block
+  and Disk I/O reads do not pay it.
+**/
+VOID
+HostFsSetClusterWalk (
+  IN UINT64  NanosecondsPerCluster
+  );
+
+/**
+  Signals every background ReadEx() whose completion is due.  CheckEvent()
+  calls it, as polling a real controller would.
+**/
+VOID
+HostFsPoll (
+  VOID
+  );
+
+//
+// AcpiFixtures.c
+//
+typedef struct {
+  EFI_ACPI_2_0_ROOT_SYSTEM_DESCRIPTION_POINTER  *Rsdp;
+  EFI_ACPI_DESCRIPTION_HEADER                   *Xsdt;
+  EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE     *Facp;
+  EFI_ACPI_DESCRIPTION_HEADER                   *Dsdt;
+  VOID                                          *Storage;
+  UINTN                                         StorageSize;
+} HOST_ACPI_TREE;
+
+/**
+  Builds a firmware-like RSDP -> XSDT -> {FACP, APIC, MCFG, SSDT x N} tree
+  with a DSDT referenced from the FADT.  All checksums are valid.
+**/
+VOID
+HostBuildAcpiTree (
+  OUT HOST_ACPI_TREE  *Tree,
+  IN  UINTN           FirmwareSsdtCount
+  );
+
+VOID
+HostFreeAcpiTree (
+  IN HOST_ACPI_TREE  *Tree
+  );
+
+/**
+  Fills Buffer with a valid ACPI table of the given signature and size.
+  The body is pseudo-random so that distinct Seeds give distinct tables.
+**/
+VOID
+HostMakeAcpiTable (
+  OUT VOID         *Buffer,
+  IN  UINT32       Signature,
+  IN  UINT32       Length,
+  IN  CONST CHAR8  *OemTableId,
+  IN  UINT32       Seed
+  );
+
+/**
+  Rewrites the body of a table built by HostMakeAcpiTable() with AML-like
+  records, which compress about as well as real AML does, and fixes up
+  its checksum.
+**/
+VOID
+HostMakeAmlBody (
+  IN OUT VOID    *Table,
+  IN     UINT32  Seed
+  );
+
+/**
+  Packs a table into the .aml.lz layout of AcpiLz.h.  Packed must have
+  room for Length + Length / 255 + 32 bytes.
+
+  @return Size of the packed file.
+**/
+UINTN
+HostLzPack (
+  IN  CONST VOID  *Table,
+  IN  UINTN       Length,
+  OUT VOID        *Packed
+  );
+
+UINT8
+HostChecksum (
+  IN CONST VOID  *Buffer,
+  IN UINTN       Length
+  );
+
+/**
+  Checks that the RSDP, XSDT, FADT and every table referenced from the XSDT
+  carry valid checksums.  Returns the number of XSDT entries, or -1 if the
+  tree is inconsistent.
+**/
+INTN
+HostVerifyAcpiTree (
+  IN EFI_ACPI_2_0_ROOT_SYSTEM_DESCRIPTION_POINTER  *Rsdp
+  );
+
+/**
+  Lists the addresses of the XSDT, every table it references and the
+  DSDT, for a tree HostVerifyAcpiTree() accepted.  Free the list with
+  free().
+**/
+UINT64 *
+HostListAcpiTables (
+  IN  EFI_ACPI_2_0_ROOT_SYSTEM_DESCRIPTION_POINTER  *Rsdp,
+  OUT UINTN                                         *Count
+  );
+
+#endif // __HOST_BENCH_H__
@@ -0,0 +1,1245 @@
+/** @file
+  In-memory EFI_SIMPLE_FILE_SYSTEM_PROTOCOL for the host harness.
+
+  Paths are backslash separated and matched case-insensitively like FAT.
+  Directory reads return EFI_FILE_INFO records in insertion order, which
+  is what most firmware FAT drivers do for a freshly written volume.  Every
+  Open, Read and directory read is counted in gHostCounters.
+
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "HostBench.h"
+
+#define HOST_FS_NAME_MAX  256
+
+struct _HOST_FS_NODE {
+  CHAR8                 Name[HOST_FS_NAME_MAX];
+  BOOLEAN               IsDirectory;
+  UINT8                 *Data;
+  UINTN                 Size;
+  struct _HOST_FS_NODE  *Parent;
+  struct _HOST_FS_NODE  **Children;
+  UINTN                 ChildCount;
+  UINTN                 ChildCapacity;
+  //
+  // Value of mModifyCount when the file was last written.
+  //
+  UINT64                Modified;
+  //
+  // Only meaningful on the root node.
+  //
+  EFI_SIMPLE_FILE_SYSTEM_PROTOCOL  *Volume;
+};
+
+typedef struct {
+  EFI_SIMPLE_FILE_SYSTEM_PROTOCOL  Protocol;
+  HOST_FS_NODE                     *Root;
+  //
+  // The partition under the volume.  Its blocks are zero apart from the
+  // bytes HostFsPlaceFile() copied there, which stay as they were when
+  // the file changes, as a disk's would.
+  //
+  EFI_BLOCK_IO_PROTOCOL            BlockIo;
+  EFI_DISK_IO_PROTOCOL             DiskIo;
+  EFI_BLOCK_IO_MEDIA               Media;
+  UINT8                            *Blocks;
+  UINT64                           BlocksOffset;
+  UINTN                            BlocksSize;
+} HOST_FS_VOLUME;
+
+typedef struct {
+  EFI_FILE_PROTOCOL  Protocol;
+  HOST_FS_NODE       *Node;
+  UINT64             Position;
+  BOOLEAN            Writable;
+} HOST_FILE;
+
+STATIC UINT64  mOpenLatency;
+
+//
+// Path components HostFsWalk() has looked up since it was last cleared.
+// A FAT driver reads a directory for each one, so Open() costs latency per
+// component rather than per call.
+//
+STATIC UINTN   mWalkSteps;
+
+//
+// Counts every change to a file's contents, so each change gets a new
+// modification time however close together they come.
+//
+STATIC UINT64  mModifyCount;
+STATIC UINT64  mReadLatencyPerKb;
+
+//
+// The emulated block device: how long each file read waits before its
+// data starts to move, and whether file handles offer ReadEx().
+//
+STATIC UINT64   mAccessLatency;
+STATIC BOOLEAN  mReadExDisabled;
+
+//
+// Cost of following a file's FAT cluster chain, per HOST_FS_CLUSTER_SIZE
+// of file data read.  Reads from the blocks do not pay it.
+//
+#define HOST_FS_CLUSTER_SIZE  4096
+
+STATIC UINT64   mClusterLatency;
+
+//
+// ReadEx() requests whose data has been copied but whose completion is
+// not due yet.  Transfers are serialised: mChannelFree is when the last
+// one queued ends.
+//
+#define HOST_FS_MAX_PENDING  64
+
+typedef struct {
+  EFI_FILE_IO_TOKEN  *Token;
+  EFI_STATUS         Status;
+  UINT64             Due;
+} HOST_FS_PENDING;
+
+STATIC HOST_FS_PENDING  mPending[HOST_FS_MAX_PENDING];
+STATIC UINTN            mPendingCount;
+STATIC UINT64           mChannelFree;
+
+STATIC EFI_FILE_PROTOCOL  mFileTemplate;
+
+VOID
+HostFsSetLatency (
+  IN UINT64  OpenNanoseconds,
+  IN UINT64  ReadNanosecondsPerKb
+  )
+{
+  mOpenLatency      = OpenNanoseconds;
+  mReadLatencyPerKb = ReadNanosecondsPerKb;
+}
+
+VOID
+HostFsSetDevice (
+  IN UINT64   AccessNanoseconds,
+  IN BOOLEAN  ReadEx
+  )
+{
+  mAccessLatency  = AccessNanoseconds;
+  mReadExDisabled = (BOOLEAN) !ReadEx;
+}
+
+VOID
+HostFsSetClusterWalk (
+  IN UINT64  NanosecondsPerCluster
+  )
+{
+  mClusterLatency = NanosecondsPerCluster;
+}
+
+/**
+  Time the media takes to move Count bytes of file data.
+**/
+STATIC
+UINT64
+HostFsTransferTime (
+  IN UINTN  Count
+  )
+{
+  return (mReadLatencyPerKb * Count) / 1024 +
+         mClusterLatency * ((Count + HOST_FS_CLUSTER_SIZE - 1) / HOST_FS_CLUSTER_SIZE);
+}
+
+STATIC
+VOID
+HostFsDelay (
+  IN UINT64  Nanoseconds
+  )
+{
+  UINT64  Deadline;
+
+  if (Nanoseconds == 0) {
+    return;
+  }
+  //
+  // Busy-wait rather than sleep so that short delays are honoured and the
+  // cost shows up in wall-clock timings exactly like blocking media I/O.
+  //
+  Deadline = HostNanoseconds () + Nanoseconds;
+  while (HostNanoseconds () < Deadline) {
+    ;
+  }
+}
+
+STATIC
+HOST_FS_NODE *
+HostFsNewNode (
+  IN HOST_FS_NODE  *Parent,
+  IN CONST CHAR8   *Name,
+  IN UINTN         NameLength,
+  IN BOOLEAN       IsDirectory
+  )
+{
+  HOST_FS_NODE  *Node;
+  HOST_FS_NODE  **Children;
+
+  Node = calloc (1, sizeof (*Node));
+  if (Node == NULL) {
+    return NULL;
+  }
+  NameLength = MIN (NameLength, HOST_FS_NAME_MAX - 1);
+  memcpy (Node->Name, Name, NameLength);
+  Node->IsDirectory = IsDirectory;
+  Node->Parent      = Parent;
+
+  if (Parent != NULL) {
+    if (Parent->ChildCount == Parent->ChildCapacity) {
+      Children = realloc (Parent->Children, (Parent->ChildCapacity * 2 + 8) * sizeof (*Children));
+      if (Children == NULL) {
+        free (Node);
+        return NULL;
+      }
+      Parent->Children      = Children;
+      Parent->ChildCapacity = Parent->ChildCapacity * 2 + 8;
+    }
+    Parent->Children[Parent->ChildCount++] = Node;
+  }
+  return Node;
+}
+
+STATIC
+VOID
+HostFsFreeNode (
+  IN HOST_FS_NODE  *Node
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < Node->ChildCount; Index++) {
+    HostFsFreeNode (Node->Children[Index]);
+  }
+  free (Node->Children);
+  free (Node->Data);
+  free (Node);
+}
+
+STATIC
+HOST_FS_NODE *
+HostFsFindChild (
+  IN HOST_FS_NODE  *Directory,
+  IN CONST CHAR8   *Name,
+  IN UINTN         NameLength
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < Directory->ChildCount; Index++) {
+    if (strlen (Directory->Children[Index]->Name) == NameLength &&
+        strncasecmp (Directory->Children[Index]->Name, Name, NameLength) == 0) {
+      return Directory->Children[Index];
+    }
+  }
+  return NULL;
+}
+
+/**
+  Walks Path from Start.  A leading separator restarts at the volume root.
+  When Create is set, missing components are created: intermediate ones as
+  directories, the last one as a file or directory depending on Directory.
+**/
+STATIC
+HOST_FS_NODE *
+HostFsWalk (
+  IN HOST_FS_NODE  *Start,
+  IN CONST CHAR8   *Path,
+  IN BOOLEAN       Create,
+  IN BOOLEAN       Directory
+  )
+{
+  HOST_FS_NODE  *Node;
+  HOST_FS_NODE  *Child;
+  CONST CHAR8   *End;
+  UINTN         Length;
+
+  Node = Start;
+  if (*Path == '\\' || *Path == '/') {
+    while (Node->Parent != NULL) {
+      Node = Node->Parent;
+    }
+  }
+
+  while (*Path != 0) {
+    while (*Path == '\\' || *Path == '/') {
+      Path++;
+    }
+    if (*Path == 0) {
+      break;
+    }
+    for (End = Path; *End != 0 && *End != '\\' && *End != '/'; End++) {
+      ;
+    }
+    Length = (UINTN) (End - Path);
+    mWalkSteps++;
+
+    if (!Node->IsDirectory) {
+      return NULL;
+    }
+
+    if (Length == 1 && Path[0] == '.') {
+      Child = Node;
+    } else if (Length == 2 && Path[0] == '.' && Path[1] == '.') {
+      if (Node->Parent == NULL) {
+        return NULL;
+      }
+      Child = Node->Parent;
+    } else {
+      Child = HostFsFindChild (Node, Path, Length);
+      if (Child == NULL) {
+        if (!Create) {
+          return NULL;
+        }
+        Child = HostFsNewNode (Node, Path, Length, (BOOLEAN) (*End != 0 || Directory));
+        if (Child == NULL) {
+          return NULL;
+        }
+      }
+    }
+    Node = Child;
+    Path = End;
+  }
+  return Node;
+}
+
+STATIC
+HOST_FILE *
+HostFsNewHandle (
+  IN HOST_FS_NODE  *Node,
+  IN BOOLEAN       Writable
+  )
+{
+  HOST_FILE  *File;
+
+  File = calloc (1, sizeof (*File));
+  if (File != NULL) {
+    File->Protocol = mFileTemplate;
+    if (mReadExDisabled) {
+      File->Protocol.Revision = EFI_FILE_PROTOCOL_REVISION;
+    }
+    File->Node     = Node;
+    File->Writable = Writable;
+  }
+  return File;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostFileOpen (
+  IN  EFI_FILE_PROTOCOL  *This,
+  OUT EFI_FILE_PROTOCOL  **NewHandle,
+  IN  CHAR16             *FileName,
+  IN  UINT64             OpenMode,
+  IN  UINT64             Attributes
+  )
+{
+  HOST_FILE     *File;
+  HOST_FILE     *NewFile;
+  HOST_FS_NODE  *Node;
+  CHAR8         Path[1024];
+
+  File = (HOST_FILE *) This;
+  gHostCounters.FileOpens++;
+
+  if (NewHandle == NULL || FileName == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  if (EFI_ERROR (UnicodeStrToAsciiStrS (FileName, Path, sizeof (Path)))) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // Relative opens are only meaningful from a directory handle.
+  //
+  if (!File->Node->IsDirectory && Path[0] != '\\') {
+    gHostCounters.FileOpenMisses++;
+    return EFI_NOT_FOUND;
+  }
+
+  mWalkSteps = 0;
+  Node = HostFsWalk (File->Node, Path, FALSE, FALSE);
+  if (Node == NULL && (OpenMode & EFI_FILE_MODE_CREATE) != 0) {
+    Node = HostFsWalk (File->Node, Path, TRUE, (BOOLEAN) ((Attributes & EFI_FILE_DIRECTORY) != 0));
+  }
+  HostFsDelay (mOpenLatency * MAX (mWalkSteps, 1));
+  if (Node == NULL) {
+    gHostCounters.FileOpenMisses++;
+    return EFI_NOT_FOUND;
+  }
+
+  NewFile = HostFsNewHandle (Node, (BOOLEAN) ((OpenMode & EFI_FILE_MODE_WRITE) != 0));
+  if (NewFile == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  *NewHandle = &NewFile->Protocol;
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostFileClose (
+  IN EFI_FILE_PROTOCOL  *This
+  )
+{
+  free (This);
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostFileDelete (
+  IN EFI_FILE_PROTOCOL  *This
+  )
+{
+  HOST_FILE     *File;
+  HOST_FS_NODE  *Node;
+  HOST_FS_NODE  *Parent;
+  UINTN         Index;
+
+  File   = (HOST_FILE *) This;
+  Node   = File->Node;
+  Parent = Node->Parent;
+  free (File);
+
+  if (Parent == NULL) {
+    return EFI_WARN_DELETE_FAILURE;
+  }
+  for (Index = 0; Index < Parent->ChildCount; Index++) {
+    if (Parent->Children[Index] == Node) {
+      memmove (&Parent->Children[Index], &Parent->Children[Index + 1], (Parent->ChildCount - Index - 1) * sizeof (Node));
+      Parent->ChildCount--;
+      break;
+    }
+  }
+  HostFsFreeNode (Node);
+  return EFI_SUCCESS;
+}
+
+STATIC
+UINTN
+HostFsFillInfo (
+  IN  HOST_FS_NODE  *Node,
+  OUT EFI_FILE_INFO *Info,
+  IN  UINTN         BufferSize
+  )
+{
+  UINTN  NameLength;
+  UINTN  Needed;
+  UINTN  Index;
+
+  NameLength = strlen (Node->Name);
+  Needed     = SIZE_OF_EFI_FILE_INFO + (NameLength + 1) * sizeof (CHAR16);
+  if (Info == NULL || BufferSize < Needed) {
+    return Needed;
+  }
+
+  ZeroMem (Info, SIZE_OF_EFI_FILE_INFO);
+  Info->Size         = Needed;
+  Info->FileSize     = Node->IsDirectory ? 0 : Node->Size;
+  Info->PhysicalSize = ALIGN_VALUE (Info->FileSize, 512);
+  Info->Attribute    = Node->IsDirectory ? EFI_FILE_DIRECTORY : EFI_FILE_ARCHIVE;
+  Info->ModificationTime.Year       = 2000;
+  Info->ModificationTime.Month      = 1;
+  Info->ModificationTime.Day        = 1;
+  Info->ModificationTime.Nanosecond = (UINT32) Node->Modified;
+  for (Index = 0; Index < NameLength; Index++) {
+    Info->FileName[Index] = (UINT8) Node->Name[Index];
+  }
+  Info->FileName[NameLength] = 0;
+  return Needed;
+}
+
+/**
+  Copies file data from the current position, without the media delay.
+**/
+STATIC
+EFI_STATUS
+HostFileCopy (
+  IN     HOST_FILE  *File,
+  IN OUT UINTN      *BufferSize,
+  OUT    VOID       *Buffer
+  )
+{
+  HOST_FS_NODE  *Node;
+  UINTN         Count;
+
+  Node = File->Node;
+  gHostCounters.FileReads++;
+  if (File->Position >= Node->Size) {
+    *BufferSize = 0;
+    return (File->Position > Node->Size) ? EFI_DEVICE_ERROR : EFI_SUCCESS;
+  }
+  Count = MIN (*BufferSize, Node->Size - (UINTN) File->Position);
+  if (Count != 0 && Buffer == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  memcpy (Buffer, Node->Data + File->Position, Count);
+  File->Position += Count;
+  *BufferSize     = Count;
+
+  gHostCounters.FileReadBytes += Count;
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostFileRead (
+  IN     EFI_FILE_PROTOCOL  *This,
+  IN OUT UINTN              *BufferSize,
+  OUT    VOID               *Buffer
+  )
+{
+  HOST_FILE     *File;
+  HOST_FS_NODE  *Node;
+  UINTN         Needed;
+  EFI_STATUS    Status;
+
+  File = (HOST_FILE *) This;
+  Node = File->Node;
+
+  if (Node->IsDirectory) {
+    gHostCounters.DirectoryReads++;
+    if (File->Position >= Node->ChildCount) {
+      *BufferSize = 0;
+      return EFI_SUCCESS;
+    }
+    Needed = HostFsFillInfo (Node->Children[File->Position], NULL, 0);
+    if (*BufferSize < Needed || Buffer == NULL) {
+      *BufferSize = Needed;
+      return EFI_BUFFER_TOO_SMALL;
+    }
+    *BufferSize = HostFsFillInfo (Node->Children[File->Position], Buffer, *BufferSize);
+    File->Position++;
+    return EFI_SUCCESS;
+  }
+
+  Status = HostFileCopy (File, BufferSize, Buffer);
+  if (!EFI_ERROR (Status) && *BufferSize != 0) {
+    HostFsDelay (mAccessLatency + HostFsTransferTime (*BufferSize));
+  }
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostFileWrite (
+  IN     EFI_FILE_PROTOCOL  *This,
+  IN OUT UINTN              *BufferSize,
+  IN     VOID               *Buffer
+  )
+{
+  HOST_FILE     *File;
+  HOST_FS_NODE  *Node;
+  UINT8         *Data;
+  UINTN         End;
+
+  File = (HOST_FILE *) This;
+  Node = File->Node;
+  if (Node->IsDirectory) {
+    return EFI_UNSUPPORTED;
+  }
+  if (!File->Writable) {
+    return EFI_ACCESS_DENIED;
+  }
+
+  End = (UINTN) File->Position + *BufferSize;
+  if (End > Node->Size) {
+    Data = realloc (Node->Data, End);
+    if (Data == NULL) {
+      return EFI_VOLUME_FULL;
+    }
+    memset (Data + Node->Size, 0, End - Node->Size);
+    Node->Data = Data;
+    Node->Size = End;
+  }
+  memcpy (Node->Data + File->Position, Buffer, *BufferSize);
+  File->Position = End;
+  Node->Modified = ++mModifyCount;
+
+  gHostCounters.FileWrites++;
+  gHostCounters.FileWriteBytes += *BufferSize;
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostFileGetPosition (
+  IN  EFI_FILE_PROTOCOL  *This,
+  OUT UINT64             *Position
+  )
+{
+  HOST_FILE  *File;
+
+  File = (HOST_FILE *) This;
+  if (File->Node->IsDirectory) {
+    return EFI_UNSUPPORTED;
+  }
+  *Position = File->Position;
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostFileSetPosition (
+  IN EFI_FILE_PROTOCOL  *This,
+  IN UINT64             Position
+  )
+{
+  HOST_FILE  *File;
+
+  File = (HOST_FILE *) This;
+  if (File->Node->IsDirectory) {
+    if (Position != 0) {
+      return EFI_UNSUPPORTED;
+    }
+    File->Position = 0;
+    return EFI_SUCCESS;
+  }
+  File->Position = (Position == MAX_UINT64) ? File->Node->Size : Position;
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostFileGetInfo (
+  IN     EFI_FILE_PROTOCOL  *This,
+  IN     EFI_GUID           *InformationType,
+  IN OUT UINTN              *BufferSize,
+  OUT    VOID               *Buffer
+  )
+{
+  HOST_FILE  *File;
+  UINTN      Needed;
+
+  File = (HOST_FILE *) This;
+  if (!CompareGuid (InformationType, &gEfiFileInfoGuid)) {
+    return EFI_UNSUPPORTED;
+  }
+  Needed = HostFsFillInfo (File->Node, NULL, 0);
+  if (*BufferSize < Needed || Buffer == NULL) {
+    *BufferSize = Needed;
+    return EFI_BUFFER_TOO_SMALL;
+  }
+  *BufferSize = HostFsFillInfo (File->Node, Buffer, *BufferSize);
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostFileSetInfo (
+  IN EFI_FILE_PROTOCOL  *This,
+  IN EFI_GUID           *InformationType,
+  IN UINTN              BufferSize,
+  IN VOID               *Buffer
+  )
+{
+  (VOID) This;
+  (VOID) InformationType;
+  (VOID) BufferSize;
+  (VOID) Buffer;
+  return EFI_UNSUPPORTED;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostFileFlush (
+  IN EFI_FILE_PROTOCOL  *This
+  )
+{
+  (VOID) This;
+  gHostCounters.FileFlushes++;
+  return EFI_SUCCESS;
+}
+
+//
+// Revision 2 entry points.  Without an emulated device the in-memory volume
+// has no real asynchrony, so each request completes immediately and signals
+// the token's event exactly the way a firmware driver would once the
+// transfer finished.
+//
+STATIC
+EFI_STATUS
+HostFileComplete (
+  IN EFI_FILE_IO_TOKEN  *Token,
+  IN EFI_STATUS         Status
+  )
+{
+  if (Token == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  Token->Status = Status;
+  if (Token->Event != NULL) {
+    gBS->SignalEvent (Token->Event);
+  }
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostFileOpenEx (
+  IN     EFI_FILE_PROTOCOL  *This,
+  OUT    EFI_FILE_PROTOCOL  **NewHandle,
+  IN     CHAR16             *FileName,
+  IN     UINT64             OpenMode,
+  IN     UINT64             Attributes,
+  IN OUT EFI_FILE_IO_TOKEN  *Token
+  )
+{
+  return HostFileComplete (Token, HostFileOpen (This, NewHandle, FileName, OpenMode, Attributes));
+}
+
+VOID
+HostFsPoll (
+  VOID
+  )
+{
+  UINT64  Now;
+  UINTN   Index;
+  UINTN   Kept;
+
+  if (mPendingCount == 0) {
+    return;
+  }
+  Now  = HostNanoseconds ();
+  Kept = 0;
+  for (Index = 0; Index < mPendingCount; Index++) {
+    if (mPending[Index].Due <= Now) {
+      HostFileComplete (mPending[Index].Token, mPending[Index].Status);
+    } else {
+      mPending[Kept++] = mPending[Index];
+    }
+  }
+  mPendingCount = Kept;
+}
+
+/**
+  On the emulated device a file ReadEx() with an event completes in the
+  background.  Its access time overlaps that of the other requests in
+  flight and only its transfer waits for theirs, so the completion is
+  queued for HostFsPoll() to signal.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+HostFileReadEx (
+  IN     EFI_FILE_PROTOCOL  *This,
+  IN OUT EFI_FILE_IO_TOKEN  *Token
+  )
+{
+  HOST_FILE   *File;
+  EFI_STATUS  Status;
+  UINT64      Start;
+
+  if (Token == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  File = (HOST_FILE *) This;
+  if (Token->Event == NULL || File->Node->IsDirectory ||
+      (mAccessLatency == 0 && mReadLatencyPerKb == 0 && mClusterLatency == 0)) {
+    return HostFileComplete (Token, HostFileRead (This, &Token->BufferSize, Token->Buffer));
+  }
+
+  Status       = HostFileCopy (File, &Token->BufferSize, Token->Buffer);
+  Start        = MAX (HostNanoseconds () + mAccessLatency, mChannelFree);
+  mChannelFree = Start + HostFsTransferTime (Token->BufferSize);
+  if (mPendingCount == HOST_FS_MAX_PENDING) {
+    while (HostNanoseconds () < mChannelFree) {
+      ;
+    }
+    return HostFileComplete (Token, Status);
+  }
+  mPending[mPendingCount].Token  = Token;
+  mPending[mPendingCount].Status = Status;
+  mPending[mPendingCount].Due    = mChannelFree;
+  mPendingCount++;
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostFileWriteEx (
+  IN     EFI_FILE_PROTOCOL  *This,
+  IN OUT EFI_FILE_IO_TOKEN  *Token
+  )
+{
+  if (Token == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  return HostFileComplete (Token, HostFileWrite (This, &Token->BufferSize, Token->Buffer));
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostFileFlushEx (
+  IN     EFI_FILE_PROTOCOL  *This,
+  IN OUT EFI_FILE_IO_TOKEN  *Token
+  )
+{
+  return HostFileComplete (Token, HostFileFlush (This));
+}
+
+STATIC EFI_FILE_PROTOCOL  mFileTemplate = {
+  EFI_FILE_PROTOCOL_REVISION2,
+  HostFileOpen,
+  HostFileClose,
+  HostFileDelete,
+  HostFileRead,
+  HostFileWrite,
+  HostFileGetPosition,
+  HostFileSetPosition,
+  HostFileGetInfo,
+  HostFileSetInfo,
+  HostFileFlush,
+  HostFileOpenEx,
+  HostFileReadEx,
+  HostFileWriteEx,
+  HostFileFlushEx
+};
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostOpenVolume (
+  IN  EFI_SIMPLE_FILE_SYSTEM_PROTOCOL  *This,
+  OUT EFI_FILE_PROTOCOL                **Root
+  )
+{
+  HOST_FILE  *File;
+
+  File = HostFsNewHandle (((HOST_FS_VOLUME *) This)->Root, TRUE);
+  if (File == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  *Root = &File->Protocol;
+  return EFI_SUCCESS;
+}
+
+/**
+  Reads the emulated partition.  Each call waits for the device once and
+  then moves its bytes at the Read cost per KB.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+HostDiskRead (
+  IN  EFI_DISK_IO_PROTOCOL  *This,
+  IN  UINT32                MediaId,
+  IN  UINT64                Offset,
+  IN  UINTN                 BufferSize,
+  OUT VOID                  *Buffer
+  )
+{
+  HOST_FS_VOLUME  *Volume;
+  UINT64          DiskSize;
+  UINT64          Start;
+  UINT64          End;
+
+  Volume   = (HOST_FS_VOLUME *) ((UINT8 *) This - OFFSET_OF (HOST_FS_VOLUME, DiskIo));
+  DiskSize = (Volume->Media.LastBlock + 1) * Volume->Media.BlockSize;
+  if (MediaId != Volume->Media.MediaId) {
+    return EFI_MEDIA_CHANGED;
+  }
+  if (Offset > DiskSize || BufferSize > DiskSize - Offset) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  gHostCounters.FileReads++;
+  gHostCounters.FileReadBytes += BufferSize;
+  memset (Buffer, 0, BufferSize);
+  Start = MAX (Offset, Volume->BlocksOffset);
+  End   = MIN (Offset + BufferSize, Volume->BlocksOffset + Volume->BlocksSize);
+  if (Volume->Blocks != NULL && Start < End) {
+    memcpy ((UINT8 *) Buffer + (Start - Offset), Volume->Blocks + (Start - Volume->BlocksOffset), (size_t) (End - Start));
+  }
+
+  HostFsDelay (mAccessLatency + (mReadLatencyPerKb * BufferSize) / 1024);
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostDiskWrite (
+  IN EFI_DISK_IO_PROTOCOL  *This,
+  IN UINT32                MediaId,
+  IN UINT64                Offset,
+  IN UINTN                 BufferSize,
+  IN VOID                  *Buffer
+  )
+{
+  return EFI_WRITE_PROTECTED;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostBlockReset (
+  IN EFI_BLOCK_IO_PROTOCOL  *This,
+  IN BOOLEAN                ExtendedVerification
+  )
+{
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostBlockRead (
+  IN  EFI_BLOCK_IO_PROTOCOL  *This,
+  IN  UINT32                 MediaId,
+  IN  EFI_LBA                Lba,
+  IN  UINTN                  BufferSize,
+  OUT VOID                   *Buffer
+  )
+{
+  HOST_FS_VOLUME  *Volume;
+
+  Volume = (HOST_FS_VOLUME *) ((UINT8 *) This - OFFSET_OF (HOST_FS_VOLUME, BlockIo));
+  if (BufferSize % Volume->Media.BlockSize != 0) {
+    return EFI_BAD_BUFFER_SIZE;
+  }
+  return HostDiskRead (&Volume->DiskIo, MediaId, Lba * Volume->Media.BlockSize, BufferSize, Buffer);
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostBlockWrite (
+  IN EFI_BLOCK_IO_PROTOCOL  *This,
+  IN UINT32                 MediaId,
+  IN EFI_LBA                Lba,
+  IN UINTN                  BufferSize,
+  IN VOID                   *Buffer
+  )
+{
+  return EFI_WRITE_PROTECTED;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostBlockFlush (
+  IN EFI_BLOCK_IO_PROTOCOL  *This
+  )
+{
+  return EFI_SUCCESS;
+}
+
+HOST_FS_NODE *
+HostFsCreateVolume (
+  VOID
+  )
+{
+  HOST_FS_NODE    *Root;
+  HOST_FS_VOLUME  *Volume;
+
+  Root   = HostFsNewNode (NULL, "", 0, TRUE);
+  Volume = calloc (1, sizeof (*Volume));
+  if (Root == NULL || Volume == NULL) {
+    free (Root);
+    free (Volume);
+    return NULL;
+  }
+  Volume->Protocol.Revision   = EFI_SIMPLE_FILE_SYSTEM_PROTOCOL_REVISION;
+  Volume->Protocol.OpenVolume = HostOpenVolume;
+  Volume->Root                = Root;
+  Volume->Media.MediaId          = 1;
+  Volume->Media.MediaPresent     = TRUE;
+  Volume->Media.LogicalPartition = TRUE;
+  Volume->Media.ReadOnly         = TRUE;
+  Volume->Media.BlockSize        = HOST_FS_BLOCK_SIZE;
+  Volume->Media.IoAlign          = 1;
+  Volume->Media.LastBlock        = HOST_FS_BLOCK_COUNT - 1;
+  Volume->BlockIo.Revision       = EFI_BLOCK_IO_PROTOCOL_REVISION;
+  Volume->BlockIo.Media          = &Volume->Media;
+  Volume->BlockIo.Reset          = HostBlockReset;
+  Volume->BlockIo.ReadBlocks     = HostBlockRead;
+  Volume->BlockIo.WriteBlocks    = HostBlockWrite;
+  Volume->BlockIo.FlushBlocks    = HostBlockFlush;
+  Volume->DiskIo.Revision        = EFI_DISK_IO_PROTOCOL_REVISION;
+  Volume->DiskIo.ReadDisk        = HostDiskRead;
+  Volume->DiskIo.WriteDisk       = HostDiskWrite;
+  Root->Volume                = &Volume->Protocol;
+  return Root;
+}
+
+VOID
+HostFsDestroyVolume (
+  IN HOST_FS_NODE  *Root
+  )
+{
+  if (Root != NULL) {
+    if (Root->Volume != NULL) {
+      free (((HOST_FS_VOLUME *) Root->Volume)->Blocks);
+    }
+    free (Root->Volume);
+    HostFsFreeNode (Root);
+  }
+}
+
+EFI_SIMPLE_FILE_SYSTEM_PROTOCOL *
+HostFsGetProtocol (
+  IN HOST_FS_NODE  *Root
+  )
+{
+  return Root->Volume;
+}
+
+EFI_BLOCK_IO_PROTOCOL *
+HostFsGetBlockIo (
+  IN HOST_FS_NODE  *Root
+  )
+{
+  return &((HOST_FS_VOLUME *) Root->Volume)->BlockIo;
+}
+
+EFI_DISK_IO_PROTOCOL *
+HostFsGetDiskIo (
+  IN HOST_FS_NODE  *Root
+  )
+{
+  return &((HOST_FS_VOLUME *) Root->Volume)->DiskIo;
+}
+
+EFI_STATUS
+HostFsPlaceFile (
+  IN HOST_FS_NODE  *Root,
+  IN CONST CHAR8   *Path,
+  IN EFI_LBA       Lba
+  )
+{
+  HOST_FS_VOLUME  *Volume;
+  HOST_FS_NODE    *Node;
+  UINT8           *Copy;
+
+  Volume = (HOST_FS_VOLUME *) Root->Volume;
+  Node   = HostFsWalk (Root, Path, FALSE, FALSE);
+  if (Node == NULL || Node->IsDirectory) {
+    return EFI_NOT_FOUND;
+  }
+  if (Lba >= HOST_FS_BLOCK_COUNT ||
+      Node->Size > (HOST_FS_BLOCK_COUNT - Lba) * HOST_FS_BLOCK_SIZE) {
+    return EFI_VOLUME_FULL;
+  }
+  Copy = malloc (Node->Size == 0 ? 1 : Node->Size);
+  if (Copy == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  memcpy (Copy, Node->Data, Node->Size);
+  free (Volume->Blocks);
+  Volume->Blocks       = Copy;
+  Volume->BlocksOffset = Lba * HOST_FS_BLOCK_SIZE;
+  Volume->BlocksSize   = Node->Size;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+HostFsAddDirectory (
+  IN HOST_FS_NODE  *Root,
+  IN CONST CHAR8   *Path
+  )
+{
+  HOST_FS_NODE  *Node;
+
+  Node = HostFsWalk (Root, Path, TRUE, TRUE);
+  return (Node != NULL && Node->IsDirectory) ? EFI_SUCCESS : EFI_ACCESS_DENIED;
+}
+
+EFI_STATUS
+HostFsAddFile (
+  IN HOST_FS_NODE  *Root,
+  IN CONST CHAR8   *Path,
+  IN CONST VOID    *Data,
+  IN UINTN         Size
+  )
+{
+  HOST_FS_NODE  *Node;
+  UINT8         *Copy;
+
+  Node = HostFsWalk (Root, Path, TRUE, FALSE);
+  if (Node == NULL || Node->IsDirectory) {
+    return EFI_ACCESS_DENIED;
+  }
+  Copy = malloc (Size == 0 ? 1 : Size);
+  if (Copy == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  memcpy (Copy, Data, Size);
+  free (Node->Data);
+  Node->Data     = Copy;
+  Node->Size     = Size;
+  Node->Modified = ++mModifyCount;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+HostFsAddZeroFile (
+  IN HOST_FS_NODE  *Root,
+  IN CONST CHAR8   *Path,
+  IN UINTN         Size
+  )
+{
+  HOST_FS_NODE  *Node;
+  UINT8         *Data;
+
+  Node = HostFsWalk (Root, Path, TRUE, FALSE);
+  if (Node == NULL || Node->IsDirectory) {
+    return EFI_ACCESS_DENIED;
+  }
+  //
+  // A large calloc() is mapped from zero pages, which stay shared until
+  // something is written to them.
+  //
+  Data = calloc (1, Size == 0 ? 1 : Size);
+  if (Data == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  free (Node->Data);
+  Node->Data     = Data;
+  Node->Size     = Size;
+  Node->Modified = ++mModifyCount;
+  return EFI_SUCCESS;
+}
+
+UINT64
+HostFsGetFileTime (
+  IN HOST_FS_NODE  *Root,
+  IN CONST CHAR8   *Path
+  )
+{
+  HOST_FS_NODE  *Node;
+
+  Node = HostFsWalk (Root, Path, FALSE, FALSE);
+  return (Node != NULL) ? Node->Modified : 0;
+}
+
+EFI_STATUS
+HostFsSetFileTime (
+  IN HOST_FS_NODE  *Root,
+  IN CONST CHAR8   *Path,
+  IN UINT64        Time
+  )
+{
+  HOST_FS_NODE  *Node;
+
+  Node = HostFsWalk (Root, Path, FALSE, FALSE);
+  if (Node == NULL) {
+    return EFI_NOT_FOUND;
+  }
+  Node->Modified = Time;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+HostFsRemoveFile (
+  IN HOST_FS_NODE  *Root,
+  IN CONST CHAR8   *Path
+  )
+{
+  HOST_FILE     *File;
+  HOST_FS_NODE  *Node;
+
+  Node = HostFsWalk (Root, Path, FALSE, FALSE);
+  if (Node == NULL || Node->IsDirectory) {
+    return EFI_NOT_FOUND;
+  }
+  File = HostFsNewHandle (Node, TRUE);
+  if (File == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  return HostFileDelete (&File->Protocol);
+}
+
+CONST VOID *
+HostFsGetFile (
+  IN  HOST_FS_NODE  *Root,
+  IN  CONST CHAR8   *Path,
+  OUT UINTN         *Size
+  )
+{
+  HOST_FS_NODE  *Node;
+
+  Node = HostFsWalk (Root, Path, FALSE, FALSE);
+  if (Node == NULL || Node->IsDirectory) {
+    return NULL;
+  }
+  *Size = Node->Size;
+  return Node->Data;
+}
+
+EFI_STATUS
+HostFsImportDirectory (
+  IN HOST_FS_NODE  *Root,
+  IN CONST CHAR8   *Path,
+  IN CONST CHAR8   *HostDirectory
+  )
+{
+  DIR            *Dir;
+  struct dirent  *Entry;
+  struct stat    Info;
+  CHAR8          HostPath[4096];
+  CHAR8          VolumePath[1024];
+  FILE           *Stream;
+  UINT8          *Data;
+  EFI_STATUS     Status;
+
+  Dir = opendir (HostDirectory);
+  if (Dir == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  Status = HostFsAddDirectory (Root, Path);
+  while (!EFI_ERROR (Status) && (Entry = readdir (Dir)) != NULL) {
+    if (strcmp (Entry->d_name, ".") == 0 || strcmp (Entry->d_name, "..") == 0) {
+      continue;
+    }
+    snprintf (HostPath, sizeof (HostPath), "%s/%s", HostDirectory, Entry->d_name);
+    snprintf (VolumePath, sizeof (VolumePath), "%s\\%s", Path, Entry->d_name);
+    if (stat (HostPath, &Info) != 0) {
+      continue;
+    }
+
+    if (S_ISDIR (Info.st_mode)) {
+      Status = HostFsImportDirectory (Root, VolumePath, HostPath);
+      continue;
+    }
+
+    Stream = fopen (HostPath, "rb");
+    if (Stream == NULL) {
+      continue;
+    }
+    Data = malloc (Info.st_size == 0 ? 1 : (size_t) Info.st_size);
+    if (Data != NULL && fread (Data, 1, (size_t) Info.st_size, Stream) == (size_t) Info.st_size) {
+      Status = HostFsAddFile (Root, VolumePath, Data, (UINTN) Info.st_size);
+    }
+    free (Data);
+    fclose (Stream);
+  }
+
+  closedir (Dir);
+  return Status;
+}
@@ -0,0 +1,5 @@
+/** @file
+  Host build wrapper for <Guid/Acpi.h>.
+**/
+
+#include <HostUefi.h>
@@ -0,0 +1,5 @@
+/** @file
+  Host build wrapper for <Guid/FileInfo.h>.
+**/
+
+#include <HostUefi.h>
@@ -0,0 +1,5 @@
+/** @file
+  Host build wrapper for <Guid/GlobalVariable.h>.
+**/
+
+#include <HostUefi.h>
@@ -0,0 +1,5 @@
+/** @file
+  Host build wrapper for <Guid/Gpt.h>.
+**/
+
+#include <HostUefi.h>
@@ -0,0 +1,857 @@
+/** @file
+  Minimal UEFI/EDK2 environment for building the ACPIPatcher core on a
+  Linux host.
+
+  This header stands in for the handful of MdePkg headers that
+  ACPIPatcher.c and FsHelpers.c include.  Only the types, protocols and
+  library functions those modules actually use are provided; layouts of
+  structures that are read from firmware memory (ACPI tables, EFI_FILE_INFO)
+  match the specifications byte for byte.
+
+  Every EDK2 include path used by the core (Uefi.h and the Library, Guid
+  and Protocol headers) is a one line wrapper around this file.
+
+**/
+
+#ifndef __HOST_UEFI_H__
+#define __HOST_UEFI_H__
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// Base types (MdePkg/Include/X64/ProcessorBind.h, Base.h)
+//
+typedef uint8_t             UINT8;
+typedef int8_t              INT8;
+typedef uint16_t            UINT16;
+typedef int16_t             INT16;
+typedef uint32_t            UINT32;
+typedef int32_t             INT32;
+typedef uint64_t            UINT64;
+typedef int64_t             INT64;
+typedef uintptr_t           UINTN;
+typedef intptr_t            INTN;
+typedef unsigned char       BOOLEAN;
+typedef char                CHAR8;
+typedef unsigned short      CHAR16;
+typedef void                VOID;
+
+typedef UINTN               RETURN_STATUS;
+typedef RETURN_STATUS       EFI_STATUS;
+typedef VOID                *EFI_HANDLE;
+typedef VOID                *EFI_EVENT;
+typedef UINTN               EFI_TPL;
+typedef UINT64              EFI_LBA;
+typedef UINT64              EFI_PHYSICAL_ADDRESS;
+typedef UINT64              EFI_VIRTUAL_ADDRESS;
+
+typedef struct {
+  UINT32  Data1;
+  UINT16  Data2;
+  UINT16  Data3;
+  UINT8   Data4[8];
+} GUID;
+typedef GUID                EFI_GUID;
+
+typedef struct {
+  UINT16  Year;
+  UINT8   Month;
+  UINT8   Day;
+  UINT8   Hour;
+  UINT8   Minute;
+  UINT8   Second;
+  UINT8   Pad1;
+  UINT32  Nanosecond;
+  INT16   TimeZone;
+  UINT8   Daylight;
+  UINT8   Pad2;
+} EFI_TIME;
+
+#define IN
+#define OUT
+#define OPTIONAL
+#define CONST               const
+#define STATIC              static
+#define EFIAPI
+#define GLOBAL_REMOVE_IF_UNREFERENCED
+
+#define TRUE                ((BOOLEAN)(1 == 1))
+#define FALSE               ((BOOLEAN)(0 == 1))
+#ifndef NULL
+#define NULL                ((VOID *) 0)
+#endif
+
+#define MDE_CPU_X64
+
+#define VA_LIST             va_list
+#define VA_START(M, P)      va_start (M, P)
+#define VA_ARG(M, T)        va_arg (M, T)
+#define VA_END(M)           va_end (M)
+#define VA_COPY(D, S)       va_copy (D, S)
+
+#define OFFSET_OF(TYPE, Field)  ((UINTN) offsetof (TYPE, Field))
+#define BASE_CR(Record, TYPE, Field)  ((TYPE *) ((CHAR8 *) (Record) - OFFSET_OF (TYPE, Field)))
+#define ALIGN_VALUE(Value, Alignment) ((Value) + (((Alignment) - (Value)) & ((Alignment) - 1U)))
+#define ALIGN_POINTER(Pointer, Alignment) ((VOID *) (ALIGN_VALUE ((UINTN)(Pointer), (Alignment))))
+#define ARRAY_SIZE(Array)   (sizeof (Array) / sizeof ((Array)[0]))
+#define SIGNATURE_16(A, B)        ((A) | (B << 8))
+#define SIGNATURE_32(A, B, C, D)  (SIGNATURE_16 (A, B) | (SIGNATURE_16 (C, D) << 16))
+#define SIGNATURE_64(A, B, C, D, E, F, G, H) \
+    (SIGNATURE_32 (A, B, C, D) | ((UINT64) (SIGNATURE_32 (E, F, G, H)) << 32))
+
+#ifndef MAX
+#define MAX(a, b)           (((a) > (b)) ? (a) : (b))
+#endif
+#ifndef MIN
+#define MIN(a, b)           (((a) < (b)) ? (a) : (b))
+#endif
+
+#define BIT0                0x00000001
+#define BIT1                0x00000002
+#define BIT2                0x00000004
+#define BIT3                0x00000008
+#define BIT4                0x00000010
+#define BIT5                0x00000020
+#define BIT6                0x00000040
+#define BIT7                0x00000080
+#define BIT8                0x00000100
+#define BIT9                0x00000200
+#define BIT10               0x00000400
+#define BIT11               0x00000800
+#define BIT12               0x00001000
+#define BIT13               0x00002000
+#define BIT14               0x00004000
+#define BIT15               0x00008000
+
+#define MAX_UINT8           ((UINT8) 0xFF)
+#define MAX_UINT16          ((UINT16) 0xFFFF)
+#define MAX_UINT32          ((UINT32) 0xFFFFFFFF)
+#define MAX_UINT64          ((UINT64) 0xFFFFFFFFFFFFFFFFULL)
+#define MAX_UINTN           ((UINTN) -1)
+#define BASE_4GB            0x0000000100000000ULL
+#define SIZE_4KB            0x00001000
+#define SIZE_8KB            0x00002000
+#define SIZE_16KB           0x00004000
+#define SIZE_64KB           0x00010000
+#define SIZE_256KB          0x00040000
+#define SIZE_1MB            0x00100000
+#define SIZE_8MB            0x00800000
+#define SIZE_16MB           0x01000000
+#define SIZE_1GB            0x40000000
+
+//
+// Status codes
+//
+#define MAX_BIT                   ((UINTN) 1 << (sizeof (UINTN) * 8 - 1))
+#define ENCODE_ERROR(a)           ((RETURN_STATUS) (MAX_BIT | (a)))
+#define ENCODE_WARNING(a)         ((RETURN_STATUS) (a))
+#define RETURN_ERROR(a)           (((INTN) (RETURN_STATUS) (a)) < 0)
+#define EFI_ERROR(A)              RETURN_ERROR (A)
+
+#define EFI_SUCCESS               0
+#define EFI_LOAD_ERROR            ENCODE_ERROR (1)
+#define EFI_INVALID_PARAMETER     ENCODE_ERROR (2)
+#define EFI_UNSUPPORTED           ENCODE_ERROR (3)
+#define EFI_BAD_BUFFER_SIZE       ENCODE_ERROR (4)
+#define EFI_BUFFER_TOO_SMALL      ENCODE_ERROR (5)
+#define EFI_NOT_READY             ENCODE_ERROR (6)
+#define EFI_DEVICE_ERROR          ENCODE_ERROR (7)
+#define EFI_WRITE_PROTECTED       ENCODE_ERROR (8)
+#define EFI_OUT_OF_RESOURCES      ENCODE_ERROR (9)
+#define EFI_VOLUME_CORRUPTED      ENCODE_ERROR (10)
+#define EFI_VOLUME_FULL           ENCODE_ERROR (11)
+#define EFI_NO_MEDIA              ENCODE_ERROR (12)
+#define EFI_MEDIA_CHANGED         ENCODE_ERROR (13)
+#define EFI_NOT_FOUND             ENCODE_ERROR (14)
+#define EFI_ACCESS_DENIED         ENCODE_ERROR (15)
+#define EFI_NO_RESPONSE           ENCODE_ERROR (16)
+#define EFI_NO_MAPPING            ENCODE_ERROR (17)
+#define EFI_TIMEOUT               ENCODE_ERROR (18)
+#define EFI_NOT_STARTED           ENCODE_ERROR (19)
+#define EFI_ALREADY_STARTED       ENCODE_ERROR (20)
+#define EFI_ABORTED               ENCODE_ERROR (21)
+#define EFI_ICMP_ERROR            ENCODE_ERROR (22)
+#define EFI_TFTP_ERROR            ENCODE_ERROR (23)
+#define EFI_PROTOCOL_ERROR        ENCODE_ERROR (24)
+#define EFI_INCOMPATIBLE_VERSION  ENCODE_ERROR (25)
+#define EFI_SECURITY_VIOLATION    ENCODE_ERROR (26)
+#define EFI_CRC_ERROR             ENCODE_ERROR (27)
+#define EFI_END_OF_MEDIA          ENCODE_ERROR (28)
+#define EFI_END_OF_FILE           ENCODE_ERROR (31)
+#define EFI_INVALID_LANGUAGE      ENCODE_ERROR (32)
+#define EFI_COMPROMISED_DATA      ENCODE_ERROR (33)
+
+#define EFI_WARN_UNKNOWN_GLYPH    ENCODE_WARNING (1)
+#define EFI_WARN_DELETE_FAILURE   ENCODE_WARNING (2)
+#define EFI_WARN_WRITE_FAILURE    ENCODE_WARNING (3)
+#define EFI_WARN_BUFFER_TOO_SMALL ENCODE_WARNING (4)
+
+#define ASSERT(Expression)
+#define DEBUG(Expression)
+
+//
+// DebugLib error levels
+//
+#define DEBUG_INIT      0x00000001
+#define DEBUG_WARN      0x00000002
+#define DEBUG_LOAD      0x00000004
+#define DEBUG_FS        0x00000008
+#define DEBUG_INFO      0x00000040
+#define DEBUG_VERBOSE   0x00400000
+#define DEBUG_ERROR     0x80000000
+
+//
+// Memory types and allocation
+//
+typedef enum {
+  EfiReservedMemoryType,
+  EfiLoaderCode,
+  EfiLoaderData,
+  EfiBootServicesCode,
+  EfiBootServicesData,
+  EfiRuntimeServicesCode,
+  EfiRuntimeServicesData,
+  EfiConventionalMemory,
+  EfiUnusableMemory,
+  EfiACPIReclaimMemory,
+  EfiACPIMemoryNVS,
+  EfiMemoryMappedIO,
+  EfiMemoryMappedIOPortSpace,
+  EfiPalCode,
+  EfiPersistentMemory,
+  EfiMaxMemoryType
+} EFI_MEMORY_TYPE;
+
+typedef enum {
+  AllocateAnyPages,
+  AllocateMaxAddress,
+  AllocateAddress,
+  MaxAllocateType
+} EFI_ALLOCATE_TYPE;
+
+#define EFI_PAGE_SIZE             SIZE_4KB
+#define EFI_PAGE_MASK             0xFFF
+#define EFI_PAGE_SHIFT            12
+#define EFI_SIZE_TO_PAGES(Size)   (((Size) >> EFI_PAGE_SHIFT) + (((Size) & EFI_PAGE_MASK) ? 1 : 0))
+#define EFI_PAGES_TO_SIZE(Pages)  ((UINTN) (Pages) << EFI_PAGE_SHIFT)
+
+//
+// Events and task priority levels
+//
+#define TPL_APPLICATION           4
+#define TPL_CALLBACK              8
+#define TPL_NOTIFY                16
+#define TPL_HIGH_LEVEL            31
+
+#define EVT_TIMER                         0x80000000
+#define EVT_RUNTIME                       0x40000000
+#define EVT_NOTIFY_WAIT                   0x00000100
+#define EVT_NOTIFY_SIGNAL                 0x00000200
+#define EVT_SIGNAL_EXIT_BOOT_SERVICES     0x00000201
+#define EVT_SIGNAL_VIRTUAL_ADDRESS_CHANGE 0x60000202
+
+typedef
+VOID
+(EFIAPI *EFI_EVENT_NOTIFY)(
+  IN  EFI_EVENT                Event,
+  IN  VOID                     *Context
+  );
+
+typedef enum {
+  TimerCancel,
+  TimerPeriodic,
+  TimerRelative
+} EFI_TIMER_DELAY;
+
+typedef enum {
+  AllHandles,
+  ByRegisterNotify,
+  ByProtocol
+} EFI_LOCATE_SEARCH_TYPE;
+
+typedef enum {
+  EFI_NATIVE_INTERFACE
+} EFI_INTERFACE_TYPE;
+
+#define EFI_OPEN_PROTOCOL_BY_HANDLE_PROTOCOL  0x00000001
+#define EFI_OPEN_PROTOCOL_GET_PROTOCOL        0x00000002
+#define EFI_OPEN_PROTOCOL_TEST_PROTOCOL       0x00000004
+
+//
+// Device paths
+//
+typedef struct {
+  UINT8   Type;
+  UINT8   SubType;
+  UINT8   Length[2];
+} EFI_DEVICE_PATH_PROTOCOL;
+
+#define HARDWARE_DEVICE_PATH      0x01
+#define ACPI_DEVICE_PATH          0x02
+#define MESSAGING_DEVICE_PATH     0x03
+#define MEDIA_DEVICE_PATH         0x04
+#define BBS_DEVICE_PATH           0x05
+#define END_DEVICE_PATH_TYPE      0x7f
+#define END_ENTIRE_DEVICE_PATH_SUBTYPE 0xFF
+#define END_INSTANCE_DEVICE_PATH_SUBTYPE 0x01
+#define END_DEVICE_PATH_LENGTH    (sizeof (EFI_DEVICE_PATH_PROTOCOL))
+
+#define MEDIA_HARDDRIVE_DP        0x01
+#define MEDIA_FILEPATH_DP         0x04
+
+#define MBR_TYPE_PCAT             0x01
+#define MBR_TYPE_EFI_PARTITION_TABLE_HEADER 0x02
+#define NO_DISK_SIGNATURE         0x00
+#define SIGNATURE_TYPE_MBR        0x01
+#define SIGNATURE_TYPE_GUID       0x02
+
+#pragma pack(1)
+typedef struct {
+  EFI_DEVICE_PATH_PROTOCOL  Header;
+  UINT32                    PartitionNumber;
+  UINT64                    PartitionStart;
+  UINT64                    PartitionSize;
+  UINT8                     Signature[16];
+  UINT8                     MBRType;
+  UINT8                     SignatureType;
+} HARDDRIVE_DEVICE_PATH;
+
+typedef struct {
+  EFI_DEVICE_PATH_PROTOCOL  Header;
+  CHAR16                    PathName[1];
+} FILEPATH_DEVICE_PATH;
+#pragma pack()
+
+#define SIZE_OF_FILEPATH_DEVICE_PATH  OFFSET_OF (FILEPATH_DEVICE_PATH, PathName)
+
+//
+// Protocol forward declarations
+//
+typedef struct _EFI_FILE_PROTOCOL               EFI_FILE_PROTOCOL;
+typedef struct _EFI_FILE_PROTOCOL               *EFI_FILE_HANDLE;
+typedef struct _EFI_SIMPLE_FILE_SYSTEM_PROTOCOL EFI_SIMPLE_FILE_SYSTEM_PROTOCOL;
+typedef struct _EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL;
+typedef struct _EFI_SIMPLE_TEXT_INPUT_PROTOCOL  EFI_SIMPLE_TEXT_INPUT_PROTOCOL;
+
+//
+// Simple File System / File protocol
+//
+#define EFI_FILE_PROTOCOL_REVISION        0x00010000
+#define EFI_FILE_PROTOCOL_REVISION2       0x00020000
+#define EFI_FILE_PROTOCOL_LATEST_REVISION EFI_FILE_PROTOCOL_REVISION2
+#define EFI_SIMPLE_FILE_SYSTEM_PROTOCOL_REVISION  0x00010000
+
+#define EFI_FILE_MODE_READ    0x0000000000000001ULL
+#define EFI_FILE_MODE_WRITE   0x0000000000000002ULL
+#define EFI_FILE_MODE_CREATE  0x8000000000000000ULL
+
+#define EFI_FILE_READ_ONLY    0x0000000000000001ULL
+#define EFI_FILE_HIDDEN       0x0000000000000002ULL
+#define EFI_FILE_SYSTEM       0x0000000000000004ULL
+#define EFI_FILE_RESERVED     0x0000000000000008ULL
+#define EFI_FILE_DIRECTORY    0x0000000000000010ULL
+#define EFI_FILE_ARCHIVE      0x0000000000000020ULL
+#define EFI_FILE_VALID_ATTR   0x0000000000000037ULL
+
+typedef struct {
+  EFI_EVENT   Event;
+  EFI_STATUS  Status;
+  UINTN       BufferSize;
+  VOID        *Buffer;
+} EFI_FILE_IO_TOKEN;
+
+typedef EFI_STATUS (EFIAPI *EFI_FILE_OPEN)(EFI_FILE_PROTOCOL *This, EFI_FILE_PROTOCOL **NewHandle, CHAR16 *FileName, UINT64 OpenMode, UINT64 Attributes);
+typedef EFI_STATUS (EFIAPI *EFI_FILE_CLOSE)(EFI_FILE_PROTOCOL *This);
+typedef EFI_STATUS (EFIAPI *EFI_FILE_DELETE)(EFI_FILE_PROTOCOL *This);
+typedef EFI_STATUS (EFIAPI *EFI_FILE_READ)(EFI_FILE_PROTOCOL *This, UINTN *BufferSize, VOID *Buffer);
+typedef EFI_STATUS (EFIAPI *EFI_FILE_WRITE)(EFI_FILE_PROTOCOL *This, UINTN *BufferSize, VOID *Buffer);
+typedef EFI_STATUS (EFIAPI *EFI_FILE_SET_POSITION)(EFI_FILE_PROTOCOL *This, UINT64 Position);
+typedef EFI_STATUS (EFIAPI *EFI_FILE_GET_POSITION)(EFI_FILE_PROTOCOL *This, UINT64 *Position);
+typedef EFI_STATUS (EFIAPI *EFI_FILE_GET_INFO)(EFI_FILE_PROTOCOL *This, EFI_GUID *InformationType, UINTN *BufferSize, VOID *Buffer);
+typedef EFI_STATUS (EFIAPI *EFI_FILE_SET_INFO)(EFI_FILE_PROTOCOL *This, EFI_GUID *InformationType, UINTN BufferSize, VOID *Buffer);
+typedef EFI_STATUS (EFIAPI *EFI_FILE_FLUSH)(EFI_FILE_PROTOCOL *This);
+typedef EFI_STATUS (EFIAPI *EFI_FILE_OPEN_EX)(EFI_FILE_PROTOCOL *This, EFI_FILE_PROTOCOL **NewHandle, CHAR16 *FileName, UINT64 OpenMode, UINT64 Attributes, EFI_FILE_IO_TOKEN *Token);
+typedef EFI_STATUS (EFIAPI *EFI_FILE_READ_EX)(EFI_FILE_PROTOCOL *This, EFI_FILE_IO_TOKEN *Token);
+typedef EFI_STATUS (EFIAPI *EFI_FILE_WRITE_EX)(EFI_FILE_PROTOCOL *This, EFI_FILE_IO_TOKEN *Token);
+typedef EFI_STATUS (EFIAPI *EFI_FILE_FLUSH_EX)(EFI_FILE_PROTOCOL *This, EFI_FILE_IO_TOKEN *Token);
+
+struct _EFI_FILE_PROTOCOL {
+  UINT64                  Revision;
+  EFI_FILE_OPEN           Open;
+  EFI_FILE_CLOSE          Close;
+  EFI_FILE_DELETE         Delete;
+  EFI_FILE_READ           Read;
+  EFI_FILE_WRITE          Write;
+  EFI_FILE_GET_POSITION   GetPosition;
+  EFI_FILE_SET_POSITION   SetPosition;
+  EFI_FILE_GET_INFO       GetInfo;
+  EFI_FILE_SET_INFO       SetInfo;
+  EFI_FILE_FLUSH          Flush;
+  EFI_FILE_OPEN_EX        OpenEx;
+  EFI_FILE_READ_EX        ReadEx;
+  EFI_FILE_WRITE_EX       WriteEx;
+  EFI_FILE_FLUSH_EX       FlushEx;
+};
+
+typedef EFI_STATUS (EFIAPI *EFI_SIMPLE_FILE_SYSTEM_PROTOCOL_OPEN_VOLUME)(EFI_SIMPLE_FILE_SYSTEM_PROTOCOL *This, EFI_FILE_PROTOCOL **Root);
+
+struct _EFI_SIMPLE_FILE_SYSTEM_PROTOCOL {
+  UINT64                                      Revision;
+  EFI_SIMPLE_FILE_SYSTEM_PROTOCOL_OPEN_VOLUME OpenVolume;
+};
+
+typedef struct {
+  UINT64    Size;
+  UINT64    FileSize;
+  UINT64    PhysicalSize;
+  EFI_TIME  CreateTime;
+  EFI_TIME  LastAccessTime;
+  EFI_TIME  ModificationTime;
+  UINT64    Attribute;
+  CHAR16    FileName[1];
+} EFI_FILE_INFO;
+
+#define SIZE_OF_EFI_FILE_INFO  OFFSET_OF (EFI_FILE_INFO, FileName)
+
+//
+// Block I/O and Disk I/O
+//
+typedef struct _EFI_BLOCK_IO_PROTOCOL  EFI_BLOCK_IO_PROTOCOL;
+typedef struct _EFI_DISK_IO_PROTOCOL   EFI_DISK_IO_PROTOCOL;
+
+#define EFI_BLOCK_IO_PROTOCOL_REVISION  0x00010000
+#define EFI_DISK_IO_PROTOCOL_REVISION   0x00010000
+
+typedef struct {
+  UINT32   MediaId;
+  BOOLEAN  RemovableMedia;
+  BOOLEAN  MediaPresent;
+  BOOLEAN  LogicalPartition;
+  BOOLEAN  ReadOnly;
+  BOOLEAN  WriteCaching;
+  UINT32   BlockSize;
+  UINT32   IoAlign;
+  EFI_LBA  LastBlock;
+} EFI_BLOCK_IO_MEDIA;
+
+typedef EFI_STATUS (EFIAPI *EFI_BLOCK_RESET)(EFI_BLOCK_IO_PROTOCOL *This, BOOLEAN ExtendedVerification);
+typedef EFI_STATUS (EFIAPI *EFI_BLOCK_READ)(EFI_BLOCK_IO_PROTOCOL *This, UINT32 MediaId, EFI_LBA Lba, UINTN BufferSize, VOID *Buffer);
+typedef EFI_STATUS (EFIAPI *EFI_BLOCK_WRITE)(EFI_BLOCK_IO_PROTOCOL *This, UINT32 MediaId, EFI_LBA Lba, UINTN BufferSize, VOID *Buffer);
+typedef EFI_STATUS (EFIAPI *EFI_BLOCK_FLUSH)(EFI_BLOCK_IO_PROTOCOL *This);
+
+struct _EFI_BLOCK_IO_PROTOCOL {
+  UINT64              Revision;
+  EFI_BLOCK_IO_MEDIA  *Media;
+  EFI_BLOCK_RESET     Reset;
+  EFI_BLOCK_READ      ReadBlocks;
+  EFI_BLOCK_WRITE     WriteBlocks;
+  EFI_BLOCK_FLUSH     FlushBlocks;
+};
+
+typedef EFI_STATUS (EFIAPI *EFI_DISK_READ)(EFI_DISK_IO_PROTOCOL *This, UINT32 MediaId, UINT64 Offset, UINTN BufferSize, VOID *Buffer);
+typedef EFI_STATUS (EFIAPI *EFI_DISK_WRITE)(EFI_DISK_IO_PROTOCOL *This, UINT32 MediaId, UINT64 Offset, UINTN BufferSize, VOID *Buffer);
+
+struct _EFI_DISK_IO_PROTOCOL {
+  UINT64          Revision;
+  EFI_DISK_READ   ReadDisk;
+  EFI_DISK_WRITE  WriteDisk;
+};
+
+//
+// Simple text protocols
+//
+typedef struct {
+  UINT16  ScanCode;
+  CHAR16  UnicodeChar;
+} EFI_INPUT_KEY;
+
+typedef EFI_STATUS (EFIAPI *EFI_TEXT_STRING)(EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *This, CHAR16 *String);
+typedef EFI_STATUS (EFIAPI *EFI_INPUT_READ_KEY)(EFI_SIMPLE_TEXT_INPUT_PROTOCOL *This, EFI_INPUT_KEY *Key);
+
+struct _EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL {
+  VOID              *Reset;
+  EFI_TEXT_STRING   OutputString;
+};
+
+struct _EFI_SIMPLE_TEXT_INPUT_PROTOCOL {
+  VOID                *Reset;
+  EFI_INPUT_READ_KEY  ReadKeyStroke;
+  EFI_EVENT           WaitForKey;
+};
+
+//
+// Loaded image protocol
+//
+typedef struct {
+  UINT32                    Revision;
+  EFI_HANDLE                ParentHandle;
+  VOID                      *SystemTable;
+  EFI_HANDLE                DeviceHandle;
+  EFI_DEVICE_PATH_PROTOCOL  *FilePath;
+  VOID                      *Reserved;
+  UINT32                    LoadOptionsSize;
+  VOID                      *LoadOptions;
+  VOID                      *ImageBase;
+  UINT64                    ImageSize;
+  EFI_MEMORY_TYPE           ImageCodeType;
+  EFI_MEMORY_TYPE           ImageDataType;
+  VOID                      *Unload;
+} EFI_LOADED_IMAGE_PROTOCOL;
+
+//
+// Table header shared by the system, boot services and runtime services tables
+//
+typedef struct {
+  UINT64  Signature;
+  UINT32  Revision;
+  UINT32  HeaderSize;
+  UINT32  CRC32;
+  UINT32  Reserved;
+} EFI_TABLE_HEADER;
+
+//
+// Boot services
+//
+typedef struct {
+  EFI_TABLE_HEADER  Hdr;
+  EFI_TPL     (EFIAPI *RaiseTPL)(EFI_TPL NewTpl);
+  VOID        (EFIAPI *RestoreTPL)(EFI_TPL OldTpl);
+  EFI_STATUS  (EFIAPI *AllocatePages)(EFI_ALLOCATE_TYPE Type, EFI_MEMORY_TYPE MemoryType, UINTN Pages, EFI_PHYSICAL_ADDRESS *Memory);
+  EFI_STATUS  (EFIAPI *FreePages)(EFI_PHYSICAL_ADDRESS Memory, UINTN Pages);
+  VOID        *GetMemoryMap;
+  EFI_STATUS  (EFIAPI *AllocatePool)(EFI_MEMORY_TYPE PoolType, UINTN Size, VOID **Buffer);
+  EFI_STATUS  (EFIAPI *FreePool)(VOID *Buffer);
+  EFI_STATUS  (EFIAPI *CreateEvent)(UINT32 Type, EFI_TPL NotifyTpl, EFI_EVENT_NOTIFY NotifyFunction, VOID *NotifyContext, EFI_EVENT *Event);
+  EFI_STATUS  (EFIAPI *SetTimer)(EFI_EVENT Event, EFI_TIMER_DELAY Type, UINT64 TriggerTime);
+  EFI_STATUS  (EFIAPI *WaitForEvent)(UINTN NumberOfEvents, EFI_EVENT *Event, UINTN *Index);
+  EFI_STATUS  (EFIAPI *SignalEvent)(EFI_EVENT Event);
+  EFI_STATUS  (EFIAPI *CloseEvent)(EFI_EVENT Event);
+  EFI_STATUS  (EFIAPI *CheckEvent)(EFI_EVENT Event);
+  EFI_STATUS  (EFIAPI *InstallProtocolInterface)(EFI_HANDLE *Handle, EFI_GUID *Protocol, EFI_INTERFACE_TYPE InterfaceType, VOID *Interface);
+  VOID        *ReinstallProtocolInterface;
+  VOID        *UninstallProtocolInterface;
+  EFI_STATUS  (EFIAPI *HandleProtocol)(EFI_HANDLE Handle, EFI_GUID *Protocol, VOID **Interface);
+  VOID        *Reserved;
+  EFI_STATUS  (EFIAPI *RegisterProtocolNotify)(EFI_GUID *Protocol, EFI_EVENT Event, VOID **Registration);
+  EFI_STATUS  (EFIAPI *LocateHandle)(EFI_LOCATE_SEARCH_TYPE SearchType, EFI_GUID *Protocol, VOID *SearchKey, UINTN *BufferSize, EFI_HANDLE *Buffer);
+  EFI_STATUS  (EFIAPI *LocateDevicePath)(EFI_GUID *Protocol, EFI_DEVICE_PATH_PROTOCOL **DevicePath, EFI_HANDLE *Device);
+  VOID        *InstallConfigurationTable;
+  VOID        *LoadImage;
+  VOID        *StartImage;
+  VOID        *Exit;
+  VOID        *UnloadImage;
+  VOID        *ExitBootServices;
+  VOID        *GetNextMonotonicCount;
+  EFI_STATUS  (EFIAPI *Stall)(UINTN Microseconds);
+  VOID        *SetWatchdogTimer;
+  VOID        *ConnectController;
+  VOID        *DisconnectController;
+  EFI_STATUS  (EFIAPI *OpenProtocol)(EFI_HANDLE Handle, EFI_GUID *Protocol, VOID **Interface, EFI_HANDLE AgentHandle, EFI_HANDLE ControllerHandle, UINT32 Attributes);
+  VOID        *CloseProtocol;
+  VOID        *OpenProtocolInformation;
+  VOID        *ProtocolsPerHandle;
+  EFI_STATUS  (EFIAPI *LocateHandleBuffer)(EFI_LOCATE_SEARCH_TYPE SearchType, EFI_GUID *Protocol, VOID *SearchKey, UINTN *NoHandles, EFI_HANDLE **Buffer);
+  EFI_STATUS  (EFIAPI *LocateProtocol)(EFI_GUID *Protocol, VOID *Registration, VOID **Interface);
+  VOID        *InstallMultipleProtocolInterfaces;
+  VOID        *UninstallMultipleProtocolInterfaces;
+  EFI_STATUS  (EFIAPI *CalculateCrc32)(VOID *Data, UINTN DataSize, UINT32 *Crc32);
+  VOID        (EFIAPI *CopyMem)(VOID *Destination, VOID *Source, UINTN Length);
+  VOID        (EFIAPI *SetMem)(VOID *Buffer, UINTN Size, UINT8 Value);
+  EFI_STATUS  (EFIAPI *CreateEventEx)(UINT32 Type, EFI_TPL NotifyTpl, EFI_EVENT_NOTIFY NotifyFunction, CONST VOID *NotifyContext, CONST EFI_GUID *EventGroup, EFI_EVENT *Event);
+} EFI_BOOT_SERVICES;
+
+//
+// Runtime services
+//
+#define EFI_VARIABLE_NON_VOLATILE        0x00000001
+#define EFI_VARIABLE_BOOTSERVICE_ACCESS  0x00000002
+#define EFI_VARIABLE_RUNTIME_ACCESS      0x00000004
+
+typedef struct {
+  EFI_TABLE_HEADER  Hdr;
+  VOID        *GetTime;
+  VOID        *SetTime;
+  VOID        *GetWakeupTime;
+  VOID        *SetWakeupTime;
+  VOID        *SetVirtualAddressMap;
+  VOID        *ConvertPointer;
+  EFI_STATUS  (EFIAPI *GetVariable)(CHAR16 *VariableName, EFI_GUID *VendorGuid, UINT32 *Attributes, UINTN *DataSize, VOID *Data);
+  VOID        *GetNextVariableName;
+  EFI_STATUS  (EFIAPI *SetVariable)(CHAR16 *VariableName, EFI_GUID *VendorGuid, UINT32 Attributes, UINTN DataSize, VOID *Data);
+  VOID        *GetNextHighMonotonicCount;
+  VOID        *ResetSystem;
+} EFI_RUNTIME_SERVICES;
+
+//
+// System table
+//
+typedef struct {
+  EFI_GUID  VendorGuid;
+  VOID      *VendorTable;
+} EFI_CONFIGURATION_TABLE;
+
+typedef struct {
+  EFI_TABLE_HEADER                  Hdr;
+  CHAR16                            *FirmwareVendor;
+  UINT32                            FirmwareRevision;
+  EFI_HANDLE                        ConsoleInHandle;
+  EFI_SIMPLE_TEXT_INPUT_PROTOCOL    *ConIn;
+  EFI_HANDLE                        ConsoleOutHandle;
+  EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL   *ConOut;
+  EFI_HANDLE                        StandardErrorHandle;
+  EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL   *StdErr;
+  EFI_RUNTIME_SERVICES              *RuntimeServices;
+  EFI_BOOT_SERVICES                 *BootServices;
+  UINTN                             NumberOfTableEntries;
+  EFI_CONFIGURATION_TABLE           *ConfigurationTable;
+} EFI_SYSTEM_TABLE;
+
+//
+// ACPI table layouts (MdePkg/Include/IndustryStandard/Acpi20.h)
+//
+#pragma pack(1)
+typedef struct {
+  UINT32  Signature;
+  UINT32  Length;
+  UINT8   Revision;
+  UINT8   Checksum;
+  UINT8   OemId[6];
+  UINT64  OemTableId;
+  UINT32  OemRevision;
+  UINT32  CreatorId;
+  UINT32  CreatorRevision;
+} EFI_ACPI_DESCRIPTION_HEADER;
+
+typedef struct {
+  UINT8   AddressSpaceId;
+  UINT8   RegisterBitWidth;
+  UINT8   RegisterBitOffset;
+  UINT8   Reserved;
+  UINT64  Address;
+} EFI_ACPI_2_0_GENERIC_ADDRESS_STRUCTURE;
+
+typedef struct {
+  UINT64  Signature;
+  UINT8   Checksum;
+  UINT8   OemId[6];
+  UINT8   Revision;
+  UINT32  RsdtAddress;
+  UINT32  Length;
+  UINT64  XsdtAddress;
+  UINT8   ExtendedChecksum;
+  UINT8   Reserved[3];
+} EFI_ACPI_2_0_ROOT_SYSTEM_DESCRIPTION_POINTER;
+
+typedef struct {
+  EFI_ACPI_DESCRIPTION_HEADER             Header;
+  UINT32                                  FirmwareCtrl;
+  UINT32                                  Dsdt;
+  UINT8                                   Reserved0;
+  UINT8                                   PreferredPmProfile;
+  UINT16                                  SciInt;
+  UINT32                                  SmiCmd;
+  UINT8                                   AcpiEnable;
+  UINT8                                   AcpiDisable;
+  UINT8                                   S4BiosReq;
+  UINT8                                   PstateCnt;
+  UINT32                                  Pm1aEvtBlk;
+  UINT32                                  Pm1bEvtBlk;
+  UINT32                                  Pm1aCntBlk;
+  UINT32                                  Pm1bCntBlk;
+  UINT32                                  Pm2CntBlk;
+  UINT32                                  PmTmrBlk;
+  UINT32                                  Gpe0Blk;
+  UINT32                                  Gpe1Blk;
+  UINT8                                   Pm1EvtLen;
+  UINT8                                   Pm1CntLen;
+  UINT8                                   Pm2CntLen;
+  UINT8                                   PmTmrLen;
+  UINT8                                   Gpe0BlkLen;
+  UINT8                                   Gpe1BlkLen;
+  UINT8                                   Gpe1Base;
+  UINT8                                   CstCnt;
+  UINT16                                  PLvl2Lat;
+  UINT16                                  PLvl3Lat;
+  UINT16                                  FlushSize;
+  UINT16                                  FlushStride;
+  UINT8                                   DutyOffset;
+  UINT8                                   DutyWidth;
+  UINT8                                   DayAlrm;
+  UINT8                                   MonAlrm;
+  UINT8                                   Century;
+  UINT16                                  IaPcBootArch;
+  UINT8                                   Reserved1;
+  UINT32                                  Flags;
+  EFI_ACPI_2_0_GENERIC_ADDRESS_STRUCTURE  ResetReg;
+  UINT8                                   ResetValue;
+  UINT8                                   Reserved2[3];
+  UINT64                                  XFirmwareCtrl;
+  UINT64                                  XDsdt;
+  EFI_ACPI_2_0_GENERIC_ADDRESS_STRUCTURE  XPm1aEvtBlk;
+  EFI_ACPI_2_0_GENERIC_ADDRESS_STRUCTURE  XPm1bEvtBlk;
+  EFI_ACPI_2_0_GENERIC_ADDRESS_STRUCTURE  XPm1aCntBlk;
+  EFI_ACPI_2_0_GENERIC_ADDRESS_STRUCTURE  XPm1bCntBlk;
+  EFI_ACPI_2_0_GENERIC_ADDRESS_STRUCTURE  XPm2CntBlk;
+  EFI_ACPI_2_0_GENERIC_ADDRESS_STRUCTURE  XPmTmrBlk;
+  EFI_ACPI_2_0_GENERIC_ADDRESS_STRUCTURE  XGpe0Blk;
+  EFI_ACPI_2_0_GENERIC_ADDRESS_STRUCTURE  XGpe1Blk;
+} EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE;
+#pragma pack()
+
+#define EFI_ACPI_2_0_ROOT_SYSTEM_DESCRIPTION_POINTER_SIGNATURE  SIGNATURE_64('R', 'S', 'D', ' ', 'P', 'T', 'R', ' ')
+#define EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE_SIGNATURE     SIGNATURE_32('F', 'A', 'C', 'P')
+#define EFI_ACPI_2_0_DIFFERENTIATED_SYSTEM_DESCRIPTION_TABLE_SIGNATURE SIGNATURE_32('D', 'S', 'D', 'T')
+#define EFI_ACPI_2_0_SECONDARY_SYSTEM_DESCRIPTION_TABLE_SIGNATURE SIGNATURE_32('S', 'S', 'D', 'T')
+#define EFI_ACPI_2_0_MULTIPLE_APIC_DESCRIPTION_TABLE_SIGNATURE  SIGNATURE_32('A', 'P', 'I', 'C')
+#define EFI_ACPI_2_0_MEMORY_MAPPED_CONFIGURATION_BASE_ADDRESS_TABLE_SIGNATURE SIGNATURE_32('M', 'C', 'F', 'G')
+#define EFI_ACPI_2_0_EXTENDED_SYSTEM_DESCRIPTION_TABLE_SIGNATURE SIGNATURE_32('X', 'S', 'D', 'T')
+#define EFI_ACPI_2_0_ROOT_SYSTEM_DESCRIPTION_TABLE_SIGNATURE    SIGNATURE_32('R', 'S', 'D', 'T')
+
+//
+// Firmware file sections (Pi/PiFirmwareFile.h)
+//
+typedef UINT8 EFI_SECTION_TYPE;
+
+#define EFI_SECTION_PE32            0x10
+#define EFI_SECTION_DXE_DEPEX       0x13
+#define EFI_SECTION_USER_INTERFACE  0x15
+#define EFI_SECTION_RAW             0x19
+
+//
+// GUIDs and protocol GUIDs referenced by the core
+//
+extern EFI_GUID gEfiAcpiTableGuid;
+extern EFI_GUID gEfiAcpi20TableGuid;
+extern EFI_GUID gEfiDxeServicesTableGuid;
+extern EFI_GUID gEfiFileInfoGuid;
+extern EFI_GUID gEfiLoadedImageProtocolGuid;
+extern EFI_GUID gEfiSimpleFileSystemProtocolGuid;
+extern EFI_GUID gEfiBlockIoProtocolGuid;
+extern EFI_GUID gEfiDiskIoProtocolGuid;
+extern EFI_GUID gEfiAcpiTableProtocolGuid;
+extern EFI_GUID gEfiDevicePathProtocolGuid;
+extern EFI_GUID gEfiPartTypeSystemPartGuid;
+extern EFI_GUID gEfiEventReadyToBootGuid;
+extern EFI_GUID gEfiGlobalVariableGuid;
+
+//
+// FILE_GUID of the module under test, as AutoGen.h would declare it
+//
+extern EFI_GUID gEfiCallerIdGuid;
+
+//
+// Global table pointers (UefiBootServicesTableLib, UefiRuntimeServicesTableLib)
+//
+extern EFI_HANDLE            gImageHandle;
+extern EFI_SYSTEM_TABLE      *gST;
+extern EFI_BOOT_SERVICES     *gBS;
+extern EFI_RUNTIME_SERVICES  *gRT;
+
+//
+// BaseLib
+//
+UINTN   EFIAPI StrLen (CONST CHAR16 *String);
+UINTN   EFIAPI StrSize (CONST CHAR16 *String);
+INTN    EFIAPI StrCmp (CONST CHAR16 *FirstString, CONST CHAR16 *SecondString);
+INTN    EFIAPI StrnCmp (CONST CHAR16 *FirstString, CONST CHAR16 *SecondString, UINTN Length);
+CHAR16 *EFIAPI StrStr (CONST CHAR16 *String, CONST CHAR16 *SearchString);
+RETURN_STATUS EFIAPI StrCpyS (CHAR16 *Destination, UINTN DestMax, CONST CHAR16 *Source);
+RETURN_STATUS EFIAPI StrnCpyS (CHAR16 *Destination, UINTN DestMax, CONST CHAR16 *Source, UINTN Length);
+RETURN_STATUS EFIAPI StrCatS (CHAR16 *Destination, UINTN DestMax, CONST CHAR16 *Source);
+UINT8   EFIAPI CalculateCheckSum8 (CONST UINT8 *Buffer, UINTN Length);
+CHAR16  EFIAPI CharToUpper (CHAR16 Char);
+UINTN   EFIAPI StrDecimalToUintn (CONST CHAR16 *String);
+UINTN   EFIAPI AsciiStrLen (CONST CHAR8 *String);
+UINTN   EFIAPI AsciiStrSize (CONST CHAR8 *String);
+INTN    EFIAPI AsciiStrCmp (CONST CHAR8 *FirstString, CONST CHAR8 *SecondString);
+INTN    EFIAPI AsciiStrnCmp (CONST CHAR8 *FirstString, CONST CHAR8 *SecondString, UINTN Length);
+UINTN   EFIAPI AsciiStrDecimalToUintn (CONST CHAR8 *String);
+UINT64  EFIAPI AsciiStrHexToUint64 (CONST CHAR8 *String);
+RETURN_STATUS EFIAPI AsciiStrToUnicodeStrS (CONST CHAR8 *Source, CHAR16 *Destination, UINTN DestMax);
+RETURN_STATUS EFIAPI UnicodeStrToAsciiStrS (CONST CHAR16 *Source, CHAR8 *Destination, UINTN DestMax);
+UINT64  EFIAPI ReadUnaligned64 (CONST UINT64 *Buffer);
+UINT32  EFIAPI ReadUnaligned32 (CONST UINT32 *Buffer);
+UINT64  EFIAPI WriteUnaligned64 (UINT64 *Buffer, UINT64 Value);
+UINT32  EFIAPI WriteUnaligned32 (UINT32 *Buffer, UINT32 Value);
+UINT16  EFIAPI ReadUnaligned16 (CONST UINT16 *Buffer);
+UINT16  EFIAPI WriteUnaligned16 (UINT16 *Buffer, UINT16 Value);
+UINT64  EFIAPI LShiftU64 (UINT64 Operand, UINTN Count);
+UINT64  EFIAPI RShiftU64 (UINT64 Operand, UINTN Count);
+UINT64  EFIAPI MultU64x32 (UINT64 Multiplicand, UINT32 Multiplier);
+UINT64  EFIAPI MultU64x64 (UINT64 Multiplicand, UINT64 Multiplier);
+UINT64  EFIAPI DivU64x32 (UINT64 Dividend, UINT32 Divisor);
+UINT64  EFIAPI AsmReadTsc (VOID);
+VOID    EFIAPI CpuPause (VOID);
+VOID    EFIAPI MemoryFence (VOID);
+
+//
+// SynchronizationLib
+//
+UINT32  EFIAPI InterlockedCompareExchange32 (volatile UINT32 *Value, UINT32 CompareValue, UINT32 ExchangeValue);
+UINT32  EFIAPI InterlockedIncrement (volatile UINT32 *Value);
+
+//
+// BaseMemoryLib
+//
+VOID   *EFIAPI CopyMem (VOID *DestinationBuffer, CONST VOID *SourceBuffer, UINTN Length);
+VOID   *EFIAPI SetMem (VOID *Buffer, UINTN Length, UINT8 Value);
+VOID   *EFIAPI ZeroMem (VOID *Buffer, UINTN Length);
+INTN    EFIAPI CompareMem (CONST VOID *DestinationBuffer, CONST VOID *SourceBuffer, UINTN Length);
+BOOLEAN EFIAPI CompareGuid (CONST GUID *Guid1, CONST GUID *Guid2);
+GUID   *EFIAPI CopyGuid (GUID *DestinationGuid, CONST GUID *SourceGuid);
+BOOLEAN EFIAPI IsZeroGuid (CONST GUID *Guid);
+
+//
+// MemoryAllocationLib
+//
+VOID   *EFIAPI AllocatePool (UINTN AllocationSize);
+VOID   *EFIAPI AllocateZeroPool (UINTN AllocationSize);
+VOID   *EFIAPI AllocateCopyPool (UINTN AllocationSize, CONST VOID *Buffer);
+VOID   *EFIAPI ReallocatePool (UINTN OldSize, UINTN NewSize, VOID *OldBuffer);
+VOID    EFIAPI FreePool (VOID *Buffer);
+VOID   *EFIAPI AllocatePages (UINTN Pages);
+VOID    EFIAPI FreePages (VOID *Buffer, UINTN Pages);
+
+//
+// PrintLib
+//
+UINTN EFIAPI UnicodeVSPrint (CHAR16 *StartOfBuffer, UINTN BufferSize, CONST CHAR16 *FormatString, VA_LIST Marker);
+UINTN EFIAPI UnicodeSPrint (CHAR16 *StartOfBuffer, UINTN BufferSize, CONST CHAR16 *FormatString, ...);
+UINTN EFIAPI AsciiVSPrint (CHAR8 *StartOfBuffer, UINTN BufferSize, CONST CHAR8 *FormatString, VA_LIST Marker);
+UINTN EFIAPI AsciiSPrint (CHAR8 *StartOfBuffer, UINTN BufferSize, CONST CHAR8 *FormatString, ...);
+
+//
+// UefiLib
+//
+UINTN      EFIAPI Print (CONST CHAR16 *Format, ...);
+UINTN      EFIAPI AsciiPrint (CONST CHAR8 *Format, ...);
+EFI_STATUS EFIAPI EfiGetSystemConfigurationTable (EFI_GUID *TableGuid, VOID **Table);
+EFI_STATUS EFIAPI EfiCreateEventReadyToBootEx (EFI_TPL NotifyTpl, EFI_EVENT_NOTIFY NotifyFunction, VOID *NotifyContext, EFI_EVENT *ReadyToBootEvent);
+EFI_EVENT  EFIAPI EfiCreateProtocolNotifyEvent (EFI_GUID *ProtocolGuid, EFI_TPL NotifyTpl, EFI_EVENT_NOTIFY NotifyFunction, VOID *NotifyContext, VOID **Registration);
+
+//
+// DevicePathLib
+//
+UINTN                     EFIAPI DevicePathNodeLength (CONST VOID *Node);
+EFI_DEVICE_PATH_PROTOCOL *EFIAPI NextDevicePathNode (CONST VOID *Node);
+BOOLEAN                   EFIAPI IsDevicePathEnd (CONST VOID *Node);
+UINT8                     EFIAPI DevicePathType (CONST VOID *Node);
+UINT8                     EFIAPI DevicePathSubType (CONST VOID *Node);
+UINTN                     EFIAPI GetDevicePathSize (CONST EFI_DEVICE_PATH_PROTOCOL *DevicePath);
+EFI_DEVICE_PATH_PROTOCOL *EFIAPI DevicePathFromHandle (EFI_HANDLE Handle);
+EFI_DEVICE_PATH_PROTOCOL *EFIAPI DuplicateDevicePath (CONST EFI_DEVICE_PATH_PROTOCOL *DevicePath);
+BOOLEAN                   EFIAPI IsDevicePathValid (CONST EFI_DEVICE_PATH_PROTOCOL *DevicePath, UINTN MaxSize);
+
+//
+// DxeServicesLib, over the sections HostFvAddSection() registered
+//
+EFI_STATUS EFIAPI GetSectionFromFv (CONST EFI_GUID *NameGuid, EFI_SECTION_TYPE SectionType, UINTN SectionInstance, VOID **Buffer, UINTN *Size);
+
+//
+// SerialPortLib
+UINTN         EFIAPI SerialPortWrite (UINT8 *Buffer, UINTN NumberOfBytes);
+RETURN_STATUS EFIAPI SerialPortInitialize (VOID);
+
+#endif // __HOST_UEFI_H__
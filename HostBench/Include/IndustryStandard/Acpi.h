@@ -0,0 +1,5 @@
+/** @file
+  Host build wrapper for <IndustryStandard/Acpi.h>.
+**/
+
+#include <HostUefi.h>
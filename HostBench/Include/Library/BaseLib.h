@@ -0,0 +1,5 @@
+/** @file
+  Host build wrapper for <Library/BaseLib.h>.
+**/
+
+#include <HostUefi.h>
@@ -0,0 +1,5 @@
+/** @file
+  Host build wrapper for <Library/BaseMemoryLib.h>.
+**/
+
+#include <HostUefi.h>
@@ -0,0 +1,5 @@
+/** @file
+  Host build wrapper for <Library/DebugLib.h>.
+**/
+
+#include <HostUefi.h>
@@ -0,0 +1,5 @@
+/** @file
+  Host build wrapper for <Library/DevicePathLib.h>.
+**/
+
+#include <HostUefi.h>
@@ -0,0 +1,5 @@
+/** @file
+  Host build wrapper for <Library/DxeServicesLib.h>.
+**/
+
+#include <HostUefi.h>
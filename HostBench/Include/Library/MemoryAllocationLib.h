@@ -0,0 +1,5 @@
+/** @file
+  Host build wrapper for <Library/MemoryAllocationLib.h>.
+**/
+
+#include <HostUefi.h>
@@ -0,0 +1,5 @@
+/** @file
+  Host build wrapper for <Library/PrintLib.h>.
+**/
+
+#include <HostUefi.h>
@@ -0,0 +1,5 @@
+/** @file
+  Host build wrapper for <Library/SerialPortLib.h>.
+**/
+
+#include <HostUefi.h>
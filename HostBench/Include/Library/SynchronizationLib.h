@@ -0,0 +1,5 @@
+/** @file
+  Host build wrapper for <Library/SynchronizationLib.h>.
+**/
+
+#include <HostUefi.h>
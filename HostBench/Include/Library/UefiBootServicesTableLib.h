@@ -0,0 +1,5 @@
+/** @file
+  Host build wrapper for <Library/UefiBootServicesTableLib.h>.
+**/
+
+#include <HostUefi.h>
@@ -0,0 +1,5 @@
+/** @file
+  Host build wrapper for <Library/UefiLib.h>.
+**/
+
+#include <HostUefi.h>
@@ -0,0 +1,5 @@
+/** @file
+  Host build wrapper for <Library/UefiRuntimeServicesTableLib.h>.
+**/
+
+#include <HostUefi.h>
@@ -0,0 +1,5 @@
+/** @file
+  Host build wrapper for <PiDxe.h>.
+**/
+
+#include <HostUefi.h>
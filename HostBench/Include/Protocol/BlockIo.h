@@ -0,0 +1,5 @@
+/** @file
+  Host build wrapper for <Protocol/BlockIo.h>.
+**/
+
+#include <HostUefi.h>
@@ -0,0 +1,5 @@
+/** @file
+  Host build wrapper for <Protocol/DiskIo.h>.
+**/
+
+#include <HostUefi.h>
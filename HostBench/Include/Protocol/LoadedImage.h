@@ -0,0 +1,5 @@
+/** @file
+  Host build wrapper for <Protocol/LoadedImage.h>.
+**/
+
+#include <HostUefi.h>
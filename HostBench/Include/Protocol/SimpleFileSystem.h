@@ -0,0 +1,5 @@
+/** @file
+  Host build wrapper for <Protocol/SimpleFileSystem.h>.
+**/
+
+#include <HostUefi.h>
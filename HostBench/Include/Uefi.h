@@ -0,0 +1,5 @@
+/** @file
+  Host build wrapper for <Uefi.h>.
+**/
+
+#include <HostUefi.h>
@@ -0,0 +1,2437 @@
+/** @file
+  Host implementation of the UEFI services and EDK2 libraries used by the
+  ACPIPatcher core.
+
+  Boot services keep a small handle database, track every pool and page
+  allocation so the benchmark can report allocation counts per phase, and
+  simulate events and timers on a virtual clock.  Console output is
+  formatted exactly like BasePrintLib would, then either echoed to stdout
+  or discarded.
+
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include "HostBench.h"
+
+HOST_COUNTERS   gHostCounters;
+BOOLEAN         gHostConsoleEcho = FALSE;
+
+EFI_GUID gEfiAcpiTableGuid                = { 0xeb9d2d30, 0x2d88, 0x11d3, { 0x9a, 0x16, 0x00, 0x90, 0x27, 0x3f, 0xc1, 0x4d } };
+EFI_GUID gEfiAcpi20TableGuid              = { 0x8868e871, 0xe4f1, 0x11d3, { 0xbc, 0x22, 0x00, 0x80, 0xc7, 0x3c, 0x88, 0x81 } };
+EFI_GUID gEfiDxeServicesTableGuid         = { 0x05ad34ba, 0x6f02, 0x4214, { 0x95, 0x2e, 0x4d, 0xa0, 0x39, 0x8e, 0x2b, 0xb9 } };
+EFI_GUID gEfiFileInfoGuid                 = { 0x09576e92, 0x6d3f, 0x11d2, { 0x8e, 0x39, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b } };
+EFI_GUID gEfiLoadedImageProtocolGuid      = { 0x5b1b31a1, 0x9562, 0x11d2, { 0x8e, 0x3f, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b } };
+EFI_GUID gEfiSimpleFileSystemProtocolGuid = { 0x964e5b22, 0x6459, 0x11d2, { 0x8e, 0x39, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b } };
+EFI_GUID gEfiBlockIoProtocolGuid          = { 0x964e5b21, 0x6459, 0x11d2, { 0x8e, 0x39, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b } };
+EFI_GUID gEfiDiskIoProtocolGuid           = { 0xce345171, 0xba0b, 0x11d2, { 0x8e, 0x4f, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b } };
+EFI_GUID gEfiAcpiTableProtocolGuid        = { 0xffe06bdd, 0x6107, 0x46a6, { 0x7b, 0xb2, 0x5a, 0x9c, 0x7e, 0xc5, 0x27, 0x5c } };
+EFI_GUID gEfiDevicePathProtocolGuid       = { 0x09576e91, 0x6d3f, 0x11d2, { 0x8e, 0x39, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b } };
+EFI_GUID gEfiPartTypeSystemPartGuid       = { 0xc12a7328, 0xf81f, 0x11d2, { 0xba, 0x4b, 0x00, 0xa0, 0xc9, 0x3e, 0xc9, 0x3b } };
+EFI_GUID gEfiEventReadyToBootGuid         = { 0x7ce88fb3, 0x4bd7, 0x4679, { 0x87, 0xa8, 0xa8, 0xd8, 0xde, 0xe5, 0x0d, 0x2b } };
+EFI_GUID gEfiGlobalVariableGuid           = { 0x8be4df61, 0x93ca, 0x11d2, { 0xaa, 0x0d, 0x00, 0xe0, 0x98, 0x03, 0x2b, 0x8c } };
+
+//
+// FILE_GUID of ACPIPatcherDxe.inf
+//
+EFI_GUID gEfiCallerIdGuid                 = { 0x7a87936e, 0xed34, 0x44db, { 0xae, 0x97, 0x1f, 0xa5, 0xe4, 0xed, 0x21, 0x16 } };
+
+//
+// ---------------------------------------------------------------------------
+// Allocation tracking
+// ---------------------------------------------------------------------------
+//
+#define HOST_POOL_MAGIC   0x4c4f4f5054534f48ULL   // "HOSTPOOL"
+
+typedef struct _HOST_POOL_HEADER {
+  struct _HOST_POOL_HEADER  *Prev;
+  struct _HOST_POOL_HEADER  *Next;
+  UINT64                    Magic;
+  UINTN                     Size;
+} HOST_POOL_HEADER;
+
+typedef struct _HOST_PAGE_RECORD {
+  struct _HOST_PAGE_RECORD  *Next;
+  VOID                      *Base;
+  UINTN                     Pages;
+  EFI_MEMORY_TYPE           MemoryType;
+} HOST_PAGE_RECORD;
+
+STATIC HOST_POOL_HEADER   mPoolHead = { &mPoolHead, &mPoolHead, 0, 0 };
+STATIC HOST_PAGE_RECORD   *mPageList = NULL;
+STATIC UINT64             mOutstanding = 0;
+
+STATIC
+VOID *
+HostPoolAlloc (
+  IN UINTN    Size,
+  IN BOOLEAN  Zero
+  )
+{
+  HOST_POOL_HEADER  *Header;
+
+  Header = Zero ? calloc (1, sizeof (*Header) + Size) : malloc (sizeof (*Header) + Size);
+  if (Header == NULL) {
+    return NULL;
+  }
+
+  Header->Magic       = HOST_POOL_MAGIC;
+  Header->Size        = Size;
+  Header->Next        = mPoolHead.Next;
+  Header->Prev        = &mPoolHead;
+  mPoolHead.Next->Prev = Header;
+  mPoolHead.Next      = Header;
+
+  gHostCounters.PoolAllocations++;
+  gHostCounters.PoolBytes += Size;
+  mOutstanding++;
+  return Header + 1;
+}
+
+STATIC
+EFI_STATUS
+HostPoolFree (
+  IN VOID  *Buffer
+  )
+{
+  HOST_POOL_HEADER  *Header;
+
+  if (Buffer == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Header = ((HOST_POOL_HEADER *) Buffer) - 1;
+  if (Header->Magic != HOST_POOL_MAGIC) {
+    fprintf (stderr, "hostbench: FreePool(%p) on a buffer that was not pool allocated\n", Buffer);
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Header->Magic      = 0;
+  Header->Prev->Next = Header->Next;
+  Header->Next->Prev = Header->Prev;
+  free (Header);
+
+  gHostCounters.PoolFrees++;
+  mOutstanding--;
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostAllocatePages (
+  IN     EFI_ALLOCATE_TYPE     Type,
+  IN     EFI_MEMORY_TYPE       MemoryType,
+  IN     UINTN                 Pages,
+  IN OUT EFI_PHYSICAL_ADDRESS  *Memory
+  )
+{
+  HOST_PAGE_RECORD  *Record;
+  VOID              *Base;
+  int               Flags;
+
+  if (Memory == NULL || Pages == 0 || Type == AllocateAddress) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_32BIT
+  //
+  // MAP_32BIT places the mapping in the low 2 GB, which satisfies any
+  // AllocateMaxAddress request at or above 4 GB - 1 on x86-64 Linux.
+  //
+  if (Type == AllocateMaxAddress && *Memory <= MAX_UINT32) {
+    Flags |= MAP_32BIT;
+  }
+#endif
+
+  Base = mmap (NULL, EFI_PAGES_TO_SIZE (Pages), PROT_READ | PROT_WRITE, Flags, -1, 0);
+  if (Base == MAP_FAILED) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  if (Type == AllocateMaxAddress && (UINT64) (UINTN) Base + EFI_PAGES_TO_SIZE (Pages) - 1 > *Memory) {
+    munmap (Base, EFI_PAGES_TO_SIZE (Pages));
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Record = malloc (sizeof (*Record));
+  if (Record == NULL) {
+    munmap (Base, EFI_PAGES_TO_SIZE (Pages));
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Record->Base       = Base;
+  Record->Pages      = Pages;
+  Record->MemoryType = MemoryType;
+  Record->Next       = mPageList;
+  mPageList     = Record;
+
+  gHostCounters.PageAllocations++;
+  gHostCounters.PageBytes += EFI_PAGES_TO_SIZE (Pages);
+  mOutstanding++;
+
+  *Memory = (EFI_PHYSICAL_ADDRESS) (UINTN) Base;
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostFreePages (
+  IN EFI_PHYSICAL_ADDRESS  Memory,
+  IN UINTN                 Pages
+  )
+{
+  HOST_PAGE_RECORD  **Link;
+  HOST_PAGE_RECORD  *Record;
+
+  for (Link = &mPageList; *Link != NULL; Link = &(*Link)->Next) {
+    Record = *Link;
+    if ((UINTN) Record->Base == (UINTN) Memory && Record->Pages == Pages) {
+      *Link = Record->Next;
+      munmap (Record->Base, EFI_PAGES_TO_SIZE (Pages));
+      free (Record);
+      mOutstanding--;
+      return EFI_SUCCESS;
+    }
+
+    //
+    // The tail of an allocation, which the DXE core also lets go of.
+    //
+    if ((UINTN) Memory > (UINTN) Record->Base &&
+        (UINTN) Memory + EFI_PAGES_TO_SIZE (Pages) == (UINTN) Record->Base + EFI_PAGES_TO_SIZE (Record->Pages)) {
+      munmap ((VOID *) (UINTN) Memory, EFI_PAGES_TO_SIZE (Pages));
+      Record->Pages -= Pages;
+      gHostCounters.PageBytes -= EFI_PAGES_TO_SIZE (Pages);
+      return EFI_SUCCESS;
+    }
+  }
+
+  return EFI_NOT_FOUND;
+}
+
+VOID
+HostReleaseAllocations (
+  VOID
+  )
+{
+  HOST_PAGE_RECORD  *Record;
+
+  while (mPoolHead.Next != &mPoolHead) {
+    HostPoolFree (mPoolHead.Next + 1);
+  }
+
+  while (mPageList != NULL) {
+    Record    = mPageList;
+    mPageList = Record->Next;
+    munmap (Record->Base, EFI_PAGES_TO_SIZE (Record->Pages));
+    free (Record);
+  }
+
+  mOutstanding = 0;
+}
+
+UINT64
+HostOutstandingAllocations (
+  VOID
+  )
+{
+  return mOutstanding;
+}
+
+UINT64
+HostLeakedAllocations (
+  IN CONST UINT64  *Published,
+  IN UINTN         Count
+  )
+{
+  HOST_PAGE_RECORD  *Record;
+  UINT64            Leaked;
+  UINTN             Index;
+
+  Leaked = mOutstanding;
+  for (Record = mPageList; Record != NULL; Record = Record->Next) {
+    if (Record->MemoryType != EfiACPIReclaimMemory) {
+      continue;
+    }
+    for (Index = 0; Index < Count; Index++) {
+      if (Published[Index] >= (UINT64) (UINTN) Record->Base &&
+          Published[Index] - (UINT64) (UINTN) Record->Base < EFI_PAGES_TO_SIZE (Record->Pages)) {
+        Leaked--;
+        break;
+      }
+    }
+  }
+
+  return Leaked;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostAllocatePoolService (
+  IN  EFI_MEMORY_TYPE  PoolType,
+  IN  UINTN            Size,
+  OUT VOID             **Buffer
+  )
+{
+  (VOID) PoolType;
+  *Buffer = HostPoolAlloc (Size, FALSE);
+  return (*Buffer == NULL) ? EFI_OUT_OF_RESOURCES : EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostFreePoolService (
+  IN VOID  *Buffer
+  )
+{
+  return HostPoolFree (Buffer);
+}
+
+//
+// MemoryAllocationLib
+//
+VOID *
+EFIAPI
+AllocatePool (
+  IN UINTN  AllocationSize
+  )
+{
+  return HostPoolAlloc (AllocationSize, FALSE);
+}
+
+VOID *
+EFIAPI
+AllocateZeroPool (
+  IN UINTN  AllocationSize
+  )
+{
+  return HostPoolAlloc (AllocationSize, TRUE);
+}
+
+VOID *
+EFIAPI
+AllocateCopyPool (
+  IN UINTN       AllocationSize,
+  IN CONST VOID  *Buffer
+  )
+{
+  VOID  *Memory;
+
+  Memory = HostPoolAlloc (AllocationSize, FALSE);
+  if (Memory != NULL) {
+    memcpy (Memory, Buffer, AllocationSize);
+  }
+  return Memory;
+}
+
+VOID *
+EFIAPI
+ReallocatePool (
+  IN UINTN  OldSize,
+  IN UINTN  NewSize,
+  IN VOID   *OldBuffer
+  )
+{
+  VOID  *NewBuffer;
+
+  NewBuffer = HostPoolAlloc (NewSize, TRUE);
+  if (NewBuffer != NULL && OldBuffer != NULL) {
+    memcpy (NewBuffer, OldBuffer, MIN (OldSize, NewSize));
+    HostPoolFree (OldBuffer);
+  }
+  return NewBuffer;
+}
+
+VOID
+EFIAPI
+FreePool (
+  IN VOID  *Buffer
+  )
+{
+  HostPoolFree (Buffer);
+}
+
+VOID *
+EFIAPI
+AllocatePages (
+  IN UINTN  Pages
+  )
+{
+  EFI_PHYSICAL_ADDRESS  Memory;
+
+  if (EFI_ERROR (HostAllocatePages (AllocateAnyPages, EfiBootServicesData, Pages, &Memory))) {
+    return NULL;
+  }
+  return (VOID *) (UINTN) Memory;
+}
+
+VOID
+EFIAPI
+FreePages (
+  IN VOID   *Buffer,
+  IN UINTN  Pages
+  )
+{
+  HostFreePages ((EFI_PHYSICAL_ADDRESS) (UINTN) Buffer, Pages);
+}
+
+//
+// ---------------------------------------------------------------------------
+// BaseMemoryLib / BaseLib / SynchronizationLib
+// ---------------------------------------------------------------------------
+//
+VOID *
+EFIAPI
+CopyMem (
+  OUT VOID       *DestinationBuffer,
+  IN  CONST VOID *SourceBuffer,
+  IN  UINTN      Length
+  )
+{
+  return memmove (DestinationBuffer, SourceBuffer, Length);
+}
+
+VOID *
+EFIAPI
+SetMem (
+  OUT VOID   *Buffer,
+  IN  UINTN  Length,
+  IN  UINT8  Value
+  )
+{
+  return memset (Buffer, Value, Length);
+}
+
+VOID *
+EFIAPI
+ZeroMem (
+  OUT VOID   *Buffer,
+  IN  UINTN  Length
+  )
+{
+  return memset (Buffer, 0, Length);
+}
+
+INTN
+EFIAPI
+CompareMem (
+  IN CONST VOID  *DestinationBuffer,
+  IN CONST VOID  *SourceBuffer,
+  IN UINTN       Length
+  )
+{
+  return memcmp (DestinationBuffer, SourceBuffer, Length);
+}
+
+BOOLEAN
+EFIAPI
+CompareGuid (
+  IN CONST GUID  *Guid1,
+  IN CONST GUID  *Guid2
+  )
+{
+  return (BOOLEAN) (memcmp (Guid1, Guid2, sizeof (GUID)) == 0);
+}
+
+GUID *
+EFIAPI
+CopyGuid (
+  OUT GUID        *DestinationGuid,
+  IN  CONST GUID  *SourceGuid
+  )
+{
+  return memcpy (DestinationGuid, SourceGuid, sizeof (GUID));
+}
+
+BOOLEAN
+EFIAPI
+IsZeroGuid (
+  IN CONST GUID  *Guid
+  )
+{
+  STATIC CONST GUID  Zero;
+
+  return CompareGuid (Guid, &Zero);
+}
+
+UINTN
+EFIAPI
+StrLen (
+  IN CONST CHAR16  *String
+  )
+{
+  UINTN  Length;
+
+  for (Length = 0; String[Length] != 0; Length++) {
+    ;
+  }
+  return Length;
+}
+
+UINTN
+EFIAPI
+StrSize (
+  IN CONST CHAR16  *String
+  )
+{
+  return (StrLen (String) + 1) * sizeof (CHAR16);
+}
+
+INTN
+EFIAPI
+StrCmp (
+  IN CONST CHAR16  *FirstString,
+  IN CONST CHAR16  *SecondString
+  )
+{
+  while (*FirstString != 0 && *FirstString == *SecondString) {
+    FirstString++;
+    SecondString++;
+  }
+  return (INTN) *FirstString - (INTN) *SecondString;
+}
+
+INTN
+EFIAPI
+StrnCmp (
+  IN CONST CHAR16  *FirstString,
+  IN CONST CHAR16  *SecondString,
+  IN UINTN         Length
+  )
+{
+  if (Length == 0) {
+    return 0;
+  }
+  while (*FirstString != 0 && *SecondString != 0 && *FirstString == *SecondString && Length > 1) {
+    FirstString++;
+    SecondString++;
+    Length--;
+  }
+  return (INTN) *FirstString - (INTN) *SecondString;
+}
+
+CHAR16 *
+EFIAPI
+StrStr (
+  IN CONST CHAR16  *String,
+  IN CONST CHAR16  *SearchString
+  )
+{
+  UINTN  SearchLength;
+
+  SearchLength = StrLen (SearchString);
+  for ( ; *String != 0; String++) {
+    if (StrnCmp (String, SearchString, SearchLength) == 0) {
+      return (CHAR16 *) String;
+    }
+  }
+  return (SearchLength == 0) ? (CHAR16 *) String : NULL;
+}
+
+RETURN_STATUS
+EFIAPI
+StrnCpyS (
+  OUT CHAR16        *Destination,
+  IN  UINTN         DestMax,
+  IN  CONST CHAR16  *Source,
+  IN  UINTN         Length
+  )
+{
+  UINTN  Index;
+
+  if (Destination == NULL || Source == NULL || DestMax == 0) {
+    return EFI_INVALID_PARAMETER;
+  }
+  for (Index = 0; Index < Length && Source[Index] != 0; Index++) {
+    if (Index + 1 >= DestMax) {
+      Destination[0] = 0;
+      return EFI_BUFFER_TOO_SMALL;
+    }
+    Destination[Index] = Source[Index];
+  }
+  Destination[Index] = 0;
+  return EFI_SUCCESS;
+}
+
+RETURN_STATUS
+EFIAPI
+StrCpyS (
+  OUT CHAR16        *Destination,
+  IN  UINTN         DestMax,
+  IN  CONST CHAR16  *Source
+  )
+{
+  return StrnCpyS (Destination, DestMax, Source, MAX_UINTN);
+}
+
+RETURN_STATUS
+EFIAPI
+StrCatS (
+  IN OUT CHAR16        *Destination,
+  IN     UINTN         DestMax,
+  IN     CONST CHAR16  *Source
+  )
+{
+  UINTN  Length;
+
+  Length = StrLen (Destination);
+  if (Length >= DestMax) {
+    return EFI_INVALID_PARAMETER;
+  }
+  return StrCpyS (Destination + Length, DestMax - Length, Source);
+}
+
+UINT8
+EFIAPI
+CalculateCheckSum8 (
+  IN CONST UINT8  *Buffer,
+  IN UINTN        Length
+  )
+{
+  UINT8  Sum;
+
+  for (Sum = 0; Length > 0; Length--) {
+    Sum = (UINT8) (Sum + *Buffer++);
+  }
+  return (UINT8) (0x100 - Sum);
+}
+
+CHAR16
+EFIAPI
+CharToUpper (
+  IN CHAR16  Char
+  )
+{
+  return (Char >= L'a' && Char <= L'z') ? (CHAR16) (Char - (L'a' - L'A')) : Char;
+}
+
+UINTN
+EFIAPI
+StrDecimalToUintn (
+  IN CONST CHAR16  *String
+  )
+{
+  UINTN  Result;
+
+  Result = 0;
+  while (*String == L' ') {
+    String++;
+  }
+  while (*String >= L'0' && *String <= L'9') {
+    Result = Result * 10 + (*String - L'0');
+    String++;
+  }
+  return Result;
+}
+
+UINTN
+EFIAPI
+AsciiStrLen (
+  IN CONST CHAR8  *String
+  )
+{
+  return strlen (String);
+}
+
+UINTN
+EFIAPI
+AsciiStrSize (
+  IN CONST CHAR8  *String
+  )
+{
+  return strlen (String) + 1;
+}
+
+INTN
+EFIAPI
+AsciiStrCmp (
+  IN CONST CHAR8  *FirstString,
+  IN CONST CHAR8  *SecondString
+  )
+{
+  return strcmp (FirstString, SecondString);
+}
+
+INTN
+EFIAPI
+AsciiStrnCmp (
+  IN CONST CHAR8  *FirstString,
+  IN CONST CHAR8  *SecondString,
+  IN UINTN        Length
+  )
+{
+  return strncmp (FirstString, SecondString, Length);
+}
+
+UINTN
+EFIAPI
+AsciiStrDecimalToUintn (
+  IN CONST CHAR8  *String
+  )
+{
+  return (UINTN) strtoull (String, NULL, 10);
+}
+
+UINT64
+EFIAPI
+AsciiStrHexToUint64 (
+  IN CONST CHAR8  *String
+  )
+{
+  return strtoull (String, NULL, 16);
+}
+
+RETURN_STATUS
+EFIAPI
+AsciiStrToUnicodeStrS (
+  IN  CONST CHAR8  *Source,
+  OUT CHAR16       *Destination,
+  IN  UINTN        DestMax
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Source[Index] != 0; Index++) {
+    if (Index + 1 >= DestMax) {
+      return EFI_BUFFER_TOO_SMALL;
+    }
+    Destination[Index] = (UINT8) Source[Index];
+  }
+  Destination[Index] = 0;
+  return EFI_SUCCESS;
+}
+
+RETURN_STATUS
+EFIAPI
+UnicodeStrToAsciiStrS (
+  IN  CONST CHAR16  *Source,
+  OUT CHAR8         *Destination,
+  IN  UINTN         DestMax
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Source[Index] != 0; Index++) {
+    if (Index + 1 >= DestMax) {
+      return EFI_BUFFER_TOO_SMALL;
+    }
+    Destination[Index] = (CHAR8) Source[Index];
+  }
+  Destination[Index] = 0;
+  return EFI_SUCCESS;
+}
+
+UINT64 EFIAPI ReadUnaligned64 (CONST UINT64 *Buffer) { UINT64 V; memcpy (&V, Buffer, sizeof (V)); return V; }
+UINT32 EFIAPI ReadUnaligned32 (CONST UINT32 *Buffer) { UINT32 V; memcpy (&V, Buffer, sizeof (V)); return V; }
+UINT64 EFIAPI WriteUnaligned64 (UINT64 *Buffer, UINT64 Value) { memcpy (Buffer, &Value, sizeof (Value)); return Value; }
+UINT32 EFIAPI WriteUnaligned32 (UINT32 *Buffer, UINT32 Value) { memcpy (Buffer, &Value, sizeof (Value)); return Value; }
+UINT16 EFIAPI ReadUnaligned16 (CONST UINT16 *Buffer) { UINT16 V; memcpy (&V, Buffer, sizeof (V)); return V; }
+UINT16 EFIAPI WriteUnaligned16 (UINT16 *Buffer, UINT16 Value) { memcpy (Buffer, &Value, sizeof (Value)); return Value; }
+UINT64 EFIAPI LShiftU64 (UINT64 Operand, UINTN Count) { return Operand << Count; }
+UINT64 EFIAPI RShiftU64 (UINT64 Operand, UINTN Count) { return Operand >> Count; }
+UINT64 EFIAPI MultU64x32 (UINT64 Multiplicand, UINT32 Multiplier) { return Multiplicand * Multiplier; }
+UINT64 EFIAPI MultU64x64 (UINT64 Multiplicand, UINT64 Multiplier) { return Multiplicand * Multiplier; }
+UINT64 EFIAPI DivU64x32 (UINT64 Dividend, UINT32 Divisor) { return Dividend / Divisor; }
+
+UINT64
+HostNanoseconds (
+  VOID
+  )
+{
+  struct timespec  Now;
+
+  clock_gettime (CLOCK_MONOTONIC, &Now);
+  return (UINT64) Now.tv_sec * 1000000000ULL + (UINT64) Now.tv_nsec;
+}
+
+UINT64
+EFIAPI
+AsmReadTsc (
+  VOID
+  )
+{
+  //
+  // The host "TSC" ticks in nanoseconds, which keeps timestamps in logs
+  // produced by the harness directly readable.
+  //
+  return HostNanoseconds ();
+}
+
+VOID
+EFIAPI
+CpuPause (
+  VOID
+  )
+{
+}
+
+VOID
+EFIAPI
+MemoryFence (
+  VOID
+  )
+{
+  __sync_synchronize ();
+}
+
+UINT32
+EFIAPI
+InterlockedCompareExchange32 (
+  IN OUT volatile UINT32  *Value,
+  IN     UINT32           CompareValue,
+  IN     UINT32           ExchangeValue
+  )
+{
+  return __sync_val_compare_and_swap (Value, CompareValue, ExchangeValue);
+}
+
+UINT32
+EFIAPI
+InterlockedIncrement (
+  IN OUT volatile UINT32  *Value
+  )
+{
+  return __sync_add_and_fetch (Value, 1);
+}
+
+//
+// ---------------------------------------------------------------------------
+// PrintLib
+// ---------------------------------------------------------------------------
+//
+typedef struct {
+  CHAR16  *Buffer;
+  CHAR8   *AsciiBuffer;
+  UINTN   Max;
+  UINTN   Length;
+} HOST_PRINT_SINK;
+
+STATIC
+VOID
+SinkPut (
+  IN OUT HOST_PRINT_SINK  *Sink,
+  IN     UINT32           Char
+  )
+{
+  if (Sink->Length + 1 < Sink->Max) {
+    if (Sink->Buffer != NULL) {
+      Sink->Buffer[Sink->Length] = (CHAR16) Char;
+    } else {
+      Sink->AsciiBuffer[Sink->Length] = (CHAR8) Char;
+    }
+    Sink->Length++;
+  }
+}
+
+STATIC
+VOID
+SinkPutPadded (
+  IN OUT HOST_PRINT_SINK  *Sink,
+  IN     CONST CHAR8      *Text,
+  IN     UINTN            Width,
+  IN     BOOLEAN          LeftJustify,
+  IN     CHAR8            Pad
+  )
+{
+  UINTN  Length;
+
+  Length = strlen (Text);
+  if (!LeftJustify) {
+    //
+    // Zero padding goes after a leading minus sign.
+    //
+    if (Pad == '0' && *Text == '-') {
+      SinkPut (Sink, '-');
+      Text++;
+    }
+    for ( ; Length < Width; Width--) {
+      SinkPut (Sink, (UINT8) Pad);
+    }
+  }
+  while (*Text != 0) {
+    SinkPut (Sink, (UINT8) *Text++);
+  }
+  if (LeftJustify) {
+    for ( ; Length < Width; Width--) {
+      SinkPut (Sink, ' ');
+    }
+  }
+}
+
+STATIC CONST CHAR8 *mStatusStrings[] = {
+  "Success",               "Load Error",            "Invalid Parameter",     "Unsupported",
+  "Bad Buffer Size",       "Buffer Too Small",      "Not Ready",             "Device Error",
+  "Write Protected",       "Out of Resources",      "Volume Corrupt",        "Volume Full",
+  "No Media",              "Media changed",         "Not Found",             "Access Denied",
+  "No Response",           "No mapping",            "Time out",              "Not started",
+  "Already started",       "Aborted",               "ICMP Error",            "TFTP Error",
+  "Protocol Error",        "Incompatible Version",  "Security Violation",    "CRC Error",
+  "End of Media",          "Reserved (29)",         "Reserved (30)",         "End of File",
+  "Invalid Language",      "Compromised Data"
+};
+
+/**
+  Shared formatter for the Unicode and ASCII PrintLib entry points.  Walks
+  the format string in whichever width it is stored and renders into Sink.
+**/
+STATIC
+UINTN
+HostFormat (
+  IN OUT HOST_PRINT_SINK  *Sink,
+  IN     CONST VOID       *Format,
+  IN     BOOLEAN          WideFormat,
+  IN     VA_LIST          Marker
+  )
+{
+  UINTN        Index;
+  UINT32       Char;
+  BOOLEAN      LeftJustify;
+  BOOLEAN      Long;
+  CHAR8        Pad;
+  UINTN        Width;
+  UINTN        Precision;
+  BOOLEAN      HavePrecision;
+  CHAR8        Number[64];
+  CHAR8        Text[512];
+
+#define FORMAT_CHAR(I)  (WideFormat ? (UINT32) ((CONST CHAR16 *) Format)[I] : (UINT32) (UINT8) ((CONST CHAR8 *) Format)[I])
+
+  for (Index = 0; (Char = FORMAT_CHAR (Index)) != 0; Index++) {
+    if (Char != '%') {
+      SinkPut (Sink, Char);
+      continue;
+    }
+
+    LeftJustify   = FALSE;
+    Long          = FALSE;
+    Pad           = ' ';
+    Width         = 0;
+    Precision     = 0;
+    HavePrecision = FALSE;
+
+    for (Index++; ; Index++) {
+      Char = FORMAT_CHAR (Index);
+      if (Char == '-') {
+        LeftJustify = TRUE;
+      } else if (Char == '0' && Width == 0 && !HavePrecision) {
+        Pad = '0';
+      } else if (Char >= '0' && Char <= '9') {
+        if (HavePrecision) {
+          Precision = Precision * 10 + (Char - '0');
+        } else {
+          Width = Width * 10 + (Char - '0');
+        }
+      } else if (Char == '*') {
+        if (HavePrecision) {
+          Precision = (UINTN) VA_ARG (Marker, UINTN);
+        } else {
+          Width = (UINTN) VA_ARG (Marker, UINTN);
+        }
+      } else if (Char == '.') {
+        HavePrecision = TRUE;
+      } else if (Char == 'l' || Char == 'L') {
+        Long = TRUE;
+      } else if (Char == '+' || Char == ' ' || Char == ',') {
+        ;
+      } else {
+        break;
+      }
+    }
+
+    switch (Char) {
+      case 'd':
+      case 'i':
+        if (Long) {
+          snprintf (Number, sizeof (Number), "%lld", (long long) VA_ARG (Marker, INT64));
+        } else {
+          snprintf (Number, sizeof (Number), "%d", VA_ARG (Marker, int));
+        }
+        SinkPutPadded (Sink, Number, Width, LeftJustify, Pad);
+        break;
+
+      case 'u':
+        if (Long) {
+          snprintf (Number, sizeof (Number), "%llu", (unsigned long long) VA_ARG (Marker, UINT64));
+        } else {
+          snprintf (Number, sizeof (Number), "%u", VA_ARG (Marker, unsigned int));
+        }
+        SinkPutPadded (Sink, Number, Width, LeftJustify, Pad);
+        break;
+
+      case 'x':
+      case 'X':
+        if (Long) {
+          snprintf (Number, sizeof (Number), (Char == 'x') ? "%llx" : "%llX", (unsigned long long) VA_ARG (Marker, UINT64));
+        } else {
+          snprintf (Number, sizeof (Number), (Char == 'x') ? "%x" : "%X", VA_ARG (Marker, unsigned int));
+        }
+        SinkPutPadded (Sink, Number, Width, LeftJustify, Pad);
+        break;
+
+      case 'p':
+        snprintf (Number, sizeof (Number), "%016llX", (unsigned long long) (UINTN) VA_ARG (Marker, VOID *));
+        SinkPutPadded (Sink, Number, Width, LeftJustify, Pad);
+        break;
+
+      case 'c':
+        SinkPut (Sink, (CHAR16) VA_ARG (Marker, UINTN));
+        break;
+
+      case 's':
+      case 'S':
+      case 'a':
+        {
+          UINTN   Length;
+          UINTN   Limit;
+          BOOLEAN Ascii;
+          VOID    *String;
+
+          Ascii  = (BOOLEAN) (Char == 'a');
+          String = VA_ARG (Marker, VOID *);
+          if (String == NULL) {
+            String = Ascii ? (VOID *) "<null string>" : (VOID *) L"<null string>";
+          }
+          Limit = HavePrecision ? Precision : MAX_UINTN;
+          for (Length = 0; Length < Limit && Length + 1 < sizeof (Text); Length++) {
+            UINT32 C = Ascii ? (UINT32) (UINT8) ((CHAR8 *) String)[Length] : (UINT32) ((CHAR16 *) String)[Length];
+            if (C == 0) {
+              break;
+            }
+            Text[Length] = (C < 0x80) ? (CHAR8) C : '?';
+          }
+          Text[Length] = 0;
+          SinkPutPadded (Sink, Text, Width, LeftJustify, ' ');
+        }
+        break;
+
+      case 'g':
+        {
+          GUID *Guid = VA_ARG (Marker, GUID *);
+          snprintf (
+            Text, sizeof (Text), "%08x-%04x-%04x-%02x%02x-%02x%02x%02x%02x%02x%02x",
+            Guid->Data1, Guid->Data2, Guid->Data3, Guid->Data4[0], Guid->Data4[1],
+            Guid->Data4[2], Guid->Data4[3], Guid->Data4[4], Guid->Data4[5],
+            Guid->Data4[6], Guid->Data4[7]
+            );
+          SinkPutPadded (Sink, Text, Width, LeftJustify, ' ');
+        }
+        break;
+
+      case 'r':
+        {
+          EFI_STATUS Status = VA_ARG (Marker, EFI_STATUS);
+          UINTN      Code   = Status & ~MAX_BIT;
+          if (Code < ARRAY_SIZE (mStatusStrings) && (Status == EFI_SUCCESS || EFI_ERROR (Status))) {
+            snprintf (Text, sizeof (Text), "%s", mStatusStrings[Code]);
+          } else {
+            snprintf (Text, sizeof (Text), "%016llX", (unsigned long long) Status);
+          }
+          SinkPutPadded (Sink, Text, Width, LeftJustify, ' ');
+        }
+        break;
+
+      case '%':
+        SinkPut (Sink, '%');
+        break;
+
+      case 0:
+        Index--;
+        break;
+
+      default:
+        SinkPut (Sink, '%');
+        SinkPut (Sink, Char);
+        break;
+    }
+  }
+
+#undef FORMAT_CHAR
+
+  if (Sink->Max > 0) {
+    if (Sink->Buffer != NULL) {
+      Sink->Buffer[Sink->Length] = 0;
+    } else {
+      Sink->AsciiBuffer[Sink->Length] = 0;
+    }
+  }
+  return Sink->Length;
+}
+
+UINTN
+EFIAPI
+UnicodeVSPrint (
+  OUT CHAR16        *StartOfBuffer,
+  IN  UINTN         BufferSize,
+  IN  CONST CHAR16  *FormatString,
+  IN  VA_LIST       Marker
+  )
+{
+  HOST_PRINT_SINK  Sink = { StartOfBuffer, NULL, BufferSize / sizeof (CHAR16), 0 };
+
+  return HostFormat (&Sink, FormatString, TRUE, Marker);
+}
+
+UINTN
+EFIAPI
+UnicodeSPrint (
+  OUT CHAR16        *StartOfBuffer,
+  IN  UINTN         BufferSize,
+  IN  CONST CHAR16  *FormatString,
+  ...
+  )
+{
+  VA_LIST  Marker;
+  UINTN    Length;
+
+  VA_START (Marker, FormatString);
+  Length = UnicodeVSPrint (StartOfBuffer, BufferSize, FormatString, Marker);
+  VA_END (Marker);
+  return Length;
+}
+
+UINTN
+EFIAPI
+AsciiVSPrint (
+  OUT CHAR8        *StartOfBuffer,
+  IN  UINTN        BufferSize,
+  IN  CONST CHAR8  *FormatString,
+  IN  VA_LIST      Marker
+  )
+{
+  HOST_PRINT_SINK  Sink = { NULL, StartOfBuffer, BufferSize, 0 };
+
+  return HostFormat (&Sink, FormatString, FALSE, Marker);
+}
+
+UINTN
+EFIAPI
+AsciiSPrint (
+  OUT CHAR8        *StartOfBuffer,
+  IN  UINTN        BufferSize,
+  IN  CONST CHAR8  *FormatString,
+  ...
+  )
+{
+  VA_LIST  Marker;
+  UINTN    Length;
+
+  VA_START (Marker, FormatString);
+  Length = AsciiVSPrint (StartOfBuffer, BufferSize, FormatString, Marker);
+  VA_END (Marker);
+  return Length;
+}
+
+//
+// ---------------------------------------------------------------------------
+// Console
+// ---------------------------------------------------------------------------
+//
+STATIC
+VOID
+HostConsoleWrite (
+  IN CONST CHAR16  *String
+  )
+{
+  UINTN  Length;
+  UINTN  Index;
+
+  Length = StrLen (String);
+  gHostCounters.ConsoleCharacters += Length;
+  if (!gHostConsoleEcho) {
+    return;
+  }
+  for (Index = 0; Index < Length; Index++) {
+    if (String[Index] < 0x80) {
+      if (String[Index] != L'\r') {
+        fputc ((int) String[Index], stdout);
+      }
+    } else if (String[Index] < 0x800) {
+      fputc (0xC0 | (String[Index] >> 6), stdout);
+      fputc (0x80 | (String[Index] & 0x3F), stdout);
+    } else {
+      fputc (0xE0 | (String[Index] >> 12), stdout);
+      fputc (0x80 | ((String[Index] >> 6) & 0x3F), stdout);
+      fputc (0x80 | (String[Index] & 0x3F), stdout);
+    }
+  }
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostOutputString (
+  IN EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL  *This,
+  IN CHAR16                           *String
+  )
+{
+  (VOID) This;
+  HostConsoleWrite (String);
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostReadKeyStroke (
+  IN  EFI_SIMPLE_TEXT_INPUT_PROTOCOL  *This,
+  OUT EFI_INPUT_KEY                   *Key
+  )
+{
+  (VOID) This;
+  (VOID) Key;
+  return EFI_NOT_READY;
+}
+
+UINTN
+EFIAPI
+Print (
+  IN CONST CHAR16  *Format,
+  ...
+  )
+{
+  VA_LIST  Marker;
+  CHAR16   Buffer[1024];
+  UINTN    Length;
+
+  VA_START (Marker, Format);
+  Length = UnicodeVSPrint (Buffer, sizeof (Buffer), Format, Marker);
+  VA_END (Marker);
+
+  HostConsoleWrite (Buffer);
+  return Length;
+}
+
+UINTN
+EFIAPI
+AsciiPrint (
+  IN CONST CHAR8  *Format,
+  ...
+  )
+{
+  VA_LIST  Marker;
+  CHAR8    Buffer[1024];
+  CHAR16   Wide[1024];
+  UINTN    Length;
+
+  VA_START (Marker, Format);
+  Length = AsciiVSPrint (Buffer, sizeof (Buffer), Format, Marker);
+  VA_END (Marker);
+
+  AsciiStrToUnicodeStrS (Buffer, Wide, ARRAY_SIZE (Wide));
+  HostConsoleWrite (Wide);
+  return Length;
+}
+
+//
+// ---------------------------------------------------------------------------
+// Handle database and protocol services
+// ---------------------------------------------------------------------------
+//
+#define HOST_MAX_PROTOCOLS_PER_HANDLE  8
+#define HOST_MAX_HANDLES               64
+#define HOST_MAX_NOTIFIES              16
+#define HOST_MAX_PENDING               HOST_MAX_HANDLES
+
+typedef struct {
+  EFI_GUID  Guid;
+  VOID      *Interface;
+} HOST_PROTOCOL_ENTRY;
+
+typedef struct {
+  UINTN                 Count;
+  HOST_PROTOCOL_ENTRY   Protocols[HOST_MAX_PROTOCOLS_PER_HANDLE];
+} HOST_HANDLE;
+
+typedef struct {
+  EFI_GUID    Protocol;
+  EFI_EVENT   Event;
+  EFI_HANDLE  Pending[HOST_MAX_PENDING];
+  UINTN       Head;
+  UINTN       Tail;
+} HOST_NOTIFY;
+
+STATIC HOST_HANDLE   mHandles[HOST_MAX_HANDLES];
+STATIC UINTN         mHandleCount;
+STATIC HOST_NOTIFY   mNotifies[HOST_MAX_NOTIFIES];
+STATIC UINTN         mNotifyCount;
+
+EFI_STATUS EFIAPI HostSignalEvent (IN EFI_EVENT Event);
+
+/**
+  Drops the protocol notifications an event was registered for, as closing
+  an event does on real firmware.  Its memory may be handed to the next
+  event created, which must not inherit them.
+**/
+STATIC
+VOID
+HostUnregisterNotifies (
+  IN EFI_EVENT  Event
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < mNotifyCount; Index++) {
+    if (mNotifies[Index].Event == Event) {
+      mNotifies[Index].Event = NULL;
+    }
+  }
+}
+
+EFI_HANDLE
+HostCreateHandle (
+  VOID
+  )
+{
+  if (mHandleCount >= HOST_MAX_HANDLES) {
+    return NULL;
+  }
+  ZeroMem (&mHandles[mHandleCount], sizeof (mHandles[0]));
+  return &mHandles[mHandleCount++];
+}
+
+VOID
+HostResetHandleDatabase (
+  VOID
+  )
+{
+  mHandleCount = 0;
+  mNotifyCount = 0;
+}
+
+STATIC
+HOST_HANDLE *
+HostLookupHandle (
+  IN EFI_HANDLE  Handle
+  )
+{
+  HOST_HANDLE  *Entry;
+
+  Entry = (HOST_HANDLE *) Handle;
+  if (Entry < &mHandles[0] || Entry >= &mHandles[mHandleCount]) {
+    return NULL;
+  }
+  return Entry;
+}
+
+EFI_STATUS
+HostInstallProtocol (
+  IN OUT EFI_HANDLE  *Handle,
+  IN     EFI_GUID    *Protocol,
+  IN     VOID        *Interface
+  )
+{
+  HOST_HANDLE  *Entry;
+  UINTN        Index;
+  HOST_NOTIFY  *Notify;
+
+  if (*Handle == NULL) {
+    *Handle = HostCreateHandle ();
+  }
+  Entry = HostLookupHandle (*Handle);
+  if (Entry == NULL || Entry->Count >= HOST_MAX_PROTOCOLS_PER_HANDLE) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  CopyGuid (&Entry->Protocols[Entry->Count].Guid, Protocol);
+  Entry->Protocols[Entry->Count].Interface = Interface;
+  Entry->Count++;
+
+  for (Index = 0; Index < mNotifyCount; Index++) {
+    Notify = &mNotifies[Index];
+    if (Notify->Event != NULL && CompareGuid (&Notify->Protocol, Protocol)) {
+      Notify->Pending[Notify->Tail++ % HOST_MAX_PENDING] = *Handle;
+      HostSignalEvent (Notify->Event);
+    }
+  }
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostInstallProtocolInterface (
+  IN OUT EFI_HANDLE          *Handle,
+  IN     EFI_GUID            *Protocol,
+  IN     EFI_INTERFACE_TYPE  InterfaceType,
+  IN     VOID                *Interface
+  )
+{
+  (VOID) InterfaceType;
+  return HostInstallProtocol (Handle, Protocol, Interface);
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostHandleProtocol (
+  IN  EFI_HANDLE  Handle,
+  IN  EFI_GUID    *Protocol,
+  OUT VOID        **Interface
+  )
+{
+  HOST_HANDLE  *Entry;
+  UINTN        Index;
+
+  Entry = HostLookupHandle (Handle);
+  if (Entry == NULL || Interface == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  for (Index = 0; Index < Entry->Count; Index++) {
+    if (CompareGuid (&Entry->Protocols[Index].Guid, Protocol)) {
+      *Interface = Entry->Protocols[Index].Interface;
+      return EFI_SUCCESS;
+    }
+  }
+  *Interface = NULL;
+  return EFI_UNSUPPORTED;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostOpenProtocol (
+  IN  EFI_HANDLE  Handle,
+  IN  EFI_GUID    *Protocol,
+  OUT VOID        **Interface,
+  IN  EFI_HANDLE  AgentHandle,
+  IN  EFI_HANDLE  ControllerHandle,
+  IN  UINT32      Attributes
+  )
+{
+  VOID  *Dummy;
+
+  (VOID) AgentHandle;
+  (VOID) ControllerHandle;
+  (VOID) Attributes;
+  return HostHandleProtocol (Handle, Protocol, (Interface != NULL) ? Interface : &Dummy);
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostLocateHandle (
+  IN     EFI_LOCATE_SEARCH_TYPE  SearchType,
+  IN     EFI_GUID                *Protocol,
+  IN     VOID                    *SearchKey,
+  IN OUT UINTN                   *BufferSize,
+  OUT    EFI_HANDLE              *Buffer
+  )
+{
+  HOST_NOTIFY  *Notify;
+  UINTN        Index;
+  UINTN        Count;
+  VOID         *Interface;
+
+  if (SearchType == ByRegisterNotify) {
+    Notify = (HOST_NOTIFY *) SearchKey;
+    if (Notify == NULL || Notify->Head == Notify->Tail) {
+      return EFI_NOT_FOUND;
+    }
+    if (*BufferSize < sizeof (EFI_HANDLE)) {
+      *BufferSize = sizeof (EFI_HANDLE);
+      return EFI_BUFFER_TOO_SMALL;
+    }
+    *Buffer     = Notify->Pending[Notify->Head++ % HOST_MAX_PENDING];
+    *BufferSize = sizeof (EFI_HANDLE);
+    return EFI_SUCCESS;
+  }
+
+  Count = 0;
+  for (Index = 0; Index < mHandleCount; Index++) {
+    if (SearchType == AllHandles || !EFI_ERROR (HostHandleProtocol (&mHandles[Index], Protocol, &Interface))) {
+      if ((Count + 1) * sizeof (EFI_HANDLE) <= *BufferSize) {
+        Buffer[Count] = &mHandles[Index];
+      }
+      Count++;
+    }
+  }
+
+  if (Count == 0) {
+    return EFI_NOT_FOUND;
+  }
+  if (Count * sizeof (EFI_HANDLE) > *BufferSize) {
+    *BufferSize = Count * sizeof (EFI_HANDLE);
+    return EFI_BUFFER_TOO_SMALL;
+  }
+  *BufferSize = Count * sizeof (EFI_HANDLE);
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostLocateHandleBuffer (
+  IN  EFI_LOCATE_SEARCH_TYPE  SearchType,
+  IN  EFI_GUID                *Protocol,
+  IN  VOID                    *SearchKey,
+  OUT UINTN                   *NoHandles,
+  OUT EFI_HANDLE              **Buffer
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       BufferSize;
+
+  BufferSize = 0;
+  Status = HostLocateHandle (SearchType, Protocol, SearchKey, &BufferSize, NULL);
+  if (Status != EFI_BUFFER_TOO_SMALL) {
+    *NoHandles = 0;
+    return EFI_ERROR (Status) ? Status : EFI_NOT_FOUND;
+  }
+
+  *Buffer = AllocatePool (BufferSize);
+  if (*Buffer == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  Status = HostLocateHandle (SearchType, Protocol, SearchKey, &BufferSize, *Buffer);
+  *NoHandles = BufferSize / sizeof (EFI_HANDLE);
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostLocateProtocol (
+  IN  EFI_GUID  *Protocol,
+  IN  VOID      *Registration,
+  OUT VOID      **Interface
+  )
+{
+  UINTN  Index;
+
+  (VOID) Registration;
+  for (Index = 0; Index < mHandleCount; Index++) {
+    if (!EFI_ERROR (HostHandleProtocol (&mHandles[Index], Protocol, Interface))) {
+      return EFI_SUCCESS;
+    }
+  }
+  return EFI_NOT_FOUND;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostLocateDevicePath (
+  IN     EFI_GUID                  *Protocol,
+  IN OUT EFI_DEVICE_PATH_PROTOCOL  **DevicePath,
+  OUT    EFI_HANDLE                *Device
+  )
+{
+  (VOID) Protocol;
+  (VOID) DevicePath;
+  (VOID) Device;
+  return EFI_NOT_FOUND;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostRegisterProtocolNotify (
+  IN  EFI_GUID   *Protocol,
+  IN  EFI_EVENT  Event,
+  OUT VOID       **Registration
+  )
+{
+  HOST_NOTIFY  *Notify;
+
+  if (mNotifyCount >= HOST_MAX_NOTIFIES) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  Notify = &mNotifies[mNotifyCount++];
+  ZeroMem (Notify, sizeof (*Notify));
+  CopyGuid (&Notify->Protocol, Protocol);
+  Notify->Event = Event;
+  *Registration = Notify;
+  return EFI_SUCCESS;
+}
+
+//
+// ---------------------------------------------------------------------------
+// Events and timers on a virtual clock
+// ---------------------------------------------------------------------------
+//
+#define HOST_EVENT_SIGNATURE  SIGNATURE_32 ('h', 'e', 'v', 't')
+
+typedef struct _HOST_EVENT {
+  UINT32              Signature;
+  UINT32              Type;
+  EFI_TPL             NotifyTpl;
+  EFI_EVENT_NOTIFY    NotifyFunction;
+  VOID                *NotifyContext;
+  BOOLEAN             Signaled;
+  BOOLEAN             HasGroup;
+  EFI_GUID            Group;
+  EFI_TIMER_DELAY     TimerType;
+  UINT64              TimerPeriod;
+  UINT64              TimerDue;
+  struct _HOST_EVENT  *Next;
+} HOST_EVENT;
+
+STATIC HOST_EVENT  *mEvents = NULL;
+STATIC UINT64      mVirtualTime = 0;
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostCreateEventEx (
+  IN  UINT32            Type,
+  IN  EFI_TPL           NotifyTpl,
+  IN  EFI_EVENT_NOTIFY  NotifyFunction,
+  IN  CONST VOID        *NotifyContext,
+  IN  CONST EFI_GUID    *EventGroup,
+  OUT EFI_EVENT         *Event
+  )
+{
+  HOST_EVENT  *NewEvent;
+
+  NewEvent = calloc (1, sizeof (*NewEvent));
+  if (NewEvent == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  NewEvent->Signature      = HOST_EVENT_SIGNATURE;
+  NewEvent->Type           = Type;
+  NewEvent->NotifyTpl      = NotifyTpl;
+  NewEvent->NotifyFunction = NotifyFunction;
+  NewEvent->NotifyContext  = (VOID *) NotifyContext;
+  if (EventGroup != NULL) {
+    NewEvent->HasGroup = TRUE;
+    CopyGuid (&NewEvent->Group, EventGroup);
+  }
+  NewEvent->Next = mEvents;
+  mEvents        = NewEvent;
+  *Event         = NewEvent;
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostCreateEvent (
+  IN  UINT32            Type,
+  IN  EFI_TPL           NotifyTpl,
+  IN  EFI_EVENT_NOTIFY  NotifyFunction,
+  IN  VOID              *NotifyContext,
+  OUT EFI_EVENT         *Event
+  )
+{
+  return HostCreateEventEx (Type, NotifyTpl, NotifyFunction, NotifyContext, NULL, Event);
+}
+
+STATIC
+HOST_EVENT *
+HostLookupEvent (
+  IN EFI_EVENT  Event
+  )
+{
+  HOST_EVENT  *Entry;
+
+  for (Entry = mEvents; Entry != NULL; Entry = Entry->Next) {
+    if (Entry == Event) {
+      return Entry;
+    }
+  }
+  return NULL;
+}
+
+STATIC
+VOID
+HostFireEvent (
+  IN HOST_EVENT  *Entry
+  )
+{
+  Entry->Signaled = TRUE;
+  if ((Entry->Type & EVT_NOTIFY_SIGNAL) != 0 && Entry->NotifyFunction != NULL) {
+    Entry->NotifyFunction (Entry, Entry->NotifyContext);
+  }
+}
+
+EFI_STATUS
+EFIAPI
+HostSignalEvent (
+  IN EFI_EVENT  Event
+  )
+{
+  HOST_EVENT  *Entry;
+
+  Entry = HostLookupEvent (Event);
+  if (Entry == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  if (Entry->HasGroup) {
+    HostSignalEventGroup (&Entry->Group);
+  } else {
+    HostFireEvent (Entry);
+  }
+  return EFI_SUCCESS;
+}
+
+VOID
+HostSignalEventGroup (
+  IN CONST EFI_GUID  *EventGroup
+  )
+{
+  HOST_EVENT  *Entry;
+  HOST_EVENT  *Next;
+
+  for (Entry = mEvents; Entry != NULL; Entry = Next) {
+    Next = Entry->Next;
+    if (Entry->HasGroup && CompareGuid (&Entry->Group, EventGroup)) {
+      HostFireEvent (Entry);
+    }
+  }
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostCloseEvent (
+  IN EFI_EVENT  Event
+  )
+{
+  HOST_EVENT  **Link;
+  HOST_EVENT  *Entry;
+
+  for (Link = &mEvents; *Link != NULL; Link = &(*Link)->Next) {
+    Entry = *Link;
+    if (Entry == Event) {
+      *Link = Entry->Next;
+      HostUnregisterNotifies (Event);
+      Entry->Signature = 0;
+      free (Entry);
+      return EFI_SUCCESS;
+    }
+  }
+  return EFI_INVALID_PARAMETER;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostCheckEvent (
+  IN EFI_EVENT  Event
+  )
+{
+  HOST_EVENT  *Entry;
+
+  HostFsPoll ();
+  Entry = HostLookupEvent (Event);
+  if (Entry == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  if (Entry->Signaled) {
+    Entry->Signaled = FALSE;
+    return EFI_SUCCESS;
+  }
+  return EFI_NOT_READY;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostSetTimer (
+  IN EFI_EVENT        Event,
+  IN EFI_TIMER_DELAY  Type,
+  IN UINT64           TriggerTime
+  )
+{
+  HOST_EVENT  *Entry;
+
+  Entry = HostLookupEvent (Event);
+  if (Entry == NULL || (Entry->Type & EVT_TIMER) == 0) {
+    return EFI_INVALID_PARAMETER;
+  }
+  Entry->TimerType   = Type;
+  Entry->TimerPeriod = TriggerTime * 100;
+  Entry->TimerDue    = mVirtualTime + Entry->TimerPeriod;
+  return EFI_SUCCESS;
+}
+
+VOID
+HostAdvanceTime (
+  IN UINT64  Nanoseconds
+  )
+{
+  UINT64      Target;
+  HOST_EVENT  *Entry;
+  HOST_EVENT  *Due;
+
+  Target = mVirtualTime + Nanoseconds;
+  for ( ; ; ) {
+    //
+    // Fire the earliest due timer first so that periodic and one-shot
+    // timers interleave the way they would on real firmware.
+    //
+    Due = NULL;
+    for (Entry = mEvents; Entry != NULL; Entry = Entry->Next) {
+      if (Entry->TimerType != TimerCancel && Entry->TimerDue <= Target &&
+          (Due == NULL || Entry->TimerDue < Due->TimerDue)) {
+        Due = Entry;
+      }
+    }
+    if (Due == NULL) {
+      break;
+    }
+
+    mVirtualTime = MAX (mVirtualTime, Due->TimerDue);
+    if (Due->TimerType == TimerPeriodic && Due->TimerPeriod != 0) {
+      Due->TimerDue += Due->TimerPeriod;
+    } else {
+      Due->TimerType = TimerCancel;
+    }
+    HostFireEvent (Due);
+  }
+  mVirtualTime = Target;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostWaitForEvent (
+  IN  UINTN      NumberOfEvents,
+  IN  EFI_EVENT  *Event,
+  OUT UINTN      *Index
+  )
+{
+  UINTN  Rounds;
+  UINTN  Loop;
+
+  for (Rounds = 0; Rounds < 100000; Rounds++) {
+    for (Loop = 0; Loop < NumberOfEvents; Loop++) {
+      if (HostCheckEvent (Event[Loop]) == EFI_SUCCESS) {
+        *Index = Loop;
+        return EFI_SUCCESS;
+      }
+    }
+    HostAdvanceTime (1000000);
+  }
+  return EFI_TIMEOUT;
+}
+
+STATIC
+EFI_TPL
+EFIAPI
+HostRaiseTpl (
+  IN EFI_TPL  NewTpl
+  )
+{
+  (VOID) NewTpl;
+  return TPL_APPLICATION;
+}
+
+STATIC
+VOID
+EFIAPI
+HostRestoreTpl (
+  IN EFI_TPL  OldTpl
+  )
+{
+  (VOID) OldTpl;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostStall (
+  IN UINTN  Microseconds
+  )
+{
+  //
+  // Stalls are accounted, not slept: the benchmark reports them as the
+  // boot delay the code under test would add on real firmware.
+  //
+  gHostCounters.StallMicroseconds += Microseconds;
+  HostAdvanceTime ((UINT64) Microseconds * 1000);
+  return EFI_SUCCESS;
+}
+
+/**
+  Table-driven, one byte per step, as the DXE core's implementation is, so
+  code that checks CRCs is timed at firmware speed.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+HostCalculateCrc32 (
+  IN  VOID    *Data,
+  IN  UINTN   DataSize,
+  OUT UINT32  *Crc32
+  )
+{
+  STATIC UINT32  Table[256];
+  UINT32         Crc;
+  UINTN          Index;
+  UINTN          Bit;
+
+  if (Table[1] == 0) {
+    for (Index = 0; Index < 256; Index++) {
+      Crc = (UINT32) Index;
+      for (Bit = 0; Bit < 8; Bit++) {
+        Crc = (Crc >> 1) ^ (0xEDB88320 & (0U - (Crc & 1)));
+      }
+      Table[Index] = Crc;
+    }
+  }
+
+  Crc = 0xFFFFFFFF;
+  for (Index = 0; Index < DataSize; Index++) {
+    Crc = (Crc >> 8) ^ Table[(Crc ^ ((UINT8 *) Data)[Index]) & 0xFF];
+  }
+  *Crc32 = ~Crc;
+  return EFI_SUCCESS;
+}
+
+STATIC
+VOID
+EFIAPI
+HostCopyMemService (
+  IN VOID   *Destination,
+  IN VOID   *Source,
+  IN UINTN  Length
+  )
+{
+  memmove (Destination, Source, Length);
+}
+
+STATIC
+VOID
+EFIAPI
+HostSetMemService (
+  IN VOID   *Buffer,
+  IN UINTN  Size,
+  IN UINT8  Value
+  )
+{
+  memset (Buffer, Value, Size);
+}
+
+//
+// ---------------------------------------------------------------------------
+// Runtime services: volatile in-memory variable store
+// ---------------------------------------------------------------------------
+//
+typedef struct _HOST_VARIABLE {
+  struct _HOST_VARIABLE  *Next;
+  CHAR16                 Name[64];
+  EFI_GUID               Guid;
+  UINT32                 Attributes;
+  UINTN                  DataSize;
+  UINT8                  *Data;
+} HOST_VARIABLE;
+
+STATIC HOST_VARIABLE  *mVariables = NULL;
+
+STATIC
+HOST_VARIABLE *
+HostFindVariable (
+  IN CHAR16    *Name,
+  IN EFI_GUID  *Guid
+  )
+{
+  HOST_VARIABLE  *Entry;
+
+  for (Entry = mVariables; Entry != NULL; Entry = Entry->Next) {
+    if (StrCmp (Entry->Name, Name) == 0 && CompareGuid (&Entry->Guid, Guid)) {
+      return Entry;
+    }
+  }
+  return NULL;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostGetVariable (
+  IN     CHAR16    *VariableName,
+  IN     EFI_GUID  *VendorGuid,
+  OUT    UINT32    *Attributes,
+  IN OUT UINTN     *DataSize,
+  OUT    VOID      *Data
+  )
+{
+  HOST_VARIABLE  *Entry;
+
+  Entry = HostFindVariable (VariableName, VendorGuid);
+  if (Entry == NULL) {
+    return EFI_NOT_FOUND;
+  }
+  if (Attributes != NULL) {
+    *Attributes = Entry->Attributes;
+  }
+  if (*DataSize < Entry->DataSize) {
+    *DataSize = Entry->DataSize;
+    return EFI_BUFFER_TOO_SMALL;
+  }
+  *DataSize = Entry->DataSize;
+  memcpy (Data, Entry->Data, Entry->DataSize);
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostSetVariable (
+  IN CHAR16    *VariableName,
+  IN EFI_GUID  *VendorGuid,
+  IN UINT32    Attributes,
+  IN UINTN     DataSize,
+  IN VOID      *Data
+  )
+{
+  HOST_VARIABLE  *Entry;
+  HOST_VARIABLE  **Link;
+
+  Entry = HostFindVariable (VariableName, VendorGuid);
+  if (DataSize == 0 || Attributes == 0) {
+    if (Entry == NULL) {
+      return EFI_NOT_FOUND;
+    }
+    for (Link = &mVariables; *Link != Entry; Link = &(*Link)->Next) {
+      ;
+    }
+    *Link = Entry->Next;
+    free (Entry->Data);
+    free (Entry);
+    return EFI_SUCCESS;
+  }
+
+  if (Entry == NULL) {
+    Entry = calloc (1, sizeof (*Entry));
+    if (Entry == NULL || StrLen (VariableName) >= ARRAY_SIZE (Entry->Name)) {
+      free (Entry);
+      return EFI_OUT_OF_RESOURCES;
+    }
+    StrCpyS (Entry->Name, ARRAY_SIZE (Entry->Name), VariableName);
+    CopyGuid (&Entry->Guid, VendorGuid);
+    Entry->Next = mVariables;
+    mVariables  = Entry;
+  }
+
+  free (Entry->Data);
+  Entry->Data = malloc (DataSize);
+  if (Entry->Data == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  memcpy (Entry->Data, Data, DataSize);
+  Entry->DataSize   = DataSize;
+  Entry->Attributes = Attributes;
+  return EFI_SUCCESS;
+}
+
+//
+// ---------------------------------------------------------------------------
+// System table
+// ---------------------------------------------------------------------------
+//
+#define HOST_MAX_CONFIG_TABLES  8
+
+STATIC EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL  mConOut = { NULL, HostOutputString };
+STATIC EFI_SIMPLE_TEXT_INPUT_PROTOCOL   mConIn  = { NULL, HostReadKeyStroke, NULL };
+STATIC EFI_CONFIGURATION_TABLE          mConfigTables[HOST_MAX_CONFIG_TABLES];
+
+STATIC EFI_BOOT_SERVICES  mBootServices;
+STATIC EFI_RUNTIME_SERVICES  mRuntimeServices;
+STATIC EFI_SYSTEM_TABLE   mSystemTable;
+
+EFI_HANDLE            gImageHandle = NULL;
+EFI_SYSTEM_TABLE      *gST = &mSystemTable;
+EFI_BOOT_SERVICES     *gBS = &mBootServices;
+EFI_RUNTIME_SERVICES  *gRT = &mRuntimeServices;
+
+VOID
+HostShimInitialize (
+  VOID
+  )
+{
+  ZeroMem (&mBootServices, sizeof (mBootServices));
+  mBootServices.RaiseTPL                 = HostRaiseTpl;
+  mBootServices.RestoreTPL               = HostRestoreTpl;
+  mBootServices.AllocatePages            = HostAllocatePages;
+  mBootServices.FreePages                = HostFreePages;
+  mBootServices.AllocatePool             = HostAllocatePoolService;
+  mBootServices.FreePool                 = HostFreePoolService;
+  mBootServices.CreateEvent              = HostCreateEvent;
+  mBootServices.CreateEventEx            = HostCreateEventEx;
+  mBootServices.SetTimer                 = HostSetTimer;
+  mBootServices.WaitForEvent             = HostWaitForEvent;
+  mBootServices.SignalEvent              = HostSignalEvent;
+  mBootServices.CloseEvent               = HostCloseEvent;
+  mBootServices.CheckEvent               = HostCheckEvent;
+  mBootServices.InstallProtocolInterface = HostInstallProtocolInterface;
+  mBootServices.HandleProtocol           = HostHandleProtocol;
+  mBootServices.OpenProtocol             = HostOpenProtocol;
+  mBootServices.RegisterProtocolNotify   = HostRegisterProtocolNotify;
+  mBootServices.LocateHandle             = HostLocateHandle;
+  mBootServices.LocateHandleBuffer       = HostLocateHandleBuffer;
+  mBootServices.LocateProtocol           = HostLocateProtocol;
+  mBootServices.LocateDevicePath         = HostLocateDevicePath;
+  mBootServices.Stall                    = HostStall;
+  mBootServices.CalculateCrc32           = HostCalculateCrc32;
+  mBootServices.CopyMem                  = HostCopyMemService;
+  mBootServices.SetMem                   = HostSetMemService;
+
+  ZeroMem (&mRuntimeServices, sizeof (mRuntimeServices));
+  mRuntimeServices.GetVariable = HostGetVariable;
+  mRuntimeServices.SetVariable = HostSetVariable;
+
+  ZeroMem (&mSystemTable, sizeof (mSystemTable));
+  mSystemTable.ConIn                = &mConIn;
+  mSystemTable.ConOut               = &mConOut;
+  mSystemTable.StdErr               = &mConOut;
+  mSystemTable.BootServices         = &mBootServices;
+  mSystemTable.RuntimeServices      = &mRuntimeServices;
+  mSystemTable.ConfigurationTable   = mConfigTables;
+  mSystemTable.NumberOfTableEntries = 0;
+}
+
+VOID
+HostInstallConfigurationTable (
+  IN EFI_GUID  *Guid,
+  IN VOID      *Table
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < mSystemTable.NumberOfTableEntries; Index++) {
+    if (CompareGuid (&mConfigTables[Index].VendorGuid, Guid)) {
+      mConfigTables[Index].VendorTable = Table;
+      return;
+    }
+  }
+  if (Index < HOST_MAX_CONFIG_TABLES) {
+    CopyGuid (&mConfigTables[Index].VendorGuid, Guid);
+    mConfigTables[Index].VendorTable = Table;
+    mSystemTable.NumberOfTableEntries++;
+  }
+}
+
+//
+// ---------------------------------------------------------------------------
+// UefiLib
+// ---------------------------------------------------------------------------
+//
+EFI_STATUS
+EFIAPI
+EfiGetSystemConfigurationTable (
+  IN  EFI_GUID  *TableGuid,
+  OUT VOID      **Table
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < gST->NumberOfTableEntries; Index++) {
+    if (CompareGuid (TableGuid, &gST->ConfigurationTable[Index].VendorGuid)) {
+      *Table = gST->ConfigurationTable[Index].VendorTable;
+      return EFI_SUCCESS;
+    }
+  }
+  *Table = NULL;
+  return EFI_NOT_FOUND;
+}
+
+EFI_STATUS
+EFIAPI
+EfiCreateEventReadyToBootEx (
+  IN  EFI_TPL           NotifyTpl,
+  IN  EFI_EVENT_NOTIFY  NotifyFunction,
+  IN  VOID              *NotifyContext,
+  OUT EFI_EVENT         *ReadyToBootEvent
+  )
+{
+  return HostCreateEventEx (
+           EVT_NOTIFY_SIGNAL,
+           NotifyTpl,
+           NotifyFunction,
+           NotifyContext,
+           &gEfiEventReadyToBootGuid,
+           ReadyToBootEvent
+           );
+}
+
+EFI_EVENT
+EFIAPI
+EfiCreateProtocolNotifyEvent (
+  IN  EFI_GUID          *ProtocolGuid,
+  IN  EFI_TPL           NotifyTpl,
+  IN  EFI_EVENT_NOTIFY  NotifyFunction,
+  IN  VOID              *NotifyContext,
+  OUT VOID              **Registration
+  )
+{
+  EFI_EVENT  Event;
+
+  if (EFI_ERROR (HostCreateEvent (EVT_NOTIFY_SIGNAL, NotifyTpl, NotifyFunction, NotifyContext, &Event))) {
+    return NULL;
+  }
+  if (EFI_ERROR (HostRegisterProtocolNotify (ProtocolGuid, Event, Registration))) {
+    HostCloseEvent (Event);
+    return NULL;
+  }
+  HostSignalEvent (Event);
+  return Event;
+}
+
+//
+// ---------------------------------------------------------------------------
+// DevicePathLib
+// ---------------------------------------------------------------------------
+//
+UINTN
+EFIAPI
+DevicePathNodeLength (
+  IN CONST VOID  *Node
+  )
+{
+  CONST UINT8  *Length;
+
+  Length = ((CONST EFI_DEVICE_PATH_PROTOCOL *) Node)->Length;
+  return (UINTN) Length[0] | ((UINTN) Length[1] << 8);
+}
+
+EFI_DEVICE_PATH_PROTOCOL *
+EFIAPI
+NextDevicePathNode (
+  IN CONST VOID  *Node
+  )
+{
+  return (EFI_DEVICE_PATH_PROTOCOL *) ((UINT8 *) Node + DevicePathNodeLength (Node));
+}
+
+UINT8
+EFIAPI
+DevicePathType (
+  IN CONST VOID  *Node
+  )
+{
+  return ((CONST EFI_DEVICE_PATH_PROTOCOL *) Node)->Type;
+}
+
+UINT8
+EFIAPI
+DevicePathSubType (
+  IN CONST VOID  *Node
+  )
+{
+  return ((CONST EFI_DEVICE_PATH_PROTOCOL *) Node)->SubType;
+}
+
+BOOLEAN
+EFIAPI
+IsDevicePathEnd (
+  IN CONST VOID  *Node
+  )
+{
+  return (BOOLEAN) (DevicePathType (Node) == END_DEVICE_PATH_TYPE &&
+                    DevicePathSubType (Node) == END_ENTIRE_DEVICE_PATH_SUBTYPE);
+}
+
+UINTN
+EFIAPI
+GetDevicePathSize (
+  IN CONST EFI_DEVICE_PATH_PROTOCOL  *DevicePath
+  )
+{
+  CONST EFI_DEVICE_PATH_PROTOCOL  *Node;
+
+  if (DevicePath == NULL) {
+    return 0;
+  }
+  for (Node = DevicePath; !IsDevicePathEnd (Node); Node = NextDevicePathNode (Node)) {
+    ;
+  }
+  return (UINTN) ((UINT8 *) Node - (UINT8 *) DevicePath) + DevicePathNodeLength (Node);
+}
+
+EFI_DEVICE_PATH_PROTOCOL *
+EFIAPI
+DevicePathFromHandle (
+  IN EFI_HANDLE  Handle
+  )
+{
+  EFI_DEVICE_PATH_PROTOCOL  *DevicePath;
+
+  if (EFI_ERROR (HostHandleProtocol (Handle, &gEfiDevicePathProtocolGuid, (VOID **) &DevicePath))) {
+    return NULL;
+  }
+  return DevicePath;
+}
+
+EFI_DEVICE_PATH_PROTOCOL *
+EFIAPI
+DuplicateDevicePath (
+  IN CONST EFI_DEVICE_PATH_PROTOCOL  *DevicePath
+  )
+{
+  UINTN  Size;
+
+  Size = GetDevicePathSize (DevicePath);
+  return (Size == 0) ? NULL : AllocateCopyPool (Size, DevicePath);
+}
+
+BOOLEAN
+EFIAPI
+IsDevicePathValid (
+  IN CONST EFI_DEVICE_PATH_PROTOCOL  *DevicePath,
+  IN       UINTN                     MaxSize
+  )
+{
+  UINTN  Offset;
+  UINTN  Length;
+
+  //
+  // As in EDK2, no size means no bound.
+  //
+  if (MaxSize == 0) {
+    MaxSize = MAX_UINTN;
+  }
+
+  for (Offset = 0; MaxSize - Offset >= sizeof (EFI_DEVICE_PATH_PROTOCOL); Offset += Length) {
+    Length = DevicePathNodeLength ((CONST UINT8 *) DevicePath + Offset);
+    if (Length < sizeof (EFI_DEVICE_PATH_PROTOCOL) || Length > MaxSize - Offset) {
+      return FALSE;
+    }
+    if (IsDevicePathEnd ((CONST UINT8 *) DevicePath + Offset)) {
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+//
+// ---------------------------------------------------------------------------
+// DxeServicesLib: sections of the driver's own FFS file
+// ---------------------------------------------------------------------------
+//
+typedef struct {
+  EFI_SECTION_TYPE  Type;
+  VOID              *Data;
+  UINTN             Size;
+} HOST_FV_SECTION;
+
+STATIC HOST_FV_SECTION  *mFvSections     = NULL;
+STATIC UINTN            mFvSectionCount = 0;
+
+EFI_STATUS
+HostFvAddSection (
+  IN EFI_SECTION_TYPE  Type,
+  IN CONST VOID        *Data,
+  IN UINTN             Size
+  )
+{
+  HOST_FV_SECTION  *Sections;
+  HOST_FV_SECTION  *Section;
+
+  Sections = realloc (mFvSections, (mFvSectionCount + 1) * sizeof (*Sections));
+  if (Sections == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  mFvSections = Sections;
+
+  Section       = &mFvSections[mFvSectionCount];
+  Section->Data = malloc (MAX (Size, 1));
+  if (Section->Data == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  memcpy (Section->Data, Data, Size);
+  Section->Type = Type;
+  Section->Size = Size;
+  mFvSectionCount++;
+  return EFI_SUCCESS;
+}
+
+VOID
+HostFvRemoveSections (
+  VOID
+  )
+{
+  while (mFvSectionCount > 0) {
+    free (mFvSections[--mFvSectionCount].Data);
+  }
+
+  free (mFvSections);
+  mFvSections = NULL;
+}
+
+EFI_STATUS
+EFIAPI
+GetSectionFromFv (
+  IN  CONST EFI_GUID    *NameGuid,
+  IN  EFI_SECTION_TYPE  SectionType,
+  IN  UINTN             SectionInstance,
+  OUT VOID              **Buffer,
+  OUT UINTN             *Size
+  )
+{
+  UINTN  Index;
+
+  if (!CompareGuid (NameGuid, &gEfiCallerIdGuid)) {
+    return EFI_NOT_FOUND;
+  }
+
+  //
+  // Like the firmware volume driver, every call hands back a pool copy.
+  //
+  for (Index = 0; Index < mFvSectionCount; Index++) {
+    if (mFvSections[Index].Type != SectionType) {
+      continue;
+    }
+    if (SectionInstance-- > 0) {
+      continue;
+    }
+
+    *Buffer = AllocateCopyPool (mFvSections[Index].Size, mFvSections[Index].Data);
+    if (*Buffer == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+    *Size = mFvSections[Index].Size;
+    return EFI_SUCCESS;
+  }
+
+  return EFI_NOT_FOUND;
+}
+
+//
+// ---------------------------------------------------------------------------
+// SerialPortLib: captured into a host buffer, optionally written to a file
+// ---------------------------------------------------------------------------
+//
+STATIC FILE  *mHostSerialFile = NULL;
+
+EFI_STATUS
+HostSerialCapture (
+  IN CONST CHAR8  *Path
+  )
+{
+  mHostSerialFile = fopen (Path, "wb");
+  return (mHostSerialFile != NULL) ? EFI_SUCCESS : EFI_NOT_FOUND;
+}
+
+RETURN_STATUS
+EFIAPI
+SerialPortInitialize (
+  VOID
+  )
+{
+  return EFI_SUCCESS;
+}
+
+UINTN
+EFIAPI
+SerialPortWrite (
+  IN UINT8  *Buffer,
+  IN UINTN  NumberOfBytes
+  )
+{
+  gHostCounters.SerialBytes += NumberOfBytes;
+  if (mHostSerialFile != NULL) {
+    fwrite (Buffer, 1, NumberOfBytes, mHostSerialFile);
+  }
+  return NumberOfBytes;
+}
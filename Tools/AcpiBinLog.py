@@ -0,0 +1,320 @@
+#!/usr/bin/env python3
+"""
+ACPIPatcher binary log tool
+
+Builds the message catalog for a build with ACPI_PATCHER_BINARY_LOG and
+turns a serial capture of that build back into text.
+
+    AcpiBinLog.py catalog ACPIPatcherPkg/ACPIPatcher -o ACPIPatcher.logcat.json
+    AcpiBinLog.py decode serial.log --catalog ACPIPatcher.logcat.json
+
+Message IDs are (ACPI_LOG_FILE_ID << 16) | __LINE__, so the catalog has to
+come from the same sources as the binary that produced the capture.
+"""
+
+import argparse
+import json
+import os
+import re
+import struct
+import sys
+
+SIGNATURE = b"ACPIBLOG"
+VERSION = 1
+RECORD_MAGIC = 0xB10C
+RECORD_HEADER = struct.Struct("<HHIQ")
+DROPPED_ID = 0xFFFFFFFF
+
+LOG_MACROS = ("AcpiDebugPrint", "DXE_DEBUG")
+PREFIXES = {
+    "DEBUG_ERROR": "ERROR: ",
+    "DEBUG_WARN": "WARN: ",
+    "DEBUG_INFO": "INFO: ",
+    "DEBUG_VERBOSE": "VERBOSE: ",
+}
+
+EFI_STATUS_NAMES = {
+    0: "Success",
+    1: "Load Error", 2: "Invalid Parameter", 3: "Unsupported",
+    4: "Bad Buffer Size", 5: "Buffer Too Small", 6: "Not Ready",
+    7: "Device Error", 8: "Write Protected", 9: "Out of Resources",
+    10: "Volume Corrupt", 11: "Volume Full", 12: "No Media",
+    13: "Media changed", 14: "Not Found", 15: "Access Denied",
+    16: "No Response", 17: "No mapping", 18: "Time out",
+    19: "Not started", 20: "Already started", 21: "Aborted",
+    22: "ICMP Error", 23: "TFTP Error", 24: "Protocol Error",
+    25: "Incompatible Version", 26: "Security Violation", 27: "CRC Error",
+    28: "End of Media", 31: "End of File", 32: "Invalid Language",
+    33: "Compromised Data",
+}
+
+CONVERSION = re.compile(r"%([-+ 0,.*lL\d]*)([a-zA-Z%])")
+
+
+# ---------------------------------------------------------------------------
+# Catalog
+# ---------------------------------------------------------------------------
+
+def strip_comments(text):
+    """Blank out comments while keeping line numbers and string literals."""
+    def repl(match):
+        token = match.group(0)
+        if token.startswith("/"):
+            return re.sub(r"[^\n]", " ", token)
+        return token
+    return re.sub(r'//[^\n]*|/\*.*?\*/|L?"(?:\\.|[^"\\])*"', repl, text, flags=re.S)
+
+
+def unescape(literal):
+    return (literal.replace("\\r", "\r").replace("\\n", "\n").replace("\\t", "\t")
+            .replace('\\"', '"').replace("\\\\", "\\"))
+
+
+def string_macros(text):
+    """Simple #define NAME L"..." macros that can appear inside formats."""
+    macros = {}
+    for match in re.finditer(r'^\s*#define\s+(\w+)\s+L"((?:\\.|[^"\\])*)"\s*$', text, re.M):
+        macros[match.group(1)] = unescape(match.group(2))
+    return macros
+
+
+def call_extent(text, start):
+    """Returns the index just past the parenthesised argument list at start."""
+    depth = 0
+    index = start
+    while index < len(text):
+        char = text[index]
+        if char == '"':
+            index += 1
+            while text[index] != '"':
+                index += 2 if text[index] == "\\" else 1
+        elif char == "(":
+            depth += 1
+        elif char == ")":
+            depth -= 1
+            if depth == 0:
+                return index + 1
+        index += 1
+    return index
+
+
+def parse_format(arguments, macros):
+    """Joins the literal pieces of the second macro argument."""
+    pieces = []
+    for token in re.finditer(r'L?"((?:\\.|[^"\\])*)"|(\w+)|(,)', arguments):
+        if token.group(3):
+            if pieces:
+                break
+            continue
+        if token.group(1) is not None:
+            pieces.append(unescape(token.group(1)))
+        elif token.group(2) in macros:
+            pieces.append(macros[token.group(2)])
+        elif pieces:
+            break
+    return "".join(pieces) if pieces else None
+
+
+def build_catalog(paths):
+    messages = {}
+    for path in paths:
+        with open(path, encoding="utf-8", errors="replace") as handle:
+            text = strip_comments(handle.read())
+        file_id = re.search(r"^\s*#define\s+ACPI_LOG_FILE_ID\s+(\d+)", text, re.M)
+        if file_id is None:
+            continue
+        file_id = int(file_id.group(1))
+        macros = string_macros(text)
+        for match in re.finditer(r"\b(%s)\s*\(" % "|".join(LOG_MACROS), text):
+            end = call_extent(text, match.end() - 1)
+            arguments = text[match.end():end - 1]
+            level = re.match(r"\s*(\w+)\s*,", arguments)
+            if level is None:
+                continue
+            fmt = parse_format(arguments[level.end():], macros)
+            if fmt is None:
+                continue
+            first = text.count("\n", 0, match.start()) + 1
+            last = text.count("\n", 0, end) + 1
+            for line in range(first, last + 1):
+                messages["%d" % ((file_id << 16) | line)] = {
+                    "file": os.path.basename(path),
+                    "line": first,
+                    "level": level.group(1),
+                    "prefix": match.group(1) == "AcpiDebugPrint",
+                    "format": fmt,
+                }
+    return {"version": VERSION, "messages": messages}
+
+
+def catalog_command(args):
+    paths = []
+    for source in args.sources:
+        if os.path.isdir(source):
+            paths += sorted(os.path.join(source, name) for name in os.listdir(source)
+                            if name.endswith(".c"))
+        else:
+            paths.append(source)
+    catalog = build_catalog(paths)
+    with open(args.output, "w") as handle:
+        json.dump(catalog, handle, indent=1, sort_keys=True)
+    print("%s: %d message ids from %d files" % (args.output, len(catalog["messages"]), len(paths)))
+    return 0
+
+
+# ---------------------------------------------------------------------------
+# Decoder
+# ---------------------------------------------------------------------------
+
+def format_guid(raw):
+    a, b, c = struct.unpack_from("<IHH", raw)
+    tail = raw[8:16]
+    return "%08X-%04X-%04X-%s-%s" % (a, b, c, tail[:2].hex().upper(), tail[2:].hex().upper())
+
+
+def render(fmt, payload):
+    """Re-runs an EDK2 PrintLib format over the encoded arguments."""
+    out = []
+    cursor = 0
+    position = 0
+
+    def take_integer():
+        nonlocal cursor
+        if cursor + 8 > len(payload):
+            return 0
+        value, = struct.unpack_from("<Q", payload, cursor)
+        cursor += 8
+        return value
+
+    def take_string():
+        nonlocal cursor
+        if cursor >= len(payload):
+            return ""
+        length = payload[cursor]
+        value = payload[cursor + 1:cursor + 1 + length].decode("ascii", "replace")
+        cursor += 1 + length
+        return value
+
+    for match in CONVERSION.finditer(fmt):
+        out.append(fmt[position:match.start()])
+        position = match.end()
+        flags, kind = match.group(1), match.group(2)
+        width = None
+        if "*" in flags:
+            width = take_integer()
+        long_arg = "l" in flags or "L" in flags
+        spec = re.sub(r"[lL*,]", "", flags)
+        if width is not None:
+            spec += str(width)
+        if kind == "%":
+            out.append("%")
+        elif kind in "di":
+            value = take_integer()
+            if not long_arg:
+                value &= 0xFFFFFFFF
+                value -= (value & 0x80000000) << 1
+            elif value & (1 << 63):
+                value -= 1 << 64
+            out.append(("%" + spec + "d") % value)
+        elif kind in "uxX":
+            value = take_integer()
+            if not long_arg:
+                value &= 0xFFFFFFFF
+            out.append(("%" + spec + {"u": "d", "x": "x", "X": "X"}[kind]) % value)
+        elif kind == "p":
+            out.append("%016X" % take_integer())
+        elif kind == "c":
+            out.append(chr(take_integer() & 0xFFFF))
+        elif kind == "r":
+            value = take_integer()
+            if value & (1 << 63):
+                name = EFI_STATUS_NAMES.get(value & ~(1 << 63))
+            else:
+                name = EFI_STATUS_NAMES.get(value) if value == 0 else None
+            out.append(name if name is not None else "%016X" % value)
+        elif kind == "g":
+            out.append(format_guid(payload[cursor:cursor + 16].ljust(16, b"\0")))
+            cursor += 16
+        elif kind in "asS":
+            out.append(("%" + re.sub(r"[0 +]", "", spec) + "s") % take_string())
+        else:
+            out.append(match.group(0))
+    out.append(fmt[position:])
+    return "".join(out)
+
+
+def records(data):
+    """Yields (message id, timestamp, payload) for every record in a capture."""
+    offset = data.find(SIGNATURE)
+    while offset >= 0:
+        version, = struct.unpack_from("<H", data, offset + 8)
+        offset += len(SIGNATURE) + 4
+        if version != VERSION:
+            offset = data.find(SIGNATURE, offset)
+            continue
+        while offset + RECORD_HEADER.size <= len(data):
+            magic, size, message_id, timestamp = RECORD_HEADER.unpack_from(data, offset)
+            if magic != RECORD_MAGIC or size < RECORD_HEADER.size or offset + size > len(data):
+                break
+            yield message_id, timestamp, data[offset + RECORD_HEADER.size:offset + size]
+            offset += size
+        offset = data.find(SIGNATURE, offset)
+
+
+def decode_command(args):
+    with open(args.catalog) as handle:
+        catalog = json.load(handle)["messages"]
+    with open(args.capture, "rb") as handle:
+        data = handle.read()
+
+    first = None
+    count = 0
+    for message_id, timestamp, payload in records(data):
+        if first is None:
+            first = timestamp
+        delta = timestamp - first
+        stamp = ("%10.3f ms" % (delta * 1000.0 / args.tsc_hz)) if args.tsc_hz else ("%12d" % delta)
+        if message_id == DROPPED_ID:
+            text = "*** %d log records dropped ***\n" % struct.unpack_from("<Q", payload)[0]
+        else:
+            entry = catalog.get("%d" % message_id)
+            if entry is None:
+                text = "<unknown message %d:%d, %d payload bytes>\n" % (
+                    message_id >> 16, message_id & 0xFFFF, len(payload))
+            else:
+                text = render(entry["format"], payload)
+                if entry["prefix"]:
+                    text = PREFIXES.get(entry["level"], "") + text
+        sys.stdout.write("[%s] %s" % (stamp, text.replace("\r", "")))
+        if not text.endswith("\n"):
+            sys.stdout.write("\n")
+        count += 1
+
+    if count == 0:
+        print("%s: no binary log records found" % args.capture, file=sys.stderr)
+        return 1
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description="ACPIPatcher binary log catalog and decoder")
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    catalog = commands.add_parser("catalog", help="Generate a message catalog from the sources")
+    catalog.add_argument("sources", nargs="+", help="Source files or directories")
+    catalog.add_argument("--output", "-o", default="ACPIPatcher.logcat.json")
+    catalog.set_defaults(handler=catalog_command)
+
+    decode = commands.add_parser("decode", help="Decode a serial capture")
+    decode.add_argument("capture", help="Raw serial capture, e.g. from QEMU -serial file:")
+    decode.add_argument("--catalog", "-c", default="ACPIPatcher.logcat.json")
+    decode.add_argument("--tsc-hz", type=float, default=0,
+                        help="TSC frequency, to print timestamps in milliseconds")
+    decode.set_defaults(handler=decode_command)
+
+    args = parser.parse_args()
+    return args.handler(args)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
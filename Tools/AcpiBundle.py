@@ -0,0 +1,378 @@
+#!/usr/bin/env python3
+"""
+ACPIPatcher bundle tool
+
+Builds an ACPIPatcher.apb from a directory of tables, so the patcher reads
+one file instead of opening every table, and checks or lists an existing
+bundle.  verify also reads the ACPIPatcher.cache a scan leaves behind,
+which has the same layout.
+
+    AcpiBundle.py build EFI/ACPIPatcher/ACPI
+    AcpiBundle.py build EFI/ACPIPatcher/ACPI --replace SSDT-CPU.aml --drop DMAR
+    AcpiBundle.py verify EFI/ACPIPatcher/ACPI/ACPIPatcher.apb
+    AcpiBundle.py locate /mnt/esp/EFI/ACPIPatcher/ACPI/ACPIPatcher.apb
+
+locate writes the ACPIPatcher.apl locator next to a bundle on a mounted
+GPT partition, so the patcher can read the bundle's blocks directly.  It
+asks the kernel where the file's blocks are (FIEMAP, Linux only) and
+rewrites the file once if they are not one contiguous run; on other
+systems it writes no locator, and the bundle is read through the file
+system.  For a disk image, give --lba and --partition-guid instead.  Run
+it again whenever the bundle is rebuilt or copied; a stale locator is
+only a slower boot.
+
+build follows the directory's ACPIPatcher.cfg if it has one.  Otherwise
+tables are taken in the order the scan would load them, DSDT.aml as a
+replace and everything else as an append unless named with --replace.
+The layout is described in AcpiBundle.h.
+"""
+
+import argparse
+import os
+import struct
+import subprocess
+import sys
+import uuid
+
+from AcpiCompress import is_table_name, read_table
+from AcpiManifest import MANIFEST_NAME, load_order, table_hash
+
+BUNDLE_NAME = "ACPIPatcher.apb"
+LOCATOR_NAME = "ACPIPatcher.apl"
+SIGNATURE = b"APB1"
+VERSION = 1
+LOCATOR_SIGNATURE = b"APL1"
+LOCATOR_VERSION = 1
+ALIGNMENT = 16
+
+# ACPI_BUNDLE_HEADER, ACPI_BUNDLE_ENTRY and ACPI_BUNDLE_LOCATOR
+HEADER = struct.Struct("<4sHHII QQ")
+ENTRY = struct.Struct("<4sB3xII6s2xQQ32s")
+LOCATOR = struct.Struct("<4sHHIIQ16sQQ")
+
+# FS_IOC_FIEMAP, struct fiemap and struct fiemap_extent from <linux/fiemap.h>
+FS_IOC_FIEMAP = 0xC020660B
+FIEMAP = struct.Struct("=QQIIII")
+FIEMAP_EXTENT = struct.Struct("=QQQ16xI12x")
+FIEMAP_FLAG_SYNC = 0x1
+FIEMAP_EXTENT_LAST = 0x1
+# Unknown, delayed, encoded, not block aligned, inline or tail-packed data
+FIEMAP_EXTENT_UNUSABLE = 0x2 | 0x4 | 0x8 | 0x80 | 0x100 | 0x200 | 0x400 | 0x800
+FIEMAP_MAX_EXTENTS = 32
+
+ACTIONS = {"append": 1, "replace": 2, "drop": 3}
+ACTION_NAMES = {value: name for name, value in ACTIONS.items()}
+
+
+def align(value):
+    return (value + ALIGNMENT - 1) & ~(ALIGNMENT - 1)
+
+
+def checksum(data):
+    return sum(data) & 0xFF
+
+
+def read_manifest(path):
+    """(action, file or signature) pairs from an ACPIPatcher.cfg."""
+    entries = []
+    with open(path, "r", encoding="utf-8-sig") as handle:
+        for number, line in enumerate(handle, 1):
+            tokens = line.split("#", 1)[0].split()
+            if not tokens:
+                continue
+            if tokens[0].lower() not in ACTIONS or len(tokens) < 2:
+                raise ValueError("%s line %d: expected replace, append or drop and a target" % (path, number))
+            entries.append((tokens[0].lower(), tokens[1]))
+    return entries
+
+
+def plan_directory(directory, replace, drop):
+    """(action, file or signature) pairs for a directory without a manifest."""
+    names = [name for name in os.listdir(directory)
+             if is_table_name(name) and os.path.isfile(os.path.join(directory, name))]
+    replace = {name.upper() for name in replace}
+    replace.update(("DSDT.AML", "DSDT.AML.LZ"))
+    entries = [("replace" if name.upper() in replace else "append", name) for name in load_order(names)]
+    entries += [("drop", signature) for signature in drop]
+    return entries
+
+
+def build(args):
+    manifest = os.path.join(args.directory, MANIFEST_NAME)
+    if os.path.isfile(manifest) and not args.replace and not args.drop:
+        entries = read_manifest(manifest)
+        print("%s: following %s" % (args.directory, MANIFEST_NAME))
+    else:
+        entries = plan_directory(args.directory, args.replace, args.drop)
+
+    tables = []
+    for action, target in entries:
+        if action == "drop":
+            if len(target) != 4:
+                print("drop %s: a signature is four characters, skipped" % target, file=sys.stderr)
+                continue
+            tables.append((action, target, target.encode("ascii"), None))
+            continue
+        # A packed .aml.lz goes into the bundle decoded
+        try:
+            data = read_table(os.path.join(args.directory, target))
+        except (ValueError, IndexError, struct.error) as error:
+            print("%s: skipped, %s" % (target, error), file=sys.stderr)
+            continue
+        if len(data) < 36 or struct.unpack_from("<I", data, 4)[0] != len(data):
+            print("%s: skipped, not an ACPI table of its own length" % target, file=sys.stderr)
+            continue
+        if checksum(data) != 0:
+            print("%s: warning, checksum is off by 0x%02x" % (target, checksum(data)), file=sys.stderr)
+        tables.append((action, target, data[0:4], data))
+
+    offset = align(HEADER.size + len(tables) * ENTRY.size)
+    toc = bytearray()
+    payload = bytearray()
+    for action, name, signature, data in tables:
+        if len(name.encode("ascii", "replace")) > 31:
+            print("%s: name shortened in the bundle log" % name, file=sys.stderr)
+        if data is None:
+            toc += ENTRY.pack(signature, ACTIONS[action], 0, 0, b"\0" * 6, 0, 0,
+                              name.encode("ascii", "replace")[:31])
+            continue
+        toc += ENTRY.pack(signature, ACTIONS[action], offset + len(payload), len(data),
+                          data[10:16], struct.unpack_from("<Q", data, 16)[0], table_hash(data),
+                          name.encode("ascii", "replace")[:31])
+        payload += data + b"\0" * (align(len(data)) - len(data))
+
+    size = offset + len(payload)
+    header = HEADER.pack(SIGNATURE, VERSION, ENTRY.size, len(tables), size, table_hash(bytes(toc)), 0)
+    bundle = header + toc + b"\0" * (offset - HEADER.size - len(toc)) + payload
+
+    output = args.output or os.path.join(args.directory, BUNDLE_NAME)
+    with open(output, "wb") as handle:
+        handle.write(bundle)
+    print("%s: %d entries, %d bytes" % (output, len(tables), len(bundle)))
+    return 0
+
+
+def verify(args):
+    with open(args.bundle, "rb") as handle:
+        bundle = handle.read()
+
+    errors = 0
+    if len(bundle) < HEADER.size:
+        print("%s: too small for a bundle header" % args.bundle)
+        return 1
+    signature, version, entry_size, count, size, toc_hash, fingerprint = HEADER.unpack_from(bundle)
+    if signature != SIGNATURE or version != VERSION or entry_size != ENTRY.size:
+        print("%s: not a version %d bundle" % (args.bundle, VERSION))
+        return 1
+    if size != len(bundle):
+        print("%s: header says %d bytes, file has %d" % (args.bundle, size, len(bundle)))
+        return 1
+    toc_end = HEADER.size + count * ENTRY.size
+    if toc_end > len(bundle):
+        print("%s: %d entries do not fit" % (args.bundle, count))
+        return 1
+    if table_hash(bundle[HEADER.size:toc_end]) != toc_hash:
+        print("%s: table of contents does not match its hash" % args.bundle)
+        errors += 1
+
+    if fingerprint:
+        print("%s: boot cache, directory fingerprint %016X" % (args.bundle, fingerprint))
+
+    for index in range(count):
+        (signature, action, offset, length, oem_id, oem_table_id,
+         expected, name) = ENTRY.unpack_from(bundle, HEADER.size + index * ENTRY.size)
+        name = name.split(b"\0", 1)[0].decode("ascii", "replace")
+        label = ACTION_NAMES.get(action, "action %d" % action)
+        if action == ACTIONS["drop"]:
+            print("  %-8s %-4s %s" % (label, signature.decode("ascii", "replace"), name))
+            continue
+
+        problems = []
+        if action not in ACTION_NAMES:
+            problems.append("unknown action")
+        if offset < toc_end or offset % ALIGNMENT or length < 36 or offset + length > len(bundle):
+            problems.append("offset 0x%x length %d is outside the bundle" % (offset, length))
+        else:
+            data = bundle[offset:offset + length]
+            if (data[0:4] != signature or struct.unpack_from("<I", data, 4)[0] != length
+                    or data[10:16] != oem_id or struct.unpack_from("<Q", data, 16)[0] != oem_table_id):
+                problems.append("table header does not match the entry")
+            if table_hash(data) != expected:
+                problems.append("hash is %016X, entry expects %016X" % (table_hash(data), expected))
+            if checksum(data) != 0:
+                problems.append("checksum is off by 0x%02x" % checksum(data))
+        print("  %-8s %-4s %-32s %7d  %s" % (label, signature.decode("ascii", "replace"), name, length,
+                                            "; ".join(problems) or "ok"))
+        errors += len(problems)
+
+    locator = os.path.join(os.path.dirname(args.bundle), LOCATOR_NAME)
+    if not fingerprint and os.path.isfile(locator):
+        problems = verify_locator(locator, bundle)
+        for problem in problems:
+            print("%s: %s" % (locator, problem))
+        errors += len(problems)
+
+    print("%s: %d entries, %d bytes, %s" % (args.bundle, count, len(bundle),
+                                           "%d problems" % errors if errors else "ok"))
+    return 1 if errors else 0
+
+
+def file_extents(path):
+    """(logical, physical, length) runs of a file, merged where they touch,
+    or None where the kernel cannot be asked (FIEMAP is Linux only)."""
+    try:
+        import fcntl
+    except ImportError:
+        return None
+
+    request = FIEMAP.pack(0, 0xFFFFFFFFFFFFFFFF, FIEMAP_FLAG_SYNC, 0, FIEMAP_MAX_EXTENTS, 0)
+    request += b"\0" * (FIEMAP_MAX_EXTENTS * FIEMAP_EXTENT.size)
+    buffer = bytearray(request)
+    with open(path, "rb") as handle:
+        fcntl.ioctl(handle.fileno(), FS_IOC_FIEMAP, buffer)
+    count = FIEMAP.unpack_from(buffer)[3]
+
+    runs = []
+    for index in range(count):
+        logical, physical, length, flags = FIEMAP_EXTENT.unpack_from(buffer, FIEMAP.size + index * FIEMAP_EXTENT.size)
+        if flags & FIEMAP_EXTENT_UNUSABLE:
+            raise OSError("%s: extent %d has no fixed place on the disk (flags 0x%x)" % (path, index, flags))
+        if runs and runs[-1][0] + runs[-1][2] == logical and runs[-1][1] + runs[-1][2] == physical:
+            runs[-1] = (runs[-1][0], runs[-1][1], runs[-1][2] + length)
+        else:
+            runs.append((logical, physical, length))
+    return runs
+
+
+def relayout(path):
+    """Rewrite a file with its space reserved up front, then put it in place."""
+    with open(path, "rb") as handle:
+        data = handle.read()
+    temporary = path + ".tmp"
+    with open(temporary, "wb") as handle:
+        os.posix_fallocate(handle.fileno(), 0, len(data))
+        handle.write(data)
+        handle.flush()
+        os.fsync(handle.fileno())
+    os.replace(temporary, path)
+
+
+def partition_of(path, guid):
+    """(partition GUID, logical block size) of the partition holding path.
+    The GUID is only looked up if guid is None."""
+    device = os.stat(path).st_dev
+    sysfs = "/sys/dev/block/%d:%d" % (os.major(device), os.minor(device))
+    with open(os.path.join(sysfs, "uevent")) as handle:
+        name = dict(line.strip().split("=", 1) for line in handle if "=" in line).get("DEVNAME")
+    # A partition's queue is its disk's
+    queue = os.path.join(sysfs, "queue")
+    if not os.path.isdir(queue):
+        queue = os.path.join(sysfs, "..", "queue")
+    with open(os.path.join(queue, "logical_block_size")) as handle:
+        block_size = int(handle.read())
+    if guid is not None:
+        return guid, block_size
+    guid = subprocess.run(["blkid", "-s", "PARTUUID", "-o", "value", "/dev/" + name],
+                          capture_output=True, text=True).stdout.strip()
+    if len(guid) != 36:
+        raise OSError("/dev/%s has no GPT partition GUID blkid can read; give --partition-guid" % name)
+    return guid, block_size
+
+
+def locate(args):
+    with open(args.bundle, "rb") as handle:
+        bundle = handle.read()
+    if len(bundle) < HEADER.size or HEADER.unpack_from(bundle)[0] != SIGNATURE:
+        print("%s: not a bundle" % args.bundle, file=sys.stderr)
+        return 1
+
+    if args.lba is not None:
+        if args.partition_guid is None:
+            print("--lba needs --partition-guid", file=sys.stderr)
+            return 1
+        guid, block_size, lba = args.partition_guid, args.block_size or 512, args.lba
+    else:
+        try:
+            runs = file_extents(args.bundle)
+            if runs is None:
+                print("%s: cannot look up its blocks on this system, no locator written; the patcher "
+                      "reads the bundle through the file system" % args.bundle)
+                return 0
+            guid, block_size = partition_of(args.bundle, args.partition_guid)
+            if len(runs) != 1:
+                print("%s: %d pieces on the disk, rewriting it" % (args.bundle, len(runs)))
+                relayout(args.bundle)
+                runs = file_extents(args.bundle)
+        except OSError as error:
+            print(error, file=sys.stderr)
+            return 1
+        if len(runs) != 1 or runs[0][0] != 0 or runs[0][2] < len(bundle):
+            print("%s: still in %d pieces; free some space on the volume" % (args.bundle, len(runs)), file=sys.stderr)
+            return 1
+        block_size = args.block_size or block_size
+        if runs[0][1] % block_size:
+            print("%s: starts inside a block" % args.bundle, file=sys.stderr)
+            return 1
+        lba = runs[0][1] // block_size
+
+    fields = (LOCATOR_SIGNATURE, LOCATOR_VERSION, 0, block_size, len(bundle), lba,
+              uuid.UUID(guid).bytes_le, table_hash(bundle))
+    locator = LOCATOR.pack(*fields, 0)[:-8]
+    locator += struct.pack("<Q", table_hash(locator))
+
+    output = args.output or os.path.join(os.path.dirname(args.bundle), LOCATOR_NAME)
+    with open(output, "wb") as handle:
+        handle.write(locator)
+    print("%s: %s at LBA %d of partition %s, %d bytes" % (output, args.bundle, lba, guid.upper(), len(bundle)))
+    return 0
+
+
+def verify_locator(path, bundle):
+    """Problems with the locator at path for the bundle bytes given."""
+    with open(path, "rb") as handle:
+        data = handle.read()
+    if len(data) < LOCATOR.size:
+        return ["too small for a locator"]
+    signature, version, _, block_size, size, lba, guid, bundle_hash, own_hash = LOCATOR.unpack_from(data)
+    if signature != LOCATOR_SIGNATURE or version != LOCATOR_VERSION:
+        return ["not a version %d locator" % LOCATOR_VERSION]
+    problems = []
+    if table_hash(data[:LOCATOR.size - 8]) != own_hash:
+        problems.append("does not match its own hash")
+    if size != len(bundle) or table_hash(bundle) != bundle_hash:
+        problems.append("describes another bundle; run locate again")
+    print("%s: LBA %d of partition %s, %d-byte blocks" % (path, lba, str(uuid.UUID(bytes_le=guid)).upper(), block_size))
+    return problems
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Build or check an ACPIPatcher.apb bundle")
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    command = commands.add_parser("build", help="Bundle a directory of tables")
+    command.add_argument("directory", help="Directory holding the .aml files")
+    command.add_argument("--output", "-o", help="Bundle to write (default: DIRECTORY/%s)" % BUNDLE_NAME)
+    command.add_argument("--replace", action="append", default=[], metavar="FILE",
+                         help="Bundle FILE as a replacement of the firmware table it matches")
+    command.add_argument("--drop", action="append", default=[], metavar="SIGNATURE",
+                         help="Remove every firmware table with SIGNATURE")
+    command.set_defaults(handler=build)
+
+    command = commands.add_parser("verify", help="Check and list a bundle")
+    command.add_argument("bundle", help="Bundle to check")
+    command.set_defaults(handler=verify)
+
+    command = commands.add_parser("locate", help="Write the locator that lets the patcher read a bundle's blocks")
+    command.add_argument("bundle", help="Bundle on a mounted GPT partition")
+    command.add_argument("--output", "-o", help="Locator to write (default: %s next to the bundle)" % LOCATOR_NAME)
+    command.add_argument("--lba", type=int, help="First block of the bundle, for a disk image")
+    command.add_argument("--block-size", type=int, help="Block size --lba counts in (default: the device's, or 512)")
+    command.add_argument("--partition-guid", help="GPT partition GUID, if blkid cannot read it")
+    command.set_defaults(handler=locate)
+
+    args = parser.parse_args()
+    return args.handler(args)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,253 @@
+#!/usr/bin/env python3
+"""
+ACPIPatcher table compressor
+
+Packs .aml tables into the .aml.lz files the patcher decodes at load time,
+so a slow boot device reads a third or so of the bytes.  A packed table is
+named and ordered exactly as the .aml it replaces; keep one or the other
+in the directory, not both.
+
+    AcpiCompress.py pack EFI/ACPIPatcher/ACPI
+    AcpiCompress.py pack EFI/ACPIPatcher/ACPI/DSDT.aml --remove
+    AcpiCompress.py unpack EFI/ACPIPatcher/ACPI/DSDT.aml.lz
+    AcpiCompress.py verify EFI/ACPIPatcher/ACPI
+
+A file is an 8-byte header, "ALZ1" and the table's length, followed by
+the table as one LZ4 block (AcpiLz.h).  The patcher sizes its memory
+before it reads anything, so a file may not decode to more than eight
+times its own size; a block that would is padded with zeros, which the
+decoder ignores.  Run AcpiManifest.py or AcpiBundle.py build after
+packing: both read .aml.lz files, and hash and bundle the decoded table.
+"""
+
+import argparse
+import os
+import struct
+import sys
+
+SUFFIX = ".aml.lz"
+SIGNATURE = b"ALZ1"
+MAX_RATIO = 8
+
+HEADER = struct.Struct("<4sI")
+MIN_MATCH = 4
+MAX_OFFSET = 0xFFFF
+# LZ4 ends every block with literals: no match starts in the last 12
+# bytes, and the last 5 are always literals.
+MATCH_LIMIT = 12
+LAST_LITERALS = 5
+
+
+def _length(count):
+    """The bytes that continue a token nibble of 15."""
+    out = bytearray()
+    while count >= 255:
+        out.append(255)
+        count -= 255
+    out.append(count)
+    return out
+
+
+def _sequence(out, literals, offset=0, match=0):
+    token = min(len(literals), 15) << 4
+    if match:
+        token |= min(match - MIN_MATCH, 15)
+    out.append(token)
+    if len(literals) >= 15:
+        out += _length(len(literals) - 15)
+    out += literals
+    if match:
+        out += struct.pack("<H", offset)
+        if match - MIN_MATCH >= 15:
+            out += _length(match - MIN_MATCH - 15)
+
+
+def compress(data):
+    """One LZ4 block for data: greedy, matching each 4 bytes against where they last occurred."""
+    out = bytearray()
+    recent = {}
+    anchor = 0
+    index = 0
+    end = len(data)
+    while index + MATCH_LIMIT < end:
+        key = data[index:index + MIN_MATCH]
+        candidate = recent.get(key)
+        recent[key] = index
+        if candidate is None or index - candidate > MAX_OFFSET:
+            index += 1
+            continue
+        match = MIN_MATCH
+        while index + match + LAST_LITERALS < end and data[candidate + match] == data[index + match]:
+            match += 1
+        _sequence(out, data[anchor:index], index - candidate, match)
+        index += match
+        anchor = index
+    _sequence(out, data[anchor:])
+    return bytes(out)
+
+
+def decompress(block, length):
+    """Decode an LZ4 block to exactly length bytes, as AcpiLzDecode() does."""
+    out = bytearray()
+    index = 0
+
+    def extend(count):
+        nonlocal index
+        while True:
+            byte = block[index]
+            index += 1
+            count += byte
+            if byte != 255:
+                return count
+
+    while len(out) < length:
+        token = block[index]
+        index += 1
+        count = token >> 4
+        if count == 15:
+            count = extend(count)
+        out += block[index:index + count]
+        index += count
+        if len(out) >= length:
+            break
+        offset = struct.unpack_from("<H", block, index)[0]
+        index += 2
+        if offset == 0 or offset > len(out):
+            raise ValueError("match offset %d outside the output" % offset)
+        count = token & 0x0F
+        if count == 15:
+            count = extend(count)
+        for _ in range(count + MIN_MATCH):
+            out.append(out[-offset])
+    if len(out) != length:
+        raise ValueError("decodes to %d bytes, header says %d" % (len(out), length))
+    return bytes(out)
+
+
+def pack(table):
+    """The .aml.lz file for a table."""
+    packed = HEADER.pack(SIGNATURE, len(table)) + compress(table)
+    floor = -(-len(table) // MAX_RATIO)
+    return packed + b"\0" * max(0, floor - len(packed))
+
+
+def unpack(packed):
+    """The table in a .aml.lz file."""
+    if len(packed) < HEADER.size:
+        raise ValueError("too small for a header")
+    signature, length = HEADER.unpack_from(packed)
+    if signature != SIGNATURE:
+        raise ValueError("not a packed table")
+    if length < 36 or length > len(packed) * MAX_RATIO:
+        raise ValueError("claims %d bytes from a %d byte file" % (length, len(packed)))
+    return decompress(packed[HEADER.size:], length)
+
+
+def is_table_name(name):
+    """True for the names the patcher loads: .aml and .aml.lz, except ._ files."""
+    lower = name.lower()
+    return (lower.endswith(".aml") or lower.endswith(SUFFIX)) and not name.startswith("._")
+
+
+def read_table(path):
+    """A table file's contents, decoded if it is packed."""
+    with open(path, "rb") as handle:
+        data = handle.read()
+    return unpack(data) if path.lower().endswith(SUFFIX) else data
+
+
+def targets(paths, suffix):
+    for path in paths:
+        if os.path.isdir(path):
+            for name in sorted(os.listdir(path)):
+                if name.lower().endswith(suffix) and not name.startswith("._"):
+                    yield os.path.join(path, name)
+        else:
+            yield path
+
+
+def pack_command(args):
+    status = 0
+    for path in targets(args.paths, ".aml"):
+        with open(path, "rb") as handle:
+            table = handle.read()
+        if len(table) < 36 or struct.unpack_from("<I", table, 4)[0] != len(table):
+            print("%s: skipped, not an ACPI table of its own length" % path, file=sys.stderr)
+            status = 1
+            continue
+        packed = pack(table)
+        if unpack(packed) != table:
+            print("%s: does not round-trip, left alone" % path, file=sys.stderr)
+            status = 1
+            continue
+        with open(path + ".lz", "wb") as handle:
+            handle.write(packed)
+        if args.remove:
+            os.remove(path)
+        print("%s.lz: %d -> %d bytes (%d%%)" % (path, len(table), len(packed), len(packed) * 100 // len(table)))
+    return status
+
+
+def unpack_command(args):
+    status = 0
+    for path in targets(args.paths, SUFFIX):
+        try:
+            table = read_table(path)
+        except (ValueError, IndexError, struct.error) as error:
+            print("%s: %s" % (path, error), file=sys.stderr)
+            status = 1
+            continue
+        with open(path[:-3], "wb") as handle:
+            handle.write(table)
+        if args.remove:
+            os.remove(path)
+        print("%s: %d bytes" % (path[:-3], len(table)))
+    return status
+
+
+def verify_command(args):
+    status = 0
+    for path in targets(args.paths, SUFFIX):
+        try:
+            table = read_table(path)
+        except (ValueError, IndexError, struct.error) as error:
+            print("%s: %s" % (path, error))
+            status = 1
+            continue
+        problems = []
+        if struct.unpack_from("<I", table, 4)[0] != len(table):
+            problems.append("header length differs from the decoded size")
+        if sum(table) & 0xFF:
+            problems.append("checksum is off by 0x%02x" % (sum(table) & 0xFF))
+        if os.path.exists(path[:-3]):
+            problems.append("%s is also present and would load twice" % os.path.basename(path[:-3]))
+        print("%s: %s, %d bytes%s" % (path, table[0:4].decode("ascii", "replace"), len(table),
+                                      "".join("; " + problem for problem in problems)))
+        status |= bool(problems)
+    return status
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Pack ACPI tables into the .aml.lz files ACPIPatcher decodes")
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    command = commands.add_parser("pack", help="Write FILE.aml.lz for each table")
+    command.add_argument("paths", nargs="+", help=".aml files, or directories of them")
+    command.add_argument("--remove", action="store_true", help="Delete each .aml once it is packed")
+    command.set_defaults(handler=pack_command)
+
+    command = commands.add_parser("unpack", help="Write FILE.aml back from each .aml.lz")
+    command.add_argument("paths", nargs="+", help=".aml.lz files, or directories of them")
+    command.add_argument("--remove", action="store_true", help="Delete each .aml.lz once it is unpacked")
+    command.set_defaults(handler=unpack_command)
+
+    command = commands.add_parser("verify", help="Decode and check each .aml.lz")
+    command.add_argument("paths", nargs="+", help=".aml.lz files, or directories of them")
+    command.set_defaults(handler=verify_command)
+
+    args = parser.parse_args()
+    return args.handler(args)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
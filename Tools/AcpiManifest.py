@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+"""
+ACPIPatcher manifest tool
+
+Writes an ACPIPatcher.cfg for a directory of tables, so the patcher loads
+exactly those files instead of scanning the directory on every boot.
+
+    AcpiManifest.py EFI/ACPIPatcher/ACPI
+    AcpiManifest.py EFI/ACPIPatcher/ACPI --replace SSDT-CPU.aml --drop DMAR
+
+Files are listed in the order the scan would load them: DSDT.aml, then
+SSDT-<number>.aml by number, then the other SSDT-*.aml and .aml files by
+name.  DSDT.aml is a replace and everything else an append unless named
+with --replace.  Every line carries the file size and the 64-bit hash the
+patcher checks it against (XsdtPlanHash() in XsdtPlan.c).  A packed
+<name>.aml.lz (AcpiCompress.py) is listed in place of <name>.aml, with its
+own file size and the hash of the table it decodes to.
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+from AcpiCompress import SUFFIX, is_table_name, read_table
+
+MANIFEST_NAME = "ACPIPatcher.cfg"
+MASK = (1 << 64) - 1
+NUMBERED = re.compile(r"^SSDT-(\d+)\.aml(\.lz)?$", re.IGNORECASE)
+
+
+def table_hash(data):
+    """XsdtPlanHash(): a multiply-xorshift over little-endian 64-bit words."""
+    value = 0x9E3779B97F4A7C15 ^ len(data)
+    whole = len(data) - len(data) % 8
+    for (word,) in struct.iter_unpack("<Q", data[:whole]):
+        value = ((value ^ word) * 0xFF51AFD7ED558CCD) & MASK
+        value ^= value >> 32
+    if whole < len(data):
+        word = int.from_bytes(data[whole:].ljust(8, b"\0"), "little")
+        value = ((value ^ word) * 0xFF51AFD7ED558CCD) & MASK
+        value ^= value >> 32
+    value = ((value ^ (value >> 29)) * 0xC4CEB9FE1A85EC53) & MASK
+    return value ^ (value >> 32)
+
+
+def load_order(names):
+    """Sort names the way the patcher's directory scan loads them."""
+    def key(name):
+        upper = name.upper()
+        if upper.endswith(SUFFIX.upper()):
+            upper = upper[:-3]
+        match = NUMBERED.match(name)
+        if upper == "DSDT.AML":
+            return (0, 0, upper)
+        if match:
+            return (1, int(match.group(1)), upper)
+        if upper.startswith("SSDT-"):
+            return (2, 0, upper)
+        return (3, 0, upper)
+    return sorted(names, key=key)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Write an ACPIPatcher.cfg manifest for a directory of tables")
+    parser.add_argument("directory", help="Directory holding the .aml files")
+    parser.add_argument("--output", "-o", help="Manifest to write (default: DIRECTORY/%s)" % MANIFEST_NAME)
+    parser.add_argument("--replace", action="append", default=[], metavar="FILE",
+                        help="List FILE as a replacement of the firmware table it matches")
+    parser.add_argument("--drop", action="append", default=[], metavar="SIGNATURE",
+                        help="Remove every firmware table with SIGNATURE")
+    args = parser.parse_args()
+
+    names = [name for name in os.listdir(args.directory)
+             if is_table_name(name) and os.path.isfile(os.path.join(args.directory, name))]
+    replace = {name.upper() for name in args.replace}
+    replace.update(("DSDT.AML", "DSDT.AML.LZ"))
+
+    lines = ["# Written by AcpiManifest.py; tables load in this order"]
+    for name in load_order(names):
+        if " " in name or "#" in name:
+            print("%s: skipped, manifest names cannot contain spaces or '#'" % name, file=sys.stderr)
+            continue
+        path = os.path.join(args.directory, name)
+        try:
+            data = read_table(path)
+        except (ValueError, IndexError, struct.error) as error:
+            print("%s: skipped, %s" % (name, error), file=sys.stderr)
+            continue
+        if len(data) < 36 or struct.unpack_from("<I", data, 4)[0] != len(data):
+            print("%s: skipped, not an ACPI table of its own length" % name, file=sys.stderr)
+            continue
+        action = "replace" if name.upper() in replace else "append"
+        lines.append("%-8s %-24s size=%d hash=%016X" % (action, name, os.path.getsize(path), table_hash(data)))
+
+    for signature in args.drop:
+        if len(signature) != 4:
+            parser.error("--drop takes a four character signature, not %r" % signature)
+        lines.append("%-8s %s" % ("drop", signature))
+
+    output = args.output or os.path.join(args.directory, MANIFEST_NAME)
+    with open(output, "w", newline="\r\n") as handle:
+        handle.write("\n".join(lines) + "\n")
+    print("%s: %d entries" % (output, len(lines) - 1))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())